@@ -12,6 +12,84 @@ FetchContent_GetProperties(coconut
     BINARY_DIR COCONUT_BUILD_DIR
 )
 
+# Makes the file level declarations that match the pattern thread local, so that threads can
+# compile in parallel. Only used for the sources generated by cocogen, which coconut.patch can not
+# reach; the sources of CoCoNut itself are changed by the patch. Fails when nothing matches, as the
+# generated declaration then changed upstream.
+function(coconut_make_thread_local PATTERN)
+    set(FOUND FALSE)
+    foreach(SOURCE ${ARGN})
+        file(READ "${SOURCE}" CONTENT)
+        string(REGEX MATCH "\n(static |extern )?_Thread_local ${PATTERN}" DONE "${CONTENT}")
+        if(DONE)
+            set(FOUND TRUE)
+            continue()
+        endif()
+        string(REGEX REPLACE "\n((static |extern )?)(${PATTERN})" "\n\\1_Thread_local \\3"
+            PATCHED "${CONTENT}")
+        if(NOT PATCHED STREQUAL CONTENT)
+            file(WRITE "${SOURCE}" "${PATCHED}")
+            set(FOUND TRUE)
+        endif()
+    endforeach()
+    if(NOT FOUND)
+        message(FATAL_ERROR "No declaration matches '${PATTERN}' in ${ARGN}")
+    endif()
+endfunction()
+
+# The stack of the running traversals, a pointer to a traversal struct
+set(COCONUT_TRAVERSAL_STACK "(struct )?[A-Za-z_]*trav[A-Za-z_]* \\*[A-Za-z_]+( = NULL)?;")
+
+# Appends CCNresetTraversals, declared by coconut.patch, to the generated source that declares the
+# traversal stack. The type of the frames and their link to the frame below are looked up in the
+# sources, the configuration fails when either is not found. The traversals of civicc keep no
+# traversal data, so a frame is freed on its own.
+function(coconut_add_traversal_reset)
+    set(STACK_SOURCE "")
+    foreach(SOURCE ${ARGN})
+        file(READ "${SOURCE}" CONTENT)
+        if(CONTENT MATCHES
+            "\n(static )?_Thread_local struct ([A-Za-z_]*trav[A-Za-z_]*) \\*([A-Za-z_]+)( = NULL)?;")
+            set(STACK_SOURCE "${SOURCE}")
+            set(STACK_TYPE "${CMAKE_MATCH_2}")
+            set(STACK_NAME "${CMAKE_MATCH_3}")
+            break()
+        endif()
+    endforeach()
+    if(NOT STACK_SOURCE)
+        message(FATAL_ERROR "No traversal stack of struct frames found in ${ARGN}")
+    endif()
+
+    set(STACK_LINK "")
+    foreach(SOURCE ${ARGN})
+        file(READ "${SOURCE}" CONTENT)
+        if(CONTENT MATCHES "struct ${STACK_TYPE}[ \n]*{[^}]*struct ${STACK_TYPE} \\*([A-Za-z_]+);")
+            set(STACK_LINK "${CMAKE_MATCH_1}")
+            break()
+        endif()
+    endforeach()
+    if(NOT STACK_LINK)
+        message(FATAL_ERROR "No link between the frames of struct ${STACK_TYPE} found in ${ARGN}")
+    endif()
+
+    file(READ "${STACK_SOURCE}" CONTENT)
+    if(CONTENT MATCHES "CCNresetTraversals")
+        return()
+    endif()
+    file(APPEND "${STACK_SOURCE}" "
+#include <stdlib.h>
+
+void CCNresetTraversals(void)
+{
+    while (${STACK_NAME} != NULL) {
+        struct ${STACK_TYPE} *frame = ${STACK_NAME};
+        ${STACK_NAME} = frame->${STACK_LINK};
+        free(frame);
+    }
+}
+")
+endfunction()
+
 if(NOT DEFINED ${COCOGEN_DIR})
     set(COCOGEN_DIR "${COCONUT_BUILD_DIR}/cocogen")
 endif()
@@ -32,9 +110,23 @@ if(NOT EXISTS "${COCOGEN_DIR}/cocogen")
     else()
         set(COCONUT_COMPILE_OPTIONS "")
     endif()
-    execute_process(COMMAND "git" "apply" "${PATCH_FILE}"
+    # An earlier configuration may have applied the patch already
+    execute_process(COMMAND "git" "apply" "--reverse" "--check" "${PATCH_FILE}"
         WORKING_DIRECTORY "${COCONUT_ROOT_DIR}"
+        RESULT_VARIABLE PATCH_APPLIED
+        OUTPUT_QUIET ERROR_QUIET
     )
+    if(PATCH_APPLIED EQUAL 0)
+        set(PATCH_RET 0)
+    else()
+        execute_process(COMMAND "git" "apply" "${PATCH_FILE}"
+            WORKING_DIRECTORY "${COCONUT_ROOT_DIR}"
+            RESULT_VARIABLE PATCH_RET
+        )
+    endif()
+    if(NOT PATCH_RET EQUAL 0)
+        message(FATAL_ERROR "Could not apply ${PATCH_FILE} to CoCoNut (${PATCH_RET}), stopping CMake.")
+    endif()
     execute_process(COMMAND ${CMAKE_COMMAND} -G "${CMAKE_GENERATOR}" -B "${COCONUT_BUILD_DIR}" -DCMAKE_BUILD_TYPE=Release -DCMAKE_C_FLAGS=${COCONUT_COMPILE_OPTIONS} -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
         WORKING_DIRECTORY "${COCONUT_ROOT_DIR}"
     )
@@ -65,6 +157,12 @@ Maybe you forgot building the coconut project?")
     if(COCOGEN_RET AND NOT COCOGEN_RET EQUAL 0)
         message(FATAL_ERROR "cocogen generation failed (${COCOGEN_RET}), stopping CMake.")
     endif()
+
+    # Each thread traverses its own tree, the traversal stack is either generated or in copra
+    file(GLOB TRAVERSAL_SOURCES "${PROJECT_BINARY_DIR}/ccngen/*.[ch]"
+        "${COCONUT_ROOT_DIR}/copra/src/*.c" "${COCONUT_ROOT_DIR}/copra/ccn/*.h")
+    coconut_make_thread_local("${COCONUT_TRAVERSAL_STACK}" ${TRAVERSAL_SOURCES})
+    coconut_add_traversal_reset(${TRAVERSAL_SOURCES})
 endfunction()
 
 function(coconut_target_generate TARGET DSL_FILE BACKEND)
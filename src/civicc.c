@@ -0,0 +1,137 @@
+#include "civicc.h"
+#include "ccn/dynamic_core.h"
+#include "ccn/phase_driver.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/str.h"
+#include "recovery.h"
+#include "release_assert.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static _Thread_local struct civicc_result *current_result = NULL;
+static _Thread_local size_t diagnostic_capacity = 0;
+
+struct civicc_options civicc_default_options(void)
+{
+    struct civicc_options options = {
+        .optimize = true,
+        .tail_calls = false,
+        .slot_packing = false,
+        .scalar_promotion = false,
+        .value_ranges = false,
+        .unroll_limit = 0,
+        .inline_limit = 0,
+        .specialize_limit = 0,
+        .eval_limit = 0,
+        .jobs = 1,
+    };
+    return options;
+}
+
+static void collect_diagnostic(enum cti_type type, const struct ctinfo *info, const char *message)
+{
+    struct civicc_result *result = current_result;
+    if (result->diagnostic_count == diagnostic_capacity)
+    {
+        diagnostic_capacity = diagnostic_capacity == 0 ? 8 : diagnostic_capacity * 2;
+        result->diagnostics =
+            realloc(result->diagnostics, diagnostic_capacity * sizeof(struct civicc_diagnostic));
+        release_assert(result->diagnostics != NULL);
+    }
+
+    struct civicc_diagnostic *diagnostic = &result->diagnostics[result->diagnostic_count++];
+    diagnostic->severity = type == CTI_ERROR  ? CIVICC_ERROR
+                           : type == CTI_WARN ? CIVICC_WARNING
+                                              : CIVICC_NOTE;
+    diagnostic->first_line = info == NULL ? 0 : info->first_line;
+    diagnostic->first_column = info == NULL ? 0 : info->first_column;
+    diagnostic->last_line = info == NULL ? 0 : info->last_line;
+    diagnostic->last_column = info == NULL ? 0 : info->last_column;
+    diagnostic->message = STRcpy(message);
+    if (type == CTI_ERROR)
+    {
+        result->success = false;
+    }
+}
+
+static void run_phases(void *arg)
+{
+    (void)arg;
+    CCNrun(NULL);
+}
+
+/**
+ * Runs the phases on the source with the globals, phase driver and diagnostics of the calling
+ * thread replaced, they are restored afterwards. The code generation writes into a memory stream,
+ * so the assembly grows with the program instead of a buffer of fixed size. An error aborts
+ * only this compilation.
+ */
+struct civicc_result *civicc_compile(const char *name, const char *source, size_t length,
+                                     const struct civicc_options *options)
+{
+    release_assert(length <= UINT32_MAX);
+    struct civicc_options defaults = civicc_default_options();
+    if (options == NULL)
+    {
+        options = &defaults;
+    }
+
+    struct civicc_result *result = calloc(1, sizeof(struct civicc_result));
+    release_assert(result != NULL);
+    result->success = true;
+
+    struct globals saved_global = global;
+    struct phase_driver saved_phase_driver = phase_driver;
+    cti_handler_ft saved_handler = cti_handler;
+    struct civicc_result *saved_result = current_result;
+    size_t saved_capacity = diagnostic_capacity;
+
+    GLBinitializeGlobals();
+    GLBapplyOptions(options);
+    global.preprocessor_enabled = false;
+    global.input_file = name;
+    global.input_buf = (char *)source;
+    global.input_buf_len = (uint32_t)length;
+    FILE *stream = open_memstream(&result->assembly, &result->assembly_length);
+    release_assert(stream != NULL);
+    global.default_out_stream = stream;
+
+    phase_driver.verbosity = PD_V_QUIET;
+    phase_driver.hooks = (struct phase_driver_hooks){0};
+    cti_handler = collect_diagnostic;
+    current_result = result;
+    diagnostic_capacity = 0;
+
+    if (!recovery_run(run_phases, NULL))
+    {
+        result->success = false;
+    }
+    fclose(stream);
+
+    global = saved_global;
+    phase_driver = saved_phase_driver;
+    cti_handler = saved_handler;
+    current_result = saved_result;
+    diagnostic_capacity = saved_capacity;
+    return result;
+}
+
+void civicc_free_result(struct civicc_result *result)
+{
+    if (result == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < result->diagnostic_count; i++)
+    {
+        free(result->diagnostics[i].message);
+    }
+    free(result->diagnostics);
+    free(result->assembly);
+    free(result);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Embeddable API of libcivicc, compiling CiviC sources in memory. A compilation runs on the calling
+ * thread with its own compiler state, traversal stack and error counters, so threads can compile
+ * in parallel; only the scanning takes turns. The source is parsed as is, without the C
+ * preprocessor.
+ */
+
+enum civicc_severity
+{
+    CIVICC_NOTE,
+    CIVICC_WARNING,
+    CIVICC_ERROR,
+};
+
+/// Diagnostic of a compilation, the lines and columns are 0 if the diagnostic has no location.
+struct civicc_diagnostic
+{
+    enum civicc_severity severity;
+    int first_line;
+    int first_column;
+    int last_line;
+    int last_column;
+    char *message;
+};
+
+struct civicc_options
+{
+    bool optimize;
+    bool tail_calls;   // Turns self tail calls into loops
+    bool slot_packing; // Shares the frame slots of locals with disjoint live ranges
+    bool scalar_promotion; // Keeps the globals and outer variables of loops in locals
+    bool value_ranges;     // Decides int comparisons from the value ranges of the locals
+    int unroll_limit;  // Maximal AST node count of an unrolled for loop body, 0 disables unrolling
+    int inline_limit;  // Maximal inlining cost of a function body, 0 disables inlining
+    int specialize_limit; // Maximal AST node count of the specialized function copies, 0 disables
+                          // the specialization
+    int eval_limit;    // Maximal evaluation steps of a pure call with literal arguments, 0
+                       // disables the evaluation
+    int jobs;          // Threads working on the functions in parallel, 1 works sequentially
+};
+
+/// Owned result of a compilation, freed with civicc_free_result.
+struct civicc_result
+{
+    bool success; // The compilation reported no errors
+    char *assembly; // Null terminated
+    size_t assembly_length;
+    struct civicc_diagnostic *diagnostics;
+    size_t diagnostic_count;
+};
+
+// Gets the options of the command line compiler without flags.
+struct civicc_options civicc_default_options(void);
+// Compiles the source to assembly. The name is used for the diagnostics only, no file is read or
+// written. The options are the defaults if NULL. A compilation error does not exit the process,
+// it is reported in the diagnostics of the result.
+struct civicc_result *civicc_compile(const char *name, const char *source, size_t length,
+                                     const struct civicc_options *options);
+void civicc_free_result(struct civicc_result *result);
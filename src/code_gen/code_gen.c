@@ -4,13 +4,17 @@
 #include "global/globals.h"
 #include "palm/hash_table.h"
 #include "palm/str.h"
+#include "profiler.h"
 #include "release_assert.h"
+#include "scheduler.h"
 #include "to_string.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
 #include <ccngen/trav.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -20,23 +24,58 @@
 #include <string.h>
 #include <strings.h>
 
-static htable_stptr current = NULL;
-static htable_stptr index_table = NULL;
-static htable_stptr import_table = NULL;
-static htable_stptr constant_table = NULL;
-static enum DataType type = DT_NULL;
-static node_st *fundef = NULL;
-static uint32_t idx_counter = 0;
-static uint32_t fun_import_counter = 0;
-static uint32_t var_import_counter = 0;
-static uint32_t constant_counter = 0;
-static FILE *out_file = NULL;
-static uint32_t if_counter = 0;
-static uint32_t loop_counter = 0;
-static bool is_expr = true;
-static bool is_arrayexpr_store = false;
-static uint32_t lfun_counter = 0; // local function counter
-static bool preprocess_decls = true;
+/**
+ * A top-level function generated on a worker thread. Each function is generated twice. The collect
+ * pass counts the labels and records the constants of each function, from which the labels and
+ * the constant pool are numbered in source order. The emit pass then generates each function into
+ * its own buffer, so the concatenated buffers equal the sequential output.
+ */
+struct codegen_job
+{
+    node_st *fundef;
+    size_t index;
+    bool emit;
+    htable_stptr symbols;         // Symbols of the program
+    htable_stptr index_table;     // Indices of the globals
+    htable_stptr import_table;    // Read-only
+    htable_stptr constant_pool;   // Constant indices of the program, read-only
+    htable_stptr constant_owners; // Index + 1 of the job that declares the constant
+    uint32_t if_counter;          // Label bases in the emit pass, label counts after collecting
+    uint32_t loop_counter;
+    uint32_t lfun_counter;
+    char **constants; // Constants in order of their first use, set by the collect pass
+    uint32_t constant_count;
+    char *output;
+    size_t output_size;
+    struct diagnostics diagnostics; // Warnings of the emit pass
+};
+
+/// Queue of jobs, the worker threads take the next job until all are done
+struct codegen_queue
+{
+    struct codegen_job *jobs;
+    size_t count;
+    atomic_size_t next;
+};
+
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr index_table = NULL;
+static _Thread_local htable_stptr import_table = NULL;
+static _Thread_local htable_stptr constant_table = NULL;
+static _Thread_local enum DataType type = DT_NULL;
+static _Thread_local node_st *fundef = NULL;
+static _Thread_local uint32_t idx_counter = 0;
+static _Thread_local uint32_t fun_import_counter = 0;
+static _Thread_local uint32_t var_import_counter = 0;
+static _Thread_local uint32_t constant_counter = 0;
+static _Thread_local FILE *out_file = NULL;
+static _Thread_local uint32_t if_counter = 0;
+static _Thread_local uint32_t loop_counter = 0;
+static _Thread_local bool is_expr = true;
+static _Thread_local bool is_arrayexpr_store = false;
+static _Thread_local uint32_t lfun_counter = 0; // local function counter
+static _Thread_local bool preprocess_decls = true;
+static _Thread_local struct codegen_job *job = NULL; // Function generated by this worker thread
 
 static void reset_state()
 {
@@ -57,11 +96,35 @@ static void reset_state()
     is_arrayexpr_store = false;
     lfun_counter = 0;
     preprocess_decls = true;
+    job = NULL;
 }
 
 /**
  * Helper functions.
  */
+
+/**
+ * Reports a warning once per function. A job generates its function twice, so the collect pass
+ * drops the warning and the emit pass buffers it, the buffers are reported in source order.
+ */
+static void report_warning(node_st *node, const char *message)
+{
+    if (job != NULL && !job->emit)
+    {
+        return;
+    }
+
+    struct ctinfo info = NODE_TO_CTINFO(node);
+    if (job == NULL)
+    {
+        CTIobj(CTI_WARN, true, info, "%s", message);
+    }
+    else
+    {
+        diagnostics_add(&job->diagnostics, CTI_WARN, true, info, message);
+    }
+}
+
 static void out(const char *restrict format, ...)
 {
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
@@ -271,6 +334,34 @@ static ptrdiff_t IDXdeep_lookup(htable_stptr table, char *key)
     return (ptrdiff_t)entry - 1;
 }
 
+/// Adds the constant to the constant table. Returns true if the constant has to be declared at
+/// this use, in the emit pass only the first function using a constant declares it.
+static bool add_constant(char *val_str)
+{
+    if (HTlookup(constant_table, val_str) != NULL)
+    {
+        return false;
+    }
+
+    bool success = IDXinsert(constant_table, STRcpy(val_str), constant_counter++);
+    release_assert(success);
+    if (job != NULL && job->emit)
+    {
+        void *owner = HTlookup(job->constant_owners, val_str);
+        return owner != NULL && (size_t)owner == job->index + 1;
+    }
+    return true;
+}
+
+static ptrdiff_t constant_index(char *val_str)
+{
+    if (job != NULL && job->emit)
+    {
+        return IDXlookup(job->constant_pool, val_str);
+    }
+    return IDXlookup(constant_table, val_str);
+}
+
 /// Recursive lookup into the index, import and symbol table parallel and in all theses parents
 /// symbol table for the given name. Also defines the level at which the index was found.
 // The (negated/negative level) - 1 indicates that is in global scope i.e. out_level = -level - 1
@@ -325,6 +416,324 @@ static ptrdiff_t IDXsmart_lookup(htable_stptr table, htable_stptr import_table,
     return (ptrdiff_t)idx - 1;
 }
 
+/// Loads the integer constant onto the stack
+static void loadi(int val)
+{
+    if (val == 0)
+    {
+        inst0("iloadc_0");
+    }
+    else if (val == 1)
+    {
+        inst0("iloadc_1");
+    }
+    else if (val == -1)
+    {
+        inst0("iloadc_m1");
+    }
+    else
+    {
+        // We have to construct a negation, because the CiviC Assembler does not support negative
+        // integer
+        bool is_negative = val < 0;
+        val = is_negative ? -val : val;
+        release_assert(val > 0);
+        char *val_str = int_to_str(val);
+        if (add_constant(val_str))
+        {
+            consti(val);
+        }
+        inst1("iloadc", constant_index(val_str));
+        free(val_str);
+
+        if (is_negative)
+        {
+            inst0("ineg");
+        }
+    }
+}
+
+/// Loads the array reference found by IDXsmart_lookup onto the stack
+static void load_array(char *name, ptrdiff_t idx, int level, node_st *entry)
+{
+    if (level == 0)
+    {
+        // Load the array reference
+        ptrdiff_t check_idx = IDXdeep_lookup(index_table, name);
+        release_assert(check_idx == idx);
+
+        char load_str = '\0';
+        switch (idx)
+        {
+        case 0:
+            load_str = '0';
+            break;
+        case 1:
+            load_str = '1';
+            break;
+        case 2:
+            load_str = '2';
+            break;
+        case 3:
+            load_str = '3';
+            break;
+        default:
+            release_assert(idx > 3);
+            break;
+        }
+
+        if (load_str != '\0')
+        {
+            char *inst = STRfmt("aload_%c", load_str);
+            inst0(inst);
+            free(inst);
+        }
+        else
+        {
+            inst1("aload", idx);
+        }
+    }
+    else if (level > 0)
+    {
+        // Load the array reference
+        ptrdiff_t check_idx = IDXdeep_lookup(index_table, name);
+        release_assert(check_idx == idx);
+
+        inst2("aloadn", level, idx);
+    }
+    else // level < 0
+    {
+        if (NODE_TYPE(entry) == NT_GLOBALDEC)
+        {
+            ptrdiff_t check_idx = IDXlookup(import_table, name);
+            release_assert(check_idx == idx);
+            inst1("aloade", idx);
+        }
+        else
+        {
+            // Load the array reference
+            ptrdiff_t check_idx = IDXdeep_lookup(index_table, name);
+            release_assert(check_idx == idx);
+            inst1("aloadg", idx);
+        }
+    }
+}
+
+/// Generates the function of the job with the state of this thread.
+static void generate_function(struct codegen_job *codegen_job)
+{
+    reset_state();
+    job = codegen_job;
+    current = job->symbols;
+    index_table = job->index_table;
+    import_table = job->import_table;
+    constant_table = HTnew_String(2 << 6);
+    preprocess_decls = false;
+    if_counter = job->if_counter;
+    loop_counter = job->loop_counter;
+    lfun_counter = job->lfun_counter;
+
+    if (job->emit)
+    {
+        out_file = open_memstream(&job->output, &job->output_size);
+        release_assert(out_file != NULL);
+    }
+
+    TRAVstart(job->fundef, TRAV_CG_CG);
+
+    if (job->emit)
+    {
+        fclose(out_file);
+        for (htable_iter_st *iter = HTiterate(constant_table); iter; iter = HTiterateNext(iter))
+        {
+            free(HTiterKey(iter));
+        }
+    }
+    else
+    {
+        job->if_counter = if_counter - job->if_counter;
+        job->loop_counter = loop_counter - job->loop_counter;
+        job->lfun_counter = lfun_counter - job->lfun_counter;
+        job->constant_count = constant_counter;
+        job->constants = malloc(constant_counter * sizeof(char *) + 1);
+        release_assert(job->constants != NULL);
+        for (htable_iter_st *iter = HTiterate(constant_table); iter; iter = HTiterateNext(iter))
+        {
+            ptrdiff_t idx = (ptrdiff_t)HTiterValue(iter) - 1;
+            job->constants[idx] = HTiterKey(iter);
+        }
+    }
+
+    HTdelete(constant_table);
+    reset_state();
+}
+
+static void *codegen_worker(void *arg)
+{
+    struct codegen_queue *queue = arg;
+    for (size_t i = atomic_fetch_add(&queue->next, 1); i < queue->count;
+         i = atomic_fetch_add(&queue->next, 1))
+    {
+        generate_function(&queue->jobs[i]);
+    }
+    return NULL;
+}
+
+static void *codegen_worker_thread(void *arg)
+{
+    codegen_worker(arg);
+    struct profiler_allocations *allocations = malloc(sizeof(struct profiler_allocations));
+    release_assert(allocations != NULL);
+    *allocations = profiler_take_allocations();
+    return allocations;
+}
+
+/// Runs the jobs on the worker threads, the calling thread works as well.
+static void run_jobs(struct codegen_job *jobs, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    struct codegen_queue queue = {.jobs = jobs, .count = count};
+    atomic_init(&queue.next, 0);
+
+    size_t thread_count = (size_t)global.jobs - 1;
+    thread_count = thread_count < count ? thread_count : count - 1;
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t) + 1);
+    release_assert(threads != NULL);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        int error = pthread_create(&threads[i], NULL, codegen_worker_thread, &queue);
+        release_assert(error == 0);
+    }
+
+    // The jobs change the state of the calling thread
+    struct globals parent_global = global;
+    global.output_buf = NULL;
+    global.output_buf_len = 0;
+    codegen_worker(&queue);
+    global = parent_global;
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        void *allocations = NULL;
+        pthread_join(threads[i], &allocations);
+        profiler_add_allocations(*(struct profiler_allocations *)allocations);
+        free(allocations);
+    }
+    free(threads);
+}
+
+/**
+ * Generates the top-level functions in parallel. The collect pass numbers the labels and the
+ * constants of each function in source order, the emit pass generates each function into its
+ * own buffer, which are written in source order together with the warnings of the function.
+ */
+static void generate_functions(node_st *program)
+{
+    size_t count = 0;
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        if (NODE_TYPE(DECLARATIONS_DECL(decls)) == NT_FUNDEF)
+        {
+            count++;
+        }
+    }
+
+    struct codegen_job *jobs = calloc(count + 1, sizeof(struct codegen_job));
+    release_assert(jobs != NULL);
+    htable_stptr constant_owners = HTnew_String(2 << 8);
+    size_t i = 0;
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        if (NODE_TYPE(DECLARATIONS_DECL(decls)) == NT_FUNDEF)
+        {
+            jobs[i].fundef = DECLARATIONS_DECL(decls);
+            jobs[i].index = i;
+            jobs[i].symbols = current;
+            jobs[i].index_table = index_table;
+            jobs[i].import_table = import_table;
+            jobs[i].constant_pool = constant_table;
+            jobs[i].constant_owners = constant_owners;
+            i++;
+        }
+    }
+
+    // Save the thread state, as the calling thread also runs jobs
+    htable_stptr program_current = current;
+    htable_stptr program_index_table = index_table;
+    htable_stptr program_import_table = import_table;
+    htable_stptr program_constant_table = constant_table;
+    uint32_t program_constant_counter = constant_counter;
+    uint32_t program_if_counter = if_counter;
+    uint32_t program_loop_counter = loop_counter;
+    uint32_t program_lfun_counter = lfun_counter;
+    FILE *program_out_file = out_file;
+
+    run_jobs(jobs, count);
+
+    // Number the labels and constants in source order
+    for (i = 0; i < count; i++)
+    {
+        uint32_t if_count = jobs[i].if_counter;
+        uint32_t loop_count = jobs[i].loop_counter;
+        uint32_t lfun_count = jobs[i].lfun_counter;
+        jobs[i].if_counter = program_if_counter;
+        jobs[i].loop_counter = program_loop_counter;
+        jobs[i].lfun_counter = program_lfun_counter;
+        program_if_counter += if_count;
+        program_loop_counter += loop_count;
+        program_lfun_counter += lfun_count;
+
+        for (uint32_t c = 0; c < jobs[i].constant_count; c++)
+        {
+            char *key = jobs[i].constants[c];
+            if (HTlookup(program_constant_table, key) == NULL)
+            {
+                bool success = IDXinsert(program_constant_table, key, program_constant_counter++);
+                release_assert(success);
+                success = HTinsert(constant_owners, key, (void *)(i + 1));
+                release_assert(success);
+            }
+            else
+            {
+                free(key);
+            }
+        }
+        free(jobs[i].constants);
+        jobs[i].constants = NULL;
+        jobs[i].emit = true;
+    }
+
+    run_jobs(jobs, count);
+
+    current = program_current;
+    index_table = program_index_table;
+    import_table = program_import_table;
+    constant_table = program_constant_table;
+    constant_counter = program_constant_counter;
+    if_counter = program_if_counter;
+    loop_counter = program_loop_counter;
+    lfun_counter = program_lfun_counter;
+    out_file = program_out_file;
+    preprocess_decls = false;
+
+    for (i = 0; i < count; i++)
+    {
+        diagnostics_report(&jobs[i].diagnostics);
+        if (jobs[i].output_size > 0)
+        {
+            out("%s", jobs[i].output);
+        }
+        free(jobs[i].output);
+    }
+
+    HTdelete(constant_owners);
+    free(jobs);
+}
+
 /**
  * CodeGen Nodes
  */
@@ -357,7 +766,14 @@ node_st *CG_CGprogram(node_st *node)
     preprocess_decls = true;
     TRAVchildren(node);
     preprocess_decls = false;
-    TRAVchildren(node);
+    if (global.jobs > 1)
+    {
+        generate_functions(node);
+    }
+    else
+    {
+        TRAVchildren(node);
+    }
 
     HTdelete(table);
     HTdelete(import_table);
@@ -577,10 +993,15 @@ node_st *CG_CGfunbody(node_st *node)
     {
         node_st *lfundef = LOCALFUNDEFS_LOCALFUNDEF(lfun);
         char *fun_name = VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(lfundef)));
-        char *old_fun_name = fun_name;
-        fun_name = STRfmt("@fun_lf%d_%s", lfun_counter++, get_pretty_name(old_fun_name));
-        VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(lfundef))) = fun_name;
-        free(old_fun_name);
+        uint32_t lfun_index = lfun_counter++;
+        if (job == NULL || job->emit)
+        {
+            // The collect pass only counts, so the names are renamed once
+            char *old_fun_name = fun_name;
+            fun_name = STRfmt("@fun_lf%d_%s", lfun_index, get_pretty_name(old_fun_name));
+            VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(lfundef))) = fun_name;
+            free(old_fun_name);
+        }
         lfun = LOCALFUNDEFS_NEXT(lfun);
     }
 
@@ -733,7 +1154,7 @@ node_st *CG_CGassign(node_st *node)
                         is_expr = parent_is_expr;
 
                         char *val_str = int_to_str(val);
-                        ptrdiff_t const_index = IDXlookup(constant_table, val_str);
+                        ptrdiff_t const_index = constant_index(val_str);
                         free(val_str);
                         release_assert(val > 1);
                         if (BINOP_OP(expr) == BO_add)
@@ -905,16 +1326,14 @@ node_st *CG_CGbinop(node_st *node)
         case DT_int:
             if (NODE_TYPE(BINOP_RIGHT(node)) == NT_INT && INT_VAL(BINOP_RIGHT(node)) == 0)
             {
-                struct ctinfo info = NODE_TO_CTINFO(node);
-                CTIobj(CTI_WARN, true, info, "Division by zero.");
+                report_warning(node, "Division by zero.");
             }
             inst0("idiv");
             break;
         case DT_float:
             if (NODE_TYPE(BINOP_RIGHT(node)) == NT_FLOAT && FLOAT_VAL(BINOP_RIGHT(node)) == 0.0)
             {
-                struct ctinfo info = NODE_TO_CTINFO(node);
-                CTIobj(CTI_WARN, true, info, "Division by zero.");
+                report_warning(node, "Division by zero.");
             }
             inst0("fdiv");
             break;
@@ -1328,8 +1747,7 @@ node_st *CG_CGforloop(node_st *node)
     node_st *iter = FORLOOP_ITER(node);
     if (iter != NULL && NODE_TYPE(iter) == NT_INT && INT_VAL(iter) == 0)
     {
-        struct ctinfo info = NODE_TO_CTINFO(iter);
-        CTIobj(CTI_WARN, true, info, "Step is '0' and may lead to undefined behaviour.");
+        report_warning(iter, "Step is '0' and may lead to undefined behaviour.");
     }
 
     node_st *assign = FORLOOP_ASSIGN(node);
@@ -1403,7 +1821,7 @@ node_st *CG_CGforloop(node_st *node)
         type = parent_type;
         is_expr = parent_is_expr;
         char *val_str = int_to_str(INT_VAL(iter));
-        inst2("iinc", IDXlookup(index_table, assign_name), IDXlookup(constant_table, val_str));
+        inst2("iinc", IDXlookup(index_table, assign_name), constant_index(val_str));
         free(val_str);
         instL("jump", start_label);
         label(end_label);
@@ -1715,67 +2133,7 @@ node_st *CG_CGarrayexpr(node_st *node)
     type = parent_type;
     release_assert(EXPRS_NEXT(ARRAYEXPR_DIMS(node)) == NULL); // Only 1d allowed
 
-    if (level == 0)
-    {
-        // Load the array reference
-        ptrdiff_t check_idx = IDXdeep_lookup(index_table, VAR_NAME(ARRAYEXPR_VAR(node)));
-        release_assert(check_idx == idx);
-
-        char load_str = '\0';
-        switch (idx)
-        {
-        case 0:
-            load_str = '0';
-            break;
-        case 1:
-            load_str = '1';
-            break;
-        case 2:
-            load_str = '2';
-            break;
-        case 3:
-            load_str = '3';
-            break;
-        default:
-            release_assert(idx > 3);
-            break;
-        }
-
-        if (load_str != '\0')
-        {
-            char *inst = STRfmt("aload_%c", load_str);
-            inst0(inst);
-            free(inst);
-        }
-        else
-        {
-            inst1("aload", idx);
-        }
-    }
-    else if (level > 0)
-    {
-        // Load the array reference
-        ptrdiff_t check_idx = IDXdeep_lookup(index_table, VAR_NAME(ARRAYEXPR_VAR(node)));
-        release_assert(check_idx == idx);
-
-        inst2("aloadn", level, idx);
-    }
-    else // level < 0
-    {
-        if (NODE_TYPE(entry) == NT_GLOBALDEC)
-        {
-            ptrdiff_t check_idx = IDXlookup(import_table, VAR_NAME(ARRAYEXPR_VAR(node)));
-            release_assert(check_idx == idx);
-            inst1("aloade", idx);
-        }
-        else
-        {
-            // Load the array reference
-            ptrdiff_t check_idx = IDXdeep_lookup(index_table, VAR_NAME(ARRAYEXPR_VAR(node)));
-            release_assert(check_idx == idx);
-            inst1("aloadg", idx);
-        }
-    }
+    load_array(VAR_NAME(ARRAYEXPR_VAR(node)), idx, level, entry);
 
     // Load the array element
     switch (has_type)
@@ -1819,69 +2177,114 @@ node_st *CG_CGarrayassign(node_st *node)
     return node;
 }
 
-node_st *CG_CGint(node_st *node)
+node_st *CG_CGarraybulkassign(node_st *node)
 {
-    release_assert(type == DT_int);
-    int val = INT_VAL(node);
-    if (is_expr == false)
-    {
-        char *val_str = int_to_str(val);
-        if (HTlookup(constant_table, val_str) == NULL)
-        {
-            bool success = IDXinsert(constant_table, val_str, constant_counter++);
-            release_assert(success);
-            consti(val);
-        }
-        else
-        {
-            free(val_str);
-        }
-        return node;
-    }
+    enum DataType parent_type = type;
+    char *name = VAR_NAME(ARRAYBULKASSIGN_VAR(node));
+    int level = INT_MAX;
+    node_st *entry = NULL;
+    ptrdiff_t idx = IDXsmart_lookup(index_table, import_table, current, name, &level, &entry);
+    release_assert(level != INT_MAX);
+    release_assert(entry != NULL);
+    enum DataType has_type = symbol_to_type(entry);
 
-    if (val == 0)
-    {
-        inst0("iloadc_0");
-    }
-    else if (val == 1)
-    {
-        inst0("iloadc_1");
-    }
-    else if (val == -1)
+    const char *store_inst = NULL;
+    switch (has_type)
     {
-        inst0("iloadc_m1");
+    case DT_NULL:
+    case DT_void:
+        release_assert(false);
+        break;
+    case DT_bool:
+        store_inst = "bstorea";
+        break;
+    case DT_int:
+        store_inst = "istorea";
+        break;
+    case DT_float:
+        store_inst = "fstorea";
+        break;
     }
-    else
+
+    int offset = 0;
+    node_st *values = ARRAYBULKASSIGN_VALUES(node);
+    while (values != NULL)
     {
-        // We have to construct a negation, because the CiviC Assembler does not support negative
-        // integer
-        bool is_negative = val < 0;
-        val = is_negative ? -val : val;
-        release_assert(val > 0);
-        char *val_str = int_to_str(val);
-        if (HTlookup(constant_table, val_str) == NULL)
+        node_st *value = EXPRS_EXPR(values);
+        int run = literal_run_length(values);
+        if (run >= bulk_fill_min_run && ARRAYBULKASSIGN_INDEX(node) != NULL)
         {
-            bool success = IDXinsert(constant_table, val_str, constant_counter++);
-            release_assert(success);
-            consti(val);
-
-            ptrdiff_t idx = IDXlookup(constant_table, val_str);
-            inst1("iloadc", idx);
+            // Repeated values are filled with a loop
+            // for (index = offset; index < offset + run; index++) {
+            //      var[index] = value
+            // }
+            node_st *index_var = ARRAYBULKASSIGN_INDEX(node);
+            ptrdiff_t index_idx = IDXlookup(index_table, VAR_NAME(index_var));
+            char *start_label = STRfmt("_fill%d", loop_counter);
+            char *end_label = STRfmt("_endfill%d", loop_counter);
+            loop_counter++;
+
+            loadi(offset);
+            inst1("istore", index_idx);
+            label(start_label);
+            type = DT_int;
+            TRAVopt(index_var);
+            loadi(offset + run);
+            inst0("ilt");
+            instL("branch_f", end_label);
+            type = has_type;
+            TRAVopt(value);
+            type = DT_int;
+            TRAVopt(index_var);
+            load_array(name, idx, level, entry);
+            inst0(store_inst);
+            inst1("iinc_1", index_idx);
+            instL("jump", start_label);
+            label(end_label);
+
+            free(start_label);
+            free(end_label);
         }
         else
         {
-            ptrdiff_t idx = IDXlookup(constant_table, val_str);
-            inst1("iloadc", idx);
+            // Constant values are stored directly to their constant index
+            for (int i = 0; i < run; i++)
+            {
+                type = has_type;
+                TRAVopt(value);
+                loadi(offset + i);
+                load_array(name, idx, level, entry);
+                inst0(store_inst);
+            }
+        }
 
-            free(val_str);
+        offset += run;
+        for (int i = 0; i < run; i++)
+        {
+            values = EXPRS_NEXT(values);
         }
+    }
 
-        if (is_negative)
+    type = parent_type;
+    return node;
+}
+
+node_st *CG_CGint(node_st *node)
+{
+    release_assert(type == DT_int);
+    int val = INT_VAL(node);
+    if (is_expr == false)
+    {
+        char *val_str = int_to_str(val);
+        if (add_constant(val_str))
         {
-            inst0("ineg");
+            consti(val);
         }
+        free(val_str);
+        return node;
     }
 
+    loadi(val);
     return node;
 }
 
@@ -1900,22 +2303,12 @@ node_st *CG_CGfloat(node_st *node)
     else
     {
         char *val_str = float_to_str(val);
-        if (HTlookup(constant_table, val_str) == NULL)
+        if (add_constant(val_str))
         {
-            bool success = IDXinsert(constant_table, val_str, constant_counter++);
-            release_assert(success);
             constf(val);
-
-            ptrdiff_t idx = IDXlookup(constant_table, val_str);
-            inst1("floadc", idx);
-        }
-        else
-        {
-            ptrdiff_t idx = IDXlookup(constant_table, val_str);
-            inst1("floadc", idx);
-
-            free(val_str);
         }
+        inst1("floadc", constant_index(val_str));
+        free(val_str);
     }
 
     return node;
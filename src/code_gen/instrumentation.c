@@ -0,0 +1,407 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "symbol_keys.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The '_' prefix of the pretty names is not allowed for user identifiers, so they can not clash
+static const char *counters_name = "@0___counters";
+static const char *dump_name = "@fun___dump_counters";
+static const char *index_name = "@counter_index";
+static const char *result_name = "@counter_result";
+static const char *print_int_name = "@fun_printInt";
+static const char *print_newlines_name = "@fun_printNewlines";
+
+/// Source location of a counter, written as a line of the mapping file.
+struct counter_site
+{
+    const char *kind;
+    const char *function;
+    const char *file;
+    uint32_t line;
+    uint32_t col;
+};
+
+static _Thread_local struct counter_site *sites = NULL;
+static _Thread_local size_t site_count = 0;
+static _Thread_local size_t site_capacity = 0;
+static _Thread_local node_st *main_fundef = NULL; // Dumps the counters before its returns
+static _Thread_local node_st *result_var = NULL;  // Holds the return value of main during the dump
+static _Thread_local const char *function_name = NULL;
+
+static void reset_state()
+{
+    sites = NULL;
+    site_count = 0;
+    site_capacity = 0;
+    main_fundef = NULL;
+    result_var = NULL;
+    function_name = NULL;
+}
+
+/// Registers a counter at the location of the node and returns its id.
+static int add_site(node_st *node, const char *kind)
+{
+    if (site_count == site_capacity)
+    {
+        site_capacity = site_capacity == 0 ? 64 : site_capacity * 2;
+        sites = realloc(sites, site_capacity * sizeof(struct counter_site));
+        release_assert(sites != NULL);
+    }
+
+    struct counter_site *site = &sites[site_count];
+    site->kind = kind;
+    site->function = function_name;
+    site->file = NODE_FILENAME(node) != NULL ? NODE_FILENAME(node) : global.input_file;
+    site->line = NODE_BLINE(node);
+    site->col = NODE_BCOL(node);
+    release_assert(site_count < INT_MAX);
+    return (int)site_count++;
+}
+
+static node_st *new_counter(int id)
+{
+    return ASTarrayexpr(ASTexprs(ASTint(id), NULL), ASTvar(STRcpy(counters_name)));
+}
+
+/// Prepends the increment of a new counter located at the node to the block, an empty block gets a
+/// new statements node.
+static node_st *count_block(node_st *block, node_st *node, const char *kind)
+{
+    int id = add_site(node, kind);
+    node_st *sum = ASTbinop(new_counter(id), ASTint(1), BO_add, DT_int);
+    return ASTstatements(ASTarrayassign(new_counter(id), sum), block);
+}
+
+static node_st *new_dump_call()
+{
+    return ASTproccall(ASTvar(STRcpy(dump_name)), NULL);
+}
+
+/**
+ * Dumps the counters before the return of main. The return value is stored in a local first, as
+ * calls in it would increment the counters after the dump.
+ * Example:
+ *  return f(x); => @counter_result = f(x); __dump_counters(); return @counter_result;
+ */
+static node_st *dump_before_return(node_st *stmts)
+{
+    node_st *ret = STATEMENTS_STMT(stmts);
+    node_st *expr = RETSTATEMENT_EXPR(ret);
+    node_st *ret_stmts = ASTstatements(ret, STATEMENTS_NEXT(stmts));
+    STATEMENTS_STMT(stmts) = new_dump_call();
+    STATEMENTS_NEXT(stmts) = ret_stmts;
+    if (expr == NULL || is_literal(expr) || NODE_TYPE(expr) == NT_VAR)
+    {
+        return ret_stmts;
+    }
+
+    if (result_var == NULL)
+    {
+        result_var = ASTvar(STRcpy(result_name));
+        node_st *vardec =
+            ASTvardec(result_var, NULL, FUNHEADER_TYPE(FUNDEF_FUNHEADER(main_fundef)));
+        add_vardec(vardec, NULL, FUNDEF_FUNBODY(main_fundef));
+        bool success = HTinsert(FUNDEF_SYMBOLS(main_fundef), VAR_NAME(result_var), vardec);
+        release_assert(success);
+    }
+
+    STATEMENTS_NEXT(stmts) = ASTstatements(STATEMENTS_STMT(stmts), ret_stmts);
+    STATEMENTS_STMT(stmts) = ASTassign(CCNcopy(result_var), expr);
+    RETSTATEMENT_EXPR(ret) = CCNcopy(result_var);
+    return ret_stmts;
+}
+
+static void walk_stmts(node_st *stmts, bool in_main);
+
+/// Counts the branch or loop body, located at its first statement or at the statement owning an
+/// empty body, and the blocks within it.
+static node_st *count_body(node_st *block, node_st *stmt, const char *kind, bool in_main)
+{
+    block = count_block(block, block != NULL ? STATEMENTS_STMT(block) : stmt, kind);
+    walk_stmts(STATEMENTS_NEXT(block), in_main);
+    return block;
+}
+
+static void walk_stmt(node_st *stmt, bool in_main)
+{
+    switch (NODE_TYPE(stmt))
+    {
+    case NT_IFSTATEMENT:
+        IFSTATEMENT_BLOCK(stmt) = count_body(IFSTATEMENT_BLOCK(stmt), stmt, "then", in_main);
+        IFSTATEMENT_ELSE_BLOCK(stmt) =
+            count_body(IFSTATEMENT_ELSE_BLOCK(stmt), stmt, "else", in_main);
+        break;
+    case NT_WHILELOOP:
+        WHILELOOP_BLOCK(stmt) = count_body(WHILELOOP_BLOCK(stmt), stmt, "loop", in_main);
+        break;
+    case NT_DOWHILELOOP:
+        DOWHILELOOP_BLOCK(stmt) = count_body(DOWHILELOOP_BLOCK(stmt), stmt, "loop", in_main);
+        break;
+    case NT_FORLOOP:
+        FORLOOP_BLOCK(stmt) = count_body(FORLOOP_BLOCK(stmt), stmt, "loop", in_main);
+        break;
+    default:
+        break;
+    }
+}
+
+/// Counts the blocks of the statements, the statements after a branch or a loop start a new block.
+static void walk_stmts(node_st *stmts, bool in_main)
+{
+    while (stmts != NULL)
+    {
+        node_st *stmt = STATEMENTS_STMT(stmts);
+        if (in_main && NODE_TYPE(stmt) == NT_RETSTATEMENT)
+        {
+            stmts = STATEMENTS_NEXT(dump_before_return(stmts));
+            continue;
+        }
+
+        walk_stmt(stmt, in_main);
+        enum ccn_nodetype type = NODE_TYPE(stmt);
+        bool ends_block = type == NT_IFSTATEMENT || type == NT_WHILELOOP ||
+                          type == NT_DOWHILELOOP || type == NT_FORLOOP;
+        if (ends_block && STATEMENTS_NEXT(stmts) != NULL)
+        {
+            STATEMENTS_NEXT(stmts) =
+                count_block(STATEMENTS_NEXT(stmts), STATEMENTS_STMT(STATEMENTS_NEXT(stmts)),
+                            "join");
+            stmts = STATEMENTS_NEXT(stmts);
+        }
+        stmts = STATEMENTS_NEXT(stmts);
+    }
+}
+
+static void walk_fundef(node_st *fundef)
+{
+    const char *parent_function_name = function_name;
+    function_name = get_pretty_name(VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(fundef))));
+    bool in_main = fundef == main_fundef;
+
+    node_st *funbody = FUNDEF_FUNBODY(fundef);
+    FUNBODY_STMTS(funbody) = count_block(FUNBODY_STMTS(funbody), fundef, "function");
+    walk_stmts(STATEMENTS_NEXT(FUNBODY_STMTS(funbody)), in_main);
+    if (in_main)
+    {
+        // A void main can end without a return
+        node_st *last = FUNBODY_STMTS(funbody);
+        while (STATEMENTS_NEXT(last) != NULL)
+        {
+            last = STATEMENTS_NEXT(last);
+        }
+        if (NODE_TYPE(STATEMENTS_STMT(last)) != NT_RETSTATEMENT)
+        {
+            STATEMENTS_NEXT(last) = ASTstatements(new_dump_call(), NULL);
+        }
+    }
+
+    for (node_st *lfuns = FUNBODY_LOCALFUNDEFS(funbody); lfuns != NULL;
+         lfuns = LOCALFUNDEFS_NEXT(lfuns))
+    {
+        walk_fundef(LOCALFUNDEFS_LOCALFUNDEF(lfuns));
+    }
+    function_name = parent_function_name;
+}
+
+static node_st *last_declarations(node_st *program)
+{
+    node_st *last = PROGRAM_DECLS(program);
+    release_assert(last != NULL);
+    while (DECLARATIONS_NEXT(last) != NULL)
+    {
+        last = DECLARATIONS_NEXT(last);
+    }
+    return last;
+}
+
+/// Gets the __init function, it is created again if the dead code elimination removed it.
+static node_st *init_function(node_st *program)
+{
+    node_st *init_fun = HTlookup(PROGRAM_SYMBOLS(program), global_init_func);
+    if (init_fun != NULL)
+    {
+        return init_fun;
+    }
+
+    node_st *funheader = ASTfunheader(ASTvar(STRcpy(global_init_func)), NULL, DT_void);
+    init_fun = ASTfundef(funheader, ASTfunbody(NULL, NULL, NULL), true);
+    FUNDEF_SYMBOLS(init_fun) = HTnew_String(2 << 8);
+    bool success = HTinsert(FUNDEF_SYMBOLS(init_fun), htable_parent_name, PROGRAM_SYMBOLS(program));
+    release_assert(success);
+    success = HTinsert(PROGRAM_SYMBOLS(program), global_init_func, init_fun);
+    release_assert(success);
+    DECLARATIONS_NEXT(last_declarations(program)) = ASTdeclarations(init_fun, NULL);
+    return init_fun;
+}
+
+/**
+ * Declares the global counter array and allocates it with zeros at the start of the __init
+ * function, before the global inits can call an instrumented function.
+ * Example:
+ *  int[N] __counters; => __counters = @alloc(N); for (int i = 0, N) { __counters[i] = 0; }
+ */
+static void add_counters(node_st *program)
+{
+    int count = (int)site_count;
+    node_st *var = ASTarrayexpr(ASTexprs(ASTint(count), NULL), ASTvar(STRcpy(counters_name)));
+    node_st *vardec = ASTvardec(var, NULL, DT_int);
+    bool success = HTinsert(PROGRAM_SYMBOLS(program), VAR_NAME(ARRAYEXPR_VAR(var)), vardec);
+    release_assert(success);
+    DECLARATIONS_NEXT(last_declarations(program)) =
+        ASTdeclarations(ASTglobaldef(vardec, false), NULL);
+
+    node_st *init_fun = init_function(program);
+    node_st *funbody = FUNDEF_FUNBODY(init_fun);
+    node_st *index = ASTvar(STRcpy(index_name));
+    node_st *index_vardec = ASTvardec(CCNcopy(index), NULL, DT_int);
+    add_vardec(index_vardec, NULL, funbody);
+    success = HTinsert(FUNDEF_SYMBOLS(init_fun), VAR_NAME(VARDEC_VAR(index_vardec)), index_vardec);
+    release_assert(success);
+
+    node_st *alloc_call = ASTproccall(ASTvar(STRcpy(alloc_func)), ASTexprs(ASTint(count), NULL));
+    node_st *alloc = ASTassign(ASTvar(STRcpy(counters_name)), alloc_call);
+    node_st *element = ASTarrayexpr(ASTexprs(CCNcopy(index), NULL), ASTvar(STRcpy(counters_name)));
+    node_st *zero = ASTstatements(ASTarrayassign(element, ASTint(0)), NULL);
+    node_st *loop = ASTforloop(ASTassign(index, ASTint(0)), ASTint(count), NULL, zero);
+    FUNBODY_STMTS(funbody) = ASTstatements(alloc, ASTstatements(loop, FUNBODY_STMTS(funbody)));
+}
+
+/// Gets the declaration of the print function, declaring the extern function if the program does
+/// not. NULL if the program declares it with another signature than 'void name(int)'.
+static node_st *print_function(node_st *program, const char *name)
+{
+    node_st *entry = HTlookup(PROGRAM_SYMBOLS(program), (void *)name);
+    if (entry != NULL)
+    {
+        node_st *funheader =
+            NODE_TYPE(entry) == NT_FUNDEF ? FUNDEF_FUNHEADER(entry) : FUNDEC_FUNHEADER(entry);
+        node_st *params = FUNHEADER_PARAMS(funheader);
+        bool matches = FUNHEADER_TYPE(funheader) == DT_void && params != NULL &&
+                       PARAMS_NEXT(params) == NULL && PARAMS_TYPE(params) == DT_int &&
+                       NODE_TYPE(PARAMS_VAR(params)) == NT_VAR;
+        return matches ? entry : NULL;
+    }
+
+    node_st *params = ASTparams(ASTvar(STRcpy("@1_val")), NULL, DT_int);
+    node_st *fundec = ASTfundec(ASTfunheader(ASTvar(STRcpy(name)), params, DT_void));
+    bool success = symbol_keys_insert(PROGRAM_SYMBOLS(program), name, fundec);
+    release_assert(success);
+    PROGRAM_DECLS(program) = ASTdeclarations(fundec, PROGRAM_DECLS(program));
+    return fundec;
+}
+
+/**
+ * Adds the exported function printing the counts in the order of the counter ids, one per line.
+ * Example:
+ *  export void __dump_counters() { for (int i = 0, N) { printInt(__counters[i]);
+ *                                                       printNewlines(1); } }
+ */
+static void add_dump_function(node_st *program)
+{
+    node_st *funheader = ASTfunheader(ASTvar(STRcpy(dump_name)), NULL, DT_void);
+    node_st *fundef = ASTfundef(funheader, ASTfunbody(NULL, NULL, NULL), true);
+    FUNDEF_SYMBOLS(fundef) = HTnew_String(2 << 8);
+    bool success = HTinsert(FUNDEF_SYMBOLS(fundef), htable_parent_name, PROGRAM_SYMBOLS(program));
+    release_assert(success);
+    success = symbol_keys_insert(PROGRAM_SYMBOLS(program), dump_name, fundef);
+    release_assert(success);
+    DECLARATIONS_NEXT(last_declarations(program)) = ASTdeclarations(fundef, NULL);
+
+    if (print_function(program, print_int_name) == NULL ||
+        print_function(program, print_newlines_name) == NULL)
+    {
+        CTI(CTI_WARN, true,
+            "Cannot print the counters, the program declares printInt or printNewlines with "
+            "another signature than 'void (int)'.");
+        return;
+    }
+
+    node_st *funbody = FUNDEF_FUNBODY(fundef);
+    node_st *index = ASTvar(STRcpy(index_name));
+    node_st *index_vardec = ASTvardec(CCNcopy(index), NULL, DT_int);
+    add_vardec(index_vardec, NULL, funbody);
+    success = HTinsert(FUNDEF_SYMBOLS(fundef), VAR_NAME(VARDEC_VAR(index_vardec)), index_vardec);
+    release_assert(success);
+
+    node_st *element = ASTarrayexpr(ASTexprs(CCNcopy(index), NULL), ASTvar(STRcpy(counters_name)));
+    node_st *print_count = ASTproccall(ASTvar(STRcpy(print_int_name)), ASTexprs(element, NULL));
+    node_st *print_newline =
+        ASTproccall(ASTvar(STRcpy(print_newlines_name)), ASTexprs(ASTint(1), NULL));
+    node_st *block = ASTstatements(print_count, ASTstatements(print_newline, NULL));
+    node_st *loop = ASTforloop(ASTassign(index, ASTint(0)), ASTint((int)site_count), NULL, block);
+    FUNBODY_STMTS(funbody) = ASTstatements(loop, NULL);
+}
+
+/// Writes a line '<id> <kind> <function> <file>:<line>:<col>' per counter.
+static void write_map(const char *path)
+{
+    FILE *fd = fopen(path, "w");
+    if (fd == NULL)
+    {
+        CTI(CTI_ERROR, true, "Cannot write the instrumentation map '%s'.", path);
+        return;
+    }
+
+    for (size_t i = 0; i < site_count; i++)
+    {
+        struct counter_site *site = &sites[i];
+        fprintf(fd, "%zu %s %s %s:%u:%u\n", i, site->kind, site->function,
+                site->file != NULL ? site->file : "<input>", site->line, site->col);
+    }
+
+    if (ferror(fd))
+    {
+        CTI(CTI_ERROR, true, "Cannot write the instrumentation map '%s'.", path);
+    }
+    fclose(fd);
+}
+
+/**
+ * Counts the executions of the functions and their blocks in a global array. A block starts at the
+ * entry of a function, a branch or a loop body and after a branch or a loop. The counts are printed
+ * by the exported __dump_counters, which main calls before it returns. The id of each counter is
+ * mapped to its source location in the instrumentation map.
+ */
+node_st *CG_BCprogram(node_st *node)
+{
+    reset_state();
+    main_fundef = HTlookup(PROGRAM_SYMBOLS(node), (void *)"@fun_main");
+    if (main_fundef != NULL && NODE_TYPE(main_fundef) != NT_FUNDEF)
+    {
+        main_fundef = NULL;
+    }
+
+    for (node_st *decls = PROGRAM_DECLS(node); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) == NT_FUNDEF &&
+            !STReq(VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(decl))), global_init_func))
+        {
+            walk_fundef(decl);
+        }
+    }
+
+    if (site_count > 0)
+    {
+        add_counters(node);
+        add_dump_function(node);
+    }
+
+    write_map(global.instrument_output);
+    free(sites);
+    reset_state();
+    check_phase_error();
+    return node;
+}
@@ -6,7 +6,7 @@
 #include <ccngen/enum.h>
 #include <stdbool.h>
 
-static htable_stptr current = NULL;
+static _Thread_local htable_stptr current = NULL;
 
 static void reset_state()
 {
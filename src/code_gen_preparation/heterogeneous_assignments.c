@@ -10,17 +10,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-static node_st *program_decls = NULL;
-static node_st *last_fundef = NULL;
-static uint32_t temp_counter = 0;
-static htable_stptr global_current = NULL;
-static htable_stptr current = NULL;
-static node_st *last_vardecs = NULL;
-static node_st *current_statements = NULL;
-static bool is_exported = false;
-static node_st *init_stmts = NULL;
-static node_st *last_decls = NULL;
-static node_st *last_init_decls = NULL;
+static _Thread_local node_st *program_decls = NULL;
+static _Thread_local node_st *last_fundef = NULL;
+static _Thread_local uint32_t temp_counter = 0;
+static _Thread_local htable_stptr global_current = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local node_st *last_vardecs = NULL;
+static _Thread_local node_st *current_statements = NULL;
+static _Thread_local bool is_exported = false;
+static _Thread_local node_st *init_stmts = NULL;
+static _Thread_local node_st *last_decls = NULL;
+static _Thread_local node_st *last_init_decls = NULL;
 
 static void reset_state()
 {
@@ -11,13 +11,13 @@
 #include <stdint.h>
 #include <stdio.h>
 
-static node_st *program_decls = NULL;
-static node_st *last_fundef = NULL;
-static htable_stptr current = NULL;
-static uint32_t loop_counter = 0;
-static node_st *last_vardecs = NULL;
-static node_st *last_stmts = NULL;
-static node_st *last_init_decls = NULL;
+static _Thread_local node_st *program_decls = NULL;
+static _Thread_local node_st *last_fundef = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local uint32_t loop_counter = 0;
+static _Thread_local node_st *last_vardecs = NULL;
+static _Thread_local node_st *last_stmts = NULL;
+static _Thread_local node_st *last_init_decls = NULL;
 
 static void reset_state()
 {
@@ -90,7 +90,38 @@ node_st *CGP_HAvardec(node_st *node)
         // Extract expr to statement
         if (expr != NULL)
         {
-            if (NODE_TYPE(expr) == NT_ARRAYINIT)
+            node_st *bulk_values =
+                NODE_TYPE(expr) == NT_ARRAYINIT ? bulk_init_values(node) : NULL;
+            if (bulk_values != NULL)
+            {
+                // Large constant array init are assigned by a single statement
+                node_st *index_var = NULL;
+                node_st *values = bulk_values;
+                while (values != NULL && index_var == NULL)
+                {
+                    int run = literal_run_length(values);
+                    if (run >= bulk_fill_min_run)
+                    {
+                        index_var = ASTvar(STRfmt("@loop_var%d", loop_counter));
+                        node_st *index_vardec = ASTvardec(CCNcopy(index_var), NULL, DT_int);
+                        last_vardecs = add_vardec(index_vardec, last_vardecs, funbody);
+                        bool success =
+                            HTinsert(current, VAR_NAME(VARDEC_VAR(index_vardec)), index_vardec);
+                        release_assert(success);
+                    }
+
+                    for (int i = 0; i < run; i++)
+                    {
+                        values = EXPRS_NEXT(values);
+                    }
+                }
+
+                node_st *bulk_assign =
+                    ASTarraybulkassign(CCNcopy(ARRAYEXPR_VAR(var)), bulk_values, index_var);
+                last_stmts = add_stmt(bulk_assign, last_stmts, funbody);
+                CCNfree(expr);
+            }
+            else if (NODE_TYPE(expr) == NT_ARRAYINIT)
             {
                 node_st *itop_stmts = NULL;
                 node_st *ilast_stmts =
@@ -11,8 +11,8 @@
 #include <ccngen/enum.h>
 #include <stdbool.h>
 
-static node_st *init_fun = NULL;
-static node_st *init_stmts = NULL;
+static _Thread_local node_st *init_fun = NULL;
+static _Thread_local node_st *init_stmts = NULL;
 
 static void reset_state()
 {
@@ -9,7 +9,7 @@
 #include <ccn/dynamic_core.h>
 #include <ccngen/enum.h>
 
-static htable_stptr current = NULL;
+static _Thread_local htable_stptr current = NULL;
 
 static void reset_state()
 {
@@ -1,5 +1,6 @@
 #include "ccngen/ast.h"
 #include "ccngen/enum.h"
+#include "definitions.h"
 #include "palm/str.h"
 #include "release_assert.h"
 #include <ccn/dynamic_core.h>
@@ -105,3 +106,87 @@ static node_st *init_index_calculation(node_st *node, const char *var_name, node
     }
     return last_stmts;
 }
+
+// Appends the values of the array init in row-major order to the values. Fails if the array init
+// does not exactly match the constant dimensions or contains a value that is not a literal.
+static bool flatten_constant_init(node_st *node, node_st *dims, node_st **values,
+                                  node_st **last_values, int *count)
+{
+    release_assert(dims != NULL);
+    release_assert(NODE_TYPE(dims) == NT_EXPRS);
+
+    node_st *dim = EXPRS_EXPR(dims);
+    if (NODE_TYPE(node) != NT_ARRAYINIT || NODE_TYPE(dim) != NT_INT)
+    {
+        return false;
+    }
+
+    int length = 0;
+    while (node != NULL)
+    {
+        release_assert(NODE_TYPE(node) == NT_ARRAYINIT);
+        node_st *expr = ARRAYINIT_EXPR(node);
+        if (expr == NULL)
+        {
+            return false;
+        }
+
+        if (EXPRS_NEXT(dims) != NULL)
+        {
+            if (!flatten_constant_init(expr, EXPRS_NEXT(dims), values, last_values, count))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (NODE_TYPE(expr) != NT_INT && NODE_TYPE(expr) != NT_FLOAT &&
+                NODE_TYPE(expr) != NT_BOOL)
+            {
+                return false;
+            }
+
+            node_st *new_values = ASTexprs(CCNcopy(expr), NULL);
+            if (*last_values == NULL)
+            {
+                *values = new_values;
+            }
+            else
+            {
+                EXPRS_NEXT(*last_values) = new_values;
+            }
+            *last_values = new_values;
+            (*count)++;
+        }
+
+        length++;
+        node = ARRAYINIT_NEXT(node);
+    }
+
+    return length == INT_VAL(dim);
+}
+
+// Collects the values of a large constant array init that can be assigned with a single
+// ArrayBulkAssign. Returns NULL if the array init needs to be unpacked per element.
+static node_st *bulk_init_values(node_st *node)
+{
+    node_st *var = VARDEC_VAR(node);
+    release_assert(NODE_TYPE(var) == NT_ARRAYEXPR);
+    release_assert(NODE_TYPE(VARDEC_EXPR(node)) == NT_ARRAYINIT);
+
+    node_st *values = NULL;
+    node_st *last_values = NULL;
+    int count = 0;
+    bool success = flatten_constant_init(VARDEC_EXPR(node), ARRAYEXPR_DIMS(var), &values,
+                                         &last_values, &count);
+    if (!success || count < bulk_assign_min_elements)
+    {
+        if (values != NULL)
+        {
+            CCNfree(values);
+        }
+        return NULL;
+    }
+
+    return values;
+}
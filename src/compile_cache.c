@@ -0,0 +1,314 @@
+#include "compile_cache.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "scanparse/preprocessor.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+#ifndef CIVICC_VERSION
+#define CIVICC_VERSION "unknown"
+#endif
+
+#define CACHE_MAGIC "civicc-cache 1\n"
+#define CACHE_EXTENSION ".cvcache"
+
+/// Entry of the cache directory for the eviction.
+struct cache_entry
+{
+    char *path;
+    size_t size;
+    struct timespec used;
+};
+
+char *cache_read_source(size_t *out_length)
+{
+    if (global.input_buf != NULL)
+    {
+        char *source = malloc(global.input_buf_len + 1u);
+        release_assert(source != NULL);
+        memcpy(source, global.input_buf, global.input_buf_len);
+        *out_length = global.input_buf_len;
+        return source;
+    }
+
+    FILE *fd = preprocessorStart();
+    if (fd == NULL)
+    {
+        CTI(CTI_ERROR, true, "Cannot open file '%s'.", global.input_file);
+        CTIabortOnError();
+    }
+
+    size_t length = 0;
+    size_t capacity = 4096;
+    char *source = malloc(capacity);
+    release_assert(source != NULL);
+    size_t read;
+    while ((read = fread(source + length, 1, capacity - length, fd)) > 0)
+    {
+        length += read;
+        if (length == capacity)
+        {
+            capacity *= 2;
+            source = realloc(source, capacity);
+            release_assert(source != NULL);
+        }
+    }
+
+    if (global.preprocessor_enabled)
+    {
+        preprocessorEnd(fd);
+    }
+    else
+    {
+        fclose(fd);
+    }
+
+    *out_length = length;
+    return source;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+/// Describes the compiler and the flags that change the generated code. The modification time of
+/// the compiler binary separates builds of the same version.
+static char *compiler_flags()
+{
+    long long build = 0;
+    struct stat info;
+    if (stat("/proc/self/exe", &info) == 0)
+    {
+        build = (long long)info.st_mtime;
+    }
+
+    return STRfmt("version=%s build=%lld cpp=%d opt=%d unroll=%d inline=%d spec=%d eval=%d tco=%d "
+                  "ranges=%d promote=%d pack=%d\n",
+                  CIVICC_VERSION, build, global.preprocessor_enabled, global.optimization_enabled,
+                  global.unroll_limit, global.inline_limit, global.specialize_limit,
+                  global.eval_limit, global.tail_calls_enabled, global.value_ranges_enabled,
+                  global.scalar_promotion_enabled, global.slot_packing_enabled);
+}
+
+char *cache_key(const char *source, size_t length)
+{
+    char *flags = compiler_flags();
+    uint64_t hash = fnv1a(0xcbf29ce484222325u, flags, strlen(flags));
+    hash = fnv1a(hash, source, length);
+    free(flags);
+    return STRfmt("%016llx", (unsigned long long)hash);
+}
+
+static char *entry_path(const char *directory, const char *key)
+{
+    return STRfmt("%s/%s" CACHE_EXTENSION, directory, key);
+}
+
+/// Reads the header of an entry and checks that it belongs to the flags and source, the hash of the
+/// key alone could collide.
+static bool read_header(FILE *fd, const char *flags, const char *source, size_t length,
+                        size_t *out_output_length)
+{
+    char line[256];
+    if (fgets(line, sizeof(line), fd) == NULL || !STReq(line, CACHE_MAGIC))
+    {
+        return false;
+    }
+    if (fgets(line, sizeof(line), fd) == NULL || !STReq(line, flags))
+    {
+        return false;
+    }
+
+    unsigned long long source_length;
+    unsigned long long output_length;
+    if (fscanf(fd, "%llu %llu", &source_length, &output_length) != 2 || fgetc(fd) != '\n' ||
+        source_length != length)
+    {
+        return false;
+    }
+
+    char buf[4096];
+    for (size_t offset = 0; offset < length;)
+    {
+        size_t chunk = length - offset < sizeof(buf) ? length - offset : sizeof(buf);
+        if (fread(buf, 1, chunk, fd) != chunk || memcmp(buf, source + offset, chunk) != 0)
+        {
+            return false;
+        }
+        offset += chunk;
+    }
+
+    *out_output_length = (size_t)output_length;
+    return true;
+}
+
+bool cache_lookup(const char *directory, const char *key, const char *source, size_t length,
+                  char **out_output, size_t *out_output_length)
+{
+    char *path = entry_path(directory, key);
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL)
+    {
+        free(path);
+        return false;
+    }
+
+    char *flags = compiler_flags();
+    size_t output_length = 0;
+    char *output = NULL;
+    bool hit = read_header(fd, flags, source, length, &output_length);
+    if (hit)
+    {
+        output = malloc(output_length + 1);
+        release_assert(output != NULL);
+        hit = fread(output, 1, output_length, fd) == output_length;
+        output[output_length] = '\0';
+    }
+    fclose(fd);
+    free(flags);
+
+    if (hit)
+    {
+        // The modification time orders the entries for the eviction
+        utime(path, NULL);
+        *out_output = output;
+        *out_output_length = output_length;
+    }
+    else
+    {
+        free(output);
+    }
+    free(path);
+    return hit;
+}
+
+bool cache_store(const char *directory, const char *key, const char *source, size_t length,
+                 const char *output, size_t output_length, size_t max_size)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        return false;
+    }
+
+    // Written to a temporary file first, so concurrent compilations never read a partial entry
+    char *path = entry_path(directory, key);
+    char *temp_path = STRfmt("%s/%s.%ld.tmp", directory, key, (long)getpid());
+    FILE *fd = fopen(temp_path, "wb");
+    if (fd == NULL)
+    {
+        free(path);
+        free(temp_path);
+        return false;
+    }
+
+    char *flags = compiler_flags();
+    fprintf(fd, CACHE_MAGIC "%s%zu %zu\n", flags, length, output_length);
+    fwrite(source, 1, length, fd);
+    fwrite(output, 1, output_length, fd);
+    bool success = !ferror(fd);
+    success = fclose(fd) == 0 && success;
+    success = success && rename(temp_path, path) == 0;
+    if (!success)
+    {
+        remove(temp_path);
+    }
+    free(flags);
+    free(path);
+    free(temp_path);
+
+    cache_evict(directory, max_size);
+    return success;
+}
+
+static int compare_used(const void *a, const void *b)
+{
+    const struct cache_entry *left = a;
+    const struct cache_entry *right = b;
+    if (left->used.tv_sec != right->used.tv_sec)
+    {
+        return left->used.tv_sec < right->used.tv_sec ? -1 : 1;
+    }
+    if (left->used.tv_nsec != right->used.tv_nsec)
+    {
+        return left->used.tv_nsec < right->used.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+void cache_evict(const char *directory, size_t max_size)
+{
+    DIR *dir = opendir(directory);
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    struct cache_entry *entries = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t total_size = 0;
+    for (struct dirent *file = readdir(dir); file != NULL; file = readdir(dir))
+    {
+        size_t name_length = strlen(file->d_name);
+        size_t extension_length = strlen(CACHE_EXTENSION);
+        if (name_length <= extension_length ||
+            !STReq(file->d_name + name_length - extension_length, CACHE_EXTENSION))
+        {
+            continue;
+        }
+
+        char *path = STRfmt("%s/%s", directory, file->d_name);
+        struct stat info;
+        if (stat(path, &info) != 0)
+        {
+            free(path);
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            entries = realloc(entries, capacity * sizeof(struct cache_entry));
+            release_assert(entries != NULL);
+        }
+        entries[count].path = path;
+        entries[count].size = (size_t)info.st_size;
+#ifdef __APPLE__
+        entries[count].used = info.st_mtimespec;
+#else
+        entries[count].used = info.st_mtim;
+#endif // __APPLE__
+        total_size += entries[count].size;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(entries, count, sizeof(struct cache_entry), compare_used);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (total_size > max_size && remove(entries[i].path) == 0)
+        {
+            total_size -= entries[i].size;
+        }
+        free(entries[i].path);
+    }
+    free(entries);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Reads the source of global.input_buf or of global.input_file after the C preprocessor if it is
+// enabled. The result is the input of the compilation, so it can be passed to the parser as
+// global.input_buf.
+char *cache_read_source(size_t *out_length);
+// Hashes the source together with the compiler version and the flags that change the output. The
+// key is the file name of the cache entry.
+char *cache_key(const char *source, size_t length);
+// Looks up the output of the source in the cache directory. A hit marks the entry as recently used.
+bool cache_lookup(const char *directory, const char *key, const char *source, size_t length,
+                  char **out_output, size_t *out_output_length);
+// Stores the output of the source in the cache directory and evicts the least recently used
+// entries until the directory holds at most max_size bytes.
+bool cache_store(const char *directory, const char *key, const char *source, size_t length,
+                 const char *output, size_t output_length, size_t max_size);
+// Removes the least recently used entries until the directory holds at most max_size bytes.
+void cache_evict(const char *directory, size_t max_size);
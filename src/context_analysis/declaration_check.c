@@ -14,14 +14,28 @@
 #include <stdlib.h>
 #include <strings.h>
 
-static htable_stptr current = NULL;
-static uint32_t level = 0;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local uint32_t level = 0;
+
+/// Declaration still keyed with its old name in the symbol table of its scope.
+struct renamed_key
+{
+    htable_stptr symbols;
+    char *name;
+    node_st *entry;
+};
+
+// Stack of the renamed keys, the keys of nested scopes are on top of the keys of their parent
+static _Thread_local struct renamed_key *renamed_keys = NULL;
+static _Thread_local size_t renamed_count = 0;
+static _Thread_local size_t renamed_capacity = 0;
 
 // TODO fix heap use after free
 static void reset_state()
 {
     current = NULL;
     level = 0;
+    renamed_count = 0;
 }
 
 static char *no_level_name(char *name)
@@ -42,30 +56,15 @@ static char *no_level_name(char *name)
     return name;
 }
 
+/// Moves the declarations renamed in the scope to the key of their new name. Only the renamed keys
+/// are visited, so closing a scope does not scan its whole symbol table.
 static void sync_symbol_keys(htable_stptr symbols)
 {
-    size_t size = HTelementCount(symbols);
-    char **delete_names = malloc(size * sizeof(char *));
-    size_t size_names = 0;
-    for (htable_iter_st *iter = HTiterate(symbols); iter; iter = HTiterateNext(iter))
-    {
-        char *name = HTiterKey(iter);
-        if (STRprefix("@fun", name) || STReq(htable_parent_name, name))
-        {
-            // Skip all function declarations and the parent
-            continue;
-        }
-
-        delete_names[size_names++] = name;
-    }
-
-    for (size_t i = 0; i < size_names; i++)
+    while (renamed_count > 0 && renamed_keys[renamed_count - 1].symbols == symbols)
     {
-
-        char *name = delete_names[i];
-
-        node_st *entry = HTlookup(symbols, name);
-        release_assert(entry != NULL);
+        struct renamed_key *renamed = &renamed_keys[--renamed_count];
+        char *name = renamed->name;
+        node_st *entry = renamed->entry;
         node_st *var = get_var_from_symbol(entry);
         char *entry_name;
         switch (NODE_TYPE(var))
@@ -96,7 +95,17 @@ static void sync_symbol_keys(htable_stptr symbols)
         release_assert(value != NULL);
         release_assert(entry == value);
     }
-    free(delete_names);
+}
+
+static void push_renamed_key(char *name, node_st *entry)
+{
+    if (renamed_count == renamed_capacity)
+    {
+        renamed_capacity = renamed_capacity == 0 ? 64 : renamed_capacity * 2;
+        renamed_keys = realloc(renamed_keys, renamed_capacity * sizeof(struct renamed_key));
+        release_assert(renamed_keys != NULL);
+    }
+    renamed_keys[renamed_count++] = (struct renamed_key){current, name, entry};
 }
 
 static void add_var_symbol(node_st *node, node_st *var)
@@ -158,6 +167,10 @@ static void add_var_symbol(node_st *node, node_st *var)
 
         bool success = HTinsert(current, name, node);
         release_assert(success);
+        if (has_new_name)
+        {
+            push_renamed_key(name, node);
+        }
     }
     else
     {
@@ -336,6 +349,10 @@ node_st *CA_DCprogram(node_st *node)
     TRAVopt(PROGRAM_DECLS(node));
 
     sync_symbol_keys(current);
+    release_assert(renamed_count == 0);
+    free(renamed_keys);
+    renamed_keys = NULL;
+    renamed_capacity = 0;
     htable_stptr parent = HTlookup(current, htable_parent_name);
     release_assert(parent == NULL);
     check_phase_error();
@@ -7,11 +7,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static node_st *funbody = NULL;
-static node_st *last_vardecs = NULL;
-static uint32_t for_counter = 0;
-static char *new_for_name = NULL;
-static char *old_for_name = NULL;
+static _Thread_local node_st *funbody = NULL;
+static _Thread_local node_st *last_vardecs = NULL;
+static _Thread_local uint32_t for_counter = 0;
+static _Thread_local char *new_for_name = NULL;
+static _Thread_local char *old_for_name = NULL;
 
 static void reset_state()
 {
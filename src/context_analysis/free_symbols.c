@@ -1,4 +1,5 @@
 #include "ccngen/ast.h"
+#include "symbol_keys.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
@@ -14,6 +15,10 @@ node_st *FSprogram(node_st *node)
         PROGRAM_SYMBOLS(node) = NULL;
     }
     TRAVopt(PROGRAM_DECLS(node));
+
+    // The symbol tables of the compilation are freed, a declaration freed without its table must
+    // not leave its registration behind for the next compilation of the thread
+    symbol_keys_reset();
     return node;
 }
 
@@ -4,6 +4,7 @@
 #include "palm/hash_table.h"
 #include "palm/str.h"
 #include "release_assert.h"
+#include "symbol_keys.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
@@ -11,8 +12,8 @@
 #include <stdbool.h>
 #include <string.h>
 
-static htable_stptr current = NULL;
-static node_st *main_candidate = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local node_st *main_candidate = NULL;
 
 static void reset_state()
 {
@@ -74,7 +75,7 @@ node_st *CA_FHfundec(node_st *node)
             error_invalid_identifier_name(node, entry, name);
         }
 
-        bool success = HTinsert(current, STRcpy(new_name), node);
+        bool success = symbol_keys_insert(current, new_name, node);
         release_assert(success);
     }
     else
@@ -119,7 +120,7 @@ node_st *CA_FHfundef(node_st *node)
             main_candidate = node;
         }
 
-        bool success = HTinsert(current, STRcpy(new_name), node);
+        bool success = symbol_keys_insert(current, new_name, node);
         release_assert(success);
     }
     else
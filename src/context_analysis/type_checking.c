@@ -1,20 +1,23 @@
 #include "ccngen/ast.h"
+#include "global/globals.h"
 #include "palm/ctinfo.h"
 #include "palm/str.h"
 #include "release_assert.h"
+#include "scheduler.h"
 #include "to_string.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
 #include <ccngen/enum.h>
+#include <ccngen/trav.h>
 #include <stdbool.h>
 #include <string.h>
 
-static htable_stptr current = NULL;
-static bool anytype = false; // Allows an expression to set the type
-static enum DataType type = DT_NULL;
-static enum DataType rettype = DT_NULL;
-static bool has_return = false;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local bool anytype = false; // Allows an expression to set the type
+static _Thread_local enum DataType type = DT_NULL;
+static _Thread_local enum DataType rettype = DT_NULL;
+static _Thread_local bool has_return = false;
 
 static void reset_state()
 {
@@ -39,8 +42,8 @@ static void type_check(node_st *node, const char *name, enum DataType expected,
     char *expected_str = datatype_to_string(expected);
     char *value_str = datatype_to_string(value);
     const char *pretty_name = get_pretty_name(name);
-    CTIobj(CTI_ERROR, true, info, "'%s' has type '%s' but expected type '%s'.", pretty_name,
-           value_str, expected_str);
+    report_obj(CTI_ERROR, true, info, "'%s' has type '%s' but expected type '%s'.", pretty_name,
+               value_str, expected_str);
     free(expected_str);
     free(value_str);
 }
@@ -51,8 +54,8 @@ static void binop_not_defined_on_type(node_st *node, enum DataType type)
     char *op_str = binoptype_to_string(BINOP_OP(node));
     release_assert(type != DT_NULL);
     char *type_str = datatype_to_string(type);
-    CTIobj(CTI_ERROR, true, info, "The binop operation '%s' is not defined on the type '%s'.",
-           op_str, type_str);
+    report_obj(CTI_ERROR, true, info, "The binop operation '%s' is not defined on the type '%s'.",
+               op_str, type_str);
     free(op_str);
     free(type_str);
 }
@@ -67,7 +70,7 @@ static bool check_nesting(unsigned int level, node_st *init)
         if (NODE_TYPE(init) == NT_ARRAYINIT)
         {
             struct ctinfo info = NODE_TO_CTINFO(init);
-            CTIobj(CTI_ERROR, true, info, "Too many dimensions in array initalization.");
+            report_obj(CTI_ERROR, true, info, "Too many dimensions in array initalization.");
             return false;
         }
         else
@@ -91,9 +94,9 @@ static bool check_nesting(unsigned int level, node_st *init)
     }
 
     struct ctinfo info = NODE_TO_CTINFO(init);
-    CTIobj(CTI_ERROR, true, info,
-           "Insufficient dimensions in array initalization, missing '%d' further dimensions.",
-           level);
+    report_obj(CTI_ERROR, true, info,
+               "Insufficient dimensions in array initalization, missing '%d' further dimensions.",
+               level);
 
     return false;
 }
@@ -151,9 +154,9 @@ static void arrexpr_dimension_check(node_st *node, const char *name, node_st *ex
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(name);
-        CTIobj(CTI_ERROR, true, info,
-               "Array '%s' has '%d' dimension, but '%d' dimensions are used.", pretty_name,
-               expected_count, actual_count);
+        report_obj(CTI_ERROR, true, info,
+                   "Array '%s' has '%d' dimension, but '%d' dimensions are used.", pretty_name,
+                   expected_count, actual_count);
     }
 }
 
@@ -234,8 +237,9 @@ node_st *CA_TCvar(node_st *node)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(name);
-        CTIobj(CTI_ERROR, true, info, "Array '%s' can only be accessed with dimension indicies.",
-               pretty_name);
+        report_obj(
+            CTI_ERROR, true, info, "Array '%s' can only be accessed with dimension indicies.",
+            pretty_name);
     }
 
     enum DataType has_type = symbol_to_type(entry);
@@ -277,7 +281,7 @@ node_st *CA_TCcast(node_st *node)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         char *type_str = datatype_to_string(has_type);
-        CTIobj(CTI_ERROR, true, info, "Cannot cast from type 'void' into type '%s'.", type_str);
+        report_obj(CTI_ERROR, true, info, "Cannot cast from type 'void' into type '%s'.", type_str);
         free(type_str);
     }
     CAST_FROMTYPE(node) = type;
@@ -309,8 +313,9 @@ node_st *CA_TCarrayexpr(node_st *node)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(name);
-        CTIobj(CTI_ERROR, true, info, "Scalar '%s' can not be accessed with an array expression.",
-               pretty_name);
+        report_obj(
+            CTI_ERROR, true, info, "Scalar '%s' can not be accessed with an array expression.",
+            pretty_name);
     }
     else
     {
@@ -379,8 +384,9 @@ node_st *CA_TCmonop(node_st *node)
         char *op_str = monoptype_to_string(MONOP_OP(node));
         release_assert(type != DT_NULL);
         char *type_str = datatype_to_string(type);
-        CTIobj(CTI_ERROR, true, info, "The monop operation '%s' is not defined on the type '%s'.",
-               op_str, type_str);
+        report_obj(
+            CTI_ERROR, true, info, "The monop operation '%s' is not defined on the type '%s'.",
+            op_str, type_str);
         free(op_str);
         free(type_str);
     }
@@ -552,13 +558,13 @@ node_st *CA_TCretstatement(node_st *node)
         if (type != DT_void)
         {
             struct ctinfo info = NODE_TO_CTINFO(node);
-            CTIobj(CTI_ERROR, true, info, "Cannot return 'void' for none-void function.");
+            report_obj(CTI_ERROR, true, info, "Cannot return 'void' for none-void function.");
         }
     }
     else if (type == DT_void)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
-        CTIobj(CTI_ERROR, true, info, "Cannot return 'none-void' for void function.");
+        report_obj(CTI_ERROR, true, info, "Cannot return 'none-void' for void function.");
         TRAVopt(expr);
     }
     else
@@ -665,18 +671,18 @@ node_st *CA_TCproccall(node_st *node)
                     else
                     {
                         struct ctinfo info = NODE_TO_CTINFO(expr);
-                        CTIobj(CTI_ERROR, true, info,
-                               "Expected array for argument '%s', but got scalar '%s'.",
-                               get_pretty_name(VAR_NAME(ARRAYVAR_VAR(paramvar))),
-                               get_pretty_name(VAR_NAME(expr)));
+                        report_obj(CTI_ERROR, true, info,
+                                   "Expected array for argument '%s', but got scalar '%s'.",
+                                   get_pretty_name(VAR_NAME(ARRAYVAR_VAR(paramvar))),
+                                   get_pretty_name(VAR_NAME(expr)));
                     }
                 }
                 else
                 {
                     struct ctinfo info = NODE_TO_CTINFO(expr);
-                    CTIobj(CTI_ERROR, true, info,
-                           "Expected array for argument '%s', but got scalar expression.",
-                           get_pretty_name(VAR_NAME(ARRAYVAR_VAR(paramvar))));
+                    report_obj(CTI_ERROR, true, info,
+                               "Expected array for argument '%s', but got scalar expression.",
+                               get_pretty_name(VAR_NAME(ARRAYVAR_VAR(paramvar))));
                 }
             }
             else
@@ -709,8 +715,9 @@ node_st *CA_TCproccall(node_st *node)
     if (params_count != exprs_count)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
-        CTIobj(CTI_ERROR, true, info, "Expected '%d' arguments, but only got '%d'.", params_count,
-               exprs_count);
+        report_obj(
+            CTI_ERROR, true, info, "Expected '%d' arguments, but only got '%d'.", params_count,
+            exprs_count);
     }
     return node;
 }
@@ -796,10 +803,10 @@ node_st *CA_TCassign(node_st *node)
                                                     : VAR_NAME(ARRAYVAR_VAR(var));
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(name);
-        CTIobj(CTI_ERROR, true, info,
-               "Array '%s' can not be assigned a scalar value without providing dimension "
-               "indices.",
-               pretty_name);
+        report_obj(CTI_ERROR, true, info,
+                   "Array '%s' can not be assigned a scalar value without providing dimension "
+                   "indices.",
+                   pretty_name);
         return node;
     }
 
@@ -808,8 +815,8 @@ node_st *CA_TCassign(node_st *node)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(name);
-        CTIobj(CTI_ERROR, true, info, "Assignment to for loop iterator '%s' is illegal.",
-               pretty_name);
+        report_obj(CTI_ERROR, true, info, "Assignment to for loop iterator '%s' is illegal.",
+                   pretty_name);
         return node;
     }
 
@@ -840,8 +847,8 @@ node_st *CA_TCarrayassign(node_st *node)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
         const char *pretty_name = get_pretty_name(VAR_NAME(var));
-        CTIobj(CTI_ERROR, true, info, "Can not use scalar variable '%s' as array variable.",
-               pretty_name);
+        report_obj(CTI_ERROR, true, info, "Can not use scalar variable '%s' as array variable.",
+                   pretty_name);
         return node;
     }
 
@@ -903,8 +910,8 @@ node_st *CA_TCvardec(node_st *node)
         {
             struct ctinfo info = NODE_TO_CTINFO(node);
             const char *pretty_name = get_pretty_name(name);
-            CTIobj(CTI_ERROR, true, info,
-                   "Array expression can not be assigned to the variable '%s'.", pretty_name);
+            report_obj(CTI_ERROR, true, info,
+                       "Array expression can not be assigned to the variable '%s'.", pretty_name);
         }
         else
         {
@@ -919,8 +926,8 @@ node_st *CA_TCvardec(node_st *node)
             if (success == false)
             {
                 struct ctinfo info = NODE_TO_CTINFO(node);
-                CTIobj(CTI_ERROR, true, info,
-                       "Array initalization does not match the dimension of the array.");
+                report_obj(CTI_ERROR, true, info,
+                           "Array initalization does not match the dimension of the array.");
             }
         }
 
@@ -958,8 +965,8 @@ node_st *CA_TCfundef(node_st *node)
     if (!has_return && rettype != DT_void)
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
-        CTIobj(CTI_ERROR, true, info,
-               "non-void function does not return a value in all control paths.");
+        report_obj(CTI_ERROR, true, info,
+                   "non-void function does not return a value in all control paths.");
     }
 
     type = parent_type;
@@ -970,15 +977,37 @@ node_st *CA_TCfundef(node_st *node)
     return node;
 }
 
-node_st *CA_TCprogram(node_st *node)
+static void check_state()
 {
-    reset_state();
-    current = PROGRAM_SYMBOLS(node);
-    TRAVopt(PROGRAM_DECLS(node));
     release_assert(type == DT_NULL);
     release_assert(rettype == DT_NULL);
     release_assert(has_return == false);
     release_assert(anytype == false);
+}
+
+/// Type checks a top-level declaration on a worker thread of the scheduler.
+static void check_decl(node_st *decl, void *symbols)
+{
+    reset_state();
+    current = symbols;
+    node_st *result = TRAVstart(decl, TRAV_CA_TC);
+    release_assert(result == decl);
+    check_state();
+}
+
+node_st *CA_TCprogram(node_st *node)
+{
+    reset_state();
+    current = PROGRAM_SYMBOLS(node);
+    if (global.jobs > 1)
+    {
+        schedule_decls(PROGRAM_DECLS(node), check_decl, PROGRAM_SYMBOLS(node));
+    }
+    else
+    {
+        TRAVopt(PROGRAM_DECLS(node));
+    }
+    check_state();
     check_phase_error();
     return node;
 }
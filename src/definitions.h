@@ -3,3 +3,33 @@
 extern char *htable_parent_name;
 extern char *global_init_func;
 extern char *alloc_func;
+
+// Minimal number of elements of a constant array init to assign them with a single
+// ArrayBulkAssign instead of one ArrayAssign per element.
+#define bulk_assign_min_elements 32
+
+// Minimal number of consecutive equal values in an ArrayBulkAssign to fill them with a loop.
+#define bulk_fill_min_run 16
+
+// Maximal number of copies of the loop body in a partially unrolled for loop.
+#define unroll_max_factor 8
+
+// Estimated AST node count saved by inlining a call: the call itself, the frame setup and the
+// return. Each argument saves one more node.
+#define inline_call_benefit 4
+
+// Additional benefit of a literal argument, as the inlined body is specialized for it.
+#define inline_literal_arg_benefit 4
+
+// Weight of a call in a loop when ranking the literal argument patterns for the function
+// specialization, a call outside of loops weighs 1.
+#define specialize_loop_call_weight 8
+
+// Maximal depth of the nested calls of a pure call evaluated at compile time.
+#define eval_max_depth 64
+
+// Maximal count of the relations between locals kept by the value range analysis.
+#define range_max_facts 64
+
+// Maximal count of relations chained to decide a comparison of two locals.
+#define range_fact_depth 4
@@ -1,7 +1,8 @@
 #include "globals.h"
+#include "civicc.h"
 #include <stdio.h>
 
-struct globals global;
+_Thread_local struct globals global;
 
 /*
  * Initialize global variables from globals.mac
@@ -11,19 +12,88 @@ void GLBinitializeGlobals()
 {
     global.preprocessor_enabled = true;
     global.optimization_enabled = true;
+    global.tail_calls_enabled = false;
+    global.slot_packing_enabled = false;
+    global.scalar_promotion_enabled = false;
+    global.value_ranges_enabled = false;
+    global.time_report = false;
+    global.unroll_limit = 0;
+    global.inline_limit = 0;
+    global.specialize_limit = 0;
+    global.eval_limit = 0;
+    global.jobs = 1;
     global.col = 1;
     global.line = 1;
     global.input_buf_len = 0;
     global.input_buf = NULL;
     global.input_file = NULL;
+    global.lto_inputs = NULL;
+    global.lto_input_count = 0;
+    global.summary_inputs = NULL;
+    global.summary_input_count = 0;
+    global.summary_output = NULL;
+    global.instrument_output = NULL;
     global.filename = NULL;
     global.output_buf_len = 0;
     global.output_buf = NULL;
     global.output_file = NULL;
+    global.trace_file = NULL;
+    global.cache_dir = NULL;
+    global.server_socket = NULL;
+    global.cache_size = 256 * 1024 * 1024;
     global.default_out_stream = stdout;
 }
 
+void GLBapplyOptions(const struct civicc_options *options)
+{
+    global.optimization_enabled = options->optimize;
+    global.tail_calls_enabled = options->tail_calls;
+    global.slot_packing_enabled = options->slot_packing;
+    global.scalar_promotion_enabled = options->scalar_promotion;
+    global.value_ranges_enabled = options->value_ranges;
+    global.unroll_limit = options->unroll_limit;
+    global.inline_limit = options->inline_limit;
+    global.specialize_limit = options->specialize_limit;
+    global.eval_limit = options->eval_limit;
+    global.jobs = options->jobs;
+}
+
 bool isOptimizationEnabled()
 {
     return global.optimization_enabled;
 }
+
+bool isInliningEnabled()
+{
+    return global.optimization_enabled && global.inline_limit > 0;
+}
+
+bool isSpecializationEnabled()
+{
+    return global.optimization_enabled && global.specialize_limit > 0;
+}
+
+bool isTailCallEliminationEnabled()
+{
+    return global.optimization_enabled && global.tail_calls_enabled;
+}
+
+bool isScalarPromotionEnabled()
+{
+    return global.optimization_enabled && global.scalar_promotion_enabled;
+}
+
+bool isInterfaceSummaryEnabled()
+{
+    return global.summary_input_count > 0 || global.summary_output != NULL;
+}
+
+bool isSlotAllocationEnabled()
+{
+    return global.optimization_enabled && global.slot_packing_enabled;
+}
+
+bool isInstrumentationEnabled()
+{
+    return global.instrument_output != NULL;
+}
@@ -6,12 +6,28 @@
 #include <stdint.h>
 #include <stdio.h>
 
+struct civicc_options;
+
 struct globals
 {
     bool preprocessor_enabled;
     bool optimization_enabled;
+    bool tail_calls_enabled; // Turns self tail calls into loops
+    bool slot_packing_enabled; // Shares the frame slots of locals with disjoint live ranges
+    bool scalar_promotion_enabled; // Keeps the globals and outer variables of loops in locals
+    bool value_ranges_enabled; // Decides int comparisons from the value ranges of the locals
+    bool time_report; // Prints the time spent per action after the compilation
     const char *input_file;
+    const char **lto_inputs; // Modules linked into one program in the whole program mode
+    int lto_input_count;     // 0 compiles the input file on its own
+    const char **summary_inputs; // Interface summaries of the modules the extern declarations use
+    int summary_input_count;
+    const char *summary_output; // Interface summary of the exports, not written if NULL
+    const char *instrument_output; // Source locations of the block counters, no counters if NULL
     const char *output_file;
+    const char *trace_file; // Chrome trace of the actions, not written if NULL
+    const char *cache_dir; // Directory of the compilation cache, no caching if NULL
+    const char *server_socket; // Socket of the compile server, no server if NULL
     char *filename;
     char *input_buf;  // Buffer holding the input to the compiler if empty the input file is
                       // read instead.
@@ -20,10 +36,21 @@ struct globals
     int line;
     int col;
     int verbose;
+    int unroll_limit; // Maximal AST node count of an unrolled for loop body, 0 disables unrolling
+    int inline_limit; // Maximal inlining cost of a function body, 0 disables inlining
+    int specialize_limit; // Maximal AST node count of the specialized function copies, 0 disables
+                          // the specialization
+    int eval_limit; // Maximal evaluation steps of a pure call with literal arguments, 0 disables
+                    // the evaluation
+    int jobs; // Threads working on the functions in parallel, 1 works sequentially
+    size_t cache_size; // Maximal size of the cache directory in bytes
     uint32_t input_buf_len;
     uint32_t output_buf_len;
     FILE *default_out_stream;
 };
 
-extern struct globals global;
+// Each thread runs its own compilation, so the globals are thread local
+extern _Thread_local struct globals global;
 extern void GLBinitializeGlobals(void);
+// Sets the optimization options of the globals, the other globals are left as they are.
+extern void GLBapplyOptions(const struct civicc_options *options);
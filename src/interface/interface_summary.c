@@ -0,0 +1,520 @@
+#include "ccngen/ast.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CIVICC_VERSION
+#define CIVICC_VERSION "unknown"
+#endif
+
+#define SUMMARY_MAGIC "civicc-summary 2\n"
+#define SUMMARY_MAX_STRING (1u << 16)
+
+/*
+ * The interface summary of a module is a binary file of its exports, read for the extern
+ * declarations of the modules importing it. After the magic and the compiler version follows one
+ * record per export, which starts with its kind, name and type:
+ *
+ * F <pure u8> <param count u32> (<type u8> <dimension count u8>)*  exported function
+ * A <dimension count u32> <size u32>*                                 dimensions of an array
+ *
+ * Strings are a u32 length followed by the characters, all numbers are little endian. Scalar
+ * globals have no record: even if their module never writes them, another module declaring them
+ * extern may, so their value is not known to the importers.
+ */
+
+enum summary_kind
+{
+    SUMMARY_FUNCTION = 'F',
+    SUMMARY_ARRAY = 'A',
+};
+
+/// Export of a read interface summary.
+struct summary_entry
+{
+    enum summary_kind kind;
+    char *name;
+    enum DataType type;
+    bool pure;      // Function without side effects
+    uint32_t count; // Parameters of a function or dimensions of an array
+    enum DataType *param_types;
+    uint8_t *param_dims; // Dimension count of the parameters, 0 for scalars
+    node_st **dims;      // Int literals of the dimension sizes of an array
+};
+
+static _Thread_local htable_stptr entries = NULL;   // Exports of the read summaries by name
+static _Thread_local htable_stptr constants = NULL; // Literals replacing the extern dimensions
+static _Thread_local htable_stptr sideeffect_table = NULL;
+
+static void reset_state()
+{
+    entries = NULL;
+    constants = NULL;
+    sideeffect_table = NULL;
+}
+
+static void write_u8(FILE *fd, uint8_t value)
+{
+    fputc(value, fd);
+}
+
+static void write_u32(FILE *fd, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        fputc((value >> (8 * i)) & 0xff, fd);
+    }
+}
+
+static void write_string(FILE *fd, const char *str)
+{
+    size_t length = strlen(str);
+    write_u32(fd, (uint32_t)length);
+    fwrite(str, 1, length, fd);
+}
+
+static bool read_u8(FILE *fd, uint8_t *out)
+{
+    int c = fgetc(fd);
+    if (c == EOF)
+    {
+        return false;
+    }
+    *out = (uint8_t)c;
+    return true;
+}
+
+static bool read_u32(FILE *fd, uint32_t *out)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t byte;
+        if (!read_u8(fd, &byte))
+        {
+            return false;
+        }
+        value |= (uint32_t)byte << (8 * i);
+    }
+    *out = value;
+    return true;
+}
+
+static char *read_string(FILE *fd)
+{
+    uint32_t length;
+    if (!read_u32(fd, &length) || length > SUMMARY_MAX_STRING)
+    {
+        return NULL;
+    }
+
+    char *str = malloc(length + 1u);
+    release_assert(str != NULL);
+    if (fread(str, 1, length, fd) != length)
+    {
+        free(str);
+        return NULL;
+    }
+    str[length] = '\0';
+    return str;
+}
+
+static bool read_type(FILE *fd, enum DataType *out)
+{
+    uint8_t type;
+    if (!read_u8(fd, &type))
+    {
+        return false;
+    }
+
+    switch (type)
+    {
+    case DT_void:
+    case DT_bool:
+    case DT_int:
+    case DT_float:
+        *out = (enum DataType)type;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void free_entry(struct summary_entry *entry)
+{
+    free(entry->name);
+    free(entry->param_types);
+    free(entry->param_dims);
+    if (entry->dims != NULL)
+    {
+        for (uint32_t i = 0; i < entry->count; i++)
+        {
+            CCNfree(entry->dims[i]);
+        }
+        free(entry->dims);
+    }
+    free(entry);
+}
+
+/// Reads the rest of a record after its kind. Returns false if the record is malformed.
+static bool read_entry(FILE *fd, struct summary_entry *entry)
+{
+    entry->name = read_string(fd);
+    if (entry->name == NULL || !read_type(fd, &entry->type))
+    {
+        return false;
+    }
+
+    switch (entry->kind)
+    {
+    case SUMMARY_FUNCTION: {
+        uint8_t pure;
+        if (!read_u8(fd, &pure) || !read_u32(fd, &entry->count) || entry->count > UINT8_MAX)
+        {
+            return false;
+        }
+        entry->pure = pure != 0;
+        entry->param_types = malloc((entry->count + 1u) * sizeof(enum DataType));
+        entry->param_dims = malloc(entry->count + 1u);
+        release_assert(entry->param_types != NULL);
+        release_assert(entry->param_dims != NULL);
+        for (uint32_t i = 0; i < entry->count; i++)
+        {
+            if (!read_type(fd, &entry->param_types[i]) || !read_u8(fd, &entry->param_dims[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case SUMMARY_ARRAY: {
+        uint32_t count;
+        if (!read_u32(fd, &count) || count > UINT8_MAX)
+        {
+            return false;
+        }
+        entry->dims = calloc(count + 1u, sizeof(node_st *));
+        release_assert(entry->dims != NULL);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t size;
+            if (!read_u32(fd, &size))
+            {
+                return false;
+            }
+            entry->dims[i] = ASTint((int32_t)size);
+            entry->count++;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/// Reads the exports of a summary into the entries. The first summary exporting a name wins, the
+/// linker reports the duplicate.
+static void read_summary(const char *path)
+{
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL)
+    {
+        CTI(CTI_ERROR, true, "Cannot open the interface summary '%s'.", path);
+        return;
+    }
+
+    char magic[sizeof(SUMMARY_MAGIC)] = {0};
+    char *version = NULL;
+    bool valid = fread(magic, 1, sizeof(SUMMARY_MAGIC) - 1, fd) == sizeof(SUMMARY_MAGIC) - 1 &&
+                 STReq(magic, SUMMARY_MAGIC);
+    if (valid)
+    {
+        version = read_string(fd);
+        valid = version != NULL && STReq(version, CIVICC_VERSION);
+    }
+
+    uint8_t kind;
+    while (valid && read_u8(fd, &kind))
+    {
+        struct summary_entry *entry = calloc(1, sizeof(struct summary_entry));
+        release_assert(entry != NULL);
+        entry->kind = (enum summary_kind)kind;
+        valid = read_entry(fd, entry);
+        if (!valid || HTlookup(entries, entry->name) != NULL)
+        {
+            free_entry(entry);
+            continue;
+        }
+        bool success = HTinsert(entries, entry->name, entry);
+        release_assert(success);
+    }
+
+    if (!valid)
+    {
+        CTI(CTI_ERROR, true, "Invalid interface summary '%s', it has to be written by this civicc.",
+            path);
+    }
+    free(version);
+    fclose(fd);
+}
+
+static uint8_t dim_count(node_st *var)
+{
+    uint8_t count = 0;
+    if (NODE_TYPE(var) == NT_ARRAYVAR)
+    {
+        for (node_st *dim = ARRAYVAR_DIMS(var); dim != NULL; dim = DIMENSIONVARS_NEXT(dim))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static bool matches_function(struct summary_entry *entry, node_st *funheader)
+{
+    if (entry->kind != SUMMARY_FUNCTION || entry->type != FUNHEADER_TYPE(funheader))
+    {
+        return false;
+    }
+
+    uint32_t i = 0;
+    for (node_st *params = FUNHEADER_PARAMS(funheader); params != NULL;
+         params = PARAMS_NEXT(params), i++)
+    {
+        if (i == entry->count || entry->param_types[i] != PARAMS_TYPE(params) ||
+            entry->param_dims[i] != dim_count(PARAMS_VAR(params)))
+        {
+            return false;
+        }
+    }
+    return i == entry->count;
+}
+
+static void warn_mismatch(node_st *decl, const char *name)
+{
+    struct ctinfo ctinfo = NODE_TO_CTINFO(decl);
+    CTIobj(CTI_WARN, true, ctinfo,
+           "The extern declaration of '%s' does not match its interface summary, it is ignored.",
+           name);
+}
+
+/// Marks the pure extern functions and collects the literals of the extern array dimensions, which
+/// this module does not write either.
+static void apply_summaries(node_st *program)
+{
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) == NT_FUNDEC)
+        {
+            node_st *funheader = FUNDEC_FUNHEADER(decl);
+            const char *name = get_pretty_name(VAR_NAME(FUNHEADER_VAR(funheader)));
+            struct summary_entry *entry = HTlookup(entries, (void *)name);
+            if (entry == NULL)
+            {
+                continue;
+            }
+
+            if (!matches_function(entry, funheader))
+            {
+                warn_mismatch(decl, name);
+                continue;
+            }
+            FUNDEC_IS_PURE(decl) = entry->pure;
+        }
+        else if (NODE_TYPE(decl) == NT_GLOBALDEC)
+        {
+            node_st *var = GLOBALDEC_VAR(decl);
+            bool is_array = NODE_TYPE(var) == NT_ARRAYVAR;
+            char *var_name = VAR_NAME(is_array ? ARRAYVAR_VAR(var) : var);
+            const char *name = get_pretty_name(var_name);
+            struct summary_entry *entry = HTlookup(entries, (void *)name);
+            if (entry == NULL || entry->kind == SUMMARY_FUNCTION)
+            {
+                // Scalar globals have no summary entry, any module may write them
+                continue;
+            }
+
+            if (!is_array || entry->type != GLOBALDEC_TYPE(decl) || entry->count != dim_count(var))
+            {
+                warn_mismatch(decl, name);
+                continue;
+            }
+
+            uint32_t i = 0;
+            for (node_st *dim = ARRAYVAR_DIMS(var); dim != NULL; dim = DIMENSIONVARS_NEXT(dim), i++)
+            {
+                char *dim_name = VAR_NAME(DIMENSIONVARS_DIM(dim));
+                if (!is_assigned(program, dim_name))
+                {
+                    HTinsert(constants, dim_name, entry->dims[i]);
+                }
+            }
+        }
+    }
+}
+
+/// Writes the exported function. It is pure if it has no side effects and no array parameters,
+/// which it could write.
+static void write_function(FILE *fd, node_st *fundef)
+{
+    node_st *funheader = FUNDEF_FUNHEADER(fundef);
+    bool pure = check_fun_sideeffect(fundef, sideeffect_table) == SEFF_NO;
+    uint32_t count = 0;
+    for (node_st *params = FUNHEADER_PARAMS(funheader); params != NULL;
+         params = PARAMS_NEXT(params))
+    {
+        pure = pure && NODE_TYPE(PARAMS_VAR(params)) == NT_VAR;
+        count++;
+    }
+
+    write_u8(fd, SUMMARY_FUNCTION);
+    write_string(fd, get_pretty_name(VAR_NAME(FUNHEADER_VAR(funheader))));
+    write_u8(fd, FUNHEADER_TYPE(funheader));
+    write_u8(fd, pure ? 1 : 0);
+    write_u32(fd, count);
+    for (node_st *params = FUNHEADER_PARAMS(funheader); params != NULL;
+         params = PARAMS_NEXT(params))
+    {
+        write_u8(fd, PARAMS_TYPE(params));
+        write_u8(fd, dim_count(PARAMS_VAR(params)));
+    }
+}
+
+/// Writes the exported array if its dimensions are constant.
+static void write_global(FILE *fd, node_st *globaldef)
+{
+    node_st *vardec = GLOBALDEF_VARDEC(globaldef);
+    node_st *var = VARDEC_VAR(vardec);
+    if (NODE_TYPE(var) != NT_ARRAYEXPR)
+    {
+        return;
+    }
+
+    uint32_t count = 0;
+    for (node_st *dims = ARRAYEXPR_DIMS(var); dims != NULL; dims = EXPRS_NEXT(dims))
+    {
+        if (NODE_TYPE(EXPRS_EXPR(dims)) != NT_INT)
+        {
+            return;
+        }
+        count++;
+    }
+
+    write_u8(fd, SUMMARY_ARRAY);
+    write_string(fd, get_pretty_name(VAR_NAME(ARRAYEXPR_VAR(var))));
+    write_u8(fd, VARDEC_TYPE(vardec));
+    write_u32(fd, count);
+    for (node_st *dims = ARRAYEXPR_DIMS(var); dims != NULL; dims = EXPRS_NEXT(dims))
+    {
+        write_u32(fd, (uint32_t)INT_VAL(EXPRS_EXPR(dims)));
+    }
+}
+
+static void write_summary(node_st *program, const char *path)
+{
+    FILE *fd = fopen(path, "wb");
+    if (fd == NULL)
+    {
+        CTI(CTI_ERROR, true, "Cannot write the interface summary '%s'.", path);
+        return;
+    }
+
+    fputs(SUMMARY_MAGIC, fd);
+    write_string(fd, CIVICC_VERSION);
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) == NT_FUNDEF && FUNDEF_HAS_EXPORT(decl))
+        {
+            write_function(fd, decl);
+        }
+        else if (NODE_TYPE(decl) == NT_GLOBALDEF && GLOBALDEF_HAS_EXPORT(decl))
+        {
+            write_global(fd, decl);
+        }
+    }
+
+    if (ferror(fd))
+    {
+        CTI(CTI_ERROR, true, "Cannot write the interface summary '%s'.", path);
+    }
+    fclose(fd);
+}
+
+node_st *IS_MIfundec(node_st *node)
+{
+    // The parameters are declarations, which must stay variables
+    return node;
+}
+
+node_st *IS_MIglobaldec(node_st *node)
+{
+    // The variable and the dimensions are declarations, which must stay variables
+    return node;
+}
+
+node_st *IS_MIvar(node_st *node)
+{
+    node_st *value = HTlookup(constants, VAR_NAME(node));
+    if (value == NULL)
+    {
+        return node;
+    }
+
+    node_st *literal = CCNcopy(value);
+    CCNfree(node);
+    return literal;
+}
+
+/**
+ * Reads the interface summaries of the imported modules and writes the summary of this module.
+ * The extern functions of a summary, which are pure, are marked as such and the dimensions of the
+ * extern arrays, which are never written, are replaced by their literals:
+ *
+ * extern int[n] table; ... for (int i = 0, n) becomes: for (int i = 0, 4)
+ *
+ * The summary is written after the imported summaries are applied, so the purity and dimensions of
+ * the imported modules pass on to the exports of this module.
+ */
+node_st *IS_MIprogram(node_st *node)
+{
+    reset_state();
+    entries = HTnew_String(2 << 6);
+    constants = HTnew_String(2 << 6);
+    for (int i = 0; i < global.summary_input_count; i++)
+    {
+        read_summary(global.summary_inputs[i]);
+    }
+    apply_summaries(node);
+    TRAVchildren(node);
+
+    if (global.summary_output != NULL)
+    {
+        sideeffect_table = HTnew_Ptr(2 << 8);
+        write_summary(node, global.summary_output);
+        HTdelete(sideeffect_table);
+    }
+
+    for (htable_iter_st *iter = HTiterate(entries); iter; iter = HTiterateNext(iter))
+    {
+        free_entry(HTiterValue(iter));
+    }
+    HTdelete(entries);
+    HTdelete(constants);
+    reset_state();
+    CTIabortOnError();
+    return node;
+}
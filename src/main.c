@@ -5,8 +5,13 @@
 
 #include "ccn/dynamic_core.h"
 #include "ccn/phase_driver.h"
+#include "compile_cache.h"
 #include "global/globals.h"
+#include "palm/ctinfo.h"
 #include "palm/str.h"
+#include "profiler.h"
+#include "release_assert.h"
+#include "server.h"
 
 static void Usage(char *program)
 {
@@ -15,12 +20,63 @@ static void Usage(char *program)
         program = program_bin + 1;
 
     printf("Usage: %s [OPTION...] <input file>\n", program);
+    printf("       %s --lto [OPTION...] <input file>...\n", program);
     printf("Options:\n");
     printf("  --help/-h                    This help message.\n");
     printf("  --output/-o <output_file>    Output assembly to the given output file instead of "
            "STDOUT.\n");
     printf("  --nocpreprocessor/-ncpp      Disables the C preprocessor.\n");
     printf("  --nooptimization/-nopt       Disables the optimizations.\n");
+    printf("  --unroll/-unroll <limit>     Unrolls constant for loops up to a body size of <limit> "
+           "AST nodes.\n");
+    printf("  --tailcalls/-tco             Turns self tail calls and accumulator recursion into "
+           "loops.\n");
+    printf("  --inline/-inline <limit>     Inlines functions with a body size of at most <limit> "
+           "AST nodes\n"
+           "                               more than the call they replace.\n");
+    printf("  --specialize/-spec <limit>   Propagates constant arguments into functions and "
+           "specializes copies\n"
+           "                               of functions for constant arguments up to <limit> AST "
+           "nodes.\n");
+    printf("  --evaluate/-eval <steps>     Evaluates calls of pure functions with constant "
+           "arguments at compile\n"
+           "                               time in at most <steps> evaluation steps per call.\n");
+    printf("  --ranges/-ranges             Removes the branches of int comparisons decided by the "
+           "value ranges\n"
+           "                               of the locals.\n");
+    printf("  --promote/-promote           Keeps the globals and outer variables of loops in "
+           "locals.\n");
+    printf("  --packslots/-pack            Shares the frame slots of locals with disjoint live "
+           "ranges.\n");
+    printf("  --lto/-lto                   Links the input files into one program and optimizes "
+           "it as a whole.\n"
+           "                               Only main stays exported.\n");
+    printf("  --emit-summary/-esum <file>  Writes the signatures, purity and array dimensions of "
+           "the exports to the\n"
+           "                               given interface summary file.\n");
+    printf("  --import-summary/-isum <file>\n"
+           "                               Reads the interface summary of a module for the extern "
+           "declarations,\n"
+           "                               can be given once per imported module.\n");
+    printf("  --instrument/-instr <file>   Counts the executed functions and blocks, prints the "
+           "counts at the exit\n"
+           "                               of main and writes the source location of each count "
+           "to the given file.\n");
+    printf("  --jobs/-j <count>            Type checks, simplifies and generates the code of the "
+           "top-level\n"
+           "                               declarations on <count> threads.\n");
+    printf("  --time-report                Prints the time, nodes and allocations per action to "
+           "STDERR.\n");
+    printf("  --trace-out <trace_file>     Writes the actions as Chrome trace events to the given "
+           "file.\n");
+    printf("  --cache-dir <directory>      Reuses the output of earlier compilations of the same "
+           "source and flags.\n");
+    printf("  --server <socket>            Compiles the requests of clients on the Unix domain "
+           "socket.\n"
+           "                               civicc forwards to the server of the CIVICC_SERVER "
+           "socket if set.\n");
+    printf("  --cache-size <MiB>           Evicts the least recently used outputs above this cache "
+           "size (default 256).\n");
 }
 
 static void RequiereArguments(char *option, int count, int argc, int index, char *program)
@@ -38,6 +94,7 @@ static void RequiereArguments(char *option, int count, int argc, int index, char
 static int ProcessArgs(int argc, char *argv[])
 {
     int i_argc = 1;
+    bool lto = false;
 
     if (i_argc < argc)
     {
@@ -59,6 +116,96 @@ static int ProcessArgs(int argc, char *argv[])
             {
                 global.optimization_enabled = false;
             }
+            else if (STReq(arg, "-unroll") || (is_long && STReq(arg, "--unroll")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.unroll_limit = atoi(argv[++i_argc]);
+            }
+            else if (STReq(arg, "-tco") || (is_long && STReq(arg, "--tailcalls")))
+            {
+                global.tail_calls_enabled = true;
+            }
+            else if (STReq(arg, "-inline") || (is_long && STReq(arg, "--inline")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.inline_limit = atoi(argv[++i_argc]);
+            }
+            else if (STReq(arg, "-spec") || (is_long && STReq(arg, "--specialize")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.specialize_limit = atoi(argv[++i_argc]);
+            }
+            else if (STReq(arg, "-eval") || (is_long && STReq(arg, "--evaluate")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.eval_limit = atoi(argv[++i_argc]);
+            }
+            else if (STReq(arg, "-ranges") || (is_long && STReq(arg, "--ranges")))
+            {
+                global.value_ranges_enabled = true;
+            }
+            else if (STReq(arg, "-promote") || (is_long && STReq(arg, "--promote")))
+            {
+                global.scalar_promotion_enabled = true;
+            }
+            else if (STReq(arg, "-pack") || (is_long && STReq(arg, "--packslots")))
+            {
+                global.slot_packing_enabled = true;
+            }
+            else if (STReq(arg, "-lto") || (is_long && STReq(arg, "--lto")))
+            {
+                lto = true;
+            }
+            else if (STReq(arg, "-esum") || (is_long && STReq(arg, "--emit-summary")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.summary_output = argv[++i_argc];
+            }
+            else if (STReq(arg, "-isum") || (is_long && STReq(arg, "--import-summary")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                if (global.summary_inputs == NULL)
+                {
+                    // Lives as long as the process, the arguments bound the summary count
+                    global.summary_inputs = malloc((size_t)argc * sizeof(const char *));
+                    release_assert(global.summary_inputs != NULL);
+                }
+                global.summary_inputs[global.summary_input_count++] = argv[++i_argc];
+            }
+            else if (STReq(arg, "-instr") || (is_long && STReq(arg, "--instrument")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.instrument_output = argv[++i_argc];
+            }
+            else if (STReq(arg, "-j") || (is_long && STReq(arg, "--jobs")))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.jobs = atoi(argv[++i_argc]);
+            }
+            else if (is_long && STReq(arg, "--time-report"))
+            {
+                global.time_report = true;
+            }
+            else if (is_long && STReq(arg, "--trace-out"))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.trace_file = argv[++i_argc];
+            }
+            else if (is_long && STReq(arg, "--cache-dir"))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.cache_dir = argv[++i_argc];
+            }
+            else if (is_long && STReq(arg, "--cache-size"))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.cache_size = (size_t)strtoul(argv[++i_argc], NULL, 10) * 1024 * 1024;
+            }
+            else if (is_long && STReq(arg, "--server"))
+            {
+                RequiereArguments(arg, 1, argc, i_argc, argv[0]);
+                global.server_socket = argv[++i_argc];
+            }
             else if (STReq(arg, "-h") || (is_long && STReq(arg, "--help")))
             {
                 Usage(argv[0]);
@@ -71,8 +218,9 @@ static int ProcessArgs(int argc, char *argv[])
                 exit(EXIT_FAILURE);
             }
 
-            if (i_argc >= argc)
+            if (i_argc + 1 >= argc)
             {
+                i_argc++;
                 break;
             }
 
@@ -80,7 +228,17 @@ static int ProcessArgs(int argc, char *argv[])
         }
     }
 
-    if (i_argc == argc - 1)
+    if (global.server_socket != NULL && i_argc == argc)
+    {
+        // The server gets the input files with the requests
+    }
+    else if (lto && i_argc < argc)
+    {
+        global.lto_inputs = (const char **)&argv[i_argc];
+        global.lto_input_count = argc - i_argc;
+        global.input_file = argv[i_argc];
+    }
+    else if (i_argc == argc - 1)
     {
         global.input_file = argv[i_argc];
     }
@@ -101,11 +259,158 @@ void BreakpointHandler(node_st *root)
     return;
 }
 
+static int WriteOutput(const char *output, size_t length)
+{
+    FILE *fd = global.output_file == NULL ? stdout : fopen(global.output_file, "w");
+    if (fd == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot write to file '%s'.\n", global.output_file);
+        return EXIT_FAILURE;
+    }
+
+    fwrite(output, 1, length, fd);
+    if (fd != stdout)
+    {
+        fclose(fd);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Compiles the preprocessed source only if the cache has no output for it. The compilation writes
+ * into a memory stream to store its output. A hit skips the whole compilation, so the warnings of
+ * the first compilation are not reported again. */
+static int CompileCached(void)
+{
+    size_t length = 0;
+    char *source = cache_read_source(&length);
+    char *key = cache_key(source, length);
+    char *output = NULL;
+    size_t output_length = 0;
+    if (!cache_lookup(global.cache_dir, key, source, length, &output, &output_length))
+    {
+        const char *output_file = global.output_file;
+        FILE *stream = open_memstream(&output, &output_length);
+        release_assert(stream != NULL);
+        global.output_file = NULL;
+        global.default_out_stream = stream;
+        global.input_buf = source;
+        global.input_buf_len = (uint32_t)length;
+
+        CCNrun(NULL);
+
+        fclose(stream);
+        global.output_file = output_file;
+        global.default_out_stream = stdout;
+        global.input_buf = NULL;
+        global.input_buf_len = 0;
+        if (CTIgetErrors() == 0 &&
+            !cache_store(global.cache_dir, key, source, length, output, output_length,
+                         global.cache_size))
+        {
+            fprintf(stderr, "WARNING: Cannot store the output in the cache '%s'.\n",
+                    global.cache_dir);
+        }
+    }
+
+    int status = WriteOutput(output, output_length);
+    free(output);
+    free(key);
+    free(source);
+    return status;
+}
+
+// The cache and the server requests are keyed by a single source, the linked modules, the
+// interface summaries and the instrumentation map are files besides it.
+static bool UsesOtherFiles(void)
+{
+    return global.lto_input_count > 0 || global.summary_input_count > 0 ||
+           global.summary_output != NULL || global.instrument_output != NULL;
+}
+
+static int Compile(void)
+{
+    bool profile = global.time_report || global.trace_file != NULL;
+    if (profile)
+    {
+        profiler_start();
+    }
+
+    int status = EXIT_SUCCESS;
+    if (global.cache_dir != NULL && !UsesOtherFiles())
+    {
+        status = CompileCached();
+    }
+    else
+    {
+        CCNrun(NULL);
+    }
+
+    if (profile)
+    {
+        profiler_stop();
+        if (global.time_report)
+        {
+            profiler_report(stderr);
+        }
+        if (global.trace_file != NULL && !profiler_write_trace(global.trace_file))
+        {
+            fprintf(stderr, "ERROR: Cannot write the trace to '%s'.\n", global.trace_file);
+            profiler_reset();
+            return EXIT_FAILURE;
+        }
+        profiler_reset();
+    }
+    return status;
+}
+
+/* Compiles a request of a client in a process forked from the server. */
+static int CompileRequest(int argc, char **argv, char *source, size_t source_length)
+{
+    GLBinitializeGlobals();
+    ProcessArgs(argc, argv);
+    if (global.server_socket != NULL)
+    {
+        fprintf(stderr, "ERROR: A request can not start another server.\n");
+        return EXIT_FAILURE;
+    }
+    if (global.lto_input_count > 0)
+    {
+        fprintf(stderr, "ERROR: A request can not link modules.\n");
+        return EXIT_FAILURE;
+    }
+    if (global.summary_input_count > 0 || global.summary_output != NULL)
+    {
+        fprintf(stderr, "ERROR: A request can not read or write interface summaries.\n");
+        return EXIT_FAILURE;
+    }
+    if (global.instrument_output != NULL)
+    {
+        fprintf(stderr, "ERROR: A request can not write an instrumentation map.\n");
+        return EXIT_FAILURE;
+    }
+
+    global.input_buf = source;
+    global.input_buf_len = (uint32_t)source_length;
+    resetPhaseDriver();
+    return Compile();
+}
+
 int main(int argc, char **argv)
 {
     GLBinitializeGlobals();
     ProcessArgs(argc, argv);
+    if (global.server_socket != NULL)
+    {
+        return server_run(global.server_socket, CompileRequest);
+    }
 
-    CCNrun(NULL);
-    return 0;
+    // Compiles locally if the server is not running
+    const char *server_socket = getenv("CIVICC_SERVER");
+    int status;
+    if (server_socket != NULL && !UsesOtherFiles() &&
+        server_forward(server_socket, argc, argv, NULL, 0, &status))
+    {
+        return status;
+    }
+    return Compile();
 }
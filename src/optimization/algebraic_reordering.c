@@ -1,8 +1,11 @@
+#include "global/globals.h"
 #include "release_assert.h"
+#include "scheduler.h"
 #include <ccn/dynamic_core.h>
 #include <ccn/phase_driver.h>
 #include <ccngen/ast.h>
 #include <ccngen/enum.h>
+#include <ccngen/trav.h>
 #include <stdio.h>
 
 node_st *OPT_ARbinop(node_st *node)
@@ -231,3 +234,24 @@ node_st *OPT_ARbinop(node_st *node)
     }
     return node;
 }
+
+/// Reorders a top-level declaration on a worker thread of the scheduler.
+static void reorder_decl(node_st *decl, void *arg)
+{
+    (void)arg;
+    node_st *result = TRAVstart(decl, TRAV_OPT_AR);
+    release_assert(result == decl);
+}
+
+node_st *OPT_ARprogram(node_st *node)
+{
+    if (global.jobs > 1)
+    {
+        schedule_decls(PROGRAM_DECLS(node), reorder_decl, NULL);
+    }
+    else
+    {
+        TRAVchildren(node);
+    }
+    return node;
+}
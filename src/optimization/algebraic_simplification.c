@@ -1,19 +1,21 @@
 #include "ccngen/ast.h"
+#include "global/globals.h"
 #include "palm/hash_table.h"
 #include "release_assert.h"
+#include "scheduler.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
-#include <ccn/phase_driver.h>
 #include <ccngen/enum.h>
+#include <ccngen/trav.h>
 #include <stdbool.h>
 #include <string.h>
 
-static htable_stptr current = NULL;
-static htable_stptr sideeffect_table = NULL;
-static node_st *sideeffected_expr = NULL;
-static bool check_sideeffects = false;
-static enum DataType sideeffect_type = DT_NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr sideeffect_table = NULL;
+static _Thread_local node_st *sideeffected_expr = NULL;
+static _Thread_local bool check_sideeffects = false;
+static _Thread_local enum DataType sideeffect_type = DT_NULL;
 
 static void reset()
 {
@@ -146,7 +148,6 @@ node_st *OPT_ASproccall(node_st *node)
                                 : ASTbinop(sideeffected_expr, expr, BO_add, sideeffect_type);
     }
 
-    CCNcycleNotify();
     return NULL;
 }
 
@@ -221,7 +222,6 @@ node_st *OPT_ASternary(node_st *node)
                 : ASTbinop(parent_sideeffect_expr, node, BO_add, sideeffect_type);
 
         sideeffected_expr = parent_sideeffect_expr;
-        CCNcycleNotify();
         return NULL;
     }
     else
@@ -234,463 +234,362 @@ node_st *OPT_ASternary(node_st *node)
     }
 }
 
-node_st *OPT_ASbinop(node_st *node)
+/// Operand of a binop rule which holds the literal.
+enum rule_side
 {
+    SIDE_LEFT,
+    SIDE_RIGHT
+};
 
-    if (check_sideeffects)
+/// Rewrite of an expression matched by a rule.
+enum rule_action
+{
+    RW_NONE,
+    RW_KEEP,     // The other operand, e.g. x * 1 -> x
+    RW_NEGATE,   // The negated other operand, e.g. x / -1 -> -x
+    RW_CONSTANT, // The result literal after the side effects of the other operand, e.g. x * 0 -> 0
+    RW_FOLD,     // The literal operand with the operator applied, e.g. -(1) -> -1
+    RW_UNWRAP    // The operand of a nested monop with the same operator, e.g. --x -> x
+};
+
+/// Identity of a binop with an Int, Float or Bool literal of the given value on one side.
+struct binop_rule
+{
+    enum ccn_nodetype literal;
+    enum rule_side side;
+    double value;
+    enum rule_action action;
+    double result; // Value of the literal of RW_CONSTANT
+};
+
+/// Identity of a monop with an operand of the given node type.
+struct monop_rule
+{
+    enum ccn_nodetype operand;
+    enum rule_action action;
+};
+
+/**
+ * The identities, one list per operator which ends with a NT_NULL literal. The rules of a list
+ * are tried in order and the first one matching rewrites the expression, so a binop with two
+ * literals is rewritten by its left one. A new identity is one more line in its list:
+ *
+ * {NT_INT, SIDE_RIGHT, 1, RW_KEEP, 0} rewrites x * 1 to x in mul_rules.
+ */
+static const struct binop_rule add_rules[] = {
+    {NT_INT, SIDE_LEFT, 0, RW_KEEP, 0},             // 0 + x -> x
+    {NT_INT, SIDE_RIGHT, 0, RW_KEEP, 0},            // x + 0 -> x
+    {NT_FLOAT, SIDE_LEFT, 0.0, RW_KEEP, 0},         // 0.0 + x -> x
+    {NT_FLOAT, SIDE_RIGHT, 0.0, RW_KEEP, 0},        // x + 0.0 -> x
+    {NT_BOOL, SIDE_LEFT, true, RW_CONSTANT, true},  // true + x -> true
+    {NT_BOOL, SIDE_RIGHT, true, RW_CONSTANT, true}, // x + true -> true
+    {NT_NULL, SIDE_LEFT, 0, RW_NONE, 0},
+};
+
+static const struct binop_rule sub_rules[] = {
+    {NT_INT, SIDE_LEFT, 0, RW_NEGATE, 0},     // 0 - x -> -x
+    {NT_INT, SIDE_RIGHT, 0, RW_KEEP, 0},      // x - 0 -> x
+    {NT_FLOAT, SIDE_LEFT, 0.0, RW_NEGATE, 0}, // 0.0 - x -> -x
+    {NT_FLOAT, SIDE_RIGHT, 0.0, RW_KEEP, 0},  // x - 0.0 -> x
+    {NT_NULL, SIDE_LEFT, 0, RW_NONE, 0},
+};
+
+static const struct binop_rule mul_rules[] = {
+    {NT_INT, SIDE_LEFT, 1, RW_KEEP, 0},               // 1 * x -> x
+    {NT_INT, SIDE_LEFT, 0, RW_CONSTANT, 0},           // 0 * x -> 0
+    {NT_INT, SIDE_RIGHT, 1, RW_KEEP, 0},              // x * 1 -> x
+    {NT_INT, SIDE_RIGHT, 0, RW_CONSTANT, 0},          // x * 0 -> 0
+    {NT_FLOAT, SIDE_LEFT, 1.0, RW_KEEP, 0},           // 1.0 * x -> x
+    {NT_FLOAT, SIDE_LEFT, 0.0, RW_CONSTANT, 0.0},     // 0.0 * x -> 0.0
+    {NT_FLOAT, SIDE_RIGHT, 1.0, RW_KEEP, 0},          // x * 1.0 -> x
+    {NT_FLOAT, SIDE_RIGHT, 0.0, RW_CONSTANT, 0.0},    // x * 0.0 -> 0.0
+    {NT_BOOL, SIDE_LEFT, true, RW_KEEP, 0},           // true * x -> x
+    {NT_BOOL, SIDE_LEFT, false, RW_CONSTANT, false},  // false * x -> false
+    {NT_BOOL, SIDE_RIGHT, true, RW_KEEP, 0},          // x * true -> x
+    {NT_BOOL, SIDE_RIGHT, false, RW_CONSTANT, false}, // x * false -> false
+    {NT_NULL, SIDE_LEFT, 0, RW_NONE, 0},
+};
+
+static const struct binop_rule div_rules[] = {
+    {NT_INT, SIDE_RIGHT, 1, RW_KEEP, 0},        // x / 1 -> x
+    {NT_INT, SIDE_RIGHT, -1, RW_NEGATE, 0},     // x / -1 -> -x
+    {NT_FLOAT, SIDE_RIGHT, 1.0, RW_KEEP, 0},    // x / 1.0 -> x
+    {NT_FLOAT, SIDE_RIGHT, -1.0, RW_NEGATE, 0}, // x / -1.0 -> -x
+    {NT_NULL, SIDE_LEFT, 0, RW_NONE, 0},
+};
+
+static const struct binop_rule mod_rules[] = {
+    {NT_INT, SIDE_RIGHT, 1, RW_CONSTANT, 0},  // x % 1 -> 0
+    {NT_INT, SIDE_RIGHT, -1, RW_CONSTANT, 0}, // x % -1 -> 0
+    {NT_NULL, SIDE_LEFT, 0, RW_NONE, 0},
+};
+
+static const struct binop_rule *const binop_rules[] = {
+    [BO_add] = add_rules,
+    [BO_sub] = sub_rules,
+    [BO_mul] = mul_rules,
+    [BO_div] = div_rules,
+    [BO_mod] = mod_rules,
+};
+
+static const struct monop_rule neg_rules[] = {
+    {NT_INT, RW_FOLD},     // -(1) -> -1
+    {NT_FLOAT, RW_FOLD},   // -(1.0) -> -1.0
+    {NT_MONOP, RW_UNWRAP}, // --x -> x
+    {NT_NULL, RW_NONE},
+};
+
+static const struct monop_rule not_rules[] = {
+    {NT_BOOL, RW_FOLD},    // !true -> false
+    {NT_MONOP, RW_UNWRAP}, // !!x -> x
+    {NT_NULL, RW_NONE},
+};
+
+static const struct monop_rule *const monop_rules[] = {
+    [MO_neg] = neg_rules,
+    [MO_not] = not_rules,
+};
+
+static enum DataType literal_type(enum ccn_nodetype literal)
+{
+    switch (literal)
     {
-        BINOP_LEFT(node) = TRAVopt(BINOP_LEFT(node));
-        BINOP_RIGHT(node) = TRAVopt(BINOP_RIGHT(node));
-        return node;
+    case NT_INT:
+        return DT_int;
+    case NT_FLOAT:
+        return DT_float;
+    case NT_BOOL:
+        return DT_bool;
+    default:
+        release_assert(false);
+        return DT_NULL;
     }
-    else
+}
+
+static bool matches_literal(node_st *node, enum ccn_nodetype literal, double value)
+{
+    if (NODE_TYPE(node) != literal)
     {
-        enum DataType parent_sideeffect_type = sideeffect_type;
-        sideeffect_type = BINOP_ARGTYPE(node);
-        BINOP_LEFT(node) = TRAVopt(BINOP_LEFT(node));
-        BINOP_RIGHT(node) = TRAVopt(BINOP_RIGHT(node));
-        sideeffect_type = parent_sideeffect_type;
+        return false;
     }
 
-    node_st *right = BINOP_RIGHT(node);
-    node_st *left = BINOP_LEFT(node);
-
-    if (BINOP_OP(node) == BO_mul)
+    switch (literal)
     {
-        // NT_INT
-        if (NODE_TYPE(left) == NT_INT)
-        {
-            if (INT_VAL(left) == 1)
-            {
-                BINOP_RIGHT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return right;
-            }
-            else if (INT_VAL(left) == 0)
-            {
-                if (is_sideffect_chain(right, DT_int))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_int;
-                BINOP_RIGHT(node) = TRAVopt(right);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTint(0);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_int);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+    case NT_INT:
+        return INT_VAL(node) == value;
+    case NT_FLOAT:
+        return FLOAT_VAL(node) == value;
+    case NT_BOOL:
+        return BOOL_VAL(node) == (value != 0);
+    default:
+        return false;
+    }
+}
 
-        if (NODE_TYPE(right) == NT_INT)
-        {
-            if (INT_VAL(right) == 1)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
-            else if (INT_VAL(right) == 0)
-            {
-                if (is_sideffect_chain(left, DT_int))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_int;
-                BINOP_LEFT(node) = TRAVopt(left);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTint(0);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_int);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+static node_st *new_literal(enum ccn_nodetype literal, double value)
+{
+    switch (literal)
+    {
+    case NT_INT:
+        return ASTint((int)value);
+    case NT_FLOAT:
+        return ASTfloat(value);
+    case NT_BOOL:
+        return ASTbool(value != 0);
+    default:
+        release_assert(false);
+        return NULL;
+    }
+}
 
-        // NT_FLOAT
-        if (NODE_TYPE(left) == NT_FLOAT)
-        {
-            if (FLOAT_VAL(left) == 1.0)
-            {
-                BINOP_RIGHT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return right;
-            }
-            else if (FLOAT_VAL(left) == 0.0)
-            {
-                if (is_sideffect_chain(right, DT_float))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_float;
-                BINOP_RIGHT(node) = TRAVopt(right);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTfloat(0.0);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_float);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+/// Replaces the binop by the result literal of the rule. The side effects of the other operand are
+/// extracted and kept in front of the literal, which does not depend on their values.
+static node_st *rewrite_constant(node_st *node, const struct binop_rule *rule,
+                                 enum rule_action *applied)
+{
+    enum DataType type = literal_type(rule->literal);
+    node_st **other = rule->side == SIDE_LEFT ? &BINOP_RIGHT(node) : &BINOP_LEFT(node);
+    if (is_sideffect_chain(*other, type))
+    {
+        // Only the side effects are left, which can not be removed
+        *applied = RW_NONE;
+        return node;
+    }
 
-        if (NODE_TYPE(right) == NT_FLOAT)
-        {
-            if (FLOAT_VAL(right) == 1.0)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
-            else if (FLOAT_VAL(right) == 0.0)
-            {
-                if (is_sideffect_chain(left, DT_float))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_float;
-                BINOP_LEFT(node) = TRAVopt(left);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTfloat(0.0);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_float);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+    check_sideeffects = true;
+    sideeffect_type = type;
+    *other = TRAVopt(*other);
+    check_sideeffects = false;
+    sideeffect_type = DT_NULL;
 
-        // NT_BOOL
-        if (NODE_TYPE(left) == NT_BOOL)
-        {
-            if (BOOL_VAL(left) == true)
-            {
-                BINOP_RIGHT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return right;
-            }
-            else
-            {
-                if (is_sideffect_chain(right, DT_bool))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_bool;
-                BINOP_RIGHT(node) = TRAVopt(right);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTbool(false);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_bool);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+    node_st *expr = new_literal(rule->literal, rule->result);
+    if (sideeffected_expr != NULL)
+    {
+        // x * 0 is 0, x * false is false and x + true is true for any value of x
+        enum BinOpType op = rule->literal == NT_BOOL && rule->result != 0 ? BO_add : BO_mul;
+        expr = ASTbinop(sideeffected_expr, expr, op, type);
+        sideeffected_expr = NULL;
+    }
+    CCNfree(node);
+    *applied = RW_CONSTANT;
+    return expr;
+}
 
-        if (NODE_TYPE(right) == NT_BOOL)
-        {
-            if (BOOL_VAL(right) == true)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
-            else
-            {
-                if (is_sideffect_chain(left, DT_bool))
-                {
-                    return node;
-                }
-
-                check_sideeffects = true;
-                sideeffect_type = DT_bool;
-                BINOP_LEFT(node) = TRAVopt(left);
-                check_sideeffects = false;
-                sideeffect_type = DT_NULL;
-                node_st *expr = ASTbool(false);
-                if (sideeffected_expr != NULL)
-                {
-                    expr = ASTbinop(sideeffected_expr, expr, BO_mul, DT_bool);
-                    sideeffected_expr = NULL;
-                }
-                CCNfree(node);
-                CCNcycleNotify();
-                return expr;
-            }
-        }
+static node_st *rewrite_binop(node_st *node, enum rule_action *applied)
+{
+    *applied = RW_NONE;
+    enum BinOpType op = BINOP_OP(node);
+    if ((size_t)op >= sizeof(binop_rules) / sizeof(binop_rules[0]) || binop_rules[op] == NULL)
+    {
+        return node;
     }
-    else if (BINOP_OP(node) == BO_add || BINOP_OP(node) == BO_sub)
+
+    for (const struct binop_rule *rule = binop_rules[op]; rule->literal != NT_NULL; rule++)
     {
-        if (NODE_TYPE(left) == NT_INT)
+        node_st *literal = rule->side == SIDE_LEFT ? BINOP_LEFT(node) : BINOP_RIGHT(node);
+        if (!matches_literal(literal, rule->literal, rule->value))
         {
-            if (INT_VAL(left) == 0)
-            {
-                BINOP_RIGHT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return right;
-            }
+            continue;
         }
 
-        if (NODE_TYPE(right) == NT_INT)
+        if (rule->action == RW_CONSTANT)
         {
-            if (INT_VAL(right) == 0)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
+            return rewrite_constant(node, rule, applied);
         }
 
-        // NT_FLOAT
-        if (NODE_TYPE(left) == NT_FLOAT)
+        node_st *other = NULL;
+        if (rule->side == SIDE_LEFT)
         {
-            if (FLOAT_VAL(left) == 0.0)
-            {
-                BINOP_RIGHT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return right;
-            }
+            other = BINOP_RIGHT(node);
+            BINOP_RIGHT(node) = NULL;
         }
-
-        if (NODE_TYPE(right) == NT_FLOAT)
+        else
         {
-            if (FLOAT_VAL(right) == 0.0)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
+            other = BINOP_LEFT(node);
+            BINOP_LEFT(node) = NULL;
         }
+        CCNfree(node);
 
-        // NT_BOOL
-        if (BINOP_OP(node) == BO_add)
+        *applied = rule->action;
+        switch (rule->action)
         {
-            if (NODE_TYPE(left) == NT_BOOL)
-            {
-                if (BOOL_VAL(left) == true)
-                {
-                    if (is_sideffect_chain(right, DT_bool))
-                    {
-                        return node;
-                    }
-
-                    BINOP_LEFT(node) = NULL;
-
-                    check_sideeffects = true;
-                    sideeffect_type = DT_bool;
-                    BINOP_RIGHT(node) = TRAVopt(right);
-                    check_sideeffects = false;
-                    sideeffect_type = DT_NULL;
-                    node_st *expr = left;
-                    if (sideeffected_expr != NULL)
-                    {
-                        expr = ASTbinop(sideeffected_expr, expr, BO_add, DT_bool);
-                        sideeffected_expr = NULL;
-                    }
-                    CCNfree(node);
-                    CCNcycleNotify();
-                    return expr;
-                }
-            }
-
-            if (NODE_TYPE(right) == NT_BOOL)
-            {
-                if (BOOL_VAL(right) == true)
-                {
-                    if (is_sideffect_chain(left, DT_bool))
-                    {
-                        return node;
-                    }
-
-                    BINOP_RIGHT(node) = NULL;
-
-                    check_sideeffects = true;
-                    sideeffect_type = DT_bool;
-                    BINOP_LEFT(node) = TRAVopt(left);
-                    check_sideeffects = false;
-                    sideeffect_type = DT_NULL;
-                    node_st *expr = right;
-                    if (sideeffected_expr != NULL)
-                    {
-                        expr = ASTbinop(sideeffected_expr, expr, BO_add, DT_bool);
-                        sideeffected_expr = NULL;
-                    }
-                    CCNfree(node);
-                    CCNcycleNotify();
-                    return expr;
-                }
-            }
+        case RW_KEEP:
+            return other;
+        case RW_NEGATE:
+            return ASTmonop(other, MO_neg);
+        default:
+            release_assert(false);
+            return other;
         }
     }
-    else if (BINOP_OP(node) == BO_div || BINOP_OP(node) == BO_mod)
+    return node;
+}
+
+static node_st *rewrite_monop(node_st *node, enum rule_action *applied)
+{
+    *applied = RW_NONE;
+    enum MonOpType op = MONOP_OP(node);
+    release_assert((size_t)op < sizeof(monop_rules) / sizeof(monop_rules[0]));
+    release_assert(monop_rules[op] != NULL);
+
+    node_st *child = MONOP_LEFT(node);
+    for (const struct monop_rule *rule = monop_rules[op]; rule->operand != NT_NULL; rule++)
     {
-        if (NODE_TYPE(right) == NT_INT)
+        if (NODE_TYPE(child) != rule->operand ||
+            (rule->action == RW_UNWRAP && MONOP_OP(child) != op))
         {
-            if (INT_VAL(right) == 1)
-            {
-                BINOP_LEFT(node) = NULL;
-                CCNfree(node);
-                CCNcycleNotify();
-                return left;
-            }
+            continue;
         }
 
-        if (NODE_TYPE(right) == NT_INT)
+        MONOP_LEFT(node) = NULL;
+        CCNfree(node);
+        *applied = rule->action;
+        if (rule->action == RW_UNWRAP)
         {
-            if (INT_VAL(right) == -1)
-            {
-                node_st *new_left = ASTmonop(left, MO_neg);
-                BINOP_LEFT(node) = NULL;
-                CCNcycleNotify();
-                CCNfree(node);
-                return new_left;
-            }
+            node_st *child_child = MONOP_LEFT(child);
+            MONOP_LEFT(child) = NULL;
+            CCNfree(child);
+            return child_child;
         }
 
-        // NT_FLOAT
-        if (BINOP_OP(node) == BO_div)
+        switch (NODE_TYPE(child))
         {
-
-            if (NODE_TYPE(right) == NT_FLOAT)
-            {
-                if (FLOAT_VAL(right) == 1.0)
-                {
-                    BINOP_LEFT(node) = NULL;
-                    CCNfree(node);
-                    CCNcycleNotify();
-                    return left;
-                }
-            }
-
-            if (NODE_TYPE(right) == NT_FLOAT)
-            {
-                if (FLOAT_VAL(right) == -1.0)
-                {
-                    node_st *new_left = ASTmonop(left, MO_neg);
-                    BINOP_LEFT(node) = NULL;
-                    CCNfree(node);
-                    CCNcycleNotify();
-                    return new_left;
-                }
-            }
+        case NT_INT:
+            INT_VAL(child) = -INT_VAL(child);
+            break;
+        case NT_FLOAT:
+            FLOAT_VAL(child) = -FLOAT_VAL(child);
+            break;
+        case NT_BOOL:
+            BOOL_VAL(child) = !BOOL_VAL(child);
+            break;
+        default:
+            release_assert(false);
+            break;
         }
+        return child;
     }
-    else if (BINOP_OP(node) == BO_and || BINOP_OP(node) == BO_or)
-    {
-        release_assert(false);
-    }
+    return node;
+}
 
+/**
+ * Applies the rules to the expression until none matches. The operands are simplified before, so
+ * only the root of a rewritten expression can match again:
+ *
+ * 0 - 5 -> -(5) -> -5
+ *
+ * A result literal with extracted side effects is final, as its side effects can not be removed.
+ */
+static node_st *simplify(node_st *node)
+{
+    enum rule_action applied = RW_NONE;
+    do
+    {
+        switch (NODE_TYPE(node))
+        {
+        case NT_BINOP:
+            node = rewrite_binop(node, &applied);
+            break;
+        case NT_MONOP:
+            node = rewrite_monop(node, &applied);
+            break;
+        default:
+            applied = RW_NONE;
+            break;
+        }
+    } while (applied != RW_NONE && applied != RW_CONSTANT);
     return node;
 }
 
-node_st *OPT_ASmonop(node_st *node)
+node_st *OPT_ASbinop(node_st *node)
 {
-    TRAVchildren(node);
     if (check_sideeffects)
     {
+        BINOP_LEFT(node) = TRAVopt(BINOP_LEFT(node));
+        BINOP_RIGHT(node) = TRAVopt(BINOP_RIGHT(node));
         return node;
     }
 
-    node_st *child = MONOP_LEFT(node);
-    enum ccn_nodetype child_type = NODE_TYPE(child);
+    enum DataType parent_sideeffect_type = sideeffect_type;
+    sideeffect_type = BINOP_ARGTYPE(node);
+    BINOP_LEFT(node) = TRAVopt(BINOP_LEFT(node));
+    BINOP_RIGHT(node) = TRAVopt(BINOP_RIGHT(node));
+    sideeffect_type = parent_sideeffect_type;
 
-    switch (MONOP_OP(node))
+    release_assert(BINOP_OP(node) != BO_and && BINOP_OP(node) != BO_or);
+    return simplify(node);
+}
+
+node_st *OPT_ASmonop(node_st *node)
+{
+    TRAVchildren(node);
+    if (check_sideeffects)
     {
-    case MO_NULL:
-        release_assert(false);
-        break;
-    case MO_neg:
-        if (child_type == NT_INT)
-        {
-            MONOP_LEFT(node) = NULL;
-            CCNfree(node);
-            INT_VAL(child) = -INT_VAL(child);
-            CCNcycleNotify();
-            return child;
-        }
-        else if (child_type == NT_FLOAT)
-        {
-            MONOP_LEFT(node) = NULL;
-            CCNfree(node);
-            FLOAT_VAL(child) = -FLOAT_VAL(child);
-            CCNcycleNotify();
-            return child;
-        }
-        else if (child_type == NT_MONOP)
-        {
-            release_assert(MONOP_OP(child) == MO_neg);
-            node_st *child_child = MONOP_LEFT(child);
-            MONOP_LEFT(child) = NULL;
-            CCNfree(node);
-            CCNcycleNotify();
-            return child_child;
-        }
-        break;
-    case MO_not:
-        if (child_type == NT_BOOL)
-        {
-            MONOP_LEFT(node) = NULL;
-            CCNfree(node);
-            BOOL_VAL(child) = !BOOL_VAL(child);
-            CCNcycleNotify();
-            return child;
-        }
-        else if (child_type == NT_MONOP)
-        {
-            release_assert(MONOP_OP(child) == MO_not);
-            node_st *child_child = MONOP_LEFT(child);
-            MONOP_LEFT(child) = NULL;
-            CCNfree(node);
-            CCNcycleNotify();
-            return child_child;
-        }
-        break;
+        return node;
     }
 
-    return node;
+    release_assert(MONOP_OP(node) != MO_NULL);
+    return simplify(node);
 }
 
 node_st *OPT_ASfundef(node_st *node)
@@ -708,12 +607,63 @@ node_st *OPT_ASfundef(node_st *node)
     return node;
 }
 
+/// Symbols and side effects shared by the declarations simplified on the worker threads.
+struct simplify_context
+{
+    htable_stptr symbols;
+    htable_stptr sideeffect_table;
+};
+
+/// Checks the side effects of the function and of its local functions ahead of the jobs. Every
+/// function then has its final entry, so the jobs only read the table and never the bodies of the
+/// functions other threads rewrite.
+static void check_fundef_sideeffects(node_st *fundef)
+{
+    enum sideeffect effect = check_fun_sideeffect(fundef, sideeffect_table);
+    release_assert(effect != SEFF_PROCESSING);
+    for (node_st *locals = FUNBODY_LOCALFUNDEFS(FUNDEF_FUNBODY(fundef)); locals != NULL;
+         locals = LOCALFUNDEFS_NEXT(locals))
+    {
+        check_fundef_sideeffects(LOCALFUNDEFS_LOCALFUNDEF(locals));
+    }
+}
+
+/// Simplifies a top-level declaration on a worker thread of the scheduler.
+static void simplify_decl(node_st *decl, void *arg)
+{
+    struct simplify_context *context = arg;
+    reset();
+    current = context->symbols;
+    sideeffect_table = context->sideeffect_table;
+    node_st *result = TRAVstart(decl, TRAV_OPT_AS);
+    release_assert(result == decl);
+}
+
+/// Simplifies every expression to the fixpoint of the rules in one traversal. It runs first in the
+/// optimization cycle, so the later traversals of the cycle see its rewrites without another cycle.
 node_st *OPT_ASprogram(node_st *node)
 {
     reset();
     sideeffect_table = HTnew_Ptr(2 << 8);
     current = PROGRAM_SYMBOLS(node);
-    TRAVopt(PROGRAM_DECLS(node));
+    if (global.jobs > 1)
+    {
+        for (node_st *decls = PROGRAM_DECLS(node); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+        {
+            if (NODE_TYPE(DECLARATIONS_DECL(decls)) == NT_FUNDEF)
+            {
+                check_fundef_sideeffects(DECLARATIONS_DECL(decls));
+            }
+        }
+
+        struct simplify_context context = {PROGRAM_SYMBOLS(node), sideeffect_table};
+        schedule_decls(PROGRAM_DECLS(node), simplify_decl, &context);
+        sideeffect_table = context.sideeffect_table; // The calling thread runs jobs as well
+    }
+    else
+    {
+        TRAVopt(PROGRAM_DECLS(node));
+    }
     HTdelete(sideeffect_table);
     return node;
 }
@@ -1,16 +1,24 @@
+#include "definitions.h"
+#include "global/globals.h"
 #include "palm/hash_table.h"
+#include "palm/str.h"
 #include "release_assert.h"
 #include "user_types.h"
+#include "utils.h"
 #include <ccn/dynamic_core.h>
 #include <ccn/phase_driver.h>
 #include <ccngen/ast.h>
 #include <ccngen/enum.h>
+#include <ccngen/trav.h>
+#include <limits.h>
 #include <stdio.h>
 
-static node_st *extracted_stmts_first = NULL;
-static node_st *extracted_stmts_last = NULL;
-static htable_stptr assign_table = NULL;
-static bool conditioned_assign = false;
+static _Thread_local node_st *extracted_stmts_first = NULL;
+static _Thread_local node_st *extracted_stmts_last = NULL;
+static _Thread_local htable_stptr assign_table = NULL;
+static _Thread_local bool conditioned_assign = false;
+static _Thread_local const char *unroll_iterator = NULL;
+static _Thread_local node_st *unroll_replacement = NULL;
 
 void reset()
 {
@@ -18,6 +26,127 @@ void reset()
     extracted_stmts_last = NULL;
     assign_table = NULL;
     conditioned_assign = false;
+    unroll_iterator = NULL;
+    unroll_replacement = NULL;
+}
+
+/// Resolves a for loop bound through the temporary variables created for the loop header. Other
+/// variables are not resolved, as they can be reassigned in an enclosing loop.
+static node_st *resolve_loop_temp(node_st *expr)
+{
+    while (expr != NULL && NODE_TYPE(expr) == NT_VAR && STRprefix("@temp_", VAR_NAME(expr)))
+    {
+        node_st *entry = HTlookup(assign_table, VAR_NAME(expr));
+        if (entry == NULL || entry == expr)
+        {
+            break;
+        }
+        expr = entry;
+    }
+    return expr;
+}
+
+/// Copies the loop body and substitutes the iterator with the replacement if given.
+static node_st *copy_block(node_st *block, const char *iterator, node_st *replacement)
+{
+    node_st *copy = CCNcopy(block);
+    if (replacement != NULL)
+    {
+        unroll_iterator = iterator;
+        unroll_replacement = replacement;
+        copy = TRAVstart(copy, TRAV_OPT_UI);
+        unroll_iterator = NULL;
+        unroll_replacement = NULL;
+        CCNfree(replacement);
+    }
+    return copy;
+}
+
+/**
+ * Unrolls a for loop with a constant trip count. If the unrolled body fits into the unroll limit,
+ * the loop is fully unrolled into the statements after the loop. Otherwise, the body is copied
+ * 'factor' times into the loop and the remaining iterations are unrolled after the loop. The loop
+ * is marked, so the next cycle does not unroll its unrolled body again.
+ *
+ * for (i = 0, 10) { a[i] = i; }
+ * becomes with a factor of 4:
+ * for (i = 0, 8, 4) { a[i] = i; a[i + 1] = i + 1; a[i + 2] = i + 2; a[i + 3] = i + 3; }
+ * a[8] = 8; a[9] = 9;
+ */
+static void unroll_forloop(node_st *node, long start, long step, long trip_count)
+{
+    node_st *block = FORLOOP_BLOCK(node);
+    if (block == NULL || global.unroll_limit <= 0 || trip_count <= 0)
+    {
+        return;
+    }
+
+    long cost = node_count(block);
+    long factor = 0; // Zero indicates full unrolling
+    if (trip_count > 1 && trip_count * cost > global.unroll_limit)
+    {
+        factor = global.unroll_limit / cost;
+        factor = factor > unroll_max_factor ? unroll_max_factor : factor;
+        if (factor < 2 || step * factor > INT_MAX || step * factor < INT_MIN)
+        {
+            return;
+        }
+    }
+
+    const char *iterator = VAR_NAME(ASSIGN_VAR(FORLOOP_ASSIGN(node)));
+    long unrolled = 0; // Iterations executed by the remaining loop
+    if (factor > 0)
+    {
+        node_st *first = NULL;
+        node_st *last = NULL;
+        for (long k = 0; k < factor; k++)
+        {
+            node_st *replacement = NULL;
+            if (k > 0)
+            {
+                replacement =
+                    ASTbinop(ASTvar(STRcpy(iterator)), ASTint((int)(k * step)), BO_add, DT_int);
+            }
+            append_stmts(copy_block(block, iterator, replacement), &first, &last);
+        }
+
+        unrolled = trip_count / factor * factor;
+        FORLOOP_BLOCK(node) = first;
+        CCNfree(FORLOOP_COND(node));
+        FORLOOP_COND(node) = ASTint((int)(start + unrolled * step));
+        if (FORLOOP_ITER(node) != NULL)
+        {
+            CCNfree(FORLOOP_ITER(node));
+        }
+        FORLOOP_ITER(node) = ASTint((int)(step * factor));
+        FORLOOP_UNROLLED(node) = true;
+    }
+    else
+    {
+        // The loop becomes dead code
+        FORLOOP_BLOCK(node) = NULL;
+    }
+
+    for (long k = unrolled; k < trip_count; k++)
+    {
+        node_st *stmts = copy_block(block, iterator, ASTint((int)(start + k * step)));
+        append_stmts(stmts, &extracted_stmts_first, &extracted_stmts_last);
+    }
+
+    CCNfree(block);
+    CCNcycleNotify();
+}
+
+node_st *OPT_UIvar(node_st *node)
+{
+    release_assert(unroll_iterator != NULL);
+    release_assert(unroll_replacement != NULL);
+    if (STReq(VAR_NAME(node), unroll_iterator))
+    {
+        CCNfree(node);
+        return CCNcopy(unroll_replacement);
+    }
+    return node;
 }
 
 node_st *OPT_BEprogram(node_st *node)
@@ -238,20 +367,32 @@ node_st *OPT_BEforloop(node_st *node)
         iter = entry;
     }
 
+    long start = 0;
+    long step = 0;
+    long trip_count = 0;
     if (NODE_TYPE(cond) == NT_INT && NODE_TYPE(expr) == NT_INT &&
         (FORLOOP_ITER(node) == NULL || NODE_TYPE(iter) == NT_INT))
     {
-        long start = INT_VAL(expr);
+        start = INT_VAL(expr);
         long end = INT_VAL(cond);
-        long step = iter == NULL ? 1 : INT_VAL(iter);
+        step = iter == NULL ? 1 : INT_VAL(iter);
 
-        if ((step > 0 && (start + step >= end)) || (step < 0 && (start + step <= end)))
+        if ((step > 0 && start >= end) || (step < 0 && start <= end))
         {
             // For loop is never executed. Remove the block so it becomes dead code
             CCNfree(FORLOOP_BLOCK(node));
             FORLOOP_BLOCK(node) = NULL;
             CCNcycleNotify();
         }
+        else if (step != 0 && !FORLOOP_UNROLLED(node) &&
+                 NODE_TYPE(resolve_loop_temp(ASSIGN_EXPR(FORLOOP_ASSIGN(node)))) == NT_INT &&
+                 NODE_TYPE(resolve_loop_temp(FORLOOP_COND(node))) == NT_INT &&
+                 (FORLOOP_ITER(node) == NULL ||
+                  NODE_TYPE(resolve_loop_temp(FORLOOP_ITER(node))) == NT_INT))
+        {
+            trip_count =
+                step > 0 ? (end - start + step - 1) / step : (start - end - step - 1) / -step;
+        }
     }
 
     bool parent_conditioned_assign = conditioned_assign;
@@ -259,6 +400,12 @@ node_st *OPT_BEforloop(node_st *node)
     TRAVchildren(node);
     conditioned_assign = parent_conditioned_assign;
 
+    // Inner loops are already unrolled, thus the cost of the body is known.
+    if (trip_count > 0)
+    {
+        unroll_forloop(node, start, step, trip_count);
+    }
+
     return node;
 }
 
@@ -0,0 +1,825 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "global/globals.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/// Value of a scalar during the evaluation of a call.
+struct eval_value
+{
+    enum DataType type;
+    union {
+        int int_val;
+        double float_val;
+        bool bool_val;
+    };
+};
+
+/// Parameter or local variable of an evaluated function.
+struct eval_slot
+{
+    const char *name;
+    bool defined;
+    struct eval_value value;
+};
+
+/// Frame of an evaluated function. Names outside of it are globals or variables of an outer
+/// function, which are never evaluated.
+struct eval_frame
+{
+    htable_stptr symbols;
+    struct eval_slot *slots;
+    size_t count;
+};
+
+enum eval_flow
+{
+    FLOW_NEXT,
+    FLOW_RETURN,
+    FLOW_FAIL,
+};
+
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr sideeffect_table = NULL;
+static _Thread_local long steps_left = 0;
+static _Thread_local int depth = 0;
+
+static void reset_state()
+{
+    current = NULL;
+    sideeffect_table = NULL;
+    steps_left = 0;
+    depth = 0;
+}
+
+/// Spends one step of the budget of the evaluated call.
+static bool charge()
+{
+    return steps_left-- > 0;
+}
+
+static struct eval_slot *lookup_slot(struct eval_frame *frame, const char *name)
+{
+    for (size_t i = 0; i < frame->count; i++)
+    {
+        if (STReq(frame->slots[i].name, name))
+        {
+            return &frame->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static bool literal_value(node_st *node, struct eval_value *out)
+{
+    switch (NODE_TYPE(node))
+    {
+    case NT_INT:
+        out->type = DT_int;
+        out->int_val = INT_VAL(node);
+        return true;
+    case NT_FLOAT:
+        out->type = DT_float;
+        out->float_val = FLOAT_VAL(node);
+        return true;
+    case NT_BOOL:
+        out->type = DT_bool;
+        out->bool_val = BOOL_VAL(node);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static node_st *value_literal(struct eval_value value)
+{
+    switch (value.type)
+    {
+    case DT_int:
+        return ASTint(value.int_val);
+    case DT_float:
+        return ASTfloat(value.float_val);
+    case DT_bool:
+        return ASTbool(value.bool_val);
+    case DT_NULL:
+    case DT_void:
+        break;
+    }
+    release_assert(false);
+    return NULL;
+}
+
+static bool eval_expr(node_st *expr, struct eval_frame *frame, struct eval_value *out);
+static bool eval_call(node_st *fundef, struct eval_value *args, size_t arg_count,
+                      struct eval_value *out, bool *out_returned);
+
+/**
+ * Applies an int operator like the runtime, but gives up wherever OPT_CFbinop would warn and
+ * saturate instead. So a result of the evaluation is always the value the program computes.
+ */
+static bool eval_int_binop(enum BinOpType op, int left, int right, struct eval_value *out)
+{
+    out->type = DT_int;
+    switch (op)
+    {
+    case BO_add:
+        if ((right > 0 && left > INT_MAX - right) || (right < 0 && left < INT_MIN - right))
+        {
+            return false;
+        }
+        out->int_val = left + right;
+        return true;
+    case BO_sub:
+        if ((right < 0 && left > INT_MAX + right) || (right > 0 && left < INT_MIN + right))
+        {
+            return false;
+        }
+        out->int_val = left - right;
+        return true;
+    case BO_mul: {
+        long long result = (long long)left * right;
+        if (result > INT_MAX || result < INT_MIN)
+        {
+            return false;
+        }
+        out->int_val = (int)result;
+        return true;
+    }
+    case BO_div:
+    case BO_mod:
+        if (right == 0 || (right == -1 && left == INT_MIN))
+        {
+            return false;
+        }
+        out->int_val = op == BO_div ? left / right : left % right;
+        return true;
+    default:
+        break;
+    }
+
+    out->type = DT_bool;
+    switch (op)
+    {
+    case BO_lt:
+        out->bool_val = left < right;
+        return true;
+    case BO_le:
+        out->bool_val = left <= right;
+        return true;
+    case BO_gt:
+        out->bool_val = left > right;
+        return true;
+    case BO_ge:
+        out->bool_val = left >= right;
+        return true;
+    case BO_eq:
+        out->bool_val = left == right;
+        return true;
+    case BO_ne:
+        out->bool_val = left != right;
+        return true;
+    default:
+        // The short circuit operators are ternaries after the code generation preparation
+        return false;
+    }
+}
+
+/// Applies a float operator in double precision like OPT_CFbinop, giving up on inf and nan.
+static bool eval_float_binop(enum BinOpType op, double left, double right, struct eval_value *out)
+{
+    out->type = DT_float;
+    switch (op)
+    {
+    case BO_add:
+        out->float_val = left + right;
+        return isfinite(out->float_val);
+    case BO_sub:
+        out->float_val = left - right;
+        return isfinite(out->float_val);
+    case BO_mul:
+        out->float_val = left * right;
+        return isfinite(out->float_val);
+    case BO_div:
+        out->float_val = left / right;
+        return isfinite(out->float_val);
+    default:
+        break;
+    }
+
+    out->type = DT_bool;
+    switch (op)
+    {
+    case BO_lt:
+        out->bool_val = left < right;
+        return true;
+    case BO_le:
+        out->bool_val = left <= right;
+        return true;
+    case BO_gt:
+        out->bool_val = left > right;
+        return true;
+    case BO_ge:
+        out->bool_val = left >= right;
+        return true;
+    case BO_eq:
+        out->bool_val = left == right;
+        return true;
+    case BO_ne:
+        out->bool_val = left != right;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Applies a bool operator, addition is the logical or and multiplication the logical and.
+static bool eval_bool_binop(enum BinOpType op, bool left, bool right, struct eval_value *out)
+{
+    out->type = DT_bool;
+    switch (op)
+    {
+    case BO_add:
+        out->bool_val = left | right;
+        return true;
+    case BO_mul:
+        out->bool_val = left & right;
+        return true;
+    case BO_eq:
+        out->bool_val = left == right;
+        return true;
+    case BO_ne:
+        out->bool_val = left != right;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool eval_cast(enum DataType type, struct eval_value value, struct eval_value *out)
+{
+    out->type = type;
+    switch (type)
+    {
+    case DT_int:
+        if (value.type == DT_float)
+        {
+            // The conversion of a float outside of the int range is undefined
+            if (!(value.float_val > (double)INT_MIN - 1.0 &&
+                  value.float_val < (double)INT_MAX + 1.0))
+            {
+                return false;
+            }
+            out->int_val = (int)value.float_val;
+        }
+        else
+        {
+            out->int_val = value.type == DT_int ? value.int_val : value.bool_val;
+        }
+        return true;
+    case DT_float:
+        out->float_val = value.type == DT_float ? value.float_val
+                         : value.type == DT_int ? (double)value.int_val
+                                                : (double)value.bool_val;
+        return true;
+    case DT_bool:
+        out->bool_val = value.type == DT_bool  ? value.bool_val
+                        : value.type == DT_int ? value.int_val != 0
+                                               : value.float_val != 0.0;
+        return true;
+    case DT_NULL:
+    case DT_void:
+        break;
+    }
+    return false;
+}
+
+/// Evaluates the arguments of a call in the frame of the caller and evaluates the called function.
+static bool eval_proccall(node_st *call, struct eval_frame *frame, struct eval_value *out,
+                          bool *out_returned)
+{
+    const char *name = VAR_NAME(PROCCALL_VAR(call));
+    if (STReq(name, alloc_func))
+    {
+        return false;
+    }
+    node_st *fun = deep_lookup(frame->symbols, name);
+    if (fun == NULL || NODE_TYPE(fun) != NT_FUNDEF)
+    {
+        return false;
+    }
+
+    size_t arg_count = 0;
+    for (node_st *exprs = PROCCALL_EXPRS(call); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+    {
+        arg_count++;
+    }
+
+    struct eval_value *args = malloc((arg_count == 0 ? 1 : arg_count) * sizeof(struct eval_value));
+    release_assert(args != NULL);
+    bool success = true;
+    size_t i = 0;
+    for (node_st *exprs = PROCCALL_EXPRS(call); success && exprs != NULL; exprs = EXPRS_NEXT(exprs))
+    {
+        success = eval_expr(EXPRS_EXPR(exprs), frame, &args[i++]);
+    }
+
+    success = success && eval_call(fun, args, arg_count, out, out_returned);
+    free(args);
+    return success;
+}
+
+static bool eval_expr(node_st *expr, struct eval_frame *frame, struct eval_value *out)
+{
+    if (!charge())
+    {
+        return false;
+    }
+
+    switch (NODE_TYPE(expr))
+    {
+    case NT_INT:
+    case NT_FLOAT:
+    case NT_BOOL:
+        return literal_value(expr, out);
+    case NT_VAR: {
+        struct eval_slot *slot = lookup_slot(frame, VAR_NAME(expr));
+        if (slot == NULL || !slot->defined)
+        {
+            return false;
+        }
+        *out = slot->value;
+        return true;
+    }
+    case NT_BINOP: {
+        struct eval_value left;
+        struct eval_value right;
+        if (!eval_expr(BINOP_LEFT(expr), frame, &left) ||
+            !eval_expr(BINOP_RIGHT(expr), frame, &right) || left.type != right.type)
+        {
+            return false;
+        }
+        switch (left.type)
+        {
+        case DT_int:
+            return eval_int_binop(BINOP_OP(expr), left.int_val, right.int_val, out);
+        case DT_float:
+            return eval_float_binop(BINOP_OP(expr), left.float_val, right.float_val, out);
+        case DT_bool:
+            return eval_bool_binop(BINOP_OP(expr), left.bool_val, right.bool_val, out);
+        case DT_NULL:
+        case DT_void:
+            break;
+        }
+        return false;
+    }
+    case NT_MONOP: {
+        if (!eval_expr(MONOP_LEFT(expr), frame, out))
+        {
+            return false;
+        }
+        if (MONOP_OP(expr) == MO_not && out->type == DT_bool)
+        {
+            out->bool_val = !out->bool_val;
+            return true;
+        }
+        if (MONOP_OP(expr) == MO_neg && out->type == DT_int && out->int_val != INT_MIN)
+        {
+            out->int_val = -out->int_val;
+            return true;
+        }
+        if (MONOP_OP(expr) == MO_neg && out->type == DT_float)
+        {
+            out->float_val = -out->float_val;
+            return true;
+        }
+        return false;
+    }
+    case NT_TERNARY: {
+        struct eval_value pred;
+        if (!eval_expr(TERNARY_PRED(expr), frame, &pred) || pred.type != DT_bool)
+        {
+            return false;
+        }
+        return eval_expr(pred.bool_val ? TERNARY_PTRUE(expr) : TERNARY_PFALSE(expr), frame, out);
+    }
+    case NT_CAST: {
+        struct eval_value value;
+        return eval_expr(CAST_EXPR(expr), frame, &value) && eval_cast(CAST_TYPE(expr), value, out);
+    }
+    case NT_PROCCALL: {
+        bool returned = false;
+        return eval_proccall(expr, frame, out, &returned) && returned;
+    }
+    default:
+        // Arrays and the pops of side effects are not evaluated
+        return false;
+    }
+}
+
+static bool eval_assign(node_st *assign, struct eval_frame *frame)
+{
+    struct eval_slot *slot = lookup_slot(frame, VAR_NAME(ASSIGN_VAR(assign)));
+    struct eval_value value;
+    if (slot == NULL || !eval_expr(ASSIGN_EXPR(assign), frame, &value))
+    {
+        return false;
+    }
+    slot->value = value;
+    slot->defined = true;
+    return true;
+}
+
+static enum eval_flow eval_stmts(node_st *stmts, struct eval_frame *frame,
+                                 struct eval_value *out);
+
+/// Evaluates a loop condition, which has to be a bool.
+static bool eval_condition(node_st *expr, struct eval_frame *frame, bool *out)
+{
+    struct eval_value value;
+    if (!eval_expr(expr, frame, &value) || value.type != DT_bool)
+    {
+        return false;
+    }
+    *out = value.bool_val;
+    return true;
+}
+
+/// Adds the step to the loop variable like the iinc of the code generation, giving up on overflow.
+static bool step_loop_var(struct eval_slot *var, int step)
+{
+    struct eval_value next;
+    if (!eval_int_binop(BO_add, var->value.int_val, step, &next))
+    {
+        return false;
+    }
+    var->value = next;
+    return true;
+}
+
+/**
+ * Evaluates a for loop the way CG_CGforloop generates it. A constant step compares the loop
+ * variable with the condition variable before each iteration, a variable step computes the trip
+ * count into the condition variable once.
+ */
+static enum eval_flow eval_forloop(node_st *loop, struct eval_frame *frame, struct eval_value *out)
+{
+    node_st *assign = FORLOOP_ASSIGN(loop);
+    if (!eval_assign(assign, frame))
+    {
+        return FLOW_FAIL;
+    }
+    struct eval_slot *var = lookup_slot(frame, VAR_NAME(ASSIGN_VAR(assign)));
+    if (var->value.type != DT_int)
+    {
+        return FLOW_FAIL;
+    }
+
+    node_st *iter = FORLOOP_ITER(loop);
+    if (iter == NULL || NODE_TYPE(iter) == NT_INT)
+    {
+        int step = iter == NULL ? 1 : INT_VAL(iter);
+        while (true)
+        {
+            struct eval_value cond;
+            if (!charge() || !eval_expr(FORLOOP_COND(loop), frame, &cond) || cond.type != DT_int)
+            {
+                return FLOW_FAIL;
+            }
+            if (step > 0 ? var->value.int_val >= cond.int_val : var->value.int_val <= cond.int_val)
+            {
+                return FLOW_NEXT;
+            }
+
+            enum eval_flow flow = eval_stmts(FORLOOP_BLOCK(loop), frame, out);
+            if (flow != FLOW_NEXT)
+            {
+                return flow;
+            }
+            if (!step_loop_var(var, step))
+            {
+                return FLOW_FAIL;
+            }
+        }
+    }
+
+    if (NODE_TYPE(iter) != NT_VAR || NODE_TYPE(FORLOOP_COND(loop)) != NT_VAR)
+    {
+        return FLOW_FAIL;
+    }
+    struct eval_slot *cond = lookup_slot(frame, VAR_NAME(FORLOOP_COND(loop)));
+    struct eval_value step;
+    if (cond == NULL || !cond->defined || cond->value.type != DT_int ||
+        !eval_expr(iter, frame, &step) || step.type != DT_int)
+    {
+        return FLOW_FAIL;
+    }
+
+    struct eval_value count;
+    struct eval_value rest;
+    if (!eval_int_binop(BO_sub, cond->value.int_val, var->value.int_val, &count) ||
+        !eval_int_binop(BO_div, count.int_val, step.int_val, &count) ||
+        !eval_int_binop(BO_mod, count.int_val, step.int_val, &rest))
+    {
+        return FLOW_FAIL;
+    }
+    cond->value.int_val = rest.int_val == 0 ? count.int_val : count.int_val + 1;
+
+    while (cond->value.int_val > 0)
+    {
+        if (!charge())
+        {
+            return FLOW_FAIL;
+        }
+        enum eval_flow flow = eval_stmts(FORLOOP_BLOCK(loop), frame, out);
+        if (flow != FLOW_NEXT)
+        {
+            return flow;
+        }
+        if (cond->value.type != DT_int)
+        {
+            return FLOW_FAIL;
+        }
+        cond->value.int_val--;
+        if (!step_loop_var(var, step.int_val))
+        {
+            return FLOW_FAIL;
+        }
+    }
+    return FLOW_NEXT;
+}
+
+static enum eval_flow eval_stmt(node_st *stmt, struct eval_frame *frame, struct eval_value *out)
+{
+    if (!charge())
+    {
+        return FLOW_FAIL;
+    }
+
+    bool condition;
+    switch (NODE_TYPE(stmt))
+    {
+    case NT_ASSIGN:
+        return eval_assign(stmt, frame) ? FLOW_NEXT : FLOW_FAIL;
+    case NT_PROCCALL: {
+        struct eval_value ignored;
+        bool returned = false;
+        return eval_proccall(stmt, frame, &ignored, &returned) ? FLOW_NEXT : FLOW_FAIL;
+    }
+    case NT_IFSTATEMENT:
+        if (!eval_condition(IFSTATEMENT_EXPR(stmt), frame, &condition))
+        {
+            return FLOW_FAIL;
+        }
+        return eval_stmts(condition ? IFSTATEMENT_BLOCK(stmt) : IFSTATEMENT_ELSE_BLOCK(stmt), frame,
+                          out);
+    case NT_WHILELOOP:
+        while (true)
+        {
+            if (!eval_condition(WHILELOOP_EXPR(stmt), frame, &condition))
+            {
+                return FLOW_FAIL;
+            }
+            if (!condition)
+            {
+                return FLOW_NEXT;
+            }
+            enum eval_flow flow = eval_stmts(WHILELOOP_BLOCK(stmt), frame, out);
+            if (flow != FLOW_NEXT)
+            {
+                return flow;
+            }
+        }
+    case NT_DOWHILELOOP:
+        while (true)
+        {
+            enum eval_flow flow = eval_stmts(DOWHILELOOP_BLOCK(stmt), frame, out);
+            if (flow != FLOW_NEXT)
+            {
+                return flow;
+            }
+            if (!eval_condition(DOWHILELOOP_EXPR(stmt), frame, &condition))
+            {
+                return FLOW_FAIL;
+            }
+            if (!condition)
+            {
+                return FLOW_NEXT;
+            }
+        }
+    case NT_FORLOOP:
+        return eval_forloop(stmt, frame, out);
+    case NT_RETSTATEMENT:
+        if (RETSTATEMENT_EXPR(stmt) == NULL)
+        {
+            out->type = DT_void;
+            return FLOW_RETURN;
+        }
+        return eval_expr(RETSTATEMENT_EXPR(stmt), frame, out) ? FLOW_RETURN : FLOW_FAIL;
+    default:
+        // Array assignments are not evaluated
+        return FLOW_FAIL;
+    }
+}
+
+static enum eval_flow eval_stmts(node_st *stmts, struct eval_frame *frame, struct eval_value *out)
+{
+    for (; stmts != NULL; stmts = STATEMENTS_NEXT(stmts))
+    {
+        enum eval_flow flow = eval_stmt(STATEMENTS_STMT(stmts), frame, out);
+        if (flow != FLOW_NEXT)
+        {
+            return flow;
+        }
+    }
+    return FLOW_NEXT;
+}
+
+/**
+ * Evaluates a function for the argument values. The frame holds the parameters and the local
+ * variables, a local variable is undefined until it is assigned. Gives up on anything that is not
+ * a scalar of the frame, e.g. a global, an array or a call of an extern function, and when the
+ * budget of steps or the maximal call depth is exceeded.
+ */
+static bool eval_call(node_st *fundef, struct eval_value *args, size_t arg_count,
+                      struct eval_value *out, bool *out_returned)
+{
+    if (depth >= eval_max_depth || !charge())
+    {
+        return false;
+    }
+
+    node_st *funbody = FUNDEF_FUNBODY(fundef);
+    size_t count = arg_count;
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        count++;
+    }
+
+    struct eval_frame frame = {FUNDEF_SYMBOLS(fundef), NULL, 0};
+    frame.slots = malloc((count == 0 ? 1 : count) * sizeof(struct eval_slot));
+    release_assert(frame.slots != NULL);
+
+    bool success = true;
+    node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef));
+    for (size_t i = 0; i < arg_count; i++)
+    {
+        if (params == NULL || NODE_TYPE(PARAMS_VAR(params)) != NT_VAR)
+        {
+            success = false;
+            break;
+        }
+        frame.slots[frame.count++] =
+            (struct eval_slot){VAR_NAME(PARAMS_VAR(params)), true, args[i]};
+        params = PARAMS_NEXT(params);
+    }
+    success = success && params == NULL;
+
+    depth++;
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); success && vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        node_st *vardec = VARDECS_VARDEC(vardecs);
+        if (NODE_TYPE(VARDEC_VAR(vardec)) != NT_VAR)
+        {
+            success = false;
+            break;
+        }
+        struct eval_slot *slot = &frame.slots[frame.count++];
+        slot->name = VAR_NAME(VARDEC_VAR(vardec));
+        slot->defined = false;
+        if (VARDEC_EXPR(vardec) != NULL)
+        {
+            success = eval_expr(VARDEC_EXPR(vardec), &frame, &slot->value);
+            slot->defined = true;
+        }
+    }
+
+    enum eval_flow flow = FLOW_FAIL;
+    if (success)
+    {
+        flow = eval_stmts(FUNBODY_STMTS(funbody), &frame, out);
+    }
+    depth--;
+    free(frame.slots);
+
+    *out_returned = flow == FLOW_RETURN && out->type != DT_void;
+    return flow != FLOW_FAIL;
+}
+
+node_st *OPT_CEproccall(node_st *node)
+{
+    TRAVchildren(node);
+
+    const char *name = VAR_NAME(PROCCALL_VAR(node));
+    if (STReq(name, alloc_func))
+    {
+        return node;
+    }
+    node_st *fun = deep_lookup(current, name);
+    release_assert(fun != NULL);
+    if (NODE_TYPE(fun) != NT_FUNDEF || FUNHEADER_TYPE(FUNDEF_FUNHEADER(fun)) == DT_void)
+    {
+        return node;
+    }
+
+    size_t arg_count = 0;
+    for (node_st *exprs = PROCCALL_EXPRS(node); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+    {
+        if (!is_literal(EXPRS_EXPR(exprs)))
+        {
+            return node;
+        }
+        arg_count++;
+    }
+
+    enum sideeffect effect = check_fun_sideeffect(fun, sideeffect_table);
+    release_assert(effect != SEFF_NULL);
+    release_assert(effect != SEFF_PROCESSING);
+    if (effect != SEFF_NO)
+    {
+        return node;
+    }
+
+    struct eval_value *args = malloc((arg_count == 0 ? 1 : arg_count) * sizeof(struct eval_value));
+    release_assert(args != NULL);
+    size_t i = 0;
+    for (node_st *exprs = PROCCALL_EXPRS(node); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+    {
+        literal_value(EXPRS_EXPR(exprs), &args[i++]);
+    }
+
+    struct eval_value result;
+    bool returned = false;
+    steps_left = global.eval_limit;
+    depth = 0;
+    bool success = eval_call(fun, args, arg_count, &result, &returned);
+    free(args);
+    if (!success || !returned)
+    {
+        return node;
+    }
+
+    node_st *literal = value_literal(result);
+    NODE_BLINE(literal) = NODE_BLINE(node);
+    NODE_BCOL(literal) = NODE_BCOL(node);
+    NODE_ELINE(literal) = NODE_ELINE(node);
+    NODE_ECOL(literal) = NODE_ECOL(node);
+    if (NODE_FILENAME(node) != NULL)
+    {
+        NODE_FILENAME(literal) = STRcpy(NODE_FILENAME(node));
+    }
+    CCNfree(node);
+    CCNcycleNotify();
+    return literal;
+}
+
+/// Only evaluates the arguments of a call statement, its result is not used.
+node_st *OPT_CEstatements(node_st *node)
+{
+    node_st *stmt = STATEMENTS_STMT(node);
+    if (NODE_TYPE(stmt) == NT_PROCCALL)
+    {
+        PROCCALL_EXPRS(stmt) = TRAVopt(PROCCALL_EXPRS(stmt));
+    }
+    else
+    {
+        STATEMENTS_STMT(node) = TRAVopt(stmt);
+    }
+    STATEMENTS_NEXT(node) = TRAVopt(STATEMENTS_NEXT(node));
+    return node;
+}
+
+node_st *OPT_CEfundef(node_st *node)
+{
+    htable_stptr parent_current = current;
+    current = FUNDEF_SYMBOLS(node);
+    TRAVchildren(node);
+    current = parent_current;
+    return node;
+}
+
+node_st *OPT_CEprogram(node_st *node)
+{
+    if (global.eval_limit <= 0)
+    {
+        return node;
+    }
+
+    reset_state();
+    sideeffect_table = HTnew_Ptr(2 << 8);
+    current = PROGRAM_SYMBOLS(node);
+    TRAVopt(PROGRAM_DECLS(node));
+    HTdelete(sideeffect_table);
+    reset_state();
+    return node;
+}
@@ -1,10 +1,13 @@
 #include "ccngen/ast.h"
+#include "global/globals.h"
 #include "release_assert.h"
+#include "scheduler.h"
 #include "to_string.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
 #include <ccn/phase_driver.h>
 #include <ccngen/enum.h>
+#include <ccngen/trav.h>
 #include <limits.h>
 #include <math.h>
 #include <stdbool.h>
@@ -14,8 +17,9 @@ static void warn_float_result_infnan(node_st *node, double val, double left, dou
     if (isnan(val) || isinf(val))
     {
         struct ctinfo info = NODE_TO_CTINFO(node);
-        CTIobj(CTI_WARN, true, info, "Encountered '%f' as optimization result of '%f %c %f'.", val,
-               left, op, right);
+        report_obj(
+            CTI_WARN, true, info, "Encountered '%f' as optimization result of '%f %c %f'.", val,
+            left, op, right);
     }
 }
 
@@ -62,15 +66,16 @@ node_st *OPT_CFbinop(node_st *node)
         case BO_add:
             if (right > 0 && left > INT_MAX - right)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Addition Overflow' as optimization result of '%d + %d'. Using "
-                       "INT_MAX=2147483647 for further optimization.",
-                       left, right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Addition Overflow' as optimization result of '%d + %d'. Using "
+                    "INT_MAX=2147483647 for further optimization.",
+                    left, right);
                 iresult = INT_MAX;
             }
             else if (right < 0 && left < INT_MIN - right)
             {
-                CTIobj(
+                report_obj(
                     CTI_WARN, true, info,
                     "Encountered 'Addition Underflow' as optimization result of '%d + %d'. Using "
                     "INT_MIN=-2147483648 for further optimization.",
@@ -86,19 +91,21 @@ node_st *OPT_CFbinop(node_st *node)
         case BO_sub:
             if (right < 0 && left > INT_MAX + right)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Substraction Overflow' as optimization result of '%d - %d'. "
-                       "Using INT_MAX=2147483647 for further optimization.",
-                       left, right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Substraction Overflow' as optimization result of '%d - %d'. "
+                    "Using INT_MAX=2147483647 for further optimization.",
+                    left, right);
                 iresult = INT_MAX;
             }
             else if (right > 0 && left < INT_MIN + right)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Substraction Underflow' as optimization result of '%d - %d'. "
-                       "Using "
-                       "INT_MIN=-2147483648 for further optimization.",
-                       left, right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Substraction Underflow' as optimization result of '%d - %d'. "
+                    "Using "
+                    "INT_MIN=-2147483648 for further optimization.",
+                    left, right);
                 iresult = INT_MIN;
             }
             else
@@ -111,15 +118,16 @@ node_st *OPT_CFbinop(node_st *node)
             if ((right == -1 && left == INT_MIN) || (left == -1 && right == INT_MIN) ||
                 (right != 0 && left > INT_MAX / right))
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Multiplication Overflow' as optimization result of '%d * %d'. "
-                       "Using INT_MAX=2147483647 for further optimization.",
-                       left, right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Multiplication Overflow' as optimization result of '%d * %d'. "
+                    "Using INT_MAX=2147483647 for further optimization.",
+                    left, right);
                 iresult = INT_MAX;
             }
             else if (right != 0 && right != -1 && left < INT_MIN / right)
             {
-                CTIobj(
+                report_obj(
                     CTI_WARN, true, info,
                     "Encountered 'Multiplication Underflow' as optimization result of '%d * %d'. "
                     "Using INT_MIN=-2147483648 for further optimization.",
@@ -136,18 +144,19 @@ node_st *OPT_CFbinop(node_st *node)
         case BO_div:
             if (right == 0)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Division by zero' as optimization result of '%d / %d'. Using "
-                       "INT_MAX=2147483647 for further optimization.",
-                       left, right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Division by zero' as optimization result of '%d / %d'. Using "
+                    "INT_MAX=2147483647 for further optimization.",
+                    left, right);
                 iresult = INT_MAX;
             }
             else if (right == -1 && left == INT_MIN)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Division Overflow' as optimization result of '%d / %d'. "
-                       "Using INT_MAX=2147483647 for further optimization.",
-                       left, right);
+                report_obj(CTI_WARN, true, info,
+                           "Encountered 'Division Overflow' as optimization result of '%d / %d'. "
+                           "Using INT_MAX=2147483647 for further optimization.",
+                           left, right);
                 iresult = INT_MAX;
             }
             else
@@ -159,18 +168,19 @@ node_st *OPT_CFbinop(node_st *node)
         case BO_mod:
             if (right == 0)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Division by zero' as optimization result of '%d %c %d'. Using "
-                       "INT_MAX=2147483647 for further optimization.",
-                       left, '%', right);
+                report_obj(
+                    CTI_WARN, true, info,
+                    "Encountered 'Division by zero' as optimization result of '%d %c %d'. Using "
+                    "INT_MAX=2147483647 for further optimization.",
+                    left, '%', right);
                 iresult = INT_MAX;
             }
             else if (right == -1 && left == INT_MIN)
             {
-                CTIobj(CTI_WARN, true, info,
-                       "Encountered 'Division Overflow' as optimization result of '%d %c %d'. "
-                       "Using INT_MAX=2147483647 for further optimization.",
-                       left, '%', right);
+                report_obj(CTI_WARN, true, info,
+                           "Encountered 'Division Overflow' as optimization result of '%d %c %d'. "
+                           "Using INT_MAX=2147483647 for further optimization.",
+                           left, '%', right);
                 iresult = INT_MAX;
             }
             else
@@ -367,8 +377,23 @@ node_st *OPT_CFternary(node_st *node)
     return node;
 }
 
+/// Folds a top-level declaration on a worker thread of the scheduler.
+static void fold_decl(node_st *decl, void *arg)
+{
+    (void)arg;
+    node_st *result = TRAVstart(decl, TRAV_OPT_CF);
+    release_assert(result == decl);
+}
+
 node_st *OPT_CFprogram(node_st *node)
 {
-    TRAVopt(PROGRAM_DECLS(node));
+    if (global.jobs > 1)
+    {
+        schedule_decls(PROGRAM_DECLS(node), fold_decl, NULL);
+    }
+    else
+    {
+        TRAVopt(PROGRAM_DECLS(node));
+    }
     return node;
 }
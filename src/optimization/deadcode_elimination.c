@@ -3,6 +3,7 @@
 #include "palm/hash_table.h"
 #include "palm/str.h"
 #include "release_assert.h"
+#include "symbol_keys.h"
 #include "user_types.h"
 #include "utils.h"
 #include <ccn/dynamic_core.h>
@@ -11,46 +12,62 @@
 #include <endian.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-static htable_stptr current = NULL;
-static htable_stptr sideeffect_table = NULL;
-static htable_stptr usage_table = NULL;
-static node_st *sideeffect_stmts_first = NULL;
-static node_st *sideeffect_stmts_last = NULL;
-static bool collect_sideeffects = false;
-static bool check_consumtion = false;
-static bool has_consumtion = false;
-static htable_stptr if_usage_stmts = NULL;
-static htable_stptr else_usage_stmts = NULL;
-static bool collect_if_usages = false;
-static bool collect_else_usages = false;
-static htable_stptr init_symbols = NULL;
-static bool remove_local_function = true;
-static bool check_return = false;
-static bool has_return = false;
-static bool tag_usages = false;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr sideeffect_table = NULL;
+static _Thread_local htable_stptr symbol_indices = NULL; // Symbol node -> dense index + 1
+static _Thread_local size_t symbol_count = 0;
+static _Thread_local size_t word_count = 0;
+static _Thread_local uint64_t *referenced = NULL; // Symbols with a usage or an assignment
+static _Thread_local uint64_t *live = NULL;       // Symbols read later in the evaluation order
+static _Thread_local uint64_t *saved_sets = NULL; // Stack of the live sets saved at branches
+static _Thread_local size_t saved_size = 0;
+static _Thread_local size_t saved_capacity = 0;
+static _Thread_local node_st **pending_stmts = NULL; // Stack of the statement lists being walked
+static _Thread_local size_t pending_size = 0;
+static _Thread_local size_t pending_capacity = 0;
+static _Thread_local node_st *sideeffect_stmts_first = NULL;
+static _Thread_local node_st *sideeffect_stmts_last = NULL;
+static _Thread_local bool collect_sideeffects = false;
+static _Thread_local bool check_consumtion = false;
+static _Thread_local bool has_consumtion = false;
+static _Thread_local htable_stptr init_symbols = NULL;
+static _Thread_local bool remove_local_function = true;
+static _Thread_local bool check_return = false;
+static _Thread_local bool has_return = false;
+static _Thread_local bool tag_usages = false;
+static _Thread_local bool control_kept = false;
 
 static void reset()
 {
     current = NULL;
     sideeffect_table = NULL;
-    usage_table = NULL;
+    symbol_indices = NULL;
+    symbol_count = 0;
+    word_count = 0;
+    referenced = NULL;
+    live = NULL;
+    saved_sets = NULL;
+    saved_size = 0;
+    saved_capacity = 0;
+    pending_stmts = NULL;
+    pending_size = 0;
+    pending_capacity = 0;
     sideeffect_stmts_first = NULL;
     sideeffect_stmts_last = NULL;
     collect_sideeffects = false;
     check_consumtion = false;
     has_consumtion = false;
-    if_usage_stmts = NULL;
-    else_usage_stmts = NULL;
-    collect_if_usages = false;
-    collect_else_usages = false;
     init_symbols = NULL;
     remove_local_function = false;
     check_return = false;
     has_return = false;
     tag_usages = false;
+    control_kept = false;
 }
 
 enum usage_state
@@ -60,105 +77,99 @@ enum usage_state
     UC_USAGE = 2, // always MAX
 };
 
-// Shift to not overwrite the value of usage_state MAX
-const uint UCshift = 5;
-const uint UCmask = (1 << UCshift) - 1;
-
-static void UCset(void *key, enum usage_state state)
+/// Gets the dense index of a symbol, a symbol seen for the first time is appended.
+static size_t UCindex(void *key)
 {
-    release_assert(usage_table != NULL);
+    release_assert(symbol_indices != NULL);
     release_assert(key != NULL);
-    HTremove(usage_table, key);
-    bool success = HTinsert(usage_table, key, (void *)state);
+    void *entry = HTlookup(symbol_indices, key);
+    if (entry != NULL)
+    {
+        return (size_t)(ptrdiff_t)entry - 1;
+    }
+
+    if (symbol_count == word_count * 64)
+    {
+        size_t new_word_count = word_count == 0 ? 4 : word_count * 2;
+        referenced = realloc(referenced, new_word_count * sizeof(uint64_t));
+        live = realloc(live, new_word_count * sizeof(uint64_t));
+        release_assert(referenced != NULL);
+        release_assert(live != NULL);
+        memset(referenced + word_count, 0, (new_word_count - word_count) * sizeof(uint64_t));
+        memset(live + word_count, 0, (new_word_count - word_count) * sizeof(uint64_t));
+        word_count = new_word_count;
+    }
+
+    size_t index = symbol_count++;
+    bool success = HTinsert(symbol_indices, key, (void *)(ptrdiff_t)(index + 1));
     release_assert(success);
+    return index;
 }
 
-static enum usage_state UClookup(void *key)
+static void UCset(void *key, enum usage_state state)
 {
-    release_assert(usage_table != NULL);
-    release_assert(key != NULL);
-    void *entry = HTlookup(usage_table, key);
-    ptrdiff_t value = (ptrdiff_t)entry;
-    release_assert(value >= UC_NONE);
-    release_assert(value <= UC_USAGE);
-    return (enum usage_state)value;
+    size_t index = UCindex(key);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    size_t word = index / 64;
+    referenced[word] = state == UC_NONE ? referenced[word] & ~bit : referenced[word] | bit;
+    live[word] = state == UC_USAGE ? live[word] | bit : live[word] & ~bit;
 }
 
-static void UCrestore()
+static enum usage_state UClookup(void *key)
 {
-    release_assert(usage_table != NULL);
-    if (if_usage_stmts == NULL)
+    size_t index = UCindex(key);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    size_t word = index / 64;
+    if (live[word] & bit)
     {
-        release_assert(else_usage_stmts == NULL);
-        return;
+        return UC_USAGE;
     }
+    return (referenced[word] & bit) ? UC_CONSUMED : UC_NONE;
+}
 
-    for (htable_iter_st *iter = HTiterate(if_usage_stmts); iter; iter = HTiterateNext(iter))
+/// Saves a copy of the live set on the stack of saved sets. The returned frame is its offset, the
+/// frame starts with the word count of the copy.
+static size_t live_save()
+{
+    size_t frame = saved_size;
+    size_t size = saved_size + 1 + word_count;
+    if (size > saved_capacity)
     {
-        void *key = HTiterKey(iter);
-        void *value = HTiterValue(iter);
-        ptrdiff_t if_value = (ptrdiff_t)value & UCmask;
-        release_assert(if_value >= UC_NONE);
-        release_assert(if_value <= UC_USAGE);
-        enum usage_state if_state = (enum usage_state)if_value;
-
-        void *entry = HTlookup(else_usage_stmts, key);
-        ptrdiff_t else_value = (ptrdiff_t)entry & UCmask;
-        release_assert(else_value >= UC_NONE);
-        release_assert(else_value <= UC_USAGE);
-        enum usage_state else_state = (enum usage_state)else_value;
+        saved_capacity = size > saved_capacity * 2 ? size : saved_capacity * 2;
+        saved_sets = realloc(saved_sets, saved_capacity * sizeof(uint64_t));
+        release_assert(saved_sets != NULL);
+    }
 
-        if ((if_state == UC_CONSUMED) & (else_state == UC_CONSUMED))
-        {
-            // We keep whats inside the usage value, as it is correct.
-            release_assert(UClookup(key) == UC_CONSUMED);
-        }
-        else
-        {
-            // We need to restore
-            // Its always usage or consumed, as it also was used the the statement itself. Thus, we
-            // need the var decleration to exist.
-            ptrdiff_t if_value_origin = ((ptrdiff_t)value >> UCshift) & UCmask;
-            release_assert(if_value_origin >= UC_NONE);
-            release_assert(if_value_origin <= UC_USAGE);
-            if (entry != NULL)
-            {
-                ptrdiff_t else_value_origin = ((ptrdiff_t)entry >> UCshift) & UCmask;
-                release_assert(else_value_origin >= UC_NONE);
-                release_assert(else_value_origin <= UC_USAGE);
-                // Should have the same origin i.e. we want to keep the vardec
-                release_assert(if_value_origin == else_value_origin);
-            }
+    saved_sets[frame] = word_count;
+    memcpy(saved_sets + frame + 1, live, word_count * sizeof(uint64_t));
+    saved_size = size;
+    return frame;
+}
 
-            // If we found a value its at least consumed
-            enum usage_state origin = (enum usage_state)if_value_origin;
-            origin = origin == UC_NONE ? UC_CONSUMED : origin;
-            UCset(key, origin);
-        }
-    }
+/// Replaces the live set with a saved one. Symbols seen after the save were not live at that time.
+static void live_load(size_t frame)
+{
+    size_t count = (size_t)saved_sets[frame];
+    memcpy(live, saved_sets + frame + 1, count * sizeof(uint64_t));
+    memset(live + count, 0, (word_count - count) * sizeof(uint64_t));
+}
 
-    // Now restore the remaining that the else contains but not if
-    for (htable_iter_st *iter = HTiterate(else_usage_stmts); iter; iter = HTiterateNext(iter))
+/// Merges a saved live set into the live set, a symbol is live if it is live on any of the paths.
+static void live_union(size_t frame)
+{
+    size_t count = (size_t)saved_sets[frame];
+    for (size_t i = 0; i < count; i++)
     {
-        void *key = HTiterKey(iter);
-        void *value = HTiterValue(iter);
-        ptrdiff_t else_value = (ptrdiff_t)value & UCmask;
-        release_assert(else_value >= UC_NONE);
-        release_assert(else_value <= UC_USAGE);
-
-        if (HTlookup(if_usage_stmts, key) == NULL)
-        {
-            ptrdiff_t else_value_origin = ((ptrdiff_t)value >> UCshift) & UCmask;
-            release_assert(else_value_origin >= UC_NONE);
-            release_assert(else_value_origin <= UC_USAGE);
-            // If we found a value its at least consumed i.e. we want to keep the vardec
-            enum usage_state origin = (enum usage_state)else_value_origin;
-            origin = origin == UC_NONE ? UC_CONSUMED : origin;
-            UCset(key, origin);
-        }
+        live[i] |= saved_sets[frame + 1 + i];
     }
 }
 
+/// Removes the saved set and all sets saved after it.
+static void live_drop(size_t frame)
+{
+    saved_size = frame;
+}
+
 /// Checks if a node has a any asignment statement
 static bool has_consume(node_st *node)
 {
@@ -202,6 +213,13 @@ static bool check_stmts_sideffect(node_st *stmts, htable_stptr symbols)
 /* Idea: Start backwards from the return statements / or last statement of a void function.
  * On the forward pass, add the usage count of a vairable/fundef and remove unused stuff in
  * the backward pass.
+ * The usage states are bitsets over dense symbol indices: referenced for UC_CONSUMED and live for
+ * UC_USAGE. At a branch the live set after it is saved, every path starts from the saved set and
+ * the sets at the start of the paths are merged. Loops start their block with everything read in
+ * the block live, i.e. an upper bound of the fixed point of the back edge.
+ * The liveness is computed in a single backward pass over each statement list instead of a
+ * worklist solver over a control flow graph: the lists are walked from the pending_stmts stack and
+ * control_kept tells the enclosing list whether a branch or loop kept any of its statements.
  */
 
 node_st *OPT_DCEprogram(node_st *node)
@@ -209,10 +227,14 @@ node_st *OPT_DCEprogram(node_st *node)
     reset();
     current = PROGRAM_SYMBOLS(node);
     sideeffect_table = HTnew_Ptr(2 << 8);
-    usage_table = HTnew_Ptr(2 << 8);
+    symbol_indices = HTnew_Ptr(2 << 8);
     TRAVchildren(node);
     HTdelete(sideeffect_table);
-    HTdelete(usage_table);
+    HTdelete(symbol_indices);
+    free(referenced);
+    free(live);
+    free(saved_sets);
+    free(pending_stmts);
     return node;
 }
 
@@ -359,28 +381,8 @@ node_st *OPT_DCElocalfundefs(node_st *node)
         LOCALFUNDEFS_LOCALFUNDEF(node) = TRAVopt(fundef);
         remove_local_function = parent_remove_local_function;
 
-        char *key = NULL;
-        bool free_key = STRprefix("@fun_", name);
-        if (free_key)
-        {
-            for (htable_iter_st *iter = HTiterate(current); iter; iter = HTiterateNext(iter))
-            {
-                key = HTiterKey(iter);
-                if (STReq(key, name))
-                {
-                    HTiterateCancel(iter);
-                    break;
-                }
-            }
-        }
-
-        node_st *expected = HTremove(current, name);
-
-        if (free_key)
-        {
-            release_assert(key != NULL);
-            free(key);
-        }
+        node_st *expected = STRprefix("@fun_", name) ? symbol_keys_remove(current, fundef)
+                                                      : HTremove(current, name);
 
         free_symbols(FUNDEF_SYMBOLS(fundef));
 
@@ -461,25 +463,11 @@ node_st *OPT_DCEdeclarations(node_st *node)
         break;
     }
 
-    char *key = NULL;
-    bool free_key = STRprefix("@fun_", name);
-    if (free_key)
-    {
-        for (htable_iter_st *iter = HTiterate(current); iter; iter = HTiterateNext(iter))
-        {
-            key = HTiterKey(iter);
-            if (STReq(key, name))
-            {
-                HTiterateCancel(iter);
-                break;
-            }
-        }
-    }
-
     node_st *new_dec_first = NULL;
     node_st *new_dec_last = NULL;
 
-    node_st *expected = HTremove(current, name);
+    node_st *expected = STRprefix("@fun_", name) ? symbol_keys_remove(current, entry)
+                                                  : HTremove(current, name);
     if (is_extern_array)
     {
         const char *pretty_name = get_pretty_name(name);
@@ -523,12 +511,6 @@ node_st *OPT_DCEdeclarations(node_st *node)
         }
     }
 
-    if (free_key)
-    {
-        release_assert(key != NULL);
-        free(key);
-    }
-
     if (NODE_TYPE(decl) == NT_FUNDEF)
     {
         free_symbols(FUNDEF_SYMBOLS(decl));
@@ -555,23 +537,10 @@ node_st *OPT_DCEdeclarations(node_st *node)
     }
 }
 
-node_st *OPT_DCEstatements(node_st *node)
+/// Eliminates the statement of a list whose next statements are already eliminated. Returns the
+/// list starting at this statement or at its replacement.
+static node_st *eliminate_statement(node_st *node)
 {
-    if (check_consumtion)
-    {
-        if (!has_consumtion)
-        {
-            TRAVchildren(node);
-        }
-        return node;
-    }
-
-    if (tag_usages)
-    {
-        TRAVchildren(node);
-        return node;
-    }
-
     node_st *parent_sideeffect_stmts_first = sideeffect_stmts_first;
     node_st *parent_sideeffect_stmts_last = sideeffect_stmts_last;
     bool parent_collect_sideeffects = collect_sideeffects;
@@ -583,12 +552,6 @@ node_st *OPT_DCEstatements(node_st *node)
     {
         // Add used tag to the usage stuff
         STATEMENTS_STMT(node) = TRAVopt(STATEMENTS_STMT(node));
-
-        // Everything after the first return statmenet is never reached.
-        node_st *next = STATEMENTS_NEXT(node);
-        STATEMENTS_NEXT(node) = NULL;
-        CCNfree(next);
-
         if (check_return)
         {
             has_return = true;
@@ -600,10 +563,9 @@ node_st *OPT_DCEstatements(node_st *node)
         return node;
     }
 
-    STATEMENTS_NEXT(node) = TRAVopt(STATEMENTS_NEXT(node));
-
     node_st *stmt = STATEMENTS_STMT(node);
     node_st *entry;
+    bool is_used = false;
     bool skip_check = false;
     bool is_local = true;       // Indicates if assigment to local variable
     bool requiere_none = false; // Indicates if assigment is an alloc call
@@ -622,12 +584,20 @@ node_st *OPT_DCEstatements(node_st *node)
         is_local = HTlookup(current, VAR_NAME(ARRAYEXPR_VAR(ARRAYASSIGN_VAR(stmt)))) != NULL;
         requiere_none = true; // We can only optimize if the var is never used.
         break;
+    case NT_ARRAYBULKASSIGN:
+        entry = deep_lookup(current, VAR_NAME(ARRAYBULKASSIGN_VAR(stmt)));
+        release_assert(entry != NULL);
+        is_local = HTlookup(current, VAR_NAME(ARRAYBULKASSIGN_VAR(stmt))) != NULL;
+        requiere_none = true; // We can only optimize if the var is never used.
+        break;
     case NT_IFSTATEMENT:
     case NT_WHILELOOP:
     case NT_DOWHILELOOP:
     case NT_FORLOOP:
         // Check if usage need or not
+        control_kept = false;
         STATEMENTS_STMT(node) = TRAVopt(STATEMENTS_STMT(node));
+        is_used = control_kept;
         entry = stmt;
         skip_check = true;
         break;
@@ -653,9 +623,13 @@ node_st *OPT_DCEstatements(node_st *node)
     release_assert(current != NULL);
     bool is_init = init_symbols == current;
     release_assert(entry != NULL);
+    if (entry != stmt)
+    {
+        is_used = UClookup(entry) == UC_USAGE;
+    }
     // We need to keep sideffecting assignment as they are not used by the current function call
     // but maybe later in another function call of this sideeffecting function.
-    if (UClookup(entry) != UC_USAGE && (is_local | is_init) &&
+    if (!is_used && (is_local | is_init) &&
         (requiere_none ? UClookup(entry) == UC_NONE : true))
     {
         collect_sideeffects = true;
@@ -697,6 +671,61 @@ node_st *OPT_DCEstatements(node_st *node)
     return node;
 }
 
+node_st *OPT_DCEstatements(node_st *node)
+{
+    if (check_consumtion)
+    {
+        for (node_st *stmts = node; stmts != NULL && !has_consumtion;
+             stmts = STATEMENTS_NEXT(stmts))
+        {
+            TRAVopt(STATEMENTS_STMT(stmts));
+        }
+        return node;
+    }
+
+    if (tag_usages)
+    {
+        for (node_st *stmts = node; stmts != NULL; stmts = STATEMENTS_NEXT(stmts))
+        {
+            STATEMENTS_STMT(stmts) = TRAVopt(STATEMENTS_STMT(stmts));
+        }
+        return node;
+    }
+
+    // The list is walked backwards from an explicit stack instead of recursing into the next
+    // statements, so the stack depth does not grow with the length of the list.
+    size_t base = pending_size;
+    for (node_st *stmts = node; stmts != NULL; stmts = STATEMENTS_NEXT(stmts))
+    {
+        if (pending_size == pending_capacity)
+        {
+            pending_capacity = pending_capacity == 0 ? 64 : pending_capacity * 2;
+            pending_stmts = realloc(pending_stmts, pending_capacity * sizeof(node_st *));
+            release_assert(pending_stmts != NULL);
+        }
+        pending_stmts[pending_size++] = stmts;
+
+        if (NODE_TYPE(STATEMENTS_STMT(stmts)) == NT_RETSTATEMENT)
+        {
+            // Everything after the first return statmenet is never reached.
+            node_st *next = STATEMENTS_NEXT(stmts);
+            STATEMENTS_NEXT(stmts) = NULL;
+            CCNfree(next);
+        }
+    }
+
+    node_st *next = NULL;
+    for (size_t i = pending_size; i-- > base;)
+    {
+        // Nested lists push above this list and pop again, so the index stays valid
+        node_st *stmts = pending_stmts[i];
+        STATEMENTS_NEXT(stmts) = next;
+        next = eliminate_statement(stmts);
+    }
+    pending_size = base;
+    return next;
+}
+
 node_st *OPT_DCEvar(node_st *node)
 {
     if (collect_sideeffects | check_consumtion)
@@ -735,24 +764,6 @@ node_st *OPT_DCEassign(node_st *node)
                        (NODE_TYPE(ASSIGN_EXPR(node)) == NT_PROCCALL &&
                         STReq(VAR_NAME(PROCCALL_VAR(ASSIGN_EXPR(node))), alloc_func)));
 
-        if (collect_if_usages)
-        {
-            release_assert(if_usage_stmts != NULL);
-            bool success =
-                HTinsert(if_usage_stmts, entry,
-                         (void *)(ptrdiff_t)((UClookup(entry) << UCshift) + UC_CONSUMED));
-            release_assert(success);
-        }
-
-        if (collect_else_usages)
-        {
-            release_assert(else_usage_stmts != NULL);
-            bool success =
-                HTinsert(else_usage_stmts, entry,
-                         (void *)(ptrdiff_t)((UClookup(entry) << UCshift) + UC_CONSUMED));
-            release_assert(success);
-        }
-
         UCset(entry, UC_CONSUMED);
 
         // collect next usages
@@ -786,24 +797,6 @@ node_st *OPT_DCEarrayassign(node_st *node)
         release_assert(local_entry == NULL || UClookup(entry) != UC_NONE);
         UCset(entry, UC_CONSUMED);
 
-        if (collect_if_usages)
-        {
-            release_assert(if_usage_stmts != NULL);
-            bool success =
-                HTinsert(if_usage_stmts, entry,
-                         (void *)(ptrdiff_t)((UClookup(entry) << UCshift) + UC_CONSUMED));
-            release_assert(success);
-        }
-
-        if (collect_else_usages)
-        {
-            release_assert(else_usage_stmts != NULL);
-            bool success =
-                HTinsert(else_usage_stmts, entry,
-                         (void *)(ptrdiff_t)((UClookup(entry) << UCshift) + UC_CONSUMED));
-            release_assert(success);
-        }
-
         // collect next usages
         ARRAYASSIGN_EXPR(node) = TRAVopt(ARRAYASSIGN_EXPR(node));
         ARRAYEXPR_DIMS(ARRAYASSIGN_VAR(node)) = TRAVopt(ARRAYEXPR_DIMS(ARRAYASSIGN_VAR(node)));
@@ -811,6 +804,45 @@ node_st *OPT_DCEarrayassign(node_st *node)
     return node;
 }
 
+node_st *OPT_DCEarraybulkassign(node_st *node)
+{
+    // The values are literals, thus only the array and the iteration variable are of interest.
+    if (collect_sideeffects)
+    {
+        return node;
+    }
+
+    if (check_consumtion)
+    {
+        char *name = VAR_NAME(ARRAYBULKASSIGN_VAR(node));
+        node_st *entry = deep_lookup(current, name);
+        release_assert(entry != NULL);
+        has_consumtion = UClookup(entry) != UC_NONE;
+        return node;
+    }
+
+    if (ARRAYBULKASSIGN_INDEX(node) != NULL)
+    {
+        node_st *index_entry = deep_lookup(current, VAR_NAME(ARRAYBULKASSIGN_INDEX(node)));
+        release_assert(index_entry != NULL);
+        UCset(index_entry, UC_USAGE);
+    }
+
+    if (tag_usages)
+    {
+        return node;
+    }
+
+    char *name = VAR_NAME(ARRAYBULKASSIGN_VAR(node));
+    node_st *entry = deep_lookup(current, name);
+    release_assert(entry != NULL);
+    node_st *local_entry = HTlookup(current, name);
+    release_assert(local_entry == NULL || UClookup(entry) != UC_NONE);
+    UCset(entry, UC_CONSUMED);
+
+    return node;
+}
+
 node_st *OPT_DCEternary(node_st *node)
 {
     if (collect_sideeffects)
@@ -1023,14 +1055,15 @@ node_st *OPT_DCEdowhileloop(node_st *node)
         release_assert(effect != SEFF_PROCESSING);
         if (effect == SEFF_NO)
         {
-            // We can remove the dowhile loop completely. Thus we dont add it to the usage table.
+            // We can remove the dowhile loop completely. Thus we dont mark it as kept.
+            control_kept = false;
             return node;
         }
     }
 
     // We do not remove and have to mark any in the expression as usage
     DOWHILELOOP_EXPR(node) = TRAVopt(DOWHILELOOP_EXPR(node));
-    UCset(node, UC_USAGE);
+    control_kept = true;
     return node;
 }
 
@@ -1061,31 +1094,17 @@ node_st *OPT_DCEforloop(node_st *node)
 
     bool is_consuming =
         check_stmts_sideffect(FORLOOP_BLOCK(node), current) || has_consume(FORLOOP_BLOCK(node));
-    htable_stptr parent_if_usage_stmts = if_usage_stmts;
-    htable_stptr parent_else_usage_stmts = else_usage_stmts;
-    bool parent_collect_if_usages = collect_if_usages;
-    bool parent_collect_else_usages = collect_else_usages;
-    if_usage_stmts = HTnew_Ptr(2 << 4);
-    else_usage_stmts = HTnew_Ptr(2 << 4);
-
-    collect_else_usages = false;
-    collect_if_usages = true;
     if (is_consuming)
     {
         tag_usages = true;
         FORLOOP_BLOCK(node) = TRAVopt(FORLOOP_BLOCK(node));
         tag_usages = false;
     }
+    // The block may be executed zero times, thus everything live after the loop stays live.
+    size_t exit_state = live_save();
     FORLOOP_BLOCK(node) = TRAVopt(FORLOOP_BLOCK(node));
-    collect_if_usages = false;
-    UCrestore();
-
-    HTdelete(if_usage_stmts);
-    HTdelete(else_usage_stmts);
-    if_usage_stmts = parent_if_usage_stmts;
-    else_usage_stmts = parent_else_usage_stmts;
-    collect_if_usages = parent_collect_if_usages;
-    collect_else_usages = parent_collect_else_usages;
+    live_union(exit_state);
+    live_drop(exit_state);
 
     if (FORLOOP_BLOCK(node) == NULL)
     {
@@ -1111,7 +1130,8 @@ node_st *OPT_DCEforloop(node_st *node)
 
         if ((effect0 | effect1 | effect2) == SEFF_NO)
         {
-            // We can remove by no adding it to the usage table.
+            // We can remove by not marking it as kept.
+            control_kept = false;
             return node;
         }
     }
@@ -1119,7 +1139,7 @@ node_st *OPT_DCEforloop(node_st *node)
     FORLOOP_ITER(node) = TRAVopt(FORLOOP_ITER(node));
     FORLOOP_COND(node) = TRAVopt(FORLOOP_COND(node));
     FORLOOP_ASSIGN(node) = TRAVopt(FORLOOP_ASSIGN(node));
-    UCset(node, UC_USAGE);
+    control_kept = true;
     return node;
 }
 
@@ -1159,31 +1179,17 @@ node_st *OPT_DCEwhileloop(node_st *node)
         WHILELOOP_EXPR(node) = TRAVopt(WHILELOOP_EXPR(node));
     }
 
-    htable_stptr parent_if_usage_stmts = if_usage_stmts;
-    htable_stptr parent_else_usage_stmts = else_usage_stmts;
-    bool parent_collect_if_usages = collect_if_usages;
-    bool parent_collect_else_usages = collect_else_usages;
-    if_usage_stmts = HTnew_Ptr(2 << 4);
-    else_usage_stmts = HTnew_Ptr(2 << 4);
-
-    collect_if_usages = true;
-    collect_else_usages = false;
     if (is_consumed)
     {
         tag_usages = true;
         WHILELOOP_BLOCK(node) = TRAVopt(WHILELOOP_BLOCK(node));
         tag_usages = false;
     }
+    // The block may be executed zero times, thus everything live after the loop stays live.
+    size_t exit_state = live_save();
     WHILELOOP_BLOCK(node) = TRAVopt(WHILELOOP_BLOCK(node)); // Statments may change
-    collect_if_usages = false;
-    UCrestore();
-
-    HTdelete(if_usage_stmts);
-    HTdelete(else_usage_stmts);
-    if_usage_stmts = parent_if_usage_stmts;
-    else_usage_stmts = parent_else_usage_stmts;
-    collect_if_usages = parent_collect_if_usages;
-    collect_else_usages = parent_collect_else_usages;
+    live_union(exit_state);
+    live_drop(exit_state);
 
     if (WHILELOOP_BLOCK(node) == NULL)
     {
@@ -1194,13 +1200,14 @@ node_st *OPT_DCEwhileloop(node_st *node)
         release_assert(effect != SEFF_PROCESSING);
         if (effect == SEFF_NO)
         {
-            // We can remove the while loop completely. Thus we dont add it to the usage table.
+            // We can remove the while loop completely. Thus we dont mark it as kept.
+            control_kept = false;
             return node;
         }
     }
 
     WHILELOOP_EXPR(node) = TRAVopt(WHILELOOP_EXPR(node));
-    UCset(node, UC_USAGE);
+    control_kept = true;
     return node;
 }
 
@@ -1229,39 +1236,25 @@ node_st *OPT_DCEifstatement(node_st *node)
         return node;
     }
 
-    htable_stptr parent_if_usage_stmts = if_usage_stmts;
-    htable_stptr parent_else_usage_stmts = else_usage_stmts;
-    bool parent_collect_if_usages = collect_if_usages;
-    bool parent_collect_else_usages = collect_else_usages;
-    if_usage_stmts = HTnew_Ptr(2 << 4);
-    else_usage_stmts = HTnew_Ptr(2 << 4);
-
-    collect_else_usages = false;
-    collect_if_usages = true;
+    // Both blocks start from the state after the if statement, a variable is live before the if
+    // statement if it is live at the start of either block.
+    size_t exit_state = live_save();
     IFSTATEMENT_BLOCK(node) = TRAVopt(IFSTATEMENT_BLOCK(node));
-    UCrestore();
-
-    collect_if_usages = false;
-    collect_else_usages = true;
+    size_t block_state = live_save();
+    live_load(exit_state);
     IFSTATEMENT_ELSE_BLOCK(node) = TRAVopt(IFSTATEMENT_ELSE_BLOCK(node));
-    collect_else_usages = false;
-    UCrestore();
-
-    HTdelete(if_usage_stmts);
-    HTdelete(else_usage_stmts);
-    if_usage_stmts = parent_if_usage_stmts;
-    else_usage_stmts = parent_else_usage_stmts;
-    collect_if_usages = parent_collect_if_usages;
-    collect_else_usages = parent_collect_else_usages;
+    live_union(block_state);
+    live_drop(exit_state);
 
     if (IFSTATEMENT_BLOCK(node) == NULL && IFSTATEMENT_ELSE_BLOCK(node) == NULL)
     {
-        // We can remove the if statement completely. Thus we dont add it to the usage table.
+        // We can remove the if statement completely. Thus we dont mark it as kept.
         // Note: side effecting expression are collected and written as additional statements.
+        control_kept = false;
         return node;
     }
 
     IFSTATEMENT_EXPR(node) = TRAVopt(IFSTATEMENT_EXPR(node));
-    UCset(node, UC_USAGE);
+    control_kept = true;
     return node;
 }
@@ -0,0 +1,426 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "global/globals.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <ccngen/trav.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static _Thread_local node_st *current_fundef = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local uint32_t inline_counter = 0;
+static _Thread_local htable_stptr substitutions = NULL;
+static _Thread_local htable_stptr inline_symbols = NULL;
+
+static void reset_state()
+{
+    current_fundef = NULL;
+    current = NULL;
+    inline_counter = 0;
+    substitutions = NULL;
+    inline_symbols = NULL;
+}
+
+/// Counts the nodes of the given type in the subtree.
+static long count_node_type(node_st *node, enum ccn_nodetype type)
+{
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    long count = NODE_TYPE(node) == type ? 1 : 0;
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        count += count_node_type(node->children[i], type);
+    }
+    return count;
+}
+
+/// Checks if all names used but not declared by the inlined function resolve to the same
+/// declarations at the call site. This holds for globals and for the variables of an enclosing
+/// function, as their names contain the scope level.
+static bool has_same_resolution(node_st *node, htable_stptr callee_symbols)
+{
+    if (node == NULL)
+    {
+        return true;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR)
+    {
+        char *name = VAR_NAME(node);
+        if (HTlookup(callee_symbols, name) == NULL &&
+            deep_lookup(callee_symbols, name) != deep_lookup(current, name))
+        {
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (!has_same_resolution(node->children[i], callee_symbols))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static node_st *last_statements(node_st *stmts)
+{
+    while (stmts != NULL && STATEMENTS_NEXT(stmts) != NULL)
+    {
+        stmts = STATEMENTS_NEXT(stmts);
+    }
+    return stmts;
+}
+
+/// Returns the call of a statement that can be replaced by the body of the called function.
+static node_st *inline_site(node_st *stmt)
+{
+    switch (NODE_TYPE(stmt))
+    {
+    case NT_PROCCALL:
+        return stmt;
+    case NT_ASSIGN:
+        return NODE_TYPE(ASSIGN_EXPR(stmt)) == NT_PROCCALL ? ASSIGN_EXPR(stmt) : NULL;
+    case NT_ARRAYASSIGN:
+        // The value of an array assign is evaluated before the index, as by the inlined body
+        return NODE_TYPE(ARRAYASSIGN_EXPR(stmt)) == NT_PROCCALL ? ARRAYASSIGN_EXPR(stmt) : NULL;
+    case NT_RETSTATEMENT:
+    {
+        node_st *expr = RETSTATEMENT_EXPR(stmt);
+        return expr != NULL && NODE_TYPE(expr) == NT_PROCCALL ? expr : NULL;
+    }
+    default:
+        return NULL;
+    }
+}
+
+/// Checks if the argument can replace the parameter in the inlined body instead of being assigned
+/// to a new local variable.
+static bool is_substitutable_arg(node_st *param, node_st *arg, node_st *body)
+{
+    node_st *var = PARAMS_VAR(param);
+    return NODE_TYPE(var) == NT_VAR && is_literal(arg) && !is_assigned(body, VAR_NAME(var));
+}
+
+/**
+ * Decides with the cost model if the call is inlined. The cost of a function is the node count of
+ * its body, reduced by the benefit of removing the call and specializing it for literal
+ * arguments. Only functions without local functions, recursion or early returns are inlined.
+ */
+static bool can_inline(node_st *callee, node_st *call, node_st *stmt)
+{
+    if (callee == NULL || NODE_TYPE(callee) != NT_FUNDEF || callee == current_fundef)
+    {
+        return false;
+    }
+
+    node_st *funheader = FUNDEF_FUNHEADER(callee);
+    node_st *funbody = FUNDEF_FUNBODY(callee);
+    char *name = VAR_NAME(FUNHEADER_VAR(funheader));
+    if (STReq(name, global_init_func) || FUNBODY_LOCALFUNDEFS(funbody) != NULL ||
+        calls_function(funbody, name))
+    {
+        return false;
+    }
+
+    // Only a return as last statement can be replaced by the statement of the call site
+    node_st *last = last_statements(FUNBODY_STMTS(funbody));
+    node_st *ret = last != NULL && NODE_TYPE(STATEMENTS_STMT(last)) == NT_RETSTATEMENT
+                       ? STATEMENTS_STMT(last)
+                       : NULL;
+    node_st *ret_expr = ret != NULL ? RETSTATEMENT_EXPR(ret) : NULL;
+    if (count_node_type(funbody, NT_RETSTATEMENT) != (ret != NULL ? 1 : 0) ||
+        (FUNHEADER_TYPE(funheader) != DT_void && ret_expr == NULL))
+    {
+        return false;
+    }
+
+    // A discarded return value is only dropped if it has no call
+    if (NODE_TYPE(stmt) == NT_PROCCALL && ret_expr != NULL &&
+        NODE_TYPE(ret_expr) != NT_PROCCALL && count_node_type(ret_expr, NT_PROCCALL) > 0)
+    {
+        return false;
+    }
+
+    if (!has_same_resolution(funbody, FUNDEF_SYMBOLS(callee)))
+    {
+        return false;
+    }
+
+    long benefit = inline_call_benefit;
+    node_st *params = FUNHEADER_PARAMS(funheader);
+    node_st *args = PROCCALL_EXPRS(call);
+    while (params != NULL && args != NULL)
+    {
+        node_st *arg = EXPRS_EXPR(args);
+        if (NODE_TYPE(PARAMS_VAR(params)) == NT_ARRAYVAR && NODE_TYPE(arg) != NT_VAR)
+        {
+            return false;
+        }
+
+        benefit += 1;
+        if (is_substitutable_arg(params, arg, funbody))
+        {
+            benefit += inline_literal_arg_benefit;
+        }
+
+        params = PARAMS_NEXT(params);
+        args = EXPRS_NEXT(args);
+    }
+    release_assert(params == NULL && args == NULL);
+
+    return node_count(FUNBODY_STMTS(funbody)) - benefit <= global.inline_limit;
+}
+
+/// Creates the name of a variable of an inlined function, by inserting the inline id after the
+/// name prefix. '@1_a' becomes '@1_inl0.a', which keeps prefixes like '@for' and '@temp_' intact.
+static char *inline_name(const char *name, uint32_t id)
+{
+    const char *separator = strchr(name, '_');
+    if (!STRprefix("@", name) || separator == NULL)
+    {
+        return STRfmt("@inl%u.%s", id, name);
+    }
+    return STRfmt("%.*s_inl%u.%s", (int)(separator - name), name, id, separator + 1);
+}
+
+/// Adds a vardec to the calling function and its symbol table.
+static void add_inlined_vardec(node_st *vardec)
+{
+    node_st *var = VARDEC_VAR(vardec);
+    char *name = VAR_NAME(NODE_TYPE(var) == NT_VAR ? var : ARRAYEXPR_VAR(var));
+    add_vardec(vardec, NULL, FUNDEF_FUNBODY(current_fundef));
+    bool success = HTinsert(current, name, vardec);
+    release_assert(success);
+}
+
+/**
+ * Creates the statements replacing the call site. The parameters become local variables of the
+ * calling function that are assigned the arguments, except for arrays which are passed by
+ * reference and for never assigned parameters with a literal argument. Both are substituted
+ * directly. The return at the end of the body is replaced by the statement of the call site.
+ *
+ * a = f(x, 2); with int f(int p, int q) { int r = p * q; return r + 1; }
+ * becomes:
+ * @1_inl0.p = x; @1_inl0.r = @1_inl0.p * 2; a = @1_inl0.r + 1;
+ */
+static node_st *inline_call(node_st *callee, node_st *call, node_st *stmt)
+{
+    node_st *funheader = FUNDEF_FUNHEADER(callee);
+    node_st *funbody = FUNDEF_FUNBODY(callee);
+    uint32_t id = inline_counter++;
+    htable_stptr parent_substitutions = substitutions;
+    htable_stptr parent_inline_symbols = inline_symbols;
+    substitutions = HTnew_String(2 << 4);
+    inline_symbols = FUNDEF_SYMBOLS(callee);
+
+    node_st *first = NULL;
+    node_st *last = NULL;
+    node_st *params = FUNHEADER_PARAMS(funheader);
+    node_st *args = PROCCALL_EXPRS(call);
+    while (params != NULL && args != NULL)
+    {
+        node_st *var = PARAMS_VAR(params);
+        node_st *arg = EXPRS_EXPR(args);
+        node_st *replacement = NULL;
+        if (NODE_TYPE(var) == NT_ARRAYVAR)
+        {
+            var = ARRAYVAR_VAR(var);
+            replacement = CCNcopy(arg);
+        }
+        else if (is_substitutable_arg(params, arg, funbody))
+        {
+            replacement = CCNcopy(arg);
+        }
+        else
+        {
+            replacement = ASTvar(inline_name(VAR_NAME(var), id));
+            add_inlined_vardec(ASTvardec(CCNcopy(replacement), NULL, PARAMS_TYPE(params)));
+            node_st *assign = ASTassign(CCNcopy(replacement), CCNcopy(arg));
+            append_stmts(ASTstatements(assign, NULL), &first, &last);
+        }
+
+        bool success = HTinsert(substitutions, VAR_NAME(var), replacement);
+        release_assert(success);
+        params = PARAMS_NEXT(params);
+        args = EXPRS_NEXT(args);
+    }
+
+    // Calls in the arguments can be inlined as well, the inlined body is not visited again
+    if (first != NULL)
+    {
+        first = TRAVopt(first);
+        last = last_statements(first);
+    }
+
+    // Local variables are renamed before copying them, as array dimensions can use them
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        node_st *var = VARDEC_VAR(VARDECS_VARDEC(vardecs));
+        char *name = VAR_NAME(NODE_TYPE(var) == NT_VAR ? var : ARRAYEXPR_VAR(var));
+        bool success = HTinsert(substitutions, name, ASTvar(inline_name(name, id)));
+        release_assert(success);
+    }
+
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        node_st *vardec = TRAVstart(CCNcopy(VARDECS_VARDEC(vardecs)), TRAV_OPT_IS);
+        add_inlined_vardec(vardec);
+    }
+
+    node_st *stmts = NULL;
+    if (FUNBODY_STMTS(funbody) != NULL)
+    {
+        stmts = TRAVstart(CCNcopy(FUNBODY_STMTS(funbody)), TRAV_OPT_IS);
+    }
+
+    node_st *ret_stmts = last_statements(stmts);
+    if (ret_stmts != NULL && NODE_TYPE(STATEMENTS_STMT(ret_stmts)) == NT_RETSTATEMENT)
+    {
+        node_st *ret = STATEMENTS_STMT(ret_stmts);
+        node_st *ret_expr = RETSTATEMENT_EXPR(ret);
+        node_st *replacement = NULL;
+        switch (NODE_TYPE(stmt))
+        {
+        case NT_ASSIGN:
+            replacement = ASTassign(CCNcopy(ASSIGN_VAR(stmt)), ret_expr);
+            break;
+        case NT_ARRAYASSIGN:
+            replacement = ASTarrayassign(CCNcopy(ARRAYASSIGN_VAR(stmt)), ret_expr);
+            break;
+        case NT_RETSTATEMENT:
+            replacement = ret;
+            break;
+        case NT_PROCCALL:
+            // The return value is discarded, only a call must be kept
+            replacement = ret_expr != NULL && NODE_TYPE(ret_expr) == NT_PROCCALL ? ret_expr : NULL;
+            break;
+        default:
+            release_assert(false);
+            break;
+        }
+
+        if (replacement != ret)
+        {
+            if (replacement != NULL)
+            {
+                RETSTATEMENT_EXPR(ret) = NULL;
+                STATEMENTS_STMT(ret_stmts) = replacement;
+                CCNfree(ret);
+            }
+            else if (ret_stmts == stmts)
+            {
+                CCNfree(stmts);
+                stmts = NULL;
+            }
+            else
+            {
+                node_st *prev = stmts;
+                while (STATEMENTS_NEXT(prev) != ret_stmts)
+                {
+                    prev = STATEMENTS_NEXT(prev);
+                }
+                STATEMENTS_NEXT(prev) = NULL;
+                CCNfree(ret_stmts);
+            }
+        }
+    }
+    else
+    {
+        release_assert(NODE_TYPE(stmt) == NT_PROCCALL);
+    }
+
+    if (stmts != NULL)
+    {
+        append_stmts(stmts, &first, &last);
+    }
+
+    for (htable_iter_st *iter = HTiterate(substitutions); iter; iter = HTiterateNext(iter))
+    {
+        CCNfree(HTiterValue(iter));
+    }
+    HTdelete(substitutions);
+    substitutions = parent_substitutions;
+    inline_symbols = parent_inline_symbols;
+    return first;
+}
+
+node_st *OPT_ISvar(node_st *node)
+{
+    release_assert(substitutions != NULL);
+    node_st *replacement = HTlookup(substitutions, VAR_NAME(node));
+    if (replacement != NULL)
+    {
+        CCNfree(node);
+        return CCNcopy(replacement);
+    }
+
+    // Every variable of the inlined function must be substituted
+    release_assert(HTlookup(inline_symbols, VAR_NAME(node)) == NULL);
+    return node;
+}
+
+node_st *OPT_INstatements(node_st *node)
+{
+    TRAVchildren(node);
+
+    node_st *stmt = STATEMENTS_STMT(node);
+    node_st *call = inline_site(stmt);
+    if (call == NULL)
+    {
+        return node;
+    }
+
+    node_st *callee = deep_lookup(current, VAR_NAME(PROCCALL_VAR(call)));
+    if (!can_inline(callee, call, stmt))
+    {
+        return node;
+    }
+
+    node_st *first = inline_call(callee, call, stmt);
+    node_st *next = STATEMENTS_NEXT(node);
+    STATEMENTS_NEXT(node) = NULL;
+    CCNfree(node);
+    if (first == NULL)
+    {
+        return next;
+    }
+
+    STATEMENTS_NEXT(last_statements(first)) = next;
+    return first;
+}
+
+node_st *OPT_INfundef(node_st *node)
+{
+    node_st *parent_fundef = current_fundef;
+    htable_stptr parent_current = current;
+    current_fundef = node;
+    current = FUNDEF_SYMBOLS(node);
+    release_assert(current != NULL);
+
+    TRAVchildren(node);
+
+    current_fundef = parent_fundef;
+    current = parent_current;
+    return node;
+}
+
+node_st *OPT_INprogram(node_st *node)
+{
+    reset_state();
+    TRAVchildren(node);
+    return node;
+}
@@ -0,0 +1,287 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Global or outer variable used in a loop.
+struct promotion_candidate
+{
+    char *name;
+    node_st *entry;
+    bool written;
+};
+
+/// Uses of a loop, collected before deciding which variables it can promote.
+struct loop_uses
+{
+    struct promotion_candidate *candidates;
+    size_t count;
+    size_t capacity;
+    bool has_call;       // Calls a function, which can read globals and outer variables
+    bool has_sideeffect; // Calls a function, which can also write them
+    bool has_return;     // Leaves the function without passing the write back
+};
+
+static _Thread_local node_st *fundef = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr sideeffect_table = NULL;
+static _Thread_local uint32_t promotion_counter = 0;
+static _Thread_local const char *promoted_name = NULL;
+static _Thread_local char *promoted_local = NULL;
+
+static void reset_state()
+{
+    fundef = NULL;
+    current = NULL;
+    sideeffect_table = NULL;
+    promotion_counter = 0;
+    promoted_name = NULL;
+    promoted_local = NULL;
+}
+
+static void add_candidate(struct loop_uses *uses, char *name, bool written)
+{
+    for (size_t i = 0; i < uses->count; i++)
+    {
+        if (STReq(uses->candidates[i].name, name))
+        {
+            uses->candidates[i].written = uses->candidates[i].written || written;
+            return;
+        }
+    }
+
+    int level = 0;
+    node_st *entry = deep_lookup_level(current, name, &level);
+    release_assert(entry != NULL);
+    if (level == 0 || NODE_TYPE(get_var_from_symbol(entry)) != NT_VAR)
+    {
+        // Locals are already cheap and arrays are not promoted
+        return;
+    }
+
+    if (uses->count == uses->capacity)
+    {
+        uses->capacity = uses->capacity == 0 ? 8 : uses->capacity * 2;
+        uses->candidates =
+            realloc(uses->candidates, uses->capacity * sizeof(struct promotion_candidate));
+        release_assert(uses->candidates != NULL);
+    }
+    uses->candidates[uses->count++] = (struct promotion_candidate){name, entry, written};
+}
+
+static void collect_uses(node_st *node, struct loop_uses *uses)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    switch (NODE_TYPE(node))
+    {
+    case NT_VAR:
+        add_candidate(uses, VAR_NAME(node), false);
+        return;
+    case NT_ASSIGN:
+        add_candidate(uses, VAR_NAME(ASSIGN_VAR(node)), true);
+        collect_uses(ASSIGN_EXPR(node), uses);
+        return;
+    case NT_PROCCALL:
+        if (!STReq(VAR_NAME(PROCCALL_VAR(node)), alloc_func))
+        {
+            enum sideeffect effect = check_expr_sideeffect(node, current, sideeffect_table);
+            release_assert(effect != SEFF_NULL);
+            release_assert(effect != SEFF_PROCESSING);
+            uses->has_call = true;
+            uses->has_sideeffect = uses->has_sideeffect || effect == SEFF_YES;
+        }
+        collect_uses(PROCCALL_EXPRS(node), uses);
+        return;
+    case NT_RETSTATEMENT:
+        uses->has_return = true;
+        break;
+    default:
+        break;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        collect_uses(node->children[i], uses);
+    }
+}
+
+/// Renames the uses of the promoted variable in the loop to its local.
+static void rename_uses(node_st *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR && STReq(VAR_NAME(node), promoted_name))
+    {
+        free(VAR_NAME(node));
+        VAR_NAME(node) = STRcpy(promoted_local);
+        return;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        rename_uses(node->children[i]);
+    }
+}
+
+/// Declares the local holding a promoted variable during the loop.
+static char *promotion_local(struct promotion_candidate *candidate)
+{
+    char *name = STRfmt("@prom%u_%s", promotion_counter++, get_pretty_name(candidate->name));
+    node_st *vardec = ASTvardec(ASTvar(name), NULL, symbol_to_type(candidate->entry));
+    add_vardec(vardec, NULL, FUNDEF_FUNBODY(fundef));
+    bool success = HTinsert(current, VAR_NAME(VARDEC_VAR(vardec)), vardec);
+    release_assert(success);
+    return name;
+}
+
+/**
+ * Promotes the globals and outer variables of a loop to locals, which are loaded before the loop
+ * and written back after it. A variable is promoted if nothing but the loop itself can access it
+ * during the loop: a call with side effects excludes all variables, and a written variable also
+ * requires a loop without calls and returns.
+ *
+ * while (i < n) { total = total + i; i = i + 1; } becomes:
+ * @prom0_total = total; while (i < n) { @prom0_total = @prom0_total + i; i = i + 1; }
+ * total = @prom0_total;
+ *
+ * Returns the statement of the last write back, or the loop if there is none.
+ */
+static node_st *promote_loop(node_st *stmts, node_st *prev, node_st **head)
+{
+    node_st *loop = STATEMENTS_STMT(stmts);
+    struct loop_uses uses = {0};
+    collect_uses(loop, &uses);
+
+    node_st *loads_first = NULL;
+    node_st *loads_last = NULL;
+    node_st *stores_first = NULL;
+    node_st *stores_last = NULL;
+    for (size_t i = 0; i < uses.count && !uses.has_sideeffect; i++)
+    {
+        struct promotion_candidate *candidate = &uses.candidates[i];
+        if (candidate->written && (uses.has_call || uses.has_return))
+        {
+            continue;
+        }
+
+        // The renaming frees the names of the uses, which the candidate points to
+        char *name = STRcpy(candidate->name);
+        char *local = promotion_local(candidate);
+        promoted_name = name;
+        promoted_local = local;
+        rename_uses(loop);
+        promoted_name = NULL;
+        promoted_local = NULL;
+
+        node_st *load = ASTassign(ASTvar(STRcpy(local)), ASTvar(STRcpy(name)));
+        append_stmts(ASTstatements(load, NULL), &loads_first, &loads_last);
+        if (candidate->written)
+        {
+            node_st *store = ASTassign(ASTvar(name), ASTvar(STRcpy(local)));
+            append_stmts(ASTstatements(store, NULL), &stores_first, &stores_last);
+        }
+        else
+        {
+            free(name);
+        }
+    }
+    free(uses.candidates);
+
+    if (loads_first != NULL)
+    {
+        STATEMENTS_NEXT(loads_last) = stmts;
+        if (prev == NULL)
+        {
+            *head = loads_first;
+        }
+        else
+        {
+            STATEMENTS_NEXT(prev) = loads_first;
+        }
+    }
+    if (stores_first == NULL)
+    {
+        return stmts;
+    }
+    STATEMENTS_NEXT(stores_last) = STATEMENTS_NEXT(stmts);
+    STATEMENTS_NEXT(stmts) = stores_first;
+    return stores_last;
+}
+
+/// Promotes the variables of the outermost loops first. The variables a loop can not promote,
+/// e.g. because of a call, may still be promoted in a nested loop without the call.
+static node_st *promote_stmts(node_st *head)
+{
+    node_st *prev = NULL;
+    for (node_st *stmts = head; stmts != NULL; stmts = STATEMENTS_NEXT(prev))
+    {
+        node_st *stmt = STATEMENTS_STMT(stmts);
+        node_st *last = stmts;
+        switch (NODE_TYPE(stmt))
+        {
+        case NT_WHILELOOP:
+            last = promote_loop(stmts, prev, &head);
+            WHILELOOP_BLOCK(stmt) = promote_stmts(WHILELOOP_BLOCK(stmt));
+            break;
+        case NT_DOWHILELOOP:
+            last = promote_loop(stmts, prev, &head);
+            DOWHILELOOP_BLOCK(stmt) = promote_stmts(DOWHILELOOP_BLOCK(stmt));
+            break;
+        case NT_FORLOOP:
+            last = promote_loop(stmts, prev, &head);
+            FORLOOP_BLOCK(stmt) = promote_stmts(FORLOOP_BLOCK(stmt));
+            break;
+        case NT_IFSTATEMENT:
+            IFSTATEMENT_BLOCK(stmt) = promote_stmts(IFSTATEMENT_BLOCK(stmt));
+            IFSTATEMENT_ELSE_BLOCK(stmt) = promote_stmts(IFSTATEMENT_ELSE_BLOCK(stmt));
+            break;
+        default:
+            break;
+        }
+        prev = last;
+    }
+    return head;
+}
+
+node_st *OPT_LPfundef(node_st *node)
+{
+    TRAVchildren(node);
+
+    node_st *parent_fundef = fundef;
+    htable_stptr parent_current = current;
+    fundef = node;
+    current = FUNDEF_SYMBOLS(node);
+
+    node_st *funbody = FUNDEF_FUNBODY(node);
+    FUNBODY_STMTS(funbody) = promote_stmts(FUNBODY_STMTS(funbody));
+
+    fundef = parent_fundef;
+    current = parent_current;
+    return node;
+}
+
+node_st *OPT_LPprogram(node_st *node)
+{
+    reset_state();
+    sideeffect_table = HTnew_Ptr(2 << 8);
+    TRAVchildren(node);
+    HTdelete(sideeffect_table);
+    reset_state();
+    return node;
+}
@@ -0,0 +1,412 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Live range of a local variable as positions in the evaluation order of the function body.
+struct live_range
+{
+    char *name;
+    enum DataType type;
+    int start;
+    int end;
+    bool pinned;        // Has to keep its own slot
+    bool first_is_def;  // First occurrence is an assignment
+    node_st *def_block; // Loop whose block contains the first occurrence at top level
+};
+
+/// Statement position range of a loop. Variables used within the loop are live in the complete
+/// range, unless they are assigned first in each iteration.
+struct loop_range
+{
+    node_st *loop;
+    int start;
+    int end;
+};
+
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local htable_stptr ranges = NULL;
+static _Thread_local struct loop_range *loops = NULL;
+static _Thread_local size_t loop_count = 0;
+static _Thread_local size_t loop_capacity = 0;
+static _Thread_local int position = 0;
+static _Thread_local node_st *top_loop = NULL;
+
+static void reset_state()
+{
+    current = NULL;
+    ranges = NULL;
+    loops = NULL;
+    loop_count = 0;
+    loop_capacity = 0;
+    position = 0;
+    top_loop = NULL;
+}
+
+static void occurrence(char *name, bool is_def)
+{
+    struct live_range *range = HTlookup(ranges, name);
+    if (range == NULL)
+    {
+        // Not a candidate, e.g. a parameter or an outer variable
+        return;
+    }
+
+    position++;
+    if (range->start < 0)
+    {
+        range->start = position;
+        range->first_is_def = is_def;
+        range->def_block = top_loop;
+    }
+    range->end = position;
+}
+
+static void add_loop(node_st *loop, int start)
+{
+    if (loop_count == loop_capacity)
+    {
+        loop_capacity = loop_capacity == 0 ? 16 : loop_capacity * 2;
+        loops = realloc(loops, loop_capacity * sizeof(struct loop_range));
+        release_assert(loops != NULL);
+    }
+
+    loops[loop_count].loop = loop;
+    loops[loop_count].start = start;
+    loops[loop_count].end = ++position;
+    loop_count++;
+}
+
+static void walk(node_st *node);
+
+static void walk_block(node_st *block, node_st *loop)
+{
+    node_st *parent_top_loop = top_loop;
+    top_loop = loop;
+    walk(block);
+    top_loop = parent_top_loop;
+}
+
+/// Numbers the variable occurrences in evaluation order and collects the loops.
+static void walk(node_st *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    int start = 0;
+    switch (NODE_TYPE(node))
+    {
+    case NT_VAR:
+        occurrence(VAR_NAME(node), false);
+        break;
+    case NT_ASSIGN:
+        walk(ASSIGN_EXPR(node));
+        occurrence(VAR_NAME(ASSIGN_VAR(node)), true);
+        break;
+    case NT_ARRAYASSIGN:
+        walk(ARRAYASSIGN_EXPR(node));
+        walk(ARRAYASSIGN_VAR(node));
+        break;
+    case NT_STATEMENTS:
+        for (node_st *stmts = node; stmts != NULL; stmts = STATEMENTS_NEXT(stmts))
+        {
+            walk(STATEMENTS_STMT(stmts));
+        }
+        break;
+    case NT_IFSTATEMENT:
+        walk(IFSTATEMENT_EXPR(node));
+        walk_block(IFSTATEMENT_BLOCK(node), NULL);
+        walk_block(IFSTATEMENT_ELSE_BLOCK(node), NULL);
+        break;
+    case NT_WHILELOOP:
+        start = ++position;
+        walk(WHILELOOP_EXPR(node));
+        walk_block(WHILELOOP_BLOCK(node), node);
+        add_loop(node, start);
+        break;
+    case NT_DOWHILELOOP:
+        start = ++position;
+        walk_block(DOWHILELOOP_BLOCK(node), node);
+        walk(DOWHILELOOP_EXPR(node));
+        add_loop(node, start);
+        break;
+    case NT_FORLOOP:
+        // The start value is assigned once, the bounds and the iterator are used in each iteration
+        walk(FORLOOP_ASSIGN(node));
+        start = ++position;
+        walk(FORLOOP_COND(node));
+        walk(FORLOOP_ITER(node));
+        walk_block(FORLOOP_BLOCK(node), node);
+        add_loop(node, start);
+        break;
+    case NT_TERNARY:
+        walk(TERNARY_PRED(node));
+        walk_block(TERNARY_PTRUE(node), NULL);
+        walk_block(TERNARY_PFALSE(node), NULL);
+        break;
+    default:
+        for (unsigned int i = 0; i < node->num_children; i++)
+        {
+            walk(node->children[i]);
+        }
+        break;
+    }
+}
+
+/// Pins the candidates used by the subtree, as local functions access them through the frame.
+static void pin_vars(node_st *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR)
+    {
+        struct live_range *range = HTlookup(ranges, VAR_NAME(node));
+        if (range != NULL)
+        {
+            range->pinned = true;
+        }
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        pin_vars(node->children[i]);
+    }
+}
+
+/// Extends the live ranges over the loops they are used in. A variable only used in a loop and
+/// assigned first at the top level of its block is not live across iterations.
+static void extend_over_loops(struct live_range *range)
+{
+    for (size_t i = 0; i < loop_count; i++)
+    {
+        struct loop_range *loop = &loops[i];
+        if (range->start > loop->end || range->end < loop->start)
+        {
+            continue;
+        }
+
+        bool is_local = range->start >= loop->start && range->end <= loop->end &&
+                        range->first_is_def && range->def_block == loop->loop;
+        if (!is_local)
+        {
+            range->start = range->start < loop->start ? range->start : loop->start;
+            range->end = range->end > loop->end ? range->end : loop->end;
+        }
+    }
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+    const struct live_range *range_a = *(struct live_range *const *)a;
+    const struct live_range *range_b = *(struct live_range *const *)b;
+    return range_a->start - range_b->start;
+}
+
+/// Renames the variables of the subtree with the slot variable they are assigned to.
+static void rename_vars(node_st *node, htable_stptr slots)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR)
+    {
+        char *slot = HTlookup(slots, VAR_NAME(node));
+        if (slot != NULL)
+        {
+            free(VAR_NAME(node));
+            VAR_NAME(node) = STRcpy(slot);
+        }
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        rename_vars(node->children[i], slots);
+    }
+}
+
+/**
+ * Packs the scalar locals of a function with disjoint live ranges into shared slots. The live
+ * ranges are intervals in evaluation order, extended over the loops they are live in. The
+ * intervals are assigned to the slots by a linear scan, where a slot is represented by the
+ * variable that was assigned to it first. The other variables are renamed to it and their vardec
+ * is removed, so CodeGeneration assigns fewer indices.
+ */
+static void allocate_slots(node_st *fundef)
+{
+    node_st *funbody = FUNDEF_FUNBODY(fundef);
+    ranges = HTnew_String(2 << 6);
+    size_t range_count = 0;
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        node_st *vardec = VARDECS_VARDEC(vardecs);
+        if (NODE_TYPE(VARDEC_VAR(vardec)) == NT_VAR)
+        {
+            range_count++;
+        }
+    }
+
+    struct live_range *range_list = malloc(range_count * sizeof(struct live_range) + 1);
+    struct live_range **sorted = malloc(range_count * sizeof(struct live_range *) + 1);
+    release_assert(range_list != NULL && sorted != NULL);
+    size_t i = 0;
+    for (node_st *vardecs = FUNBODY_VARDECS(funbody); vardecs != NULL;
+         vardecs = VARDECS_NEXT(vardecs))
+    {
+        node_st *vardec = VARDECS_VARDEC(vardecs);
+        if (NODE_TYPE(VARDEC_VAR(vardec)) == NT_VAR)
+        {
+            struct live_range *range = &range_list[i];
+            range->name = VAR_NAME(VARDEC_VAR(vardec));
+            range->type = VARDEC_TYPE(vardec);
+            range->start = -1;
+            range->end = -1;
+            range->pinned = false;
+            range->first_is_def = false;
+            range->def_block = NULL;
+            sorted[i++] = range;
+            bool success = HTinsert(ranges, range->name, range);
+            release_assert(success);
+        }
+        else
+        {
+            // Array dimensions are not part of the evaluated statements
+            pin_vars(ARRAYEXPR_DIMS(VARDEC_VAR(vardec)));
+        }
+    }
+
+    pin_vars(FUNBODY_LOCALFUNDEFS(funbody));
+    position = 0;
+    loop_count = 0;
+    top_loop = NULL;
+    walk(FUNBODY_STMTS(funbody));
+
+    for (i = 0; i < range_count; i++)
+    {
+        struct live_range *range = sorted[i];
+        if (range->start < 0)
+        {
+            // Never used, it shares any slot
+            range->start = 0;
+            range->end = 0;
+        }
+        extend_over_loops(range);
+    }
+    qsort(sorted, range_count, sizeof(struct live_range *), compare_ranges);
+
+    // Linear scan: A slot can be reused when the live range of its last variable has ended
+    htable_stptr slots = HTnew_String(2 << 6);
+    struct live_range **slot_last = malloc(range_count * sizeof(struct live_range *) + 1);
+    char **slot_names = malloc(range_count * sizeof(char *) + 1);
+    release_assert(slot_last != NULL && slot_names != NULL);
+    size_t slot_count = 0;
+    for (i = 0; i < range_count; i++)
+    {
+        struct live_range *range = sorted[i];
+        if (range->pinned)
+        {
+            continue;
+        }
+
+        size_t slot = 0;
+        while (slot < slot_count &&
+               (slot_last[slot]->type != range->type || slot_last[slot]->end >= range->start))
+        {
+            slot++;
+        }
+
+        if (slot == slot_count)
+        {
+            slot_names[slot_count] = range->name;
+            slot_count++;
+        }
+        else
+        {
+            bool success = HTinsert(slots, range->name, slot_names[slot]);
+            release_assert(success);
+        }
+        slot_last[slot] = range;
+    }
+
+    rename_vars(FUNBODY_STMTS(funbody), slots);
+
+    // Remove the vardecs of the renamed variables
+    node_st *prev = NULL;
+    node_st *vardecs = FUNBODY_VARDECS(funbody);
+    while (vardecs != NULL)
+    {
+        node_st *next = VARDECS_NEXT(vardecs);
+        node_st *var = VARDEC_VAR(VARDECS_VARDEC(vardecs));
+        if (NODE_TYPE(var) == NT_VAR && HTlookup(slots, VAR_NAME(var)) != NULL)
+        {
+            node_st *entry = HTremove(current, VAR_NAME(var));
+            release_assert(entry == VARDECS_VARDEC(vardecs));
+            if (prev == NULL)
+            {
+                FUNBODY_VARDECS(funbody) = next;
+            }
+            else
+            {
+                VARDECS_NEXT(prev) = next;
+            }
+            VARDECS_NEXT(vardecs) = NULL;
+            CCNfree(vardecs);
+        }
+        else
+        {
+            prev = vardecs;
+        }
+        vardecs = next;
+    }
+
+    HTdelete(slots);
+    HTdelete(ranges);
+    ranges = NULL;
+    free(slot_last);
+    free(slot_names);
+    free(sorted);
+    free(range_list);
+}
+
+node_st *OPT_SPfundef(node_st *node)
+{
+    TRAVchildren(node);
+
+    htable_stptr parent_current = current;
+    current = FUNDEF_SYMBOLS(node);
+    release_assert(current != NULL);
+
+    // The locals of the init function hold the dimensions of the global arrays
+    if (!STReq(VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(node))), global_init_func))
+    {
+        allocate_slots(node);
+    }
+
+    current = parent_current;
+    return node;
+}
+
+node_st *OPT_SPprogram(node_st *node)
+{
+    reset_state();
+    TRAVchildren(node);
+    free(loops);
+    loops = NULL;
+    loop_capacity = 0;
+    return node;
+}
@@ -0,0 +1,683 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "global/globals.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "symbol_keys.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <ccngen/trav.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Called function with its call sites and the place of its definition.
+struct function_info
+{
+    node_st *fundef;
+    node_st *list;      // Declarations or LocalFunDefs holding the definition
+    htable_stptr scope; // Symbol table holding the function symbol
+    node_st **calls;
+    long *weights;
+    size_t call_count;
+    size_t call_capacity;
+};
+
+/// Calls of a function passing the same literals for the same parameters.
+struct call_pattern
+{
+    size_t function;
+    size_t order;
+    node_st **literals; // Literal argument per parameter, NULL if the parameter is not specialized
+    node_st **calls;
+    size_t call_count;
+    long weight;
+};
+
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local node_st *current_list = NULL;
+static _Thread_local uint32_t loop_depth = 0;
+static _Thread_local htable_stptr function_indices = NULL; // FunDef to its index + 1
+static _Thread_local struct function_info *functions = NULL;
+static _Thread_local size_t function_count = 0;
+static _Thread_local size_t function_capacity = 0;
+static _Thread_local uint32_t clone_counter = 0;
+static _Thread_local const char *substituted_name = NULL;
+static _Thread_local node_st *substituted_literal = NULL;
+
+static void reset_state()
+{
+    current = NULL;
+    current_list = NULL;
+    loop_depth = 0;
+    function_indices = NULL;
+    functions = NULL;
+    function_count = 0;
+    function_capacity = 0;
+    clone_counter = 0;
+    substituted_name = NULL;
+    substituted_literal = NULL;
+}
+
+static size_t function_index(node_st *fundef)
+{
+    void *entry = HTlookup(function_indices, fundef);
+    if (entry != NULL)
+    {
+        return (size_t)(ptrdiff_t)entry - 1;
+    }
+
+    if (function_count == function_capacity)
+    {
+        function_capacity = function_capacity == 0 ? 64 : function_capacity * 2;
+        functions = realloc(functions, function_capacity * sizeof(struct function_info));
+        release_assert(functions != NULL);
+    }
+
+    size_t index = function_count++;
+    functions[index] = (struct function_info){.fundef = fundef};
+    bool success = HTinsert(function_indices, fundef, (void *)(ptrdiff_t)(index + 1));
+    release_assert(success);
+    return index;
+}
+
+static size_t param_count(node_st *fundef)
+{
+    size_t count = 0;
+    for (node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef)); params != NULL;
+         params = PARAMS_NEXT(params))
+    {
+        count++;
+    }
+    return count;
+}
+
+/// Gets the arguments of the call as array with an entry per parameter.
+static node_st **call_args(node_st *call, size_t count)
+{
+    node_st **args = calloc(count == 0 ? 1 : count, sizeof(node_st *));
+    release_assert(args != NULL);
+    size_t i = 0;
+    for (node_st *exprs = PROCCALL_EXPRS(call); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+    {
+        release_assert(i < count);
+        args[i++] = EXPRS_EXPR(exprs);
+    }
+    release_assert(i == count);
+    return args;
+}
+
+static const char *declared_name(node_st *entry)
+{
+    node_st *var = get_var_from_symbol(entry);
+    switch (NODE_TYPE(var))
+    {
+    case NT_VAR:
+        return VAR_NAME(var);
+    case NT_ARRAYEXPR:
+        return VAR_NAME(ARRAYEXPR_VAR(var));
+    case NT_ARRAYVAR:
+        return VAR_NAME(ARRAYVAR_VAR(var));
+    default:
+        release_assert(false);
+        return NULL;
+    }
+}
+
+/// Checks if all calls of the function are known, it is neither exported nor called by the runtime.
+static bool has_known_calls(node_st *fundef)
+{
+    const char *name = VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(fundef)));
+    return !FUNDEF_HAS_EXPORT(fundef) && !STReq(name, "@fun_main") &&
+           !STReq(name, global_init_func);
+}
+
+/// Checks if the parameter can be replaced by a literal in the body of the function.
+static bool is_bindable_param(node_st *param, node_st *funbody)
+{
+    node_st *var = PARAMS_VAR(param);
+    return NODE_TYPE(var) == NT_VAR && !is_assigned(funbody, VAR_NAME(var));
+}
+
+/// Finds the bound parameters that are removed together with their arguments. The dimension
+/// parameters of ParameterPassing are declared by their array parameter, so they are kept.
+static void find_removed_params(node_st *fundef, node_st **literals, bool *removed)
+{
+    size_t i = 0;
+    for (node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef)); params != NULL;
+         params = PARAMS_NEXT(params), i++)
+    {
+        removed[i] = literals[i] != NULL &&
+                     HTlookup(FUNDEF_SYMBOLS(fundef), VAR_NAME(PARAMS_VAR(params))) == params;
+    }
+}
+
+/// Replaces the bound parameters by their literal in the body of the function and removes the
+/// parameters found by find_removed_params.
+static void bind_params(node_st *fundef, node_st **literals, const bool *removed)
+{
+    node_st *funheader = FUNDEF_FUNHEADER(fundef);
+    node_st *prev = NULL;
+    node_st *params = FUNHEADER_PARAMS(funheader);
+    for (size_t i = 0; params != NULL; i++)
+    {
+        node_st *next = PARAMS_NEXT(params);
+        if (literals[i] == NULL)
+        {
+            prev = params;
+            params = next;
+            continue;
+        }
+
+        char *name = VAR_NAME(PARAMS_VAR(params));
+        substituted_name = name;
+        substituted_literal = literals[i];
+        FUNDEF_FUNBODY(fundef) = TRAVstart(FUNDEF_FUNBODY(fundef), TRAV_OPT_PS);
+        substituted_name = NULL;
+        substituted_literal = NULL;
+
+        if (!removed[i])
+        {
+            prev = params;
+            params = next;
+            continue;
+        }
+
+        node_st *entry = HTremove(FUNDEF_SYMBOLS(fundef), name);
+        release_assert(entry == params);
+        if (prev == NULL)
+        {
+            FUNHEADER_PARAMS(funheader) = next;
+        }
+        else
+        {
+            PARAMS_NEXT(prev) = next;
+        }
+        PARAMS_NEXT(params) = NULL;
+        CCNfree(params);
+        params = next;
+    }
+}
+
+/// Removes the arguments of the removed parameters from the call.
+static void drop_args(node_st *call, const bool *removed)
+{
+    node_st *prev = NULL;
+    node_st *exprs = PROCCALL_EXPRS(call);
+    for (size_t i = 0; exprs != NULL; i++)
+    {
+        node_st *next = EXPRS_NEXT(exprs);
+        if (removed[i])
+        {
+            if (prev == NULL)
+            {
+                PROCCALL_EXPRS(call) = next;
+            }
+            else
+            {
+                EXPRS_NEXT(prev) = next;
+            }
+            EXPRS_NEXT(exprs) = NULL;
+            CCNfree(exprs);
+        }
+        else
+        {
+            prev = exprs;
+        }
+        exprs = next;
+    }
+}
+
+/**
+ * Binds the parameters for which every call passes the same literal. Only functions whose calls
+ * are all known are changed, the bound parameters are removed with their arguments.
+ *
+ * int scale(int x, int f) { return x * f; } called as scale(a, 3) and scale(b, 3)
+ * becomes:
+ * int scale(int x) { return x * 3; } called as scale(a) and scale(b)
+ */
+static void propagate_constants(struct function_info *info)
+{
+    node_st *fundef = info->fundef;
+    if (info->call_count == 0 || !has_known_calls(fundef))
+    {
+        return;
+    }
+
+    size_t count = param_count(fundef);
+    node_st **literals = calloc(count == 0 ? 1 : count, sizeof(node_st *));
+    bool *removed = calloc(count == 0 ? 1 : count, sizeof(bool));
+    release_assert(literals != NULL && removed != NULL);
+
+    node_st **first_args = call_args(info->calls[0], count);
+    bool is_bound = false;
+    size_t i = 0;
+    for (node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef)); params != NULL;
+         params = PARAMS_NEXT(params), i++)
+    {
+        node_st *literal = first_args[i];
+        if (!is_literal(literal) || !is_bindable_param(params, FUNDEF_FUNBODY(fundef)))
+        {
+            continue;
+        }
+
+        bool is_same = true;
+        for (size_t call = 1; call < info->call_count && is_same; call++)
+        {
+            node_st **args = call_args(info->calls[call], count);
+            is_same = is_same_literal(args[i], literal);
+            free(args);
+        }
+
+        if (is_same)
+        {
+            literals[i] = CCNcopy(literal);
+            is_bound = true;
+        }
+    }
+    free(first_args);
+
+    if (is_bound)
+    {
+        find_removed_params(fundef, literals, removed);
+        bind_params(fundef, literals, removed);
+        for (size_t call = 0; call < info->call_count; call++)
+        {
+            drop_args(info->calls[call], removed);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (literals[i] != NULL)
+        {
+            CCNfree(literals[i]);
+        }
+    }
+    free(literals);
+    free(removed);
+}
+
+static void map_declarations(node_st *node, node_st *copy, htable_stptr map)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    release_assert(copy != NULL && NODE_TYPE(node) == NODE_TYPE(copy));
+    release_assert(node->num_children == copy->num_children);
+    enum ccn_nodetype type = NODE_TYPE(node);
+    if (type == NT_PARAMS || type == NT_VARDEC || type == NT_DIMENSIONVARS)
+    {
+        bool success = HTinsert(map, node, copy);
+        release_assert(success);
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        map_declarations(node->children[i], copy->children[i], map);
+    }
+}
+
+/// Creates the symbol table of a copied function, with the entries of the original mapped to
+/// their copy. Returns NULL if an entry is not a declaration of the function.
+static htable_stptr copy_symbols(node_st *fundef, node_st *copy)
+{
+    htable_stptr map = HTnew_Ptr(2 << 8);
+    map_declarations(fundef, copy, map);
+
+    htable_stptr symbols = HTnew_String(2 << 8);
+    bool is_complete = true;
+    for (htable_iter_st *iter = HTiterate(FUNDEF_SYMBOLS(fundef)); iter;
+         iter = HTiterateNext(iter))
+    {
+        char *key = HTiterKey(iter);
+        node_st *entry = HTiterValue(iter);
+        if (STReq(key, htable_parent_name))
+        {
+            bool success = HTinsert(symbols, htable_parent_name, entry);
+            release_assert(success);
+            continue;
+        }
+
+        node_st *entry_copy = HTlookup(map, entry);
+        if (entry_copy == NULL || !STReq(key, declared_name(entry_copy)))
+        {
+            is_complete = false;
+            HTiterateCancel(iter);
+            break;
+        }
+
+        // The copied declaration owns the key, like the declarations of the original
+        bool success = HTinsert(symbols, (char *)declared_name(entry_copy), entry_copy);
+        release_assert(success);
+    }
+
+    HTdelete(map);
+    if (!is_complete)
+    {
+        HTdelete(symbols);
+        return NULL;
+    }
+    return symbols;
+}
+
+/**
+ * Copies the function for the calls of the pattern with its parameters bound to their literals.
+ * The copy is inserted after the function and the calls are redirected to it. Functions with
+ * local functions are not copied, as their symbol tables would have to be copied with them.
+ */
+static bool specialize(struct call_pattern *pattern)
+{
+    struct function_info *info = &functions[pattern->function];
+    node_st *fundef = info->fundef;
+    node_st *copy = CCNcopy(fundef);
+    htable_stptr symbols = copy_symbols(fundef, copy);
+    if (symbols == NULL)
+    {
+        CCNfree(copy);
+        return false;
+    }
+
+    node_st *var = FUNHEADER_VAR(FUNDEF_FUNHEADER(copy));
+    char *name = STRfmt("@fun__spec%u_%s", clone_counter++, get_pretty_name(VAR_NAME(var)));
+    free(VAR_NAME(var));
+    VAR_NAME(var) = name;
+    FUNDEF_HAS_EXPORT(copy) = false;
+    FUNDEF_SYMBOLS(copy) = symbols;
+
+    size_t count = param_count(fundef);
+    node_st **literals = calloc(count == 0 ? 1 : count, sizeof(node_st *));
+    bool *removed = calloc(count == 0 ? 1 : count, sizeof(bool));
+    release_assert(literals != NULL && removed != NULL);
+    for (size_t i = 0; i < count; i++)
+    {
+        literals[i] = pattern->literals[i] == NULL ? NULL : CCNcopy(pattern->literals[i]);
+    }
+
+    find_removed_params(copy, literals, removed);
+    bind_params(copy, literals, removed);
+    for (size_t i = 0; i < pattern->call_count; i++)
+    {
+        node_st *call = pattern->calls[i];
+        free(VAR_NAME(PROCCALL_VAR(call)));
+        VAR_NAME(PROCCALL_VAR(call)) = STRcpy(name);
+        drop_args(call, removed);
+    }
+
+    bool success = symbol_keys_insert(info->scope, name, copy);
+    release_assert(success);
+    if (NODE_TYPE(info->list) == NT_DECLARATIONS)
+    {
+        DECLARATIONS_NEXT(info->list) = ASTdeclarations(copy, DECLARATIONS_NEXT(info->list));
+    }
+    else
+    {
+        release_assert(NODE_TYPE(info->list) == NT_LOCALFUNDEFS);
+        LOCALFUNDEFS_NEXT(info->list) = ASTlocalfundefs(copy, LOCALFUNDEFS_NEXT(info->list));
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (literals[i] != NULL)
+        {
+            CCNfree(literals[i]);
+        }
+    }
+    free(literals);
+    free(removed);
+    return true;
+}
+
+static bool has_same_literals(node_st **a, node_st **b, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((a[i] == NULL) != (b[i] == NULL) || (a[i] != NULL && !is_same_literal(a[i], b[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Groups the calls of the function by the literals they pass to the bindable parameters.
+static void collect_patterns(size_t function, struct call_pattern **patterns, size_t *pattern_count,
+                             size_t *pattern_capacity)
+{
+    struct function_info *info = &functions[function];
+    node_st *fundef = info->fundef;
+    size_t count = param_count(fundef);
+    size_t first_pattern = *pattern_count;
+    for (size_t call = 0; call < info->call_count; call++)
+    {
+        node_st **literals = call_args(info->calls[call], count);
+        bool has_literal = false;
+        size_t i = 0;
+        for (node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef)); params != NULL;
+             params = PARAMS_NEXT(params), i++)
+        {
+            if (!is_literal(literals[i]) || !is_bindable_param(params, FUNDEF_FUNBODY(fundef)))
+            {
+                literals[i] = NULL;
+            }
+            has_literal = has_literal || literals[i] != NULL;
+        }
+
+        if (!has_literal)
+        {
+            free(literals);
+            continue;
+        }
+
+        struct call_pattern *pattern = NULL;
+        for (size_t p = first_pattern; p < *pattern_count && pattern == NULL; p++)
+        {
+            if (has_same_literals((*patterns)[p].literals, literals, count))
+            {
+                pattern = &(*patterns)[p];
+            }
+        }
+
+        if (pattern == NULL)
+        {
+            if (*pattern_count == *pattern_capacity)
+            {
+                *pattern_capacity = *pattern_capacity == 0 ? 16 : *pattern_capacity * 2;
+                *patterns = realloc(*patterns, *pattern_capacity * sizeof(struct call_pattern));
+                release_assert(*patterns != NULL);
+            }
+            pattern = &(*patterns)[*pattern_count];
+            *pattern = (struct call_pattern){
+                .function = function,
+                .order = *pattern_count,
+                .literals = literals,
+                .calls = malloc(info->call_count * sizeof(node_st *)),
+            };
+            release_assert(pattern->calls != NULL);
+            (*pattern_count)++;
+        }
+        else
+        {
+            free(literals);
+        }
+
+        pattern->calls[pattern->call_count++] = info->calls[call];
+        pattern->weight += info->weights[call];
+    }
+}
+
+static int compare_patterns(const void *a, const void *b)
+{
+    const struct call_pattern *left = a;
+    const struct call_pattern *right = b;
+    if (left->weight != right->weight)
+    {
+        return left->weight > right->weight ? -1 : 1;
+    }
+    return left->order < right->order ? -1 : left->order > right->order ? 1 : 0;
+}
+
+/**
+ * Specializes the functions for the patterns of literal arguments, the patterns with the most
+ * calls first. A call in a loop weighs specialize_loop_call_weight. Each copy costs the node count
+ * of the function body, until global.specialize_limit is spent.
+ */
+static void specialize_patterns()
+{
+    struct call_pattern *patterns = NULL;
+    size_t pattern_count = 0;
+    size_t pattern_capacity = 0;
+    for (size_t i = 0; i < function_count; i++)
+    {
+        node_st *fundef = functions[i].fundef;
+        if (FUNBODY_LOCALFUNDEFS(FUNDEF_FUNBODY(fundef)) == NULL &&
+            !STReq(VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(fundef))), global_init_func))
+        {
+            collect_patterns(i, &patterns, &pattern_count, &pattern_capacity);
+        }
+    }
+
+    if (pattern_count > 0)
+    {
+        qsort(patterns, pattern_count, sizeof(struct call_pattern), compare_patterns);
+    }
+
+    long budget = global.specialize_limit;
+    for (size_t i = 0; i < pattern_count; i++)
+    {
+        long cost = node_count(FUNDEF_FUNBODY(functions[patterns[i].function].fundef));
+        if (cost <= budget && specialize(&patterns[i]))
+        {
+            budget -= cost;
+        }
+        free(patterns[i].literals);
+        free(patterns[i].calls);
+    }
+    free(patterns);
+}
+
+node_st *OPT_PSvar(node_st *node)
+{
+    release_assert(substituted_name != NULL);
+    release_assert(substituted_literal != NULL);
+    if (STReq(VAR_NAME(node), substituted_name))
+    {
+        CCNfree(node);
+        return CCNcopy(substituted_literal);
+    }
+    return node;
+}
+
+node_st *OPT_FSPproccall(node_st *node)
+{
+    TRAVchildren(node);
+
+    node_st *callee = deep_lookup(current, VAR_NAME(PROCCALL_VAR(node)));
+    if (callee == NULL || NODE_TYPE(callee) != NT_FUNDEF)
+    {
+        return node;
+    }
+
+    struct function_info *info = &functions[function_index(callee)];
+    if (info->call_count == info->call_capacity)
+    {
+        info->call_capacity = info->call_capacity == 0 ? 8 : info->call_capacity * 2;
+        info->calls = realloc(info->calls, info->call_capacity * sizeof(node_st *));
+        info->weights = realloc(info->weights, info->call_capacity * sizeof(long));
+        release_assert(info->calls != NULL && info->weights != NULL);
+    }
+    info->calls[info->call_count] = node;
+    info->weights[info->call_count] = loop_depth > 0 ? specialize_loop_call_weight : 1;
+    info->call_count++;
+    return node;
+}
+
+node_st *OPT_FSPwhileloop(node_st *node)
+{
+    loop_depth++;
+    TRAVchildren(node);
+    loop_depth--;
+    return node;
+}
+
+node_st *OPT_FSPdowhileloop(node_st *node)
+{
+    loop_depth++;
+    TRAVchildren(node);
+    loop_depth--;
+    return node;
+}
+
+node_st *OPT_FSPforloop(node_st *node)
+{
+    loop_depth++;
+    TRAVchildren(node);
+    loop_depth--;
+    return node;
+}
+
+node_st *OPT_FSPdeclarations(node_st *node)
+{
+    current_list = node;
+    TRAVopt(DECLARATIONS_DECL(node));
+    TRAVopt(DECLARATIONS_NEXT(node));
+    return node;
+}
+
+node_st *OPT_FSPlocalfundefs(node_st *node)
+{
+    current_list = node;
+    TRAVopt(LOCALFUNDEFS_LOCALFUNDEF(node));
+    TRAVopt(LOCALFUNDEFS_NEXT(node));
+    return node;
+}
+
+node_st *OPT_FSPfundef(node_st *node)
+{
+    struct function_info *info = &functions[function_index(node)];
+    info->list = current_list;
+    info->scope = current;
+
+    htable_stptr parent_current = current;
+    uint32_t parent_loop_depth = loop_depth;
+    current = FUNDEF_SYMBOLS(node);
+    release_assert(current != NULL);
+    loop_depth = 0;
+
+    TRAVchildren(node);
+
+    current = parent_current;
+    loop_depth = parent_loop_depth;
+    return node;
+}
+
+node_st *OPT_FSPprogram(node_st *node)
+{
+    reset_state();
+    current = PROGRAM_SYMBOLS(node);
+    function_indices = HTnew_Ptr(2 << 8);
+
+    TRAVchildren(node);
+
+    for (size_t i = 0; i < function_count; i++)
+    {
+        propagate_constants(&functions[i]);
+    }
+    specialize_patterns();
+
+    for (size_t i = 0; i < function_count; i++)
+    {
+        free(functions[i].calls);
+        free(functions[i].weights);
+    }
+    free(functions);
+    HTdelete(function_indices);
+    reset_state();
+    return node;
+}
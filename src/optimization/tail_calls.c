@@ -0,0 +1,400 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static _Thread_local node_st *fundef = NULL;
+static _Thread_local htable_stptr current = NULL;
+static _Thread_local enum BinOpType acc_op = BO_NULL;
+static _Thread_local uint32_t site_count = 0;
+
+static void reset_state()
+{
+    fundef = NULL;
+    current = NULL;
+    acc_op = BO_NULL;
+    site_count = 0;
+}
+
+/// Checks if the subtree uses the variable with the given name.
+static bool uses_var(node_st *node, const char *name)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR && STReq(VAR_NAME(node), name))
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (uses_var(node->children[i], name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Checks if the expression has no calls and only uses parameters and local variables, which can
+/// not be changed by the recursive call.
+static bool is_local_expr(node_st *node)
+{
+    if (node == NULL)
+    {
+        return true;
+    }
+
+    if (NODE_TYPE(node) == NT_PROCCALL ||
+        (NODE_TYPE(node) == NT_VAR && HTlookup(current, VAR_NAME(node)) == NULL))
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (!is_local_expr(node->children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_self_call(node_st *node)
+{
+    return NODE_TYPE(node) == NT_PROCCALL &&
+           STReq(VAR_NAME(PROCCALL_VAR(node)), VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(fundef))));
+}
+
+static bool always_returns(node_st *stmts)
+{
+    while (stmts != NULL && STATEMENTS_NEXT(stmts) != NULL)
+    {
+        stmts = STATEMENTS_NEXT(stmts);
+    }
+
+    if (stmts == NULL)
+    {
+        return false;
+    }
+
+    node_st *stmt = STATEMENTS_STMT(stmts);
+    return NODE_TYPE(stmt) == NT_RETSTATEMENT ||
+           (NODE_TYPE(stmt) == NT_IFSTATEMENT && always_returns(IFSTATEMENT_BLOCK(stmt)) &&
+            always_returns(IFSTATEMENT_ELSE_BLOCK(stmt)));
+}
+
+/// Moves the statements after an if, whose block always returns, into its else block. This
+/// brings the calls of early returns into a tail position.
+static void normalize_returns(node_st *stmts)
+{
+    while (stmts != NULL)
+    {
+        node_st *stmt = STATEMENTS_STMT(stmts);
+        if (NODE_TYPE(stmt) == NT_IFSTATEMENT)
+        {
+            normalize_returns(IFSTATEMENT_BLOCK(stmt));
+            normalize_returns(IFSTATEMENT_ELSE_BLOCK(stmt));
+            if (IFSTATEMENT_ELSE_BLOCK(stmt) == NULL && STATEMENTS_NEXT(stmts) != NULL &&
+                always_returns(IFSTATEMENT_BLOCK(stmt)))
+            {
+                IFSTATEMENT_ELSE_BLOCK(stmt) = STATEMENTS_NEXT(stmts);
+                STATEMENTS_NEXT(stmts) = NULL;
+                normalize_returns(IFSTATEMENT_ELSE_BLOCK(stmt));
+            }
+        }
+        stmts = STATEMENTS_NEXT(stmts);
+    }
+}
+
+/**
+ * Returns the recursive call of a tail call statement. This is 'return f(...);', 'f(...);' of a
+ * void function, or 'return e + f(...);' and 'return e * f(...);' of an int function, where 'e'
+ * is stored in the accumulator.
+ */
+static node_st *tail_call(node_st *stmt, node_st **operand)
+{
+    *operand = NULL;
+    if (NODE_TYPE(stmt) == NT_PROCCALL)
+    {
+        bool is_void = FUNHEADER_TYPE(FUNDEF_FUNHEADER(fundef)) == DT_void;
+        return is_void && is_self_call(stmt) ? stmt : NULL;
+    }
+    else if (NODE_TYPE(stmt) != NT_RETSTATEMENT || RETSTATEMENT_EXPR(stmt) == NULL)
+    {
+        return NULL;
+    }
+
+    node_st *expr = RETSTATEMENT_EXPR(stmt);
+    if (is_self_call(expr))
+    {
+        return expr;
+    }
+
+    if (NODE_TYPE(expr) != NT_BINOP || BINOP_ARGTYPE(expr) != DT_int ||
+        (BINOP_OP(expr) != BO_add && BINOP_OP(expr) != BO_mul) ||
+        (acc_op != BO_NULL && acc_op != BINOP_OP(expr)))
+    {
+        return NULL;
+    }
+
+    node_st *call = is_self_call(BINOP_RIGHT(expr)) ? BINOP_RIGHT(expr) : BINOP_LEFT(expr);
+    node_st *other = call == BINOP_RIGHT(expr) ? BINOP_LEFT(expr) : BINOP_RIGHT(expr);
+    if (!is_self_call(call) || !is_local_expr(other))
+    {
+        return NULL;
+    }
+
+    acc_op = BINOP_OP(expr);
+    *operand = other;
+    return call;
+}
+
+/// Returns the variable of a compiler generated local, which is declared on its first use.
+static node_st *tail_var(char *name, enum DataType type)
+{
+    if (HTlookup(current, name) == NULL)
+    {
+        node_st *vardec = ASTvardec(ASTvar(STRcpy(name)), NULL, type);
+        add_vardec(vardec, NULL, FUNDEF_FUNBODY(fundef));
+        bool success = HTinsert(current, VAR_NAME(VARDEC_VAR(vardec)), vardec);
+        release_assert(success);
+    }
+    return ASTvar(name);
+}
+
+/**
+ * Replaces a tail call by the assignment of its arguments to the parameters. An argument is
+ * stored in a temporary first, if a following argument uses the parameter.
+ *
+ * return n * f(n - 1, m); becomes:
+ * @tail_acc = @tail_acc * n; n = n - 1; @tail_call = true;
+ */
+static node_st *replace_tail_call(node_st *call, node_st *operand)
+{
+    node_st *first = NULL;
+    node_st *last = NULL;
+    if (operand != NULL)
+    {
+        node_st *acc = tail_var(STRcpy("@tail_acc"), DT_int);
+        node_st *expr = ASTbinop(CCNcopy(acc), CCNcopy(operand), acc_op, DT_int);
+        append_stmts(ASTstatements(ASTassign(acc, expr), NULL), &first, &last);
+    }
+
+    node_st *temps_first = NULL;
+    node_st *temps_last = NULL;
+    node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(fundef));
+    node_st *args = PROCCALL_EXPRS(call);
+    for (int i = 0; params != NULL && args != NULL; i++)
+    {
+        node_st *param = PARAMS_VAR(params);
+        node_st *arg = EXPRS_EXPR(args);
+        bool needs_temp = false;
+        for (node_st *next = EXPRS_NEXT(args); next != NULL; next = EXPRS_NEXT(next))
+        {
+            needs_temp = needs_temp || uses_var(EXPRS_EXPR(next), VAR_NAME(param));
+        }
+
+        if (needs_temp)
+        {
+            node_st *temp = tail_var(STRfmt("@tail_arg%d", i), PARAMS_TYPE(params));
+            append_stmts(ASTstatements(ASTassign(CCNcopy(temp), CCNcopy(arg)), NULL), &first,
+                         &last);
+            append_stmts(ASTstatements(ASTassign(CCNcopy(param), temp), NULL), &temps_first,
+                         &temps_last);
+        }
+        else if (NODE_TYPE(arg) != NT_VAR || !STReq(VAR_NAME(arg), VAR_NAME(param)))
+        {
+            append_stmts(ASTstatements(ASTassign(CCNcopy(param), CCNcopy(arg)), NULL), &first,
+                         &last);
+        }
+
+        params = PARAMS_NEXT(params);
+        args = EXPRS_NEXT(args);
+    }
+    release_assert(params == NULL && args == NULL);
+
+    if (temps_first != NULL)
+    {
+        append_stmts(temps_first, &first, &last);
+    }
+
+    node_st *flag = tail_var(STRcpy("@tail_call"), DT_bool);
+    append_stmts(ASTstatements(ASTassign(flag, ASTbool(true)), NULL), &first, &last);
+    return first;
+}
+
+/// Walks the tail positions of the statements, which are the last statement and the blocks of a
+/// last if statement. Counts the tail calls and replaces them if 'replace' is set.
+static node_st *tail_positions(node_st *stmts, bool replace)
+{
+    node_st *prev = NULL;
+    node_st *last = stmts;
+    while (last != NULL && STATEMENTS_NEXT(last) != NULL)
+    {
+        prev = last;
+        last = STATEMENTS_NEXT(last);
+    }
+
+    if (last == NULL)
+    {
+        return stmts;
+    }
+
+    node_st *stmt = STATEMENTS_STMT(last);
+    if (replace && NODE_TYPE(stmt) == NT_RETSTATEMENT && RETSTATEMENT_EXPR(stmt) == NULL)
+    {
+        // A return at the end of a void function does nothing, but hides a call before it
+        CCNfree(last);
+        if (prev == NULL)
+        {
+            return NULL;
+        }
+        STATEMENTS_NEXT(prev) = NULL;
+        return tail_positions(stmts, replace);
+    }
+    else if (!replace && NODE_TYPE(stmt) == NT_RETSTATEMENT && RETSTATEMENT_EXPR(stmt) == NULL &&
+             prev != NULL)
+    {
+        stmt = STATEMENTS_STMT(prev);
+    }
+
+    if (NODE_TYPE(stmt) == NT_IFSTATEMENT)
+    {
+        IFSTATEMENT_BLOCK(stmt) = tail_positions(IFSTATEMENT_BLOCK(stmt), replace);
+        IFSTATEMENT_ELSE_BLOCK(stmt) = tail_positions(IFSTATEMENT_ELSE_BLOCK(stmt), replace);
+        return stmts;
+    }
+
+    node_st *operand = NULL;
+    node_st *call = tail_call(stmt, &operand);
+    if (call == NULL)
+    {
+        return stmts;
+    }
+
+    site_count++;
+    if (!replace)
+    {
+        return stmts;
+    }
+
+    node_st *replacement = replace_tail_call(call, operand);
+    if (prev == NULL)
+    {
+        stmts = replacement;
+    }
+    else
+    {
+        STATEMENTS_NEXT(prev) = replacement;
+    }
+    CCNfree(last);
+    return stmts;
+}
+
+/// Adds the accumulator to the returned values, which were not replaced.
+static void accumulate_returns(node_st *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_RETSTATEMENT)
+    {
+        release_assert(RETSTATEMENT_EXPR(node) != NULL);
+        RETSTATEMENT_EXPR(node) =
+            ASTbinop(ASTvar(STRcpy("@tail_acc")), RETSTATEMENT_EXPR(node), acc_op, DT_int);
+        return;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        accumulate_returns(node->children[i]);
+    }
+}
+
+/**
+ * Turns the self tail calls of a function into a loop. The parameters are reassigned and the
+ * loop is repeated instead of calling the function.
+ *
+ * int fac(int n) { if (n == 0) { return 1; } return n * fac(n - 1); }
+ * becomes:
+ * int fac(int n) {
+ *     @tail_acc = 1;
+ *     do { @tail_call = false; if (n == 0) { return @tail_acc * 1; }
+ *          else { @tail_acc = @tail_acc * n; n = n - 1; @tail_call = true; }
+ *     } while (@tail_call);
+ * }
+ */
+node_st *OPT_TCfundef(node_st *node)
+{
+    TRAVchildren(node);
+
+    node_st *parent_fundef = fundef;
+    htable_stptr parent_current = current;
+    fundef = node;
+    current = FUNDEF_SYMBOLS(node);
+    acc_op = BO_NULL;
+    site_count = 0;
+
+    node_st *funbody = FUNDEF_FUNBODY(node);
+    char *name = VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(node)));
+    bool has_array_param = false;
+    for (node_st *params = FUNHEADER_PARAMS(FUNDEF_FUNHEADER(node)); params != NULL;
+         params = PARAMS_NEXT(params))
+    {
+        has_array_param = has_array_param || NODE_TYPE(PARAMS_VAR(params)) == NT_ARRAYVAR;
+    }
+
+    // Local functions could use the reassigned parameters
+    if (!has_array_param && FUNBODY_LOCALFUNDEFS(funbody) == NULL &&
+        !STReq(name, global_init_func) && calls_function(funbody, name))
+    {
+        normalize_returns(FUNBODY_STMTS(funbody));
+        tail_positions(FUNBODY_STMTS(funbody), false);
+    }
+
+    if (site_count > 0)
+    {
+        enum BinOpType op = acc_op;
+        acc_op = BO_NULL;
+        FUNBODY_STMTS(funbody) = tail_positions(FUNBODY_STMTS(funbody), true);
+        release_assert(acc_op == op);
+
+        node_st *flag = tail_var(STRcpy("@tail_call"), DT_bool);
+        node_st *block = ASTstatements(ASTassign(CCNcopy(flag), ASTbool(false)),
+                                       FUNBODY_STMTS(funbody));
+        node_st *loop = ASTstatements(ASTdowhileloop(block, flag), NULL);
+        if (acc_op != BO_NULL)
+        {
+            accumulate_returns(block);
+            node_st *acc = tail_var(STRcpy("@tail_acc"), DT_int);
+            node_st *init = ASTassign(acc, ASTint(acc_op == BO_mul ? 1 : 0));
+            loop = ASTstatements(init, loop);
+        }
+        FUNBODY_STMTS(funbody) = loop;
+    }
+
+    fundef = parent_fundef;
+    current = parent_current;
+    return node;
+}
+
+node_st *OPT_TCprogram(node_st *node)
+{
+    reset_state();
+    TRAVchildren(node);
+    return node;
+}
@@ -0,0 +1,981 @@
+#include "ccngen/ast.h"
+#include "definitions.h"
+#include "global/globals.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "user_types.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccn/phase_driver.h>
+#include <ccngen/enum.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Closed interval of the values of an int expression.
+struct interval
+{
+    long long low;
+    long long high;
+};
+
+/// Known interval of a local, a local without entry can have any value.
+struct range_entry
+{
+    const char *name;
+    struct interval range;
+};
+
+/// Known relation between two locals: left < right if strict, left <= right otherwise.
+struct range_fact
+{
+    const char *left;
+    const char *right;
+    bool strict;
+};
+
+/// Intervals and relations of the locals at a point of the function. The names are the names of
+/// the declarations, so they are compared by pointer.
+struct range_env
+{
+    struct range_entry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    struct range_fact *facts;
+    size_t fact_count;
+    size_t fact_capacity;
+};
+
+static const struct interval top = {INT_MIN, INT_MAX};
+
+static _Thread_local node_st *fundef = NULL;
+
+static void reset_state()
+{
+    fundef = NULL;
+}
+
+static bool is_top(struct interval range)
+{
+    return range.low <= INT_MIN && range.high >= INT_MAX;
+}
+
+/// Interval of an int operation, all values if the result can overflow.
+static struct interval checked(long long low, long long high)
+{
+    if (low < INT_MIN || high > INT_MAX)
+    {
+        return top;
+    }
+    return (struct interval){low, high};
+}
+
+static struct range_env *env_new()
+{
+    struct range_env *env = calloc(1, sizeof(struct range_env));
+    release_assert(env != NULL);
+    return env;
+}
+
+static struct range_env *env_copy(struct range_env *env)
+{
+    struct range_env *copy = env_new();
+    copy->entry_count = env->entry_count;
+    copy->entry_capacity = env->entry_count;
+    copy->fact_count = env->fact_count;
+    copy->fact_capacity = env->fact_count;
+    if (env->entry_count > 0)
+    {
+        copy->entries = malloc(env->entry_count * sizeof(struct range_entry));
+        release_assert(copy->entries != NULL);
+        memcpy(copy->entries, env->entries, env->entry_count * sizeof(struct range_entry));
+    }
+    if (env->fact_count > 0)
+    {
+        copy->facts = malloc(env->fact_count * sizeof(struct range_fact));
+        release_assert(copy->facts != NULL);
+        memcpy(copy->facts, env->facts, env->fact_count * sizeof(struct range_fact));
+    }
+    return copy;
+}
+
+static void env_free(struct range_env *env)
+{
+    free(env->entries);
+    free(env->facts);
+    free(env);
+}
+
+/// Moves the content of source into target and frees source.
+static void env_move(struct range_env *target, struct range_env *source)
+{
+    free(target->entries);
+    free(target->facts);
+    *target = *source;
+    free(source);
+}
+
+static struct range_entry *env_entry(struct range_env *env, const char *name)
+{
+    for (size_t i = 0; i < env->entry_count; i++)
+    {
+        if (env->entries[i].name == name)
+        {
+            return &env->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void env_set(struct range_env *env, const char *name, struct interval range)
+{
+    struct range_entry *entry = env_entry(env, name);
+    if (entry != NULL)
+    {
+        entry->range = range;
+        return;
+    }
+
+    if (env->entry_count == env->entry_capacity)
+    {
+        env->entry_capacity = env->entry_capacity == 0 ? 8 : env->entry_capacity * 2;
+        env->entries = realloc(env->entries, env->entry_capacity * sizeof(struct range_entry));
+        release_assert(env->entries != NULL);
+    }
+    env->entries[env->entry_count++] = (struct range_entry){name, range};
+}
+
+static void env_add_fact(struct range_env *env, const char *left, const char *right, bool strict)
+{
+    if (left == right || env->fact_count >= range_max_facts)
+    {
+        return;
+    }
+
+    if (env->fact_count == env->fact_capacity)
+    {
+        env->fact_capacity = env->fact_capacity == 0 ? 8 : env->fact_capacity * 2;
+        env->facts = realloc(env->facts, env->fact_capacity * sizeof(struct range_fact));
+        release_assert(env->facts != NULL);
+    }
+    env->facts[env->fact_count++] = (struct range_fact){left, right, strict};
+}
+
+/// Forgets the interval and the relations of the local, e.g. because it is assigned.
+static void env_forget(struct range_env *env, const char *name)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < env->entry_count; i++)
+    {
+        if (env->entries[i].name != name)
+        {
+            env->entries[kept++] = env->entries[i];
+        }
+    }
+    env->entry_count = kept;
+
+    kept = 0;
+    for (size_t i = 0; i < env->fact_count; i++)
+    {
+        if (env->facts[i].left != name && env->facts[i].right != name)
+        {
+            env->facts[kept++] = env->facts[i];
+        }
+    }
+    env->fact_count = kept;
+}
+
+/// Keeps what holds on both paths in target and frees other.
+static void env_join(struct range_env *target, struct range_env *other)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < target->entry_count; i++)
+    {
+        struct range_entry *entry = env_entry(other, target->entries[i].name);
+        if (entry == NULL)
+        {
+            continue;
+        }
+
+        struct interval range = target->entries[i].range;
+        range.low = range.low < entry->range.low ? range.low : entry->range.low;
+        range.high = range.high > entry->range.high ? range.high : entry->range.high;
+        target->entries[kept++] = (struct range_entry){target->entries[i].name, range};
+    }
+    target->entry_count = kept;
+
+    kept = 0;
+    for (size_t i = 0; i < target->fact_count; i++)
+    {
+        struct range_fact fact = target->facts[i];
+        bool found = false;
+        bool strict = false;
+        for (size_t k = 0; k < other->fact_count; k++)
+        {
+            if (other->facts[k].left == fact.left && other->facts[k].right == fact.right)
+            {
+                found = true;
+                strict = strict || other->facts[k].strict;
+            }
+        }
+        if (found)
+        {
+            fact.strict = fact.strict && strict;
+            target->facts[kept++] = fact;
+        }
+    }
+    target->fact_count = kept;
+    env_free(other);
+}
+
+/// Checks if the node writes the local, also as the fill index of an ArrayBulkAssign.
+static bool is_written(node_st *node, const char *name)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+    if (NODE_TYPE(node) == NT_ASSIGN && STReq(VAR_NAME(ASSIGN_VAR(node)), name))
+    {
+        return true;
+    }
+    if (NODE_TYPE(node) == NT_ARRAYBULKASSIGN && ARRAYBULKASSIGN_INDEX(node) != NULL &&
+        STReq(VAR_NAME(ARRAYBULKASSIGN_INDEX(node)), name))
+    {
+        return true;
+    }
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (is_written(node->children[i], name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Forgets the locals written in the loop, so the env holds at the start of every iteration. The
+/// forgotten local has no entry or fact left, so the ones before the index stay unchanged.
+static void env_widen(struct range_env *env, node_st *loop)
+{
+    size_t i = 0;
+    while (i < env->entry_count)
+    {
+        const char *name = env->entries[i].name;
+        if (is_written(loop, name))
+        {
+            env_forget(env, name);
+            continue;
+        }
+        i++;
+    }
+
+    i = 0;
+    while (i < env->fact_count)
+    {
+        struct range_fact fact = env->facts[i];
+        if (is_written(loop, fact.left))
+        {
+            env_forget(env, fact.left);
+            continue;
+        }
+        if (is_written(loop, fact.right))
+        {
+            env_forget(env, fact.right);
+            continue;
+        }
+        i++;
+    }
+}
+
+/// Checks if the facts prove left < right, or left <= right if not strict.
+static bool is_less(struct range_env *env, const char *left, const char *right, bool strict,
+                    int depth)
+{
+    for (size_t i = 0; i < env->fact_count; i++)
+    {
+        struct range_fact fact = env->facts[i];
+        if (fact.left != left)
+        {
+            continue;
+        }
+
+        bool rest_strict = strict && !fact.strict;
+        if (fact.right == right && !rest_strict)
+        {
+            return true;
+        }
+        if (depth > 0 && is_less(env, fact.right, right, rest_strict, depth - 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Gets the name of the declaration of a tracked local, NULL if the variable is not tracked. Only
+/// the scalar int locals of the function are tracked, which no local function writes.
+static const char *tracked_name(node_st *expr)
+{
+    if (NODE_TYPE(expr) != NT_VAR)
+    {
+        return NULL;
+    }
+
+    node_st *entry = HTlookup(FUNDEF_SYMBOLS(fundef), VAR_NAME(expr));
+    if (entry == NULL || NODE_TYPE(entry) == NT_FUNDEF || NODE_TYPE(entry) == NT_FUNDEC ||
+        symbol_to_type(entry) != DT_int)
+    {
+        return NULL;
+    }
+
+    node_st *var = get_var_from_symbol(entry);
+    if (NODE_TYPE(var) != NT_VAR)
+    {
+        return NULL;
+    }
+
+    node_st *local_fundefs = FUNBODY_LOCALFUNDEFS(FUNDEF_FUNBODY(fundef));
+    if (is_written(local_fundefs, VAR_NAME(var)))
+    {
+        return NULL;
+    }
+    return VAR_NAME(var);
+}
+
+static bool has_call(node_st *node)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+    if (NODE_TYPE(node) == NT_PROCCALL)
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (has_call(node->children[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static struct interval eval(node_st *expr, struct range_env *env)
+{
+    switch (NODE_TYPE(expr))
+    {
+    case NT_INT:
+        return (struct interval){INT_VAL(expr), INT_VAL(expr)};
+    case NT_VAR: {
+        const char *name = tracked_name(expr);
+        if (name == NULL)
+        {
+            return top;
+        }
+
+        struct range_entry *entry = env_entry(env, name);
+        if (entry != NULL)
+        {
+            return entry->range;
+        }
+
+        // The dimensions of array parameters are sizes
+        node_st *symbol = HTlookup(FUNDEF_SYMBOLS(fundef), VAR_NAME(expr));
+        if (NODE_TYPE(symbol) == NT_DIMENSIONVARS && !is_written(FUNDEF_FUNBODY(fundef), name))
+        {
+            return (struct interval){0, INT_MAX};
+        }
+        return top;
+    }
+    case NT_MONOP:
+        if (MONOP_OP(expr) != MO_neg)
+        {
+            return top;
+        }
+        {
+            struct interval left = eval(MONOP_LEFT(expr), env);
+            return checked(-left.high, -left.low);
+        }
+    case NT_TERNARY: {
+        struct interval ptrue = eval(TERNARY_PTRUE(expr), env);
+        struct interval pfalse = eval(TERNARY_PFALSE(expr), env);
+        return (struct interval){ptrue.low < pfalse.low ? ptrue.low : pfalse.low,
+                                 ptrue.high > pfalse.high ? ptrue.high : pfalse.high};
+    }
+    case NT_BINOP:
+        break;
+    default:
+        return top;
+    }
+
+    if (BINOP_ARGTYPE(expr) != DT_int)
+    {
+        return top;
+    }
+
+    struct interval left = eval(BINOP_LEFT(expr), env);
+    struct interval right = eval(BINOP_RIGHT(expr), env);
+    switch (BINOP_OP(expr))
+    {
+    case BO_add:
+        return checked(left.low + right.low, left.high + right.high);
+    case BO_sub:
+        return checked(left.low - right.high, left.high - right.low);
+    case BO_mul: {
+        long long products[] = {left.low * right.low, left.low * right.high,
+                                left.high * right.low, left.high * right.high};
+        long long low = products[0];
+        long long high = products[0];
+        for (int i = 1; i < 4; i++)
+        {
+            low = products[i] < low ? products[i] : low;
+            high = products[i] > high ? products[i] : high;
+        }
+        return checked(low, high);
+    }
+    case BO_div: {
+        if (right.low <= 0 && right.high >= 0)
+        {
+            return top;
+        }
+        // The truncating division is monotonic on divisors of one sign
+        long long quotients[] = {left.low / right.low, left.low / right.high,
+                                 left.high / right.low, left.high / right.high};
+        long long low = quotients[0];
+        long long high = quotients[0];
+        for (int i = 1; i < 4; i++)
+        {
+            low = quotients[i] < low ? quotients[i] : low;
+            high = quotients[i] > high ? quotients[i] : high;
+        }
+        return checked(low, high);
+    }
+    case BO_mod:
+        if (right.low != right.high || right.low <= 0)
+        {
+            return top;
+        }
+        if (left.low >= 0)
+        {
+            return (struct interval){0, left.high < right.low - 1 ? left.high : right.low - 1};
+        }
+        return (struct interval){-(right.low - 1), right.low - 1};
+    default:
+        return top;
+    }
+}
+
+/// Gets the relation of right and left if the operands are swapped.
+static enum BinOpType mirror(enum BinOpType op)
+{
+    switch (op)
+    {
+    case BO_lt:
+        return BO_gt;
+    case BO_le:
+        return BO_ge;
+    case BO_gt:
+        return BO_lt;
+    case BO_ge:
+        return BO_le;
+    default:
+        return op;
+    }
+}
+
+static enum BinOpType negate(enum BinOpType op)
+{
+    switch (op)
+    {
+    case BO_lt:
+        return BO_ge;
+    case BO_le:
+        return BO_gt;
+    case BO_gt:
+        return BO_le;
+    case BO_ge:
+        return BO_lt;
+    case BO_eq:
+        return BO_ne;
+    case BO_ne:
+        return BO_eq;
+    default:
+        release_assert(false);
+        return op;
+    }
+}
+
+static bool is_relation(node_st *expr)
+{
+    if (NODE_TYPE(expr) != NT_BINOP || BINOP_ARGTYPE(expr) != DT_int)
+    {
+        return false;
+    }
+
+    switch (BINOP_OP(expr))
+    {
+    case BO_lt:
+    case BO_le:
+    case BO_gt:
+    case BO_ge:
+    case BO_eq:
+    case BO_ne:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Decides 'left op right' by the intervals and the facts. Returns 1 if it always holds, 0 if it
+/// never holds and -1 if it is unknown.
+static int decide(enum BinOpType op, node_st *left, node_st *right, struct range_env *env)
+{
+    struct interval l = eval(left, env);
+    struct interval r = eval(right, env);
+    const char *a = tracked_name(left);
+    const char *b = tracked_name(right);
+    bool facts = a != NULL && b != NULL;
+    switch (op)
+    {
+    case BO_gt:
+        return decide(BO_lt, right, left, env);
+    case BO_ge:
+        return decide(BO_le, right, left, env);
+    case BO_lt:
+        if (l.high < r.low || (facts && is_less(env, a, b, true, range_fact_depth)))
+        {
+            return 1;
+        }
+        if (l.low >= r.high || (facts && is_less(env, b, a, false, range_fact_depth)))
+        {
+            return 0;
+        }
+        return -1;
+    case BO_le:
+        if (l.high <= r.low || (facts && is_less(env, a, b, false, range_fact_depth)))
+        {
+            return 1;
+        }
+        if (l.low > r.high || (facts && is_less(env, b, a, true, range_fact_depth)))
+        {
+            return 0;
+        }
+        return -1;
+    case BO_eq:
+        if (l.low == l.high && r.low == r.high && l.low == r.low)
+        {
+            return 1;
+        }
+        if (l.high < r.low || r.high < l.low ||
+            (facts && (is_less(env, a, b, true, range_fact_depth) ||
+                       is_less(env, b, a, true, range_fact_depth))))
+        {
+            return 0;
+        }
+        return -1;
+    case BO_ne: {
+        int equal = decide(BO_eq, left, right, env);
+        return equal < 0 ? -1 : !equal;
+    }
+    default:
+        return -1;
+    }
+}
+
+/// Narrows the interval of the local to the values for which 'local op range' holds.
+static void restrict_local(struct range_env *env, node_st *var, enum BinOpType op,
+                           struct interval range)
+{
+    const char *name = tracked_name(var);
+    if (name == NULL)
+    {
+        return;
+    }
+
+    struct interval current = eval(var, env);
+    switch (op)
+    {
+    case BO_lt:
+        current.high = current.high < range.high - 1 ? current.high : range.high - 1;
+        break;
+    case BO_le:
+        current.high = current.high < range.high ? current.high : range.high;
+        break;
+    case BO_gt:
+        current.low = current.low > range.low + 1 ? current.low : range.low + 1;
+        break;
+    case BO_ge:
+        current.low = current.low > range.low ? current.low : range.low;
+        break;
+    case BO_eq:
+        current.low = current.low > range.low ? current.low : range.low;
+        current.high = current.high < range.high ? current.high : range.high;
+        break;
+    case BO_ne:
+        if (range.low == range.high && current.low == range.low)
+        {
+            current.low++;
+        }
+        else if (range.low == range.high && current.high == range.low)
+        {
+            current.high--;
+        }
+        break;
+    default:
+        return;
+    }
+
+    // An empty interval is an unreachable path, which is left to the other optimizations
+    if (current.low <= current.high && !is_top(current))
+    {
+        env_set(env, name, current);
+    }
+}
+
+/// Narrows the env to the values for which the condition has the given truth value.
+static void refine(struct range_env *env, node_st *cond, bool truth)
+{
+    switch (NODE_TYPE(cond))
+    {
+    case NT_MONOP:
+        if (MONOP_OP(cond) == MO_not)
+        {
+            refine(env, MONOP_LEFT(cond), !truth);
+        }
+        return;
+    case NT_TERNARY: {
+        // a && b is a ? b : false and a || b is a ? true : b
+        node_st *ptrue = TERNARY_PTRUE(cond);
+        node_st *pfalse = TERNARY_PFALSE(cond);
+        if (truth && NODE_TYPE(pfalse) == NT_BOOL && !BOOL_VAL(pfalse))
+        {
+            refine(env, TERNARY_PRED(cond), true);
+            refine(env, ptrue, true);
+        }
+        else if (!truth && NODE_TYPE(ptrue) == NT_BOOL && BOOL_VAL(ptrue))
+        {
+            refine(env, TERNARY_PRED(cond), false);
+            refine(env, pfalse, false);
+        }
+        return;
+    }
+    case NT_BINOP:
+        break;
+    default:
+        return;
+    }
+
+    if (!is_relation(cond) || has_call(cond))
+    {
+        return;
+    }
+
+    enum BinOpType op = truth ? BINOP_OP(cond) : negate(BINOP_OP(cond));
+    node_st *left = BINOP_LEFT(cond);
+    node_st *right = BINOP_RIGHT(cond);
+    struct interval l = eval(left, env);
+    struct interval r = eval(right, env);
+    restrict_local(env, left, op, r);
+    restrict_local(env, right, mirror(op), l);
+
+    const char *a = tracked_name(left);
+    const char *b = tracked_name(right);
+    if (a == NULL || b == NULL)
+    {
+        return;
+    }
+    switch (op)
+    {
+    case BO_lt:
+        env_add_fact(env, a, b, true);
+        break;
+    case BO_le:
+        env_add_fact(env, a, b, false);
+        break;
+    case BO_gt:
+        env_add_fact(env, b, a, true);
+        break;
+    case BO_ge:
+        env_add_fact(env, b, a, false);
+        break;
+    case BO_eq:
+        env_add_fact(env, a, b, false);
+        env_add_fact(env, b, a, false);
+        break;
+    default:
+        break;
+    }
+}
+
+/// Replaces the relations with a known outcome by their Bool literal.
+static node_st *simplify(node_st *expr, struct range_env *env)
+{
+    switch (NODE_TYPE(expr))
+    {
+    case NT_BINOP:
+        BINOP_LEFT(expr) = simplify(BINOP_LEFT(expr), env);
+        BINOP_RIGHT(expr) = simplify(BINOP_RIGHT(expr), env);
+        break;
+    case NT_MONOP:
+        MONOP_LEFT(expr) = simplify(MONOP_LEFT(expr), env);
+        return expr;
+    case NT_CAST:
+        CAST_EXPR(expr) = simplify(CAST_EXPR(expr), env);
+        return expr;
+    case NT_TERNARY: {
+        TERNARY_PRED(expr) = simplify(TERNARY_PRED(expr), env);
+        struct range_env *true_env = env_copy(env);
+        refine(true_env, TERNARY_PRED(expr), true);
+        TERNARY_PTRUE(expr) = simplify(TERNARY_PTRUE(expr), true_env);
+        env_free(true_env);
+        struct range_env *false_env = env_copy(env);
+        refine(false_env, TERNARY_PRED(expr), false);
+        TERNARY_PFALSE(expr) = simplify(TERNARY_PFALSE(expr), false_env);
+        env_free(false_env);
+        return expr;
+    }
+    case NT_PROCCALL:
+        for (node_st *exprs = PROCCALL_EXPRS(expr); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+        {
+            EXPRS_EXPR(exprs) = simplify(EXPRS_EXPR(exprs), env);
+        }
+        return expr;
+    case NT_ARRAYEXPR:
+        for (node_st *exprs = ARRAYEXPR_DIMS(expr); exprs != NULL; exprs = EXPRS_NEXT(exprs))
+        {
+            EXPRS_EXPR(exprs) = simplify(EXPRS_EXPR(exprs), env);
+        }
+        return expr;
+    default:
+        return expr;
+    }
+
+    if (!is_relation(expr) || has_call(expr))
+    {
+        return expr;
+    }
+
+    int outcome = decide(BINOP_OP(expr), BINOP_LEFT(expr), BINOP_RIGHT(expr), env);
+    if (outcome < 0)
+    {
+        return expr;
+    }
+
+    node_st *literal = ASTbool(outcome == 1);
+    NODE_BLINE(literal) = NODE_BLINE(expr);
+    NODE_BCOL(literal) = NODE_BCOL(expr);
+    NODE_ELINE(literal) = NODE_ELINE(expr);
+    NODE_ECOL(literal) = NODE_ECOL(expr);
+    if (NODE_FILENAME(expr) != NULL)
+    {
+        NODE_FILENAME(literal) = STRcpy(NODE_FILENAME(expr));
+    }
+    CCNfree(expr);
+    CCNcycleNotify();
+    return literal;
+}
+
+static void assign_local(struct range_env *env, node_st *var, node_st *expr)
+{
+    const char *name = tracked_name(var);
+    if (name == NULL)
+    {
+        return;
+    }
+
+    // The value is evaluated before the assignment, as it can read the local itself
+    struct interval range = eval(expr, env);
+    const char *source = tracked_name(expr);
+    env_forget(env, name);
+    if (!is_top(range))
+    {
+        env_set(env, name, range);
+    }
+    if (source != NULL && source != name)
+    {
+        env_add_fact(env, name, source, false);
+        env_add_fact(env, source, name, false);
+    }
+}
+
+static void walk_stmts(node_st *stmts, struct range_env *env);
+
+/**
+ * Seeds the interval of the loop iterator from the bounds. The iterator stays below the end for a
+ * positive step and above it for a negative step, and it does not wrap around if the step past
+ * the last iteration does not overflow:
+ *
+ * for (int i = 0, n) { ... } gives i in [0, INT_MAX - 1] and i < n in the body.
+ */
+static void walk_forloop(node_st *loop, struct range_env *env)
+{
+    node_st *assign = FORLOOP_ASSIGN(loop);
+    node_st *block = FORLOOP_BLOCK(loop);
+    ASSIGN_EXPR(assign) = simplify(ASSIGN_EXPR(assign), env);
+    struct interval start = eval(ASSIGN_EXPR(assign), env);
+    node_st *start_var = ASSIGN_EXPR(assign);
+    bool start_kept = tracked_name(start_var) != NULL &&
+                      !is_written(block, tracked_name(start_var)) &&
+                      !STReq(VAR_NAME(start_var), VAR_NAME(ASSIGN_VAR(assign)));
+
+    // The end and the step are read in every iteration
+    env_widen(env, loop);
+    struct interval end = eval(FORLOOP_COND(loop), env);
+    struct interval step =
+        FORLOOP_ITER(loop) == NULL ? (struct interval){1, 1} : eval(FORLOOP_ITER(loop), env);
+    const char *iterator = tracked_name(ASSIGN_VAR(assign));
+    const char *end_name = tracked_name(FORLOOP_COND(loop));
+    if (end_name != NULL && is_written(block, end_name))
+    {
+        end_name = NULL;
+    }
+
+    struct range_env *body_env = env_copy(env);
+    if (iterator != NULL && step.low == step.high && step.low != 0 &&
+        !is_written(block, iterator))
+    {
+        long long c = step.low;
+        if (c > 0 && end.high - 1 + c <= INT_MAX && start.low <= end.high - 1)
+        {
+            env_set(body_env, iterator, (struct interval){start.low, end.high - 1});
+            if (end_name != NULL)
+            {
+                env_add_fact(body_env, iterator, end_name, true);
+            }
+            if (start_kept)
+            {
+                env_add_fact(body_env, tracked_name(start_var), iterator, false);
+            }
+        }
+        else if (c < 0 && end.low + 1 + c >= INT_MIN && end.low + 1 <= start.high)
+        {
+            env_set(body_env, iterator, (struct interval){end.low + 1, start.high});
+            if (end_name != NULL)
+            {
+                env_add_fact(body_env, end_name, iterator, true);
+            }
+            if (start_kept)
+            {
+                env_add_fact(body_env, iterator, tracked_name(start_var), false);
+            }
+        }
+    }
+    walk_stmts(block, body_env);
+    env_free(body_env);
+}
+
+static void walk_stmt(node_st *stmt, struct range_env *env)
+{
+    switch (NODE_TYPE(stmt))
+    {
+    case NT_ASSIGN:
+        ASSIGN_EXPR(stmt) = simplify(ASSIGN_EXPR(stmt), env);
+        assign_local(env, ASSIGN_VAR(stmt), ASSIGN_EXPR(stmt));
+        break;
+    case NT_PROCCALL:
+        simplify(stmt, env);
+        break;
+    case NT_ARRAYASSIGN:
+        simplify(ARRAYASSIGN_VAR(stmt), env);
+        ARRAYASSIGN_EXPR(stmt) = simplify(ARRAYASSIGN_EXPR(stmt), env);
+        break;
+    case NT_ARRAYBULKASSIGN:
+        if (ARRAYBULKASSIGN_INDEX(stmt) != NULL)
+        {
+            const char *index = tracked_name(ARRAYBULKASSIGN_INDEX(stmt));
+            env_forget(env, index);
+        }
+        break;
+    case NT_RETSTATEMENT:
+        if (RETSTATEMENT_EXPR(stmt) != NULL)
+        {
+            RETSTATEMENT_EXPR(stmt) = simplify(RETSTATEMENT_EXPR(stmt), env);
+        }
+        break;
+    case NT_IFSTATEMENT: {
+        IFSTATEMENT_EXPR(stmt) = simplify(IFSTATEMENT_EXPR(stmt), env);
+        struct range_env *else_env = env_copy(env);
+        refine(env, IFSTATEMENT_EXPR(stmt), true);
+        refine(else_env, IFSTATEMENT_EXPR(stmt), false);
+        walk_stmts(IFSTATEMENT_BLOCK(stmt), env);
+        walk_stmts(IFSTATEMENT_ELSE_BLOCK(stmt), else_env);
+        env_join(env, else_env);
+    }
+    break;
+    case NT_WHILELOOP: {
+        env_widen(env, stmt);
+        WHILELOOP_EXPR(stmt) = simplify(WHILELOOP_EXPR(stmt), env);
+        struct range_env *body_env = env_copy(env);
+        refine(body_env, WHILELOOP_EXPR(stmt), true);
+        walk_stmts(WHILELOOP_BLOCK(stmt), body_env);
+        env_free(body_env);
+        refine(env, WHILELOOP_EXPR(stmt), false);
+    }
+    break;
+    case NT_DOWHILELOOP: {
+        // The condition is checked at the end of an iteration, which starts in the widened env
+        env_widen(env, stmt);
+        struct range_env *body_env = env_copy(env);
+        walk_stmts(DOWHILELOOP_BLOCK(stmt), body_env);
+        DOWHILELOOP_EXPR(stmt) = simplify(DOWHILELOOP_EXPR(stmt), body_env);
+        refine(body_env, DOWHILELOOP_EXPR(stmt), false);
+        env_move(env, body_env);
+    }
+    break;
+    case NT_FORLOOP:
+        walk_forloop(stmt, env);
+        break;
+    default:
+        break;
+    }
+}
+
+static void walk_stmts(node_st *stmts, struct range_env *env)
+{
+    for (; stmts != NULL; stmts = STATEMENTS_NEXT(stmts))
+    {
+        walk_stmt(STATEMENTS_STMT(stmts), env);
+    }
+}
+
+node_st *OPT_VRfundef(node_st *node)
+{
+    TRAVchildren(node);
+
+    node_st *parent_fundef = fundef;
+    fundef = node;
+    struct range_env *env = env_new();
+    walk_stmts(FUNBODY_STMTS(FUNDEF_FUNBODY(node)), env);
+    env_free(env);
+    fundef = parent_fundef;
+    return node;
+}
+
+/**
+ * Computes the integer intervals of the locals from the literals, the for loop bounds and the
+ * conditions of the enclosing branches, and replaces the comparisons with a known outcome by
+ * their Bool literal. The branch evaluation then removes the dead arms and the constant folding
+ * folds the resulting expressions.
+ *
+ * for (int i = 0, n) { if (i >= 0 && i < n) { a[i] = 0; } } becomes:
+ * for (int i = 0, n) { if (true ? true : false) { a[i] = 0; } }
+ */
+node_st *OPT_VRprogram(node_st *node)
+{
+    if (!global.value_ranges_enabled)
+    {
+        return node;
+    }
+
+    reset_state();
+    TRAVchildren(node);
+    reset_state();
+    return node;
+}
@@ -439,6 +439,15 @@ node_st *PRTarrayassign(node_st *node)
     return node;
 }
 
+node_st *PRTarraybulkassign(node_st *node)
+{
+    TRAVvar(node);
+    printf(" = [");
+    TRAVvalues(node);
+    printf("]");
+    return node;
+}
+
 node_st *PRTint(node_st *node)
 {
     printf("%d", INT_VAL(node));
@@ -0,0 +1,410 @@
+#include "profiler.h"
+#include "ccn/action_types.h"
+#include "ccn/phase_driver.h"
+#include "ccngen/ast.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/// State of the compilation at the start or end of an action.
+struct snapshot
+{
+    uint64_t time; // Nanoseconds since profiler_start without the time spent in the profiler
+    size_t nodes;
+    size_t allocations;
+    size_t allocated_bytes;
+    size_t notifications;
+};
+
+struct profile_event
+{
+    char *name;
+    const char *category;
+    size_t depth;
+    bool finished;
+    struct snapshot begin;
+    struct snapshot end;
+};
+
+/// Action that has started but not yet ended.
+struct open_action
+{
+    size_t event;
+    size_t iteration_count;
+    struct snapshot iteration; // Start of the current iteration of a cycle phase
+};
+
+/// Totals of the actions with the same name.
+struct action_total
+{
+    const char *name;
+    const char *category;
+    size_t depth;
+    size_t calls;
+    uint64_t duration;
+    size_t nodes_before;
+    size_t nodes_after;
+    size_t allocations;
+    size_t allocated_bytes;
+    size_t notifications;
+};
+
+static _Thread_local struct profile_event *events = NULL;
+static _Thread_local size_t event_count = 0;
+static _Thread_local size_t event_capacity = 0;
+static _Thread_local struct open_action *open_actions = NULL;
+static _Thread_local size_t open_count = 0;
+static _Thread_local size_t open_capacity = 0;
+static _Thread_local uint64_t origin = 0;
+static _Thread_local uint64_t overhead = 0; // Time spent in the profiler
+static _Thread_local bool running = false;
+static _Thread_local bool in_profiler = false; // Excludes the allocations of the profiler
+
+// Counted by the allocation wrappers of the civicc executable, see profiler_allocations.c. The
+// workers of the scheduler count their own allocations, which are added to the thread that joins
+// them.
+static atomic_int profiling_threads = 0;
+static _Thread_local size_t allocation_count = 0;
+static _Thread_local size_t allocated_bytes = 0;
+
+void profiler_count_allocation(size_t size)
+{
+    if (atomic_load_explicit(&profiling_threads, memory_order_relaxed) > 0 && !in_profiler)
+    {
+        allocation_count++;
+        allocated_bytes += size;
+    }
+}
+
+struct profiler_allocations profiler_take_allocations(void)
+{
+    struct profiler_allocations allocations = {
+        .count = allocation_count,
+        .bytes = allocated_bytes,
+    };
+    allocation_count = 0;
+    allocated_bytes = 0;
+    return allocations;
+}
+
+void profiler_add_allocations(struct profiler_allocations allocations)
+{
+    allocation_count += allocations.count;
+    allocated_bytes += allocations.bytes;
+}
+
+static uint64_t now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+static size_t count_nodes(node_st *node)
+{
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    size_t count = 1;
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        count += count_nodes(node->children[i]);
+    }
+    return count;
+}
+
+/// Takes a snapshot of the tree, the time spent counting the nodes is excluded from the durations.
+static struct snapshot take_snapshot(node_st *node)
+{
+    uint64_t start = now();
+    struct snapshot snapshot = {
+        .time = start - origin - overhead,
+        .nodes = count_nodes(node),
+        .allocations = allocation_count,
+        .allocated_bytes = allocated_bytes,
+        .notifications = phase_driver.cycle_notifications,
+    };
+    overhead += now() - start;
+    return snapshot;
+}
+
+static size_t add_event(char *name, const char *category, struct snapshot *begin)
+{
+    if (event_count == event_capacity)
+    {
+        event_capacity = event_capacity == 0 ? 256 : event_capacity * 2;
+        events = realloc(events, event_capacity * sizeof(struct profile_event));
+        release_assert(events != NULL);
+    }
+
+    struct profile_event *event = &events[event_count];
+    event->name = name;
+    event->category = category;
+    event->depth = open_count;
+    event->finished = false;
+    event->begin = *begin;
+    return event_count++;
+}
+
+static const char *action_category(struct ccn_action *action)
+{
+    switch (action->type)
+    {
+    case CCN_ACTION_PHASE:
+        return "phase";
+    case CCN_ACTION_TRAVERSAL:
+        return "traversal";
+    case CCN_ACTION_PASS:
+        return "pass";
+    default:
+        return "action";
+    }
+}
+
+static void action_start(struct ccn_action *action, node_st *node)
+{
+    in_profiler = true;
+    struct snapshot begin = take_snapshot(node);
+    size_t event = add_event(STRcpy(action->name), action_category(action), &begin);
+
+    if (open_count == open_capacity)
+    {
+        open_capacity = open_capacity == 0 ? 16 : open_capacity * 2;
+        open_actions = realloc(open_actions, open_capacity * sizeof(struct open_action));
+        release_assert(open_actions != NULL);
+    }
+    open_actions[open_count].event = event;
+    open_actions[open_count].iteration_count = 0;
+    open_actions[open_count].iteration = begin;
+    open_count++;
+    in_profiler = false;
+}
+
+static void action_end(struct ccn_action *action, node_st *node)
+{
+    (void)action;
+    release_assert(open_count > 0);
+    struct snapshot end = take_snapshot(node);
+    open_count--;
+    struct profile_event *event = &events[open_actions[open_count].event];
+    event->end = end;
+    event->finished = true;
+}
+
+static void cycle_iteration(struct ccn_phase *phase, char *phase_name, node_st *node)
+{
+    (void)phase;
+    release_assert(open_count > 0);
+    in_profiler = true;
+    struct snapshot end = take_snapshot(node);
+    struct open_action *cycle = &open_actions[open_count - 1];
+    cycle->iteration_count++;
+    char *name = STRfmt("%s #%zu", phase_name, cycle->iteration_count);
+    size_t index = add_event(name, "cycle", &cycle->iteration);
+    events[index].end = end;
+    events[index].finished = true;
+    cycle->iteration = end;
+    in_profiler = false;
+}
+
+void profiler_start(void)
+{
+    release_assert(!running);
+    running = true;
+    origin = now();
+    overhead = 0;
+    open_count = 0;
+    phase_driver.hooks.action_start = action_start;
+    phase_driver.hooks.action_end = action_end;
+    phase_driver.hooks.cycle_iteration = cycle_iteration;
+    atomic_fetch_add(&profiling_threads, 1);
+}
+
+void profiler_stop(void)
+{
+    release_assert(running);
+    running = false;
+    phase_driver.hooks.action_start = NULL;
+    phase_driver.hooks.action_end = NULL;
+    phase_driver.hooks.cycle_iteration = NULL;
+    atomic_fetch_sub(&profiling_threads, 1);
+}
+
+static void print_header(FILE *out, const char *title)
+{
+    fprintf(out, "%-40s %6s %11s %6s %10s %10s %10s %12s %9s\n", title, "Calls", "Time (ms)", "%",
+            "Nodes in", "Nodes out", "Allocs", "Bytes", "Notifies");
+}
+
+static void print_row(FILE *out, const struct action_total *total, uint64_t total_duration)
+{
+    int indent = (int)total->depth * 2;
+    double percent =
+        total_duration > 0 ? (double)total->duration * 100.0 / (double)total_duration : 0.0;
+    fprintf(out, "%*s%-*s %6zu %11.3f %6.1f %10zu %10zu %10zu %12zu %9zu\n", indent, "",
+            40 - indent, total->name, total->calls, (double)total->duration / 1e6, percent,
+            total->nodes_before, total->nodes_after, total->allocations, total->allocated_bytes,
+            total->notifications);
+}
+
+static void add_to_total(struct action_total *total, const struct profile_event *event)
+{
+    if (total->calls == 0)
+    {
+        total->nodes_before = event->begin.nodes;
+    }
+    total->calls++;
+    total->duration += event->end.time - event->begin.time;
+    total->nodes_after = event->end.nodes;
+    total->allocations += event->end.allocations - event->begin.allocations;
+    total->allocated_bytes += event->end.allocated_bytes - event->begin.allocated_bytes;
+    total->notifications += event->end.notifications - event->begin.notifications;
+}
+
+/**
+ * Prints the actions aggregated by name in the order they first started, indented by their
+ * nesting. The node counts are those before the first and after the last call. The iterations of
+ * the cycle phases follow in a separate table.
+ */
+void profiler_report(FILE *out)
+{
+    struct action_total *totals = calloc(event_count + 1, sizeof(struct action_total));
+    release_assert(totals != NULL);
+    size_t total_count = 0;
+    uint64_t total_duration = 0;
+    for (size_t i = 0; i < event_count; i++)
+    {
+        const struct profile_event *event = &events[i];
+        if (!event->finished || STReq(event->category, "cycle"))
+        {
+            continue;
+        }
+
+        if (event->depth == 0)
+        {
+            total_duration += event->end.time - event->begin.time;
+        }
+
+        size_t j = 0;
+        while (j < total_count &&
+               !(STReq(totals[j].name, event->name) && STReq(totals[j].category, event->category)))
+        {
+            j++;
+        }
+        if (j == total_count)
+        {
+            totals[j].name = event->name;
+            totals[j].category = event->category;
+            totals[j].depth = event->depth;
+            total_count++;
+        }
+        add_to_total(&totals[j], event);
+    }
+
+    print_header(out, "Action");
+    for (size_t i = 0; i < total_count; i++)
+    {
+        print_row(out, &totals[i], total_duration);
+    }
+
+    bool has_cycles = false;
+    for (size_t i = 0; i < event_count; i++)
+    {
+        const struct profile_event *event = &events[i];
+        if (!STReq(event->category, "cycle"))
+        {
+            continue;
+        }
+
+        if (!has_cycles)
+        {
+            fprintf(out, "\n");
+            print_header(out, "Cycle iteration");
+            has_cycles = true;
+        }
+        struct action_total iteration = {.name = event->name, .category = event->category};
+        add_to_total(&iteration, event);
+        print_row(out, &iteration, total_duration);
+    }
+
+    free(totals);
+}
+
+static void write_json_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc('\\', out);
+        }
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Writes the finished actions and cycle iterations as complete events ("ph": "X") of a single
+ * thread. The arguments of an event hold its node counts and the allocations and notifications
+ * during the event.
+ */
+bool profiler_write_trace(const char *filepath)
+{
+    FILE *out = fopen(filepath, "w");
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    fprintf(out, "{\"traceEvents\":[");
+    bool first = true;
+    for (size_t i = 0; i < event_count; i++)
+    {
+        const struct profile_event *event = &events[i];
+        if (!event->finished)
+        {
+            continue;
+        }
+
+        fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+        write_json_string(out, event->name);
+        fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,",
+                event->category, (double)event->begin.time / 1e3,
+                (double)(event->end.time - event->begin.time) / 1e3);
+        fprintf(out,
+                "\"args\":{\"nodes_before\":%zu,\"nodes_after\":%zu,\"allocations\":%zu,"
+                "\"allocated_bytes\":%zu,\"cycle_notifications\":%zu}}",
+                event->begin.nodes, event->end.nodes,
+                event->end.allocations - event->begin.allocations,
+                event->end.allocated_bytes - event->begin.allocated_bytes,
+                event->end.notifications - event->begin.notifications);
+        first = false;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(out) == 0;
+}
+
+void profiler_reset(void)
+{
+    for (size_t i = 0; i < event_count; i++)
+    {
+        free(events[i].name);
+    }
+    free(events);
+    free(open_actions);
+    events = NULL;
+    event_count = 0;
+    event_capacity = 0;
+    open_actions = NULL;
+    open_count = 0;
+    open_capacity = 0;
+}
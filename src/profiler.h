@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Installs the phase driver hooks of the calling thread and starts recording the actions. Each
+// action records its wall time, the node count of its tree before and after, the allocations and
+// the calls of CCNcycleNotify. The iterations of cycle phases are recorded as well.
+void profiler_start(void);
+// Removes the hooks of the calling thread, the recorded actions are kept for the reports.
+void profiler_stop(void);
+// Prints the recorded actions aggregated by name and the cycle iterations as tables.
+void profiler_report(FILE *out);
+// Writes the recorded actions in the Chrome trace event format, e.g. for chrome://tracing.
+bool profiler_write_trace(const char *filepath);
+// Frees the recorded actions.
+void profiler_reset(void);
+
+/// Allocations counted on a thread.
+struct profiler_allocations
+{
+    size_t count;
+    size_t bytes;
+};
+
+// Counts an allocation of the calling thread while a thread is profiling, called by the wrapped
+// allocation functions.
+void profiler_count_allocation(size_t size);
+// Returns and clears the allocations counted on the calling thread, called by a worker thread
+// before it is joined.
+struct profiler_allocations profiler_take_allocations(void);
+// Adds the allocations of a joined worker thread to the calling thread.
+void profiler_add_allocations(struct profiler_allocations allocations);
@@ -0,0 +1,26 @@
+#include "profiler.h"
+#include <stddef.h>
+
+// The allocation functions of the civicc executable are wrapped by the linker with --wrap, the
+// library and the other executables use the allocation functions as is.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    profiler_count_allocation(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    profiler_count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    profiler_count_allocation(size);
+    return __real_realloc(ptr, size);
+}
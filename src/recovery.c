@@ -0,0 +1,74 @@
+#include "recovery.h"
+#include "ccn/dynamic_core.h"
+#include "ccn/phase_driver.h"
+#include "ccngen/action_handling.h"
+#include "ccngen/ast.h"
+#include "palm/ctinfo.h"
+#include "symbol_keys.h"
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+static _Thread_local node_st *tracked_root = NULL;
+
+void recovery_track(node_st *root)
+{
+    if (cti_recover != NULL)
+    {
+        tracked_root = root;
+    }
+}
+
+void recovery_release(node_st *root)
+{
+    if (tracked_root == root)
+    {
+        tracked_root = NULL;
+    }
+}
+
+/**
+ * The aborted compilation left the traversal frames, the phase driver and the error counts of its
+ * failed phase, they are reset before the tree is freed, as the freeing dispatches an action
+ * itself. The symbol key registry is dropped even if no tree was tracked. All are owned by the
+ * calling thread, so the reset does not touch the compilations of other threads.
+ */
+static void recover(jmp_buf *outer_scope)
+{
+    cti_recover = outer_scope;
+    CCNresetTraversals();
+    resetPhaseDriver();
+    CTIresetErrors();
+    if (tracked_root != NULL)
+    {
+        node_st *root = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_FREESYMBOLS),
+                                          CCN_ROOT_TYPE, tracked_root, true);
+        TRAVstart(root, TRAV_free);
+        tracked_root = NULL;
+    }
+    symbol_keys_reset();
+}
+
+bool recovery_run(void (*job)(void *arg), void *arg)
+{
+    jmp_buf scope;
+    jmp_buf *outer_scope = cti_recover;
+    node_st *outer_root = tracked_root;
+    tracked_root = NULL;
+
+    bool success = true;
+    if (setjmp(scope) == 0)
+    {
+        cti_recover = &scope;
+        job(arg);
+    }
+    else
+    {
+        success = false;
+        recover(outer_scope);
+    }
+
+    cti_recover = outer_scope;
+    tracked_root = outer_root;
+    return success;
+}
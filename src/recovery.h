@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ccngen/ast.h"
+#include <stdbool.h>
+
+/*
+ * Recovery of aborted compilations. Within a recovery scope an error aborts only the running
+ * compilation: its tree and symbol tables are freed, the scanner and phase driver are reset and the
+ * process continues with the next input. Without a scope an error exits the process as before.
+ */
+
+// Runs the job in a recovery scope of the calling thread. Returns false if the job was aborted by
+// a compilation error.
+bool recovery_run(void (*job)(void *arg), void *arg);
+// Registers the tree of the running compilation, so it is freed if the compilation is aborted.
+void recovery_track(node_st *root);
+// Unregisters the tree when its owner frees it.
+void recovery_release(node_st *root);
@@ -0,0 +1,438 @@
+#include "scanparse/module_link.h"
+#include "ccngen/ast.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/hash_table.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include "utils.h"
+#include <ccn/dynamic_core.h>
+#include <ccngen/enum.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/// Top-level name of the linked modules.
+struct link_name
+{
+    char *name;
+    size_t module;   // First module declaring the name
+    bool shared;     // Declared by more than one module
+    node_st *export; // Exported FunDef or GlobalDef, NULL if none
+    size_t export_module;
+    node_st *decl; // First FunDec or GlobalDec that is not resolved by an export
+};
+
+/// Renamed definition without export, which clashes with a name of another module.
+struct link_rename
+{
+    size_t module;
+    char *name;
+    char *new_name;
+};
+
+static _Thread_local htable_stptr names = NULL;
+static _Thread_local struct link_name **infos = NULL;
+static _Thread_local size_t info_count = 0;
+static _Thread_local size_t info_capacity = 0;
+static _Thread_local htable_stptr renames = NULL; // Renames of the walked module
+
+static void reset_state()
+{
+    names = NULL;
+    infos = NULL;
+    info_count = 0;
+    info_capacity = 0;
+    renames = NULL;
+}
+
+static const char *module_file(size_t module)
+{
+    return (int)module < global.lto_input_count ? global.lto_inputs[module] : global.input_file;
+}
+
+static char *decl_name(node_st *decl)
+{
+    node_st *var = NULL;
+    switch (NODE_TYPE(decl))
+    {
+    case NT_FUNDEF:
+        return VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(decl)));
+    case NT_FUNDEC:
+        return VAR_NAME(FUNHEADER_VAR(FUNDEC_FUNHEADER(decl)));
+    case NT_GLOBALDEF:
+        var = VARDEC_VAR(GLOBALDEF_VARDEC(decl));
+        return VAR_NAME(NODE_TYPE(var) == NT_VAR ? var : ARRAYEXPR_VAR(var));
+    case NT_GLOBALDEC:
+        var = GLOBALDEC_VAR(decl);
+        return VAR_NAME(NODE_TYPE(var) == NT_VAR ? var : ARRAYVAR_VAR(var));
+    default:
+        release_assert(false);
+        return NULL;
+    }
+}
+
+static bool is_export(node_st *decl)
+{
+    return (NODE_TYPE(decl) == NT_FUNDEF && FUNDEF_HAS_EXPORT(decl)) ||
+           (NODE_TYPE(decl) == NT_GLOBALDEF && GLOBALDEF_HAS_EXPORT(decl));
+}
+
+static struct link_name *lookup_name(char *name, size_t module)
+{
+    struct link_name *info = HTlookup(names, name);
+    if (info != NULL)
+    {
+        info->shared = info->shared || info->module != module;
+        return info;
+    }
+
+    if (info_count == info_capacity)
+    {
+        info_capacity = info_capacity == 0 ? 64 : info_capacity * 2;
+        infos = realloc(infos, info_capacity * sizeof(struct link_name *));
+        release_assert(infos != NULL);
+    }
+    info = calloc(1, sizeof(struct link_name));
+    release_assert(info != NULL);
+    info->name = STRcpy(name);
+    info->module = module;
+    infos[info_count++] = info;
+    bool success = HTinsert(names, info->name, info);
+    release_assert(success);
+    return info;
+}
+
+/// Checks that a FunDec declares the parameters and return type of the function it is linked to.
+static bool same_signature(node_st *left, node_st *right)
+{
+    if (FUNHEADER_TYPE(left) != FUNHEADER_TYPE(right))
+    {
+        return false;
+    }
+
+    node_st *left_params = FUNHEADER_PARAMS(left);
+    node_st *right_params = FUNHEADER_PARAMS(right);
+    while (left_params != NULL && right_params != NULL)
+    {
+        node_st *left_var = PARAMS_VAR(left_params);
+        node_st *right_var = PARAMS_VAR(right_params);
+        if (PARAMS_TYPE(left_params) != PARAMS_TYPE(right_params) ||
+            NODE_TYPE(left_var) != NODE_TYPE(right_var))
+        {
+            return false;
+        }
+        if (NODE_TYPE(left_var) == NT_ARRAYVAR)
+        {
+            node_st *left_dims = ARRAYVAR_DIMS(left_var);
+            node_st *right_dims = ARRAYVAR_DIMS(right_var);
+            while (left_dims != NULL && right_dims != NULL)
+            {
+                left_dims = DIMENSIONVARS_NEXT(left_dims);
+                right_dims = DIMENSIONVARS_NEXT(right_dims);
+            }
+            if (left_dims != right_dims)
+            {
+                return false;
+            }
+        }
+        left_params = PARAMS_NEXT(left_params);
+        right_params = PARAMS_NEXT(right_params);
+    }
+    return left_params == right_params;
+}
+
+/// Checks if an extern declaration can be linked to a declaration of the same name, which is an
+/// exported definition or an earlier extern declaration. Extern arrays are not linked, as their
+/// dimension variables would have to be bound to the dimensions of the definition.
+static bool is_linkable(node_st *decl, node_st *target)
+{
+    if (NODE_TYPE(decl) == NT_FUNDEC)
+    {
+        node_st *header = FUNDEC_FUNHEADER(decl);
+        return (NODE_TYPE(target) == NT_FUNDEF &&
+                same_signature(header, FUNDEF_FUNHEADER(target))) ||
+               (NODE_TYPE(target) == NT_FUNDEC && same_signature(header, FUNDEC_FUNHEADER(target)));
+    }
+
+    release_assert(NODE_TYPE(decl) == NT_GLOBALDEC);
+    if (NODE_TYPE(GLOBALDEC_VAR(decl)) != NT_VAR)
+    {
+        return false;
+    }
+    if (NODE_TYPE(target) == NT_GLOBALDEF)
+    {
+        node_st *vardec = GLOBALDEF_VARDEC(target);
+        return NODE_TYPE(VARDEC_VAR(vardec)) == NT_VAR &&
+               VARDEC_TYPE(vardec) == GLOBALDEC_TYPE(decl);
+    }
+    return NODE_TYPE(target) == NT_GLOBALDEC && NODE_TYPE(GLOBALDEC_VAR(target)) == NT_VAR &&
+           GLOBALDEC_TYPE(target) == GLOBALDEC_TYPE(decl);
+}
+
+/// Registers the top-level names of a module and reports exports defined by two modules.
+static void collect_names(node_st *program, size_t module)
+{
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        struct link_name *info = lookup_name(decl_name(decl), module);
+        if (!is_export(decl))
+        {
+            continue;
+        }
+
+        if (info->export != NULL)
+        {
+            struct ctinfo ctinfo = NODE_TO_CTINFO(decl);
+            CTIobj(CTI_ERROR, true, ctinfo, "'%s' is exported by '%s' and '%s'.", info->name,
+                   module_file(info->export_module), module_file(module));
+            continue;
+        }
+        info->export = decl;
+        info->export_module = module;
+    }
+}
+
+/// Removes the extern declarations that are linked to an exported definition or to the same
+/// extern declaration of an earlier module.
+static void resolve_externs(node_st *program, size_t module)
+{
+    node_st *prev = NULL;
+    node_st *decls = PROGRAM_DECLS(program);
+    while (decls != NULL)
+    {
+        node_st *next = DECLARATIONS_NEXT(decls);
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) != NT_FUNDEC && NODE_TYPE(decl) != NT_GLOBALDEC)
+        {
+            prev = decls;
+            decls = next;
+            continue;
+        }
+
+        struct link_name *info = HTlookup(names, decl_name(decl));
+        release_assert(info != NULL);
+        node_st *target = info->export != NULL ? info->export : info->decl;
+        if (target == NULL)
+        {
+            info->decl = decl;
+            prev = decls;
+            decls = next;
+            continue;
+        }
+
+        if (!is_linkable(decl, target))
+        {
+            struct ctinfo ctinfo = NODE_TO_CTINFO(decl);
+            CTIobj(CTI_ERROR, true, ctinfo,
+                   "Cannot link the extern declaration of '%s' in '%s' to its declaration in "
+                   "another module.",
+                   info->name, module_file(module));
+            prev = decls;
+            decls = next;
+            continue;
+        }
+
+        DECLARATIONS_NEXT(decls) = NULL;
+        CCNfree(decls);
+        if (prev == NULL)
+        {
+            PROGRAM_DECLS(program) = next;
+        }
+        else
+        {
+            DECLARATIONS_NEXT(prev) = next;
+        }
+        decls = next;
+    }
+}
+
+static void collect_var_names(node_st *node, htable_stptr used)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR)
+    {
+        HTinsert(used, VAR_NAME(node), VAR_NAME(node));
+    }
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        collect_var_names(node->children[i], used);
+    }
+}
+
+static void rename_vars(node_st *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+
+    if (NODE_TYPE(node) == NT_VAR)
+    {
+        char *new_name = HTlookup(renames, VAR_NAME(node));
+        if (new_name != NULL)
+        {
+            free(VAR_NAME(node));
+            VAR_NAME(node) = STRcpy(new_name);
+        }
+        return;
+    }
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        rename_vars(node->children[i]);
+    }
+}
+
+/**
+ * Renames the definitions without export, whose names are also declared by another module. All
+ * uses of the name in the module are renamed, so the local variables shadowing it stay
+ * consistent. The new name is not used in any module.
+ *
+ * int counter; in two modules becomes int counter; and int counter_1;
+ */
+static void rename_clashes(node_st **modules, size_t count)
+{
+    htable_stptr used = HTnew_String(2 << 10);
+    for (size_t i = 0; i < count; i++)
+    {
+        collect_var_names(modules[i], used);
+    }
+
+    struct link_rename *list = NULL;
+    size_t list_count = 0;
+    for (size_t module = 0; module < count; module++)
+    {
+        for (node_st *decls = PROGRAM_DECLS(modules[module]); decls != NULL;
+             decls = DECLARATIONS_NEXT(decls))
+        {
+            node_st *decl = DECLARATIONS_DECL(decls);
+            struct link_name *info = HTlookup(names, decl_name(decl));
+            bool is_definition = NODE_TYPE(decl) == NT_FUNDEF || NODE_TYPE(decl) == NT_GLOBALDEF;
+            if (!is_definition || is_export(decl) || !info->shared)
+            {
+                continue;
+            }
+
+            char *new_name = NULL;
+            for (unsigned int suffix = 1; new_name == NULL; suffix++)
+            {
+                new_name = STRfmt("%s_%u", info->name, suffix);
+                if (HTlookup(used, new_name) != NULL)
+                {
+                    free(new_name);
+                    new_name = NULL;
+                }
+            }
+            HTinsert(used, new_name, new_name);
+
+            list = realloc(list, (list_count + 1) * sizeof(struct link_rename));
+            release_assert(list != NULL);
+            list[list_count++] = (struct link_rename){module, info->name, new_name};
+        }
+    }
+    // The keys of the used names are freed by the renaming
+    HTdelete(used);
+
+    for (size_t module = 0; module < count; module++)
+    {
+        renames = HTnew_String(2 << 4);
+        for (size_t i = 0; i < list_count; i++)
+        {
+            if (list[i].module == module)
+            {
+                HTinsert(renames, list[i].name, list[i].new_name);
+            }
+        }
+        rename_vars(modules[module]);
+        HTdelete(renames);
+        renames = NULL;
+    }
+
+    for (size_t i = 0; i < list_count; i++)
+    {
+        free(list[i].new_name);
+    }
+    free(list);
+}
+
+/// Keeps only main exported, so the optimizations treat the other definitions as internal to the
+/// program and the dead code elimination removes the unused ones.
+static void hide_exports(node_st *program)
+{
+    for (node_st *decls = PROGRAM_DECLS(program); decls != NULL; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) == NT_FUNDEF && !STReq(decl_name(decl), "main"))
+        {
+            FUNDEF_HAS_EXPORT(decl) = false;
+        }
+        else if (NODE_TYPE(decl) == NT_GLOBALDEF)
+        {
+            GLOBALDEF_HAS_EXPORT(decl) = false;
+        }
+    }
+}
+
+node_st *link_modules(node_st **modules, size_t count)
+{
+    release_assert(count > 0);
+    reset_state();
+    names = HTnew_String(2 << 8);
+    for (size_t i = 0; i < count; i++)
+    {
+        collect_names(modules[i], i);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        resolve_externs(modules[i], i);
+    }
+    rename_clashes(modules, count);
+
+    node_st *program = modules[0];
+    node_st *last = PROGRAM_DECLS(program);
+    while (last != NULL && DECLARATIONS_NEXT(last) != NULL)
+    {
+        last = DECLARATIONS_NEXT(last);
+    }
+    for (size_t i = 1; i < count; i++)
+    {
+        node_st *decls = PROGRAM_DECLS(modules[i]);
+        PROGRAM_DECLS(modules[i]) = NULL;
+        CCNfree(modules[i]);
+        if (decls == NULL)
+        {
+            continue;
+        }
+
+        if (last == NULL)
+        {
+            PROGRAM_DECLS(program) = decls;
+        }
+        else
+        {
+            DECLARATIONS_NEXT(last) = decls;
+        }
+        last = decls;
+        while (DECLARATIONS_NEXT(last) != NULL)
+        {
+            last = DECLARATIONS_NEXT(last);
+        }
+    }
+    hide_exports(program);
+
+    HTdelete(names);
+    for (size_t i = 0; i < info_count; i++)
+    {
+        free(infos[i]->name);
+        free(infos[i]);
+    }
+    free(infos);
+    reset_state();
+    CTIabortOnError();
+    return program;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ccngen/ast.h"
+#include <stddef.h>
+
+// Links the parsed modules of the whole program mode into the first module, the other program
+// nodes are freed. The extern declarations of exported definitions are resolved, the clashing
+// definitions without export are renamed and only main stays exported. Aborts on link errors.
+node_st *link_modules(node_st **modules, size_t count);
@@ -13,15 +13,23 @@
 #include "global/globals.h"
 #include "release_assert.h"
 #include "utils.h"
+#include "scanparse/module_link.h"
 #include "scanparse/preprocessor.h"
+#include "recovery.h"
+#include <pthread.h>
+#include <setjmp.h>
 
-static node_st *parseresult = NULL;
+static _Thread_local node_st *parseresult = NULL;
+// The flex scanner and the bison parser keep their state in globals, so one thread scans at a time
+static pthread_mutex_t scanner_lock = PTHREAD_MUTEX_INITIALIZER;
 extern int yylex();
 int yyerror(char *errname);
 extern FILE *yyin;
 typedef void *YY_BUFFER_STATE;
 extern YY_BUFFER_STATE yy_scan_bytes(char *, size_t);
 extern void yy_delete_buffer(YY_BUFFER_STATE);
+extern int yylex_destroy(void);
+extern int yycolumn;
 void AddLocToNode(node_st *node, void *begin_loc, void *end_loc);
 
 
@@ -1081,22 +1089,71 @@ int yyerror(char *error)
   return 0;
 }
 
-node_st *SPdoScanParse(node_st *root)
+/**
+ * Releases the scanner after a parse that was aborted by an error within a recovery scope and
+ * continues the recovery in the outer scope. The nodes that bison built so far are not reachable
+ * from a tree and leak.
+ */
+static void AbortParse(FILE *fd, jmp_buf *outer_scope)
 {
-    DBUG_ASSERT(root == NULL, "Started parsing with existing syntax tree.");
-    release_assert(root == NULL);
+    if (fd != NULL)
+    {
+        if (global.preprocessor_enabled)
+        {
+            pclose(fd);
+        }
+        else
+        {
+            fclose(fd);
+        }
+    }
+    yylex_destroy();
+    yyin = NULL;
+    yycolumn = 1;
+    if (global.filename != NULL)
+    {
+        free(global.filename);
+        global.filename = NULL;
+    }
+    pthread_mutex_unlock(&scanner_lock);
+    cti_recover = outer_scope;
+    longjmp(*outer_scope, 1);
+}
+
+/// Parses the input buffer, or the input file if there is no buffer, into a program.
+static node_st *ParseInput()
+{
+    pthread_mutex_lock(&scanner_lock);
+    parseresult = NULL;
+
+    // Without a recovery scope an error exits the process, so the scanner is never reused
+    FILE *volatile fd = NULL;
+    jmp_buf scope;
+    jmp_buf *outer_scope = cti_recover;
+    if (outer_scope != NULL)
+    {
+        if (setjmp(scope) != 0)
+        {
+            AbortParse(fd, outer_scope);
+        }
+        cti_recover = &scope;
+    }
+
     if (global.input_buf == NULL)
     {
-        FILE* fd = preprocessorStart();
+        fd = preprocessorStart();
         yyin = fd;
         if (yyin == NULL) {
             CTI(CTI_ERROR, true, "Cannot open file '%s'.", global.input_file);
             CTIabortOnError();
         }
         yyparse();
+        recovery_track(parseresult);
 
+        FILE *file = fd;
+        fd = NULL;
         if (global.preprocessor_enabled){
-            preprocessorEnd(fd);
+            preprocessorEnd(file);
         }
     }
     else
@@ -1104,7 +1161,10 @@ node_st *SPdoScanParse(node_st *root)
         YY_BUFFER_STATE buffer = yy_scan_bytes(global.input_buf, global.input_buf_len);
         yyparse();
         yy_delete_buffer(buffer);
+        recovery_track(parseresult);
     }
+    cti_recover = outer_scope;
+    pthread_mutex_unlock(&scanner_lock);
 
     if(global.filename != NULL) 
     {
@@ -1114,3 +1174,29 @@ node_st *SPdoScanParse(node_st *root)
 
     return parseresult;
 }
+
+node_st *SPdoScanParse(node_st *root)
+{
+    DBUG_ASSERT(root == NULL, "Started parsing with existing syntax tree.");
+    release_assert(root == NULL);
+    if (global.lto_input_count == 0)
+    {
+        return ParseInput();
+    }
+
+    // Whole program mode, each module is parsed on its own and linked into one program
+    node_st **modules = malloc((size_t)global.lto_input_count * sizeof(node_st *));
+    release_assert(modules != NULL);
+    const char *input_file = global.input_file;
+    for (int i = 0; i < global.lto_input_count; i++)
+    {
+        global.input_file = global.lto_inputs[i];
+        modules[i] = ParseInput();
+    }
+    global.input_file = input_file;
+
+    node_st *program = link_modules(modules, (size_t)global.lto_input_count);
+    free(modules);
+    recovery_track(program);
+    return program;
+}
@@ -0,0 +1,286 @@
+#include "scheduler.h"
+#include "ccn/phase_driver.h"
+#include "ccngen/ast.h"
+#include "global/globals.h"
+#include "palm/ctinfo.h"
+#include "palm/str.h"
+#include "profiler.h"
+#include "release_assert.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Diagnostic of a scheduled job, reported after all jobs are done
+struct diagnostic
+{
+    enum cti_type type;
+    bool newline;
+    struct ctinfo info;
+    char *line; // Copy of the source line, the original points into the file cache of the thread
+    char *message;
+    struct diagnostic *next;
+};
+
+struct node_job
+{
+    node_st *node;
+    struct diagnostics diagnostics;
+    bool notified; // Called CCNcycleNotify
+};
+
+/// Range of jobs owned by a thread, the owner takes from the front and thieves from the back
+struct job_queue
+{
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+};
+
+struct scheduler
+{
+    struct node_job *jobs;
+    struct job_queue *queues;
+    size_t queue_count;
+    schedule_job job;
+    void *arg;
+    struct globals *global;
+};
+
+struct worker
+{
+    struct scheduler *scheduler;
+    size_t queue;
+    struct profiler_allocations allocations; // Counted on the thread of the worker
+};
+
+static _Thread_local struct node_job *current_job = NULL;
+
+static bool take_front(struct job_queue *queue, size_t *index)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->begin < queue->end;
+    if (found)
+    {
+        *index = queue->begin++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool take_back(struct job_queue *queue, size_t *index)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->begin < queue->end;
+    if (found)
+    {
+        *index = --queue->end;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static void run_job(struct scheduler *scheduler, size_t index)
+{
+    struct node_job *job = &scheduler->jobs[index];
+    current_job = job;
+    phase_driver.fixed_point = true;
+    scheduler->job(job->node, scheduler->arg);
+    job->notified = !phase_driver.fixed_point;
+    current_job = NULL;
+}
+
+static void *run_worker(void *arg)
+{
+    struct worker *worker = arg;
+    struct scheduler *scheduler = worker->scheduler;
+    if (&global != scheduler->global)
+    {
+        global = *scheduler->global;
+    }
+
+    size_t index = 0;
+    while (take_front(&scheduler->queues[worker->queue], &index))
+    {
+        run_job(scheduler, index);
+    }
+
+    // Steal the remaining jobs of the other threads
+    for (size_t i = 1; i < scheduler->queue_count; i++)
+    {
+        struct job_queue *victim = &scheduler->queues[(worker->queue + i) % scheduler->queue_count];
+        while (take_back(victim, &index))
+        {
+            run_job(scheduler, index);
+        }
+    }
+    return NULL;
+}
+
+static void *run_worker_thread(void *arg)
+{
+    struct worker *worker = arg;
+    run_worker(worker);
+    worker->allocations = profiler_take_allocations();
+    return NULL;
+}
+
+void schedule_nodes(node_st **nodes, size_t count, schedule_job job, void *arg)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    size_t thread_count = global.jobs > 1 ? (size_t)global.jobs : 1;
+    thread_count = thread_count < count ? thread_count : count;
+
+    struct scheduler scheduler = {
+        .jobs = calloc(count, sizeof(struct node_job)),
+        .queues = calloc(thread_count, sizeof(struct job_queue)),
+        .queue_count = thread_count,
+        .job = job,
+        .arg = arg,
+        .global = &global,
+    };
+    struct worker *workers = calloc(thread_count, sizeof(struct worker));
+    pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+    release_assert(scheduler.jobs != NULL && scheduler.queues != NULL);
+    release_assert(workers != NULL && threads != NULL);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        scheduler.jobs[i].node = nodes[i];
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        pthread_mutex_init(&scheduler.queues[i].lock, NULL);
+        scheduler.queues[i].begin = i * count / thread_count;
+        scheduler.queues[i].end = (i + 1) * count / thread_count;
+        workers[i].scheduler = &scheduler;
+        workers[i].queue = i;
+    }
+
+    // The calling thread works on the first queue
+    bool parent_fixed_point = phase_driver.fixed_point;
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        int error = pthread_create(&threads[i], NULL, run_worker_thread, &workers[i]);
+        release_assert(error == 0);
+    }
+    run_worker(&workers[0]);
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        pthread_join(threads[i], NULL);
+        profiler_add_allocations(workers[i].allocations);
+    }
+    phase_driver.fixed_point = parent_fixed_point;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        struct node_job *node_job = &scheduler.jobs[i];
+        if (node_job->notified)
+        {
+            CCNcycleNotify();
+        }
+
+        diagnostics_report(&node_job->diagnostics);
+    }
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        pthread_mutex_destroy(&scheduler.queues[i].lock);
+    }
+    free(scheduler.jobs);
+    free(scheduler.queues);
+    free(workers);
+    free(threads);
+}
+
+void schedule_decls(node_st *decls, schedule_job job, void *arg)
+{
+    size_t count = 0;
+    for (node_st *iter = decls; iter != NULL; iter = DECLARATIONS_NEXT(iter))
+    {
+        count++;
+    }
+
+    node_st **nodes = malloc(count * sizeof(node_st *) + 1);
+    release_assert(nodes != NULL);
+    size_t i = 0;
+    for (node_st *iter = decls; iter != NULL; iter = DECLARATIONS_NEXT(iter))
+    {
+        nodes[i++] = DECLARATIONS_DECL(iter);
+    }
+
+    schedule_nodes(nodes, count, job, arg);
+    free(nodes);
+}
+
+void report_obj(enum cti_type type, bool newline, struct ctinfo info, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int length = vsnprintf(NULL, 0, format, args_copy);
+    va_end(args_copy);
+    release_assert(length >= 0);
+
+    char *message = malloc((size_t)length + 1);
+    release_assert(message != NULL);
+    vsnprintf(message, (size_t)length + 1, format, args);
+    va_end(args);
+
+    if (current_job == NULL)
+    {
+        CTIobj(type, newline, info, "%s", message);
+    }
+    else
+    {
+        diagnostics_add(&current_job->diagnostics, type, newline, info, message);
+    }
+    free(message);
+}
+
+void diagnostics_add(struct diagnostics *diagnostics, enum cti_type type, bool newline,
+                     struct ctinfo info, const char *message)
+{
+    struct diagnostic *diagnostic = malloc(sizeof(struct diagnostic));
+    release_assert(diagnostic != NULL);
+    diagnostic->type = type;
+    diagnostic->newline = newline;
+    diagnostic->line = info.line != NULL ? STRcpy(info.line) : NULL;
+    diagnostic->info = info;
+    diagnostic->info.line = diagnostic->line;
+    diagnostic->message = STRcpy(message);
+    diagnostic->next = NULL;
+    if (diagnostics->last == NULL)
+    {
+        diagnostics->first = diagnostic;
+    }
+    else
+    {
+        diagnostics->last->next = diagnostic;
+    }
+    diagnostics->last = diagnostic;
+}
+
+void diagnostics_report(struct diagnostics *diagnostics)
+{
+    struct diagnostic *diagnostic = diagnostics->first;
+    while (diagnostic != NULL)
+    {
+        struct diagnostic *next = diagnostic->next;
+        CTIobj(diagnostic->type, diagnostic->newline, diagnostic->info, "%s", diagnostic->message);
+        free(diagnostic->line);
+        free(diagnostic->message);
+        free(diagnostic);
+        diagnostic = next;
+    }
+    diagnostics->first = NULL;
+    diagnostics->last = NULL;
+}
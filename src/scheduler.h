@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ccngen/ast.h"
+#include "palm/ctinfo.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*schedule_job)(node_st *node, void *arg);
+
+/// Diagnostics buffered by a job on a worker thread, reported later on the calling thread.
+struct diagnostics
+{
+    struct diagnostic *first;
+    struct diagnostic *last;
+};
+
+// Runs the job for each node on global.jobs threads. Each thread takes the nodes from its own
+// queue and steals from the end of the other queues when it runs out. The diagnostics of the jobs
+// are reported afterwards in node order, cycle notifications are forwarded to the calling thread.
+// The traversal stack is thread local, so the job starts its own traversal with TRAVstart.
+void schedule_nodes(node_st **nodes, size_t count, schedule_job job, void *arg);
+// Runs the job for each top-level declaration of the list with schedule_nodes.
+void schedule_decls(node_st *decls, schedule_job job, void *arg);
+// Reports a diagnostic like CTIobj. In a scheduled job the diagnostic is buffered.
+void report_obj(enum cti_type type, bool newline, struct ctinfo info, const char *format, ...);
+// Appends a diagnostic like CTIobj to the buffer, the source line of the info is copied.
+void diagnostics_add(struct diagnostics *diagnostics, enum cti_type type, bool newline,
+                     struct ctinfo info, const char *message);
+// Reports the buffered diagnostics in order with CTIobj and empties the buffer.
+void diagnostics_report(struct diagnostics *diagnostics);
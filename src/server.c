@@ -0,0 +1,374 @@
+#include "server.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Requests and responses are a sequence of frames, each a header line '<tag> <length>' followed by
+ * <length> bytes of data. A request holds an 'arg' frame per argument, an optional 'cwd' and
+ * 'source' frame and ends with an empty 'end' frame. The response holds the 'stdout' and 'stderr'
+ * output and ends with the 'exit' frame of the exit status.
+ */
+
+#define TAG_LENGTH 16
+
+/// Compile request received from a client.
+struct request
+{
+    char **argv;
+    int argc;
+    size_t capacity;
+    char *cwd;
+    char *source;
+    size_t source_length;
+};
+
+static const char *bound_path = NULL; // Socket path removed when the server is terminated
+
+static bool write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static bool write_frame(int fd, const char *tag, const char *data, size_t length)
+{
+    char header[TAG_LENGTH + 32];
+    int header_length = snprintf(header, sizeof(header), "%s %zu\n", tag, length);
+    return write_all(fd, header, (size_t)header_length) && write_all(fd, data, length);
+}
+
+/// Reads a frame, the data is null terminated for the text frames.
+static bool read_frame(FILE *in, char tag[TAG_LENGTH], char **out_data, size_t *out_length)
+{
+    size_t length;
+    if (fscanf(in, "%15s %zu", tag, &length) != 2 || fgetc(in) != '\n')
+    {
+        return false;
+    }
+
+    char *data = malloc(length + 1);
+    release_assert(data != NULL);
+    if (fread(data, 1, length, in) != length)
+    {
+        free(data);
+        return false;
+    }
+    data[length] = '\0';
+    *out_data = data;
+    *out_length = length;
+    return true;
+}
+
+static bool read_request(FILE *in, struct request *request)
+{
+    while (true)
+    {
+        char tag[TAG_LENGTH];
+        char *data;
+        size_t length;
+        if (!read_frame(in, tag, &data, &length))
+        {
+            return false;
+        }
+
+        if (STReq(tag, "arg"))
+        {
+            if ((size_t)request->argc + 1 >= request->capacity)
+            {
+                request->capacity = request->capacity == 0 ? 16 : request->capacity * 2;
+                request->argv = realloc(request->argv, request->capacity * sizeof(char *));
+                release_assert(request->argv != NULL);
+            }
+            request->argv[request->argc++] = data;
+            request->argv[request->argc] = NULL;
+        }
+        else if (STReq(tag, "cwd"))
+        {
+            free(request->cwd);
+            request->cwd = data;
+        }
+        else if (STReq(tag, "source"))
+        {
+            free(request->source);
+            request->source = data;
+            request->source_length = length;
+        }
+        else
+        {
+            free(data);
+            return STReq(tag, "end") && request->argc > 0;
+        }
+    }
+}
+
+static void free_request(struct request *request)
+{
+    for (int i = 0; i < request->argc; i++)
+    {
+        free(request->argv[i]);
+    }
+    free(request->argv);
+    free(request->cwd);
+    free(request->source);
+}
+
+static bool send_file(int connection, const char *tag, FILE *file)
+{
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    release_assert(size >= 0);
+
+    char *data = malloc((size_t)size + 1);
+    release_assert(data != NULL);
+    size_t length = fread(data, 1, (size_t)size, file);
+    bool success = write_frame(connection, tag, data, length);
+    free(data);
+    return success;
+}
+
+/// Compiles the request of the connection in a forked process that writes its STDOUT and STDERR
+/// into temporary files, which are sent to the client with the exit status afterwards.
+static void handle_connection(int connection, server_compile compile)
+{
+    FILE *in = fdopen(dup(connection), "r");
+    release_assert(in != NULL);
+    struct request request = {0};
+    bool valid = read_request(in, &request);
+    fclose(in);
+
+    int exit_status = EXIT_FAILURE;
+    if (valid)
+    {
+        FILE *out = tmpfile();
+        FILE *err = tmpfile();
+        release_assert(out != NULL && err != NULL);
+        fflush(stdout);
+        fflush(stderr);
+
+        pid_t pid = fork();
+        release_assert(pid >= 0);
+        if (pid == 0)
+        {
+            dup2(fileno(out), STDOUT_FILENO);
+            dup2(fileno(err), STDERR_FILENO);
+            close(connection);
+            if (request.cwd != NULL && chdir(request.cwd) != 0)
+            {
+                fprintf(stderr, "ERROR: Cannot change to the directory '%s'.\n", request.cwd);
+                exit(EXIT_FAILURE);
+            }
+            // Also an aborted compilation exits, which flushes its output
+            exit(compile(request.argc, request.argv, request.source, request.source_length));
+        }
+
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        send_file(connection, "stdout", out);
+        send_file(connection, "stderr", err);
+        fclose(out);
+        fclose(err);
+    }
+    else
+    {
+        const char *message = "ERROR: Invalid compile request.\n";
+        write_frame(connection, "stderr", message, strlen(message));
+    }
+
+    char *text = STRfmt("%d", exit_status);
+    write_frame(connection, "exit", text, strlen(text));
+    free(text);
+    free_request(&request);
+}
+
+static void stop_server(int signal)
+{
+    (void)signal;
+    if (bound_path != NULL)
+    {
+        unlink(bound_path);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+static bool socket_address(const char *socket_path, struct sockaddr_un *address)
+{
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path))
+    {
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+int server_run(const char *socket_path, server_compile compile)
+{
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address))
+    {
+        fprintf(stderr, "ERROR: The socket path '%s' is too long.\n", socket_path);
+        return EXIT_FAILURE;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    release_assert(server >= 0);
+    if (connect(server, (struct sockaddr *)&address, sizeof(address)) == 0)
+    {
+        fprintf(stderr, "ERROR: A server already listens on '%s'.\n", socket_path);
+        close(server);
+        return EXIT_FAILURE;
+    }
+    close(server);
+
+    // Removes the socket of a previous server that did not shut down
+    unlink(socket_path);
+    server = socket(AF_UNIX, SOCK_STREAM, 0);
+    release_assert(server >= 0);
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 64) != 0)
+    {
+        fprintf(stderr, "ERROR: Cannot listen on '%s'. Returned with errno '%d'.\n", socket_path,
+                errno);
+        close(server);
+        return EXIT_FAILURE;
+    }
+
+    bound_path = socket_path;
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+    signal(SIGPIPE, SIG_IGN);
+    // The connection handlers are never waited for
+    struct sigaction no_zombies = {.sa_handler = SIG_IGN, .sa_flags = SA_NOCLDWAIT};
+    sigaction(SIGCHLD, &no_zombies, NULL);
+
+    while (true)
+    {
+        int connection = accept(server, NULL, NULL);
+        if (connection < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            fprintf(stderr, "ERROR: Cannot accept a connection. Returned with errno '%d'.\n",
+                    errno);
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(server);
+            bound_path = NULL;
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGCHLD, SIG_DFL);
+            handle_connection(connection, compile);
+            close(connection);
+            _exit(EXIT_SUCCESS);
+        }
+        close(connection);
+    }
+
+    close(server);
+    unlink(socket_path);
+    bound_path = NULL;
+    return EXIT_FAILURE;
+}
+
+bool server_forward(const char *socket_path, int argc, char **argv, const char *source,
+                    size_t source_length, int *out_status)
+{
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address))
+    {
+        return false;
+    }
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+    {
+        return false;
+    }
+    if (connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(connection);
+        return false;
+    }
+
+    bool sent = true;
+    for (int i = 0; i < argc && sent; i++)
+    {
+        sent = write_frame(connection, "arg", argv[i], strlen(argv[i]));
+    }
+    char cwd[PATH_MAX];
+    if (sent && getcwd(cwd, sizeof(cwd)) != NULL)
+    {
+        sent = write_frame(connection, "cwd", cwd, strlen(cwd));
+    }
+    if (sent && source != NULL)
+    {
+        sent = write_frame(connection, "source", source, source_length);
+    }
+    sent = sent && write_frame(connection, "end", "", 0);
+    if (!sent)
+    {
+        close(connection);
+        return false;
+    }
+
+    FILE *in = fdopen(connection, "r");
+    release_assert(in != NULL);
+    bool finished = false;
+    char tag[TAG_LENGTH];
+    char *data;
+    size_t length;
+    while (!finished && read_frame(in, tag, &data, &length))
+    {
+        if (STReq(tag, "stdout"))
+        {
+            fwrite(data, 1, length, stdout);
+        }
+        else if (STReq(tag, "stderr"))
+        {
+            fwrite(data, 1, length, stderr);
+        }
+        else if (STReq(tag, "exit"))
+        {
+            *out_status = atoi(data);
+            finished = true;
+        }
+        free(data);
+    }
+    fclose(in);
+    return finished;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compiles a forwarded request, the arguments are those of the client including the program name.
+// The source is the buffer of the request or NULL to read the input file.
+typedef int (*server_compile)(int argc, char **argv, char *source, size_t source_length);
+
+// Accepts compile requests on the Unix domain socket until the process is terminated. Each request
+// is compiled in a forked process of the server, so the compilation starts with the state of the
+// loaded compiler and an aborted compilation does not end the server. The client receives the
+// STDOUT and STDERR output of the compilation and its exit status.
+int server_run(const char *socket_path, server_compile compile);
+// Sends the arguments, working directory and optional source to the server and writes its output to
+// STDOUT and STDERR. Returns false if the server can not be reached, e.g. to compile locally.
+bool server_forward(const char *socket_path, int argc, char **argv, const char *source,
+                    size_t source_length, int *out_status);
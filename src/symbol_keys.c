@@ -0,0 +1,69 @@
+#include "symbol_keys.h"
+#include "palm/str.h"
+#include "release_assert.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Owned key of each declaration, the table is deleted when the last key is removed
+static _Thread_local htable_stptr owned_keys = NULL;
+
+bool symbol_keys_insert(htable_stptr symbols, const char *name, node_st *node)
+{
+    char *key = STRcpy(name);
+    if (!HTinsert(symbols, key, node))
+    {
+        free(key);
+        return false;
+    }
+
+    if (owned_keys == NULL)
+    {
+        owned_keys = HTnew_Ptr(2 << 8);
+    }
+    // A declaration freed without its symbol table leaves a stale key behind
+    HTremove(owned_keys, node);
+    bool success = HTinsert(owned_keys, node, key);
+    release_assert(success);
+    return true;
+}
+
+node_st *symbol_keys_remove(htable_stptr symbols, node_st *node)
+{
+    char *key = owned_keys == NULL ? NULL : HTlookup(owned_keys, node);
+    release_assert(key != NULL);
+    symbol_keys_forget(node);
+
+    node_st *entry = HTremove(symbols, key);
+    free(key);
+    return entry;
+}
+
+void symbol_keys_forget(node_st *node)
+{
+    if (owned_keys == NULL)
+    {
+        return;
+    }
+
+    HTremove(owned_keys, node);
+    if (HTelementCount(owned_keys) == 0)
+    {
+        HTdelete(owned_keys);
+        owned_keys = NULL;
+    }
+}
+
+void symbol_keys_reset(void)
+{
+    if (owned_keys != NULL)
+    {
+        HTdelete(owned_keys);
+        owned_keys = NULL;
+    }
+}
+
+size_t symbol_keys_count(void)
+{
+    return owned_keys == NULL ? 0 : HTelementCount(owned_keys);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ccngen/ast.h"
+#include "palm/hash_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The function symbols are inserted with keys owned by the symbol table. Their keys are registered
+ * by declaration, so removing a function symbol finds its key without scanning the symbol table.
+ */
+
+// Inserts the declaration with a copy of the name as owned key.
+bool symbol_keys_insert(htable_stptr symbols, const char *name, node_st *node);
+// Removes the declaration inserted with symbol_keys_insert and frees its key.
+node_st *symbol_keys_remove(htable_stptr symbols, node_st *node);
+// Unregisters the key of the declaration, the key is freed by the caller.
+void symbol_keys_forget(node_st *node);
+// Drops the registry of the calling thread at the end of a compilation, the keys themselves are
+// freed with their symbol tables.
+void symbol_keys_reset(void);
+// Returns the number of declarations registered on the calling thread.
+size_t symbol_keys_count(void);
@@ -130,6 +130,7 @@ bool has_child_next(node_st *node, node_st **child_next)
     case NT_FLOAT:
     case NT_INT:
     case NT_ARRAYASSIGN:
+    case NT_ARRAYBULKASSIGN:
     case NT_ARRAYEXPR:
     case NT_ARRAYVAR:
     case NT_VAR:
@@ -224,6 +225,9 @@ char *get_node_name(node_st *node)
         case NT_ARRAYASSIGN:
             node_string = STRcpy("ArrayAssign");
             break;
+        case NT_ARRAYBULKASSIGN:
+            node_string = STRcpy("ArrayBulkAssign");
+            break;
         case NT_ARRAYINIT:
             node_string = STRcpy("ArrayInit");
             break;
@@ -6,6 +6,7 @@
 #include "palm/hash_table.h"
 #include "palm/str.h"
 #include "release_assert.h"
+#include "symbol_keys.h"
 #include "user_types.h"
 #include <ccn/phase_driver.h>
 #include <ccngen/ast.h>
@@ -46,7 +47,8 @@ static inline uint64_t nodessettype_to_nodetypes(enum nodesettype type)
     case NS_STATEMENT:
         return (one << NT_ASSIGN) | (one << NT_PROCCALL) | (one << NT_IFSTATEMENT) |
                (one << NT_WHILELOOP) | (one << NT_DOWHILELOOP) | (one << NT_FORLOOP) |
-               (one << NT_FORLOOP) | (one << NT_RETSTATEMENT) | (one << NT_ARRAYASSIGN);
+               (one << NT_FORLOOP) | (one << NT_RETSTATEMENT) | (one << NT_ARRAYASSIGN) |
+               (one << NT_ARRAYBULKASSIGN);
     case NS_EXPR:
         return (one << NT_BINOP) | (one << NT_MONOP) | (one << NT_CAST) | (one << NT_PROCCALL) |
                (one << NT_VAR) | (one << NT_ARRAYEXPR) | (one << NT_INT) | (one << NT_FLOAT) |
@@ -63,7 +65,7 @@ static inline uint64_t nodessettype_to_nodetypes(enum nodesettype type)
 }
 
 #define error_cache_size 1024 * 5 // 5 KiB
-static char cache_file[error_cache_size];
+static _Thread_local char cache_file[error_cache_size];
 
 static char *get_file_line(const char *filename, int start_line, int end_line)
 {
@@ -328,6 +330,134 @@ static node_st *add_stmt(node_st *stmt, node_st *last_stmts, node_st *funbody)
     }
 }
 
+/// Appends the stmts to the list given by first and last.
+static void append_stmts(node_st *stmts, node_st **first, node_st **last)
+{
+    release_assert(stmts != NULL);
+    if (*last == NULL)
+    {
+        *first = stmts;
+    }
+    else
+    {
+        STATEMENTS_NEXT(*last) = stmts;
+    }
+
+    while (STATEMENTS_NEXT(stmts) != NULL)
+    {
+        stmts = STATEMENTS_NEXT(stmts);
+    }
+    *last = stmts;
+}
+
+/// Counts the nodes of the subtree, used as cost of a code block.
+static long node_count(node_st *node)
+{
+    if (node == NULL)
+    {
+        return 0;
+    }
+
+    long count = 1;
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        count += node_count(node->children[i]);
+    }
+    return count;
+}
+
+/// Checks if the subtree calls the function with the given name.
+static bool calls_function(node_st *node, const char *name)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    if (NODE_TYPE(node) == NT_PROCCALL && STReq(VAR_NAME(PROCCALL_VAR(node)), name))
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (calls_function(node->children[i], name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Checks if the subtree assigns the variable with the given name.
+static bool is_assigned(node_st *node, const char *name)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    if (NODE_TYPE(node) == NT_ASSIGN && STReq(VAR_NAME(ASSIGN_VAR(node)), name))
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < node->num_children; i++)
+    {
+        if (is_assigned(node->children[i], name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Checks if the node is an Int, Float or Bool literal
+static inline bool is_literal(node_st *node)
+{
+    enum ccn_nodetype type = NODE_TYPE(node);
+    return type == NT_INT || type == NT_FLOAT || type == NT_BOOL;
+}
+
+/// Checks if both nodes are literals of the same type and value
+static inline bool is_same_literal(node_st *a, node_st *b)
+{
+    release_assert(a != NULL);
+    release_assert(b != NULL);
+    if (NODE_TYPE(a) != NODE_TYPE(b))
+    {
+        return false;
+    }
+
+    switch (NODE_TYPE(a))
+    {
+    case NT_INT:
+        return INT_VAL(a) == INT_VAL(b);
+    case NT_FLOAT:
+        return FLOAT_VAL(a) == FLOAT_VAL(b);
+    case NT_BOOL:
+        return BOOL_VAL(a) == BOOL_VAL(b);
+    default:
+        return false;
+    }
+}
+
+/// Counts the consecutive equal literals at the start of the exprs
+static inline int literal_run_length(node_st *exprs)
+{
+    release_assert(exprs != NULL);
+    release_assert(NODE_TYPE(exprs) == NT_EXPRS);
+
+    int length = 1;
+    node_st *next = EXPRS_NEXT(exprs);
+    while (next != NULL && is_same_literal(EXPRS_EXPR(exprs), EXPRS_EXPR(next)))
+    {
+        length++;
+        next = EXPRS_NEXT(next);
+    }
+    return length;
+}
+
 /// Finds the correct stmts position to insert the find_name assign in the __init function
 static node_st *search_last_init_stmts(bool use_arrayexpr, node_st *stmts, node_st *decls,
                                        const char *find_name, node_st **out_decls)
@@ -358,7 +488,8 @@ static node_st *search_last_init_stmts(bool use_arrayexpr, node_st *stmts, node_
             }
 
             node_st *stmt = STATEMENTS_STMT(stmts);
-            if (NODE_TYPE(stmt) == NT_FORLOOP || NODE_TYPE(stmt) == NT_ARRAYASSIGN)
+            if (NODE_TYPE(stmt) == NT_FORLOOP || NODE_TYPE(stmt) == NT_ARRAYASSIGN ||
+                NODE_TYPE(stmt) == NT_ARRAYBULKASSIGN)
             {
                 last_stmts = stmts;
                 stmts = STATEMENTS_NEXT(stmts);
@@ -412,7 +543,7 @@ static enum sideeffect check_expr_sideeffect(node_st *expr, htable_stptr symbols
         release_assert(NODE_TYPE(entry) == NT_FUNDEF || NODE_TYPE(entry) == NT_FUNDEC);
         if (NODE_TYPE(entry) == NT_FUNDEC)
         {
-            return SEFF_YES;
+            return FUNDEC_IS_PURE(entry) ? SEFF_NO : SEFF_YES;
         }
 
         void *fun_eff = HTlookup(sideeffect_table, entry);
@@ -625,6 +756,9 @@ static enum sideeffect check_stmt_sideeffect(node_st *stmt, htable_stptr symbols
         release_assert(ARRAYASSIGN_EXPR(stmt) != NULL);
         effect |= check_expr_sideeffect(ARRAYASSIGN_EXPR(stmt), symbols, sideeffect_table);
         break;
+    case NT_ARRAYBULKASSIGN:
+        // Only consists of literals
+        break;
     default:
         release_assert(false);
         break;
@@ -642,8 +776,9 @@ static enum sideeffect check_fun_sideeffect(node_st *fun, htable_stptr sideeffec
 
     if (NODE_TYPE(fun) == NT_FUNDEC)
     {
-        // Can not check if extern functions have side effects, thus we need to assume yes.
-        return SEFF_YES;
+        // Can not check if extern functions have side effects, thus we need to assume yes unless
+        // the interface summary of their module says otherwise.
+        return FUNDEC_IS_PURE(fun) ? SEFF_NO : SEFF_YES;
     }
 
     char *name = VAR_NAME(FUNHEADER_VAR(FUNDEF_FUNHEADER(fun)));
@@ -691,6 +826,7 @@ static void free_symbols(htable_stptr symbols)
         if (STRprefix("@fun_", key))
         {
             // Free function keys
+            symbol_keys_forget(HTiterValue(iter));
             free(key);
         }
     }
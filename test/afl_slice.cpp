@@ -22,6 +22,7 @@
 extern "C"
 {
 #include "palm/ctinfo.h"
+#include "recovery.h"
 #include "test_interface.h"
 }
 
@@ -49,6 +50,63 @@ __AFL_FUZZ_INIT();
 #ifndef __AFL_COMPILER
 #endif // !__AFL_COMPILER
 
+/// Input of a single compilation of the slice.
+struct slice_input
+{
+    const char *filepath;
+    char *src;
+    size_t len;
+};
+
+static void run_slice(void *arg)
+{
+    struct slice_input *input = (struct slice_input *)arg;
+#if SLICE_TARGET == 1
+#ifdef __AFL_COMPILER
+    node_st *root = run_scan_parse_buf(input->filepath, input->src, (uint32_t)input->len);
+#else
+    node_st *root = run_scan_parse(input->filepath);
+#endif // __AFL_COMPILER
+#elif SLICE_TARGET == 2
+#ifdef __AFL_COMPILER
+    node_st *root = run_context_analysis_buf(input->filepath, input->src, (uint32_t)input->len);
+#else
+    node_st *root = run_context_analysis(input->filepath);
+#endif // __AFL_COMPILER
+#elif SLICE_TARGET == 3
+#ifdef __AFL_COMPILER
+    node_st *root =
+        run_code_gen_preparation_buf(input->filepath, input->src, (uint32_t)input->len);
+#else
+    node_st *root = run_code_gen_preparation(input->filepath);
+#endif // __AFL_COMPILER
+#elif SLICE_TARGET == 4
+#ifdef __AFL_COMPILER
+    node_st *root = run_optimization_buf(input->filepath, input->src, (uint32_t)input->len,
+                                         CCNAC_ID_OPTIMIZATION);
+#else
+    node_st *root = run_optimization(input->filepath, CCNAC_ID_OPTIMIZATION);
+#endif // __AFL_COMPILER
+#elif SLICE_TARGET == 5
+#ifdef __AFL_COMPILER
+    node_st *root = run_code_generation_buf(input->filepath, input->src, (uint32_t)input->len,
+                                            NULL, NULL, 0, false);
+#else
+    node_st *root = run_code_generation(input->filepath, NULL, 0, false);
+#endif // __AFL_COMPILER
+#elif SLICE_TARGET == 6
+#ifdef __AFL_COMPILER
+    node_st *root = run_code_generation_buf(input->filepath, input->src, (uint32_t)input->len,
+                                            NULL, NULL, 0, true);
+#else
+    node_st *root = run_code_generation(input->filepath, NULL, 0, true);
+#endif // __AFL_COMPILER
+#else
+    static_assert(false, "No valid slice target given to preprocessor");
+#endif
+    cleanup_nodes(root);
+}
+
 int main(int argc, char *argv[])
 {
 #ifdef AFL_LSAN_MODE
@@ -73,6 +131,7 @@ int main(int argc, char *argv[])
 #endif
 
     char *src = NULL;
+    int failures = 0;
 
 #ifndef __AFL_COMPILER
     int i_argc = 1;
@@ -89,50 +148,17 @@ int main(int argc, char *argv[])
         release_assert(len <= 1024 * 1024 * 1024); // Ensure less than one GiB
         src = (char *)realloc(src, len);
         std::memcpy(src, buf, len);
+        struct slice_input input = {filepath, src, len};
 #else
         const char *filepath = argv[i_argc++];
         fprintf(stderr, "Compiling '%s'\n", filepath);
+        struct slice_input input = {filepath, NULL, 0};
 #endif
-#if SLICE_TARGET == 1
-#ifdef __AFL_COMPILER
-        node_st *root = run_scan_parse_buf(filepath, src, (uint32_t)len);
-#else
-        node_st *root = run_scan_parse(filepath);
-#endif // __AFL_COMPILER
-#elif SLICE_TARGET == 2
-#ifdef __AFL_COMPILER
-        node_st *root = run_context_analysis_buf(filepath, src, (uint32_t)len);
-#else
-        node_st *root = run_context_analysis(filepath);
-#endif // __AFL_COMPILER
-#elif SLICE_TARGET == 3
-#ifdef __AFL_COMPILER
-        node_st *root = run_code_gen_preparation_buf(filepath, src, (uint32_t)len);
-#else
-        node_st *root = run_code_gen_preparation(filepath);
-#endif // __AFL_COMPILER
-#elif SLICE_TARGET == 4
-#ifdef __AFL_COMPILER
-        node_st *root = run_optimization_buf(filepath, src, (uint32_t)len, CCNAC_ID_OPTIMIZATION);
-#else
-        node_st *root = run_optimization(filepath, CCNAC_ID_OPTIMIZATION);
-#endif // __AFL_COMPILER
-#elif SLICE_TARGET == 5
-#ifdef __AFL_COMPILER
-        node_st *root = run_code_generation_buf(filepath, src, (uint32_t)len, NULL, NULL, 0, false);
-#else
-        node_st *root = run_code_generation(filepath, NULL, 0, false);
-#endif // __AFL_COMPILER
-#elif SLICE_TARGET == 6
-#ifdef __AFL_COMPILER
-        node_st *root = run_code_generation_buf(filepath, src, (uint32_t)len, NULL, NULL, 0, true);
-#else
-        node_st *root = run_code_generation(filepath, NULL, 0, true);
-#endif // __AFL_COMPILER
-#else
-        static_assert(false, "No valid slice target given to preprocessor");
-#endif
-        cleanup_nodes(root);
+        // An invalid input aborts only its own compilation, so the persistent loop continues
+        if (!recovery_run(run_slice, &input))
+        {
+            failures++;
+        }
 #ifdef AFL_LSAN_MODE
         __AFL_LEAK_CHECK();
 #endif
@@ -143,6 +169,6 @@ int main(int argc, char *argv[])
         free(src);
     }
 
-    CTIabortOnError();
-    return 0;
+    // Fails like a compilation of the single file if any of the files failed
+    return failures > 0 ? 1 : 0;
 }
@@ -5,11 +5,13 @@
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 
 extern "C"
 {
@@ -319,6 +321,25 @@ TEST_F(BehaviorTest_1, ArrayInit)
     ASSERT_EQ(237, instruction_count);
 }
 
+TEST_F(BehaviorTest_1, ArrayBulkInit)
+{
+    std::string filepaths[] = {"codegen/array_bulk_init/main.cvc"};
+    SetUp(filepaths);
+    ASSERT_NE(nullptr, root);
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+
+    const char *expected = "210\n"
+                           "0\n"
+                           "11\n"
+                           "184\n"
+                           "7\n"
+                           "8\n";
+
+    ASSERT_THAT(vm_output, testing::HasSubstr(expected));
+}
+
 TEST_F(BehaviorTest_1, Binops)
 {
     std::string filepaths[] = {"codegen/binops/main.cvc"};
@@ -389,6 +410,48 @@ TEST_F(BehaviorTest_1, Monops)
     ASSERT_EQ(23, instruction_count);
 }
 
+TEST_F(BehaviorTest_1, Instrumentation)
+{
+    std::string map =
+        std::filesystem::temp_directory_path().string() + "/civicc_instrumentation.map";
+    std::filesystem::remove(map);
+    std::string filepaths[] = {"codegen/instrumentation/main.cvc"};
+    struct test_options options = test_default_options();
+    options.instrument_output = map.c_str();
+    set_options(&options);
+    SetUp(filepaths);
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // One line per counter in the order of the ids
+    std::ifstream stream(map);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(stream, line);)
+    {
+        lines.push_back(line);
+    }
+    ASSERT_EQ(9, lines.size());
+    ASSERT_THAT(lines[0], testing::StartsWith("0 function collatz "));
+    ASSERT_THAT(lines[0], testing::HasSubstr("main.cvc:4:"));
+    ASSERT_THAT(lines[1], testing::StartsWith("1 loop collatz "));
+    ASSERT_THAT(lines[1], testing::HasSubstr("main.cvc:8:"));
+    ASSERT_THAT(lines[2], testing::StartsWith("2 then collatz "));
+    ASSERT_THAT(lines[3], testing::StartsWith("3 else collatz "));
+    ASSERT_THAT(lines[3], testing::HasSubstr("main.cvc:11:"));
+    ASSERT_THAT(lines[4], testing::StartsWith("4 join collatz "));
+    ASSERT_THAT(lines[5], testing::StartsWith("5 join collatz "));
+    ASSERT_THAT(lines[6], testing::StartsWith("6 function main "));
+    ASSERT_THAT(lines[7], testing::StartsWith("7 loop main "));
+    ASSERT_THAT(lines[8], testing::StartsWith("8 join main "));
+
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+
+    // The total of the collatz steps and the counts dumped before main returns
+    ASSERT_THAT(vm_output, testing::HasSubstr("8\n4\n8\n6\n2\n8\n4\n1\n3\n1\n"));
+}
+
 TEST_F(BehaviorTest_2, Suite_Arrays_ExternArrayArg)
 {
     std::string filepaths[] = {"testsuite_public/arrays/check_success/extern_array_arg.cvc",
@@ -1153,6 +1216,136 @@ TEST_F(BehaviorTestOpt_1, ArrayInit)
     ASSERT_EQ(2, instruction_count);
 }
 
+TEST_F(BehaviorTestOpt_1, ArrayBulkInit)
+{
+    std::string filepaths[] = {"codegen/array_bulk_init/main.cvc"};
+    SetUp(filepaths);
+    ASSERT_NE(nullptr, root);
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+
+    const char *expected = "210\n"
+                           "0\n"
+                           "11\n"
+                           "184\n"
+                           "7\n"
+                           "8\n";
+
+    ASSERT_THAT(vm_output, testing::HasSubstr(expected));
+}
+
+// Optimization that is off by default and turned on by an option.
+struct OptionCase
+{
+    const char *name;
+    const char *filepath;
+    const char *expected; // Output of the program, with and without the option
+    void (*enable)(struct test_options *options);
+    bool fewer_instructions; // The option reduces the executed instructions of the program
+};
+
+class BehaviorTestOption : public BehaviorTest<1, true>,
+                           public testing::WithParamInterface<OptionCase>
+{
+};
+
+TEST_P(BehaviorTestOption, Output)
+{
+    const OptionCase &option = GetParam();
+    std::string filepaths[] = {option.filepath};
+    size_t default_instruction_count = 0;
+    if (option.fewer_instructions)
+    {
+        SetUp(filepaths);
+        ASSERT_NE(nullptr, root);
+        Execute();
+        check_skip(skipped);
+        ASSERT_EQ(0, vm_status);
+        ASSERT_THAT(vm_output, testing::HasSubstr(option.expected));
+        default_instruction_count = instruction_count;
+
+        // Compile the same program again with the option
+        free(root_string[0]);
+        free(symbols_string[0]);
+        cleanup_nodes(root[0]);
+        root_string[0] = nullptr;
+        symbols_string[0] = nullptr;
+        root[0] = nullptr;
+        vm_output.clear();
+    }
+
+    struct test_options options = test_default_options();
+    option.enable(&options);
+    set_options(&options);
+    SetUp(filepaths);
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+    ASSERT_THAT(vm_output, testing::HasSubstr(option.expected));
+
+    if (option.fewer_instructions)
+    {
+        ASSERT_LT(instruction_count, default_instruction_count);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Options, BehaviorTestOption,
+    testing::Values(
+        OptionCase{"LoopUnrolling", "optimization/loop_unrolling/main.cvc", "146\n",
+                   [](struct test_options *options) { options->compiler.unroll_limit = 100; },
+                   true},
+        OptionCase{"FunctionInlining", "optimization/function_inlining/main.cvc", "130\n",
+                   [](struct test_options *options) { options->compiler.inline_limit = 50; },
+                   true},
+        OptionCase{"FunctionSpecialization", "optimization/function_specialization/main.cvc",
+                   "283\n",
+                   [](struct test_options *options) { options->compiler.specialize_limit = 200; },
+                   true},
+        OptionCase{"CallEvaluation", "optimization/call_evaluation/main.cvc",
+                   "6765\n1024\n4\n1\n2147483645\n6\n",
+                   [](struct test_options *options) { options->compiler.eval_limit = 1000000; },
+                   true},
+        OptionCase{"TailCalls", "optimization/tail_calls/main.cvc",
+                   "3628800 21 50005000 \n3 2 1 0 \n",
+                   [](struct test_options *options) { options->compiler.tail_calls = true; },
+                   false},
+        OptionCase{"ScalarPromotion", "optimization/scalar_promotion/main.cvc",
+                   "59\n10\n10\n60\n61\n62\n",
+                   [](struct test_options *options) { options->compiler.scalar_promotion = true; },
+                   false},
+        OptionCase{"ValueRanges", "optimization/value_ranges/main.cvc",
+                   "10\n0\n50\n100\n55\n103\n",
+                   [](struct test_options *options) { options->compiler.value_ranges = true; },
+                   false},
+        OptionCase{"SlotAllocation", "optimization/slot_allocation/main.cvc", "61\n",
+                   [](struct test_options *options) { options->compiler.slot_packing = true; },
+                   false}),
+    [](const testing::TestParamInfo<OptionCase> &info) { return std::string(info.param.name); });
+
+TEST_F(BehaviorTestOpt_1, LinkTimeOptimization)
+{
+    std::string directory = std::string(PROJECT_DIRECTORY) + "/test/data/optimization/link_time/";
+    std::string main_path = directory + "main.cvc";
+    std::string lib_path = directory + "lib.cvc";
+    const char *inputs[] = {main_path.c_str(), lib_path.c_str()};
+    std::string filepaths[] = {"optimization/link_time/main.cvc"};
+    struct test_options options = test_default_options();
+    options.lto_inputs = inputs;
+    options.lto_input_count = 2;
+    set_options(&options);
+    SetUp(filepaths);
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+    ASSERT_THAT(vm_output, testing::HasSubstr("22\n2\n3\n"));
+}
+
 TEST_F(BehaviorTestOpt_1, Binops)
 {
     std::string filepaths[] = {"codegen/binops/main.cvc"};
@@ -1881,6 +2074,33 @@ TEST_F(BehaviorTestOpt_4, Functional_Assignment01_Queens)
     ASSERT_THAT(vm_output, testing::HasSubstr(expected));
 }
 
+TEST_F(BehaviorTestOpt_2, InterfaceSummary)
+{
+    std::string summary =
+        std::filesystem::temp_directory_path().string() + "/civicc_interface_summary_2.cvsum";
+    std::string lib_path =
+        std::string(PROJECT_DIRECTORY) + "/test/data/optimization/interface_summary/lib.cvc";
+    struct test_options options = test_default_options();
+    options.summary_output = summary.c_str();
+    set_options(&options);
+    cleanup_nodes(run_context_analysis(lib_path.c_str()));
+
+    const char *inputs[] = {summary.c_str()};
+    std::string filepaths[] = {"optimization/interface_summary/lib.cvc",
+                               "optimization/interface_summary/main.cvc"};
+    options = test_default_options();
+    options.summary_inputs = inputs;
+    options.summary_input_count = 1;
+    set_options(&options);
+    SetUp(filepaths);
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    Execute();
+    check_skip(skipped);
+    ASSERT_EQ(0, vm_status);
+    ASSERT_THAT(vm_output, testing::HasSubstr("12\n2\n2\n"));
+}
+
 TEST_F(BehaviorTestOpt_2, Functional_Codegen_Paths)
 {
     std::string filepaths[] = {"functional/codegen_paths/main.cvc",
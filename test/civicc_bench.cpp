@@ -0,0 +1,175 @@
+#include "program_generator.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+#include "test_interface.h"
+}
+
+namespace
+{
+/// Part of the compiler that is measured, the stages before it run untimed.
+enum class Stage
+{
+    ScanParse,
+    ContextAnalysis,
+    CodeGenPreparation,
+    Optimization,
+    CodeGen,
+    Full, // All stages from the source to the assembly
+};
+
+const Stage stages[] = {Stage::ScanParse,    Stage::ContextAnalysis, Stage::CodeGenPreparation,
+                        Stage::Optimization, Stage::CodeGen,         Stage::Full};
+
+const ProgramShape shapes[] = {ProgramShape::Globals,        ProgramShape::DeepNesting,
+                               ProgramShape::LongExpressions, ProgramShape::ArrayInits,
+                               ProgramShape::LocalFunctions,  ProgramShape::StatementLists,
+                               ProgramShape::Mixed};
+
+const char *stage_name(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::ScanParse:
+        return "ScanParse";
+    case Stage::ContextAnalysis:
+        return "ContextAnalysis";
+    case Stage::CodeGenPreparation:
+        return "CodeGenPreparation";
+    case Stage::Optimization:
+        return "Optimization";
+    case Stage::CodeGen:
+        return "CodeGen";
+    case Stage::Full:
+        return "Full";
+    }
+    return "Unknown";
+}
+
+/// Generates each program once, the generation is not part of the measurement.
+const std::string &program(ProgramShape shape, size_t scale)
+{
+    static std::map<std::pair<ProgramShape, size_t>, std::string> programs;
+    auto key = std::make_pair(shape, scale);
+    auto found = programs.find(key);
+    if (found == programs.end())
+    {
+        found = programs.emplace(key, generate_program(shape, scale)).first;
+    }
+    return found->second;
+}
+
+node_st *run_before(Stage stage, const char *name, std::string &input)
+{
+    char *buffer = input.data();
+    uint32_t length = static_cast<uint32_t>(input.size());
+    switch (stage)
+    {
+    case Stage::ContextAnalysis:
+        return run_scan_parse_buf(name, buffer, length);
+    case Stage::CodeGenPreparation:
+        return run_context_analysis_buf(name, buffer, length);
+    case Stage::Optimization:
+        return run_code_gen_preparation_buf(name, buffer, length);
+    case Stage::CodeGen:
+        return run_optimization_buf(name, buffer, length, CCNAC_ID_OPTIMIZATION);
+    case Stage::ScanParse:
+    case Stage::Full:
+        break;
+    }
+    return nullptr;
+}
+
+node_st *run_stage(Stage stage, node_st *node, const char *name, std::string &input,
+                   std::vector<char> &output)
+{
+    char *buffer = input.data();
+    uint32_t length = static_cast<uint32_t>(input.size());
+    uint32_t output_length = static_cast<uint32_t>(output.size());
+    switch (stage)
+    {
+    case Stage::ScanParse:
+        return run_scan_parse_buf(name, buffer, length);
+    case Stage::ContextAnalysis:
+        return run_action_buf(node, CCNAC_ID_SEMANTICANALYSIS, nullptr, 0);
+    case Stage::CodeGenPreparation:
+        return run_action_buf(node, CCNAC_ID_CODEGENPREPARATION, nullptr, 0);
+    case Stage::Optimization:
+        return run_action_buf(node, CCNAC_ID_OPTIMIZATION, nullptr, 0);
+    case Stage::CodeGen:
+        return run_action_buf(node, CCNAC_ID_CODEGEN, output.data(), output_length);
+    case Stage::Full:
+        return run_code_generation_buf(name, buffer, length, nullptr, output.data(), output_length,
+                                       true);
+    }
+    return node;
+}
+
+void compile(benchmark::State &state, ProgramShape shape, Stage stage)
+{
+    const size_t scale = static_cast<size_t>(state.range(0));
+    const std::string &source = program(shape, scale);
+    const std::string name = std::string(shape_name(shape)) + ".cvc";
+    std::vector<char> output(std::max<size_t>(1 << 20, source.size() * 64));
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::string input = source;
+        node_st *node = run_before(stage, name.c_str(), input);
+        state.ResumeTiming();
+
+        node = run_stage(stage, node, name.c_str(), input, output);
+
+        state.PauseTiming();
+        cleanup_nodes(node);
+        state.ResumeTiming();
+    }
+
+    state.SetComplexityN(state.range(0));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+    state.counters["lines"] =
+        static_cast<double>(std::count(source.begin(), source.end(), '\n'));
+}
+} // namespace
+
+/**
+ * Measures each stage of the compiler on the generated programs of each shape at 1x to 1000x
+ * their base size. The complexity fit over the sizes gives the scaling curve of each stage, a
+ * single stage or shape is selected with e.g. --benchmark_filter=Optimization/DeepNesting.
+ */
+int main(int argc, char **argv)
+{
+    struct test_options options = test_default_options();
+    options.verbosity = 0;
+    set_options(&options);
+    for (Stage stage : stages)
+    {
+        for (ProgramShape shape : shapes)
+        {
+            std::string name = std::string(stage_name(stage)) + "/" + shape_name(shape);
+            benchmark::RegisterBenchmark(name, compile, shape, stage)
+                ->RangeMultiplier(10)
+                ->Range(1, 1000)
+                ->Complexity()
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,23 +1,37 @@
 #include "testutils.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 #ifdef __APPLE__
 #include <fcntl.h>
 #endif // __APPLE__
 
 extern "C"
 {
+#include "civicc.h"
+#include "compile_cache.h"
 #include "palm/str.h"
+#include "profiler.h"
+#include "server.h"
+#include "symbol_keys.h"
 #include "test_interface.h"
 #include "to_string.h"
 }
@@ -5890,3 +5904,495 @@ TEST_F(GenerationTest, EdgeCasesValid2)
 
     ASSERT_MLSTREQ(expected, output_buffer);
 }
+
+static std::string compile_to_string(const std::string &filepath, bool optimize)
+{
+    const uint32_t buffer_size = 4 * 1024 * 1024;
+    std::unique_ptr<char[]> buffer(new char[buffer_size]);
+    buffer[0] = '\0';
+    node_st *root = run_code_generation(filepath.c_str(), buffer.get(), buffer_size, optimize);
+    cleanup_nodes(root);
+    return std::string(buffer.get());
+}
+
+TEST(GenerationStressTest, ThreadedCompilation)
+{
+    // The programs of test/data that compile without errors
+    const char *directories[] = {"codegen",
+                                 "optimization",
+                                 "testsuite_public/basic/functional",
+                                 "testsuite_public/basic/check_success",
+                                 "testsuite_public/arrays/functional",
+                                 "testsuite_public/arrays/check_success",
+                                 "testsuite_public/nested_funs/functional",
+                                 "testsuite_public/nested_funs/check_success"};
+    std::vector<std::string> filepaths;
+    for (const char *directory : directories)
+    {
+        std::string path = std::string(PROJECT_DIRECTORY) + "/test/data/" + directory;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(path))
+        {
+            if (entry.path().extension() == ".cvc")
+            {
+                filepaths.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(filepaths.begin(), filepaths.end());
+    ASSERT_FALSE(filepaths.empty());
+
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+
+    // Each program is compiled with and without optimizations, twice on different threads
+    const size_t job_count = filepaths.size() * 4;
+    std::vector<std::string> expected(filepaths.size() * 2);
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        expected[i] = compile_to_string(filepaths[i / 2], i % 2 == 1);
+    }
+
+    // All state of a compilation, including the traversal stack of CoCoNut and the error counters
+    // of palm, is owned by the compiling thread. Only scanning and parsing take turns.
+    std::vector<std::string> outputs(job_count);
+    std::vector<std::thread> threads;
+    const size_t thread_count = 8;
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (size_t job = t; job < job_count; job += thread_count)
+                {
+                    size_t index = job % expected.size();
+                    outputs[job] = compile_to_string(filepaths[index / 2], index % 2 == 1);
+                }
+            });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    testing::internal::GetCapturedStdout();
+    testing::internal::GetCapturedStderr();
+
+    for (size_t job = 0; job < job_count; job++)
+    {
+        size_t index = job % expected.size();
+        ASSERT_EQ(expected[index], outputs[job])
+            << "Output differs for '" << filepaths[index / 2] << "'"
+            << (index % 2 == 1 ? " with optimizations" : "");
+    }
+}
+
+TEST(GenerationStressTest, ParallelFunctions)
+{
+    const char *filepaths[] = {"codegen/manual_example/main.cvc",
+                               "codegen/for_loops/main.cvc",
+                               "codegen/array_bulk_init/main.cvc",
+                               "codegen/edgecases/valid.cvc",
+                               "codegen/parallel_warnings/main.cvc",
+                               "testsuite_public/nested_funs/functional/nested_funs.cvc",
+                               "testsuite_public/nested_funs/functional/scopes.cvc",
+                               "optimization/function_inlining/main.cvc",
+                               "optimization/algebraic_simplification/main.cvc"};
+
+    testing::internal::CaptureStdout();
+    for (const char *filepath : filepaths)
+    {
+        std::string path = std::string(PROJECT_DIRECTORY) + "/test/data/" + filepath;
+        for (bool optimize : {false, true})
+        {
+            testing::internal::CaptureStderr();
+            std::string expected = compile_to_string(path, optimize);
+            std::string expected_err = testing::internal::GetCapturedStderr();
+
+            // The labels, constants and local functions are numbered as in the sequential output,
+            // the warnings are reported once in source order
+            testing::internal::CaptureStderr();
+            struct test_options options = test_default_options();
+            options.compiler.jobs = 4;
+            set_options(&options);
+            std::string output = compile_to_string(path, optimize);
+            reset_options();
+            std::string err_output = testing::internal::GetCapturedStderr();
+            EXPECT_EQ(expected, output)
+                << "Output differs for '" << filepath << "'"
+                << (optimize ? " with optimizations" : "");
+            EXPECT_EQ(expected_err, err_output)
+                << "Diagnostics differ for '" << filepath << "'"
+                << (optimize ? " with optimizations" : "");
+
+            if (!optimize && std::string(filepath) == "codegen/parallel_warnings/main.cvc")
+            {
+                size_t divisions = 0;
+                size_t steps = 0;
+                for (size_t pos = err_output.find("Division by zero"); pos != std::string::npos;
+                     pos = err_output.find("Division by zero", pos + 1))
+                {
+                    divisions++;
+                }
+                for (size_t pos = err_output.find("Step is '0'"); pos != std::string::npos;
+                     pos = err_output.find("Step is '0'", pos + 1))
+                {
+                    steps++;
+                }
+                EXPECT_EQ(2, divisions);
+                EXPECT_EQ(1, steps);
+                EXPECT_LT(err_output.find("a / 0;"), err_output.find("a / 0.0;"));
+            }
+        }
+    }
+    testing::internal::GetCapturedStdout();
+}
+
+TEST(GenerationStressTest, ParallelDiagnostics)
+{
+    std::string path = std::string(PROJECT_DIRECTORY) +
+                       "/test/data/optimization/parallel_diagnostics/main.cvc";
+
+    testing::internal::CaptureStderr();
+    std::string expected = compile_to_string(path, true);
+    std::string expected_err = testing::internal::GetCapturedStderr();
+
+    // The warnings of the functions are reported in source order, whichever thread folds them
+    testing::internal::CaptureStderr();
+    struct test_options options = test_default_options();
+    options.compiler.jobs = 4;
+    set_options(&options);
+    std::string output = compile_to_string(path, true);
+    reset_options();
+    std::string err_output = testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(expected, output);
+    EXPECT_EQ(expected_err, err_output);
+    EXPECT_THAT(err_output, testing::HasSubstr("Division by zero"));
+    EXPECT_THAT(err_output, testing::HasSubstr("Addition Overflow"));
+    EXPECT_THAT(err_output, testing::HasSubstr("Multiplication Overflow"));
+}
+
+TEST(ProfilerTest, TimeReportAndTrace)
+{
+    std::string path =
+        std::string(PROJECT_DIRECTORY) + "/test/data/optimization/constant_folding/main.cvc";
+    std::string trace_path = std::filesystem::temp_directory_path().string() + "/civicc_trace.json";
+
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    profiler_start();
+    std::string output = compile_to_string(path, true);
+    profiler_stop();
+    testing::internal::GetCapturedStdout();
+    testing::internal::GetCapturedStderr();
+
+    char *report = nullptr;
+    size_t report_size = 0;
+    FILE *report_stream = open_memstream(&report, &report_size);
+    ASSERT_NE(nullptr, report_stream);
+    profiler_report(report_stream);
+    fclose(report_stream);
+    ASSERT_TRUE(profiler_write_trace(trace_path.c_str()));
+    profiler_reset();
+
+    std::string report_string(report);
+    free(report);
+    EXPECT_THAT(report_string, testing::HasSubstr("Action"));
+    EXPECT_THAT(report_string, testing::HasSubstr("Optimization"));
+    EXPECT_THAT(report_string, testing::HasSubstr("Cycle iteration"));
+    EXPECT_THAT(report_string, testing::HasSubstr("Optimization #1"));
+
+    std::ifstream trace_file(trace_path);
+    std::string trace((std::istreambuf_iterator<char>(trace_file)),
+                      std::istreambuf_iterator<char>());
+    std::filesystem::remove(trace_path);
+    EXPECT_THAT(trace, testing::StartsWith("{\"traceEvents\":["));
+    EXPECT_THAT(trace, testing::HasSubstr("\"name\":\"Optimization #1\",\"cat\":\"cycle\""));
+    EXPECT_THAT(trace, testing::HasSubstr("\"ph\":\"X\""));
+    EXPECT_THAT(trace, testing::HasSubstr("\"nodes_before\":"));
+    EXPECT_THAT(trace, testing::HasSubstr("\"cycle_notifications\":"));
+}
+
+TEST(CompileCacheTest, LookupStoreAndEvict)
+{
+    std::filesystem::path directory =
+        std::filesystem::path(PROJECT_DIRECTORY) / "build/test_output/compile_cache";
+    std::filesystem::remove_all(directory);
+
+    std::string sources[] = {"export int main() { return 1; }", "export int main() { return 2; }",
+                             "export int main() { return 3; }"};
+    std::string outputs[] = {std::string(1000, 'a'), std::string(1000, 'b'),
+                             std::string(1000, 'c')};
+    char *keys[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        keys[i] = cache_key(sources[i].c_str(), sources[i].size());
+    }
+    EXPECT_STRNE(keys[0], keys[1]);
+
+    char *output = nullptr;
+    size_t output_length = 0;
+    EXPECT_FALSE(cache_lookup(directory.c_str(), keys[0], sources[0].c_str(), sources[0].size(),
+                              &output, &output_length));
+    ASSERT_TRUE(cache_store(directory.c_str(), keys[0], sources[0].c_str(), sources[0].size(),
+                            outputs[0].c_str(), outputs[0].size(), 1 << 20));
+    ASSERT_TRUE(cache_lookup(directory.c_str(), keys[0], sources[0].c_str(), sources[0].size(),
+                             &output, &output_length));
+    EXPECT_EQ(outputs[0], std::string(output, output_length));
+    free(output);
+
+    // A key of a different source is not a hit, even if the hashes would collide
+    EXPECT_FALSE(cache_lookup(directory.c_str(), keys[0], sources[1].c_str(), sources[1].size(),
+                              &output, &output_length));
+
+    // The second entry is the least recently used after the hit of the first one
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache_store(directory.c_str(), keys[1], sources[1].c_str(), sources[1].size(),
+                            outputs[1].c_str(), outputs[1].size(), 1 << 20));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache_lookup(directory.c_str(), keys[0], sources[0].c_str(), sources[0].size(),
+                             &output, &output_length));
+    free(output);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache_store(directory.c_str(), keys[2], sources[2].c_str(), sources[2].size(),
+                            outputs[2].c_str(), outputs[2].size(), 2500));
+
+    EXPECT_TRUE(cache_lookup(directory.c_str(), keys[0], sources[0].c_str(), sources[0].size(),
+                             &output, &output_length));
+    free(output);
+    EXPECT_FALSE(cache_lookup(directory.c_str(), keys[1], sources[1].c_str(), sources[1].size(),
+                              &output, &output_length));
+    EXPECT_TRUE(cache_lookup(directory.c_str(), keys[2], sources[2].c_str(), sources[2].size(),
+                             &output, &output_length));
+    free(output);
+
+    for (char *key : keys)
+    {
+        free(key);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+static int echo_request(int argc, char **argv, char *source, size_t source_length)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        printf("[%s]", argv[i]);
+    }
+    if (source != nullptr)
+    {
+        fprintf(stderr, "%.*s", (int)source_length, source);
+    }
+    if (argc > 1 && std::string(argv[1]) == "abort")
+    {
+        exit(7); // Like CTIabortOnError
+    }
+    return argc;
+}
+
+TEST(ServerTest, ForwardRequests)
+{
+    std::string socket_path = std::filesystem::temp_directory_path().string() + "/civicc_" +
+                              std::to_string(getpid()) + ".sock";
+    pid_t server = fork();
+    ASSERT_GE(server, 0);
+    if (server == 0)
+    {
+        _exit(server_run(socket_path.c_str(), echo_request));
+    }
+
+    const char *source = "int x;";
+    const char *args[] = {"civicc", "-nopt", "main.cvc"};
+    const char *abort_args[] = {"civicc", "abort", "main.cvc"};
+    int status = -1;
+    bool forwarded = false;
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    for (int i = 0; i < 100 && !forwarded; i++)
+    {
+        forwarded = server_forward(socket_path.c_str(), 3, const_cast<char **>(args), source,
+                                   strlen(source), &status);
+        if (!forwarded)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+    std::string err_output = testing::internal::GetCapturedStderr();
+    ASSERT_TRUE(forwarded);
+    EXPECT_EQ(3, status);
+    EXPECT_EQ("[civicc][-nopt][main.cvc]", output);
+    EXPECT_EQ(source, err_output);
+
+    // An aborted request does not end the server
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(server_forward(socket_path.c_str(), 3, const_cast<char **>(abort_args), nullptr,
+                               0, &status));
+    EXPECT_EQ(7, status);
+    EXPECT_TRUE(server_forward(socket_path.c_str(), 3, const_cast<char **>(args), nullptr, 0,
+                               &status));
+    EXPECT_EQ(3, status);
+    testing::internal::GetCapturedStdout();
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    EXPECT_FALSE(std::filesystem::exists(socket_path));
+    EXPECT_FALSE(server_forward(socket_path.c_str(), 3, const_cast<char **>(args), nullptr, 0,
+                                &status));
+}
+
+TEST(LibraryTest, CompileInMemory)
+{
+    std::string source = "extern void printInt(int val);\n"
+                         "int divide()\n"
+                         "{\n"
+                         "    return 7 / 0;\n"
+                         "}\n"
+                         "export int main()\n"
+                         "{\n"
+                         "    printInt(divide());\n"
+                         "    return 0;\n"
+                         "}\n";
+
+    civicc_result *result = civicc_compile("snippet.cvc", source.c_str(), source.size(), nullptr);
+    ASSERT_NE(nullptr, result);
+    EXPECT_TRUE(result->success);
+    std::string assembly(result->assembly, result->assembly_length);
+    EXPECT_THAT(assembly, testing::HasSubstr(".exportfun \"main\" int main"));
+    ASSERT_LE(1, result->diagnostic_count);
+    EXPECT_EQ(CIVICC_WARNING, result->diagnostics[0].severity);
+    EXPECT_EQ(4, result->diagnostics[0].first_line);
+    EXPECT_THAT(result->diagnostics[0].message, testing::HasSubstr("Division by zero"));
+    civicc_free_result(result);
+
+    // The output grows beyond any fixed buffer and the threads compile independently, the errors
+    // of one thread neither abort nor count for the compilations of the other threads
+    std::string big_source;
+    for (int i = 0; i < 2000; i++)
+    {
+        big_source += "int value" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+    std::string invalid_source = "export int main()\n{\n    return true;\n}\n";
+    civicc_options options = civicc_default_options();
+    options.optimize = false;
+    std::vector<std::thread> threads;
+    std::vector<size_t> lengths(8, 0);
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        threads.emplace_back([&, i]() {
+            for (int repeat = 0; repeat < 4; repeat++)
+            {
+                if (i % 2 == 1)
+                {
+                    civicc_result *invalid_result = civicc_compile(
+                        "invalid.cvc", invalid_source.c_str(), invalid_source.size(), &options);
+                    EXPECT_FALSE(invalid_result->success);
+                    EXPECT_LE(1, invalid_result->diagnostic_count);
+                    civicc_free_result(invalid_result);
+                    continue;
+                }
+
+                civicc_result *big_result =
+                    civicc_compile("big.cvc", big_source.c_str(), big_source.size(), &options);
+                EXPECT_TRUE(big_result->success);
+                EXPECT_EQ(0, big_result->diagnostic_count);
+                lengths[i] = big_result->assembly_length;
+                civicc_free_result(big_result);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_GT(lengths[0], 20000);
+    for (size_t i = 2; i < lengths.size(); i += 2)
+    {
+        EXPECT_EQ(lengths[0], lengths[i]);
+    }
+}
+
+TEST(LibraryTest, RecoverFromErrors)
+{
+    // A syntax error aborts in the parser and a type error after the context analysis
+    std::vector<std::string> invalid_sources = {
+        "export int main()\n{\n    return 0\n}\n",
+        "export int main()\n{\n    return true;\n}\n",
+    };
+    for (const std::string &source : invalid_sources)
+    {
+        civicc_result *result =
+            civicc_compile("invalid.cvc", source.c_str(), source.size(), nullptr);
+        ASSERT_NE(nullptr, result);
+        EXPECT_FALSE(result->success);
+        ASSERT_LE(1, result->diagnostic_count);
+        EXPECT_EQ(CIVICC_ERROR, result->diagnostics[result->diagnostic_count - 1].severity);
+        civicc_free_result(result);
+    }
+
+    // The process continues with the next compilation in a clean state
+    std::string source = "export int main()\n{\n    return 0;\n}\n";
+    civicc_result *result = civicc_compile("valid.cvc", source.c_str(), source.size(), nullptr);
+    ASSERT_NE(nullptr, result);
+    EXPECT_TRUE(result->success);
+    EXPECT_EQ(0, result->diagnostic_count);
+    std::string assembly(result->assembly, result->assembly_length);
+    EXPECT_THAT(assembly, testing::HasSubstr(".exportfun \"main\" int main"));
+    civicc_free_result(result);
+}
+
+TEST(LibraryTest, CompileTwice)
+{
+    // The function keys registered by a compilation are dropped when it ends or is aborted, so the
+    // next compilation of the thread starts with an empty registry
+    std::string invalid_source = "int twice(int x)\n"
+                                 "{\n"
+                                 "    int inner(int y)\n"
+                                 "    {\n"
+                                 "        return y + y;\n"
+                                 "    }\n"
+                                 "    return inner(x);\n"
+                                 "}\n"
+                                 "export int main()\n"
+                                 "{\n"
+                                 "    return twice(true);\n"
+                                 "}\n";
+    civicc_result *invalid_result = civicc_compile("invalid.cvc", invalid_source.c_str(),
+                                                   invalid_source.size(), nullptr);
+    ASSERT_NE(nullptr, invalid_result);
+    EXPECT_FALSE(invalid_result->success);
+    civicc_free_result(invalid_result);
+    EXPECT_EQ(0, symbol_keys_count());
+
+    std::string source = "int twice(int x)\n"
+                         "{\n"
+                         "    int inner(int y)\n"
+                         "    {\n"
+                         "        return y + y;\n"
+                         "    }\n"
+                         "    return inner(x);\n"
+                         "}\n"
+                         "int unused()\n"
+                         "{\n"
+                         "    return 1;\n"
+                         "}\n"
+                         "export int main()\n"
+                         "{\n"
+                         "    return twice(21);\n"
+                         "}\n";
+    std::string first_assembly;
+    for (int i = 0; i < 2; i++)
+    {
+        civicc_result *result = civicc_compile("valid.cvc", source.c_str(), source.size(), nullptr);
+        ASSERT_NE(nullptr, result);
+        EXPECT_TRUE(result->success) << "Compilation " << i;
+        EXPECT_EQ(0, symbol_keys_count()) << "Compilation " << i;
+        std::string assembly(result->assembly, result->assembly_length);
+        if (i == 0)
+        {
+            first_assembly = assembly;
+        }
+        EXPECT_EQ(first_assembly, assembly) << "Compilation " << i;
+        civicc_free_result(result);
+    }
+}
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 extern "C"
 {
@@ -399,7 +400,7 @@ TEST_F(OptimizationTest, AlgebraicSimplifications)
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_a4'\n"
-                           "┃        ┃     └─ Int -- val:'5'\n"
+                           "┃        ┃     └─ Int -- val:'-5'\n"
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_a5'\n"
@@ -617,7 +618,7 @@ TEST_F(OptimizationTest, AlgebraicSimplifications)
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_b'\n"
-                           "┃        ┃     └─ Var -- name:'@1_b'\n"
+                           "┃        ┃     └─ Int -- val:'0'\n"
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_b'\n"
@@ -626,8 +627,7 @@ TEST_F(OptimizationTest, AlgebraicSimplifications)
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_b'\n"
-                           "┃        ┃     └─ Monop -- op:'-'\n"
-                           "┃        ┃        └─ Var -- name:'@1_b'\n"
+                           "┃        ┃     └─ Int -- val:'0'\n"
                            "┃        ┣─ Statements\n"
                            "┃        ┃  └─ Assign\n"
                            "┃        ┃     ├─ Var -- name:'@1_g5'\n"
@@ -2199,6 +2199,517 @@ TEST_F(OptimizationTest, BranchEvaluation)
     ASSERT_MLSTREQ(expected, symbols_string);
 }
 
+TEST_F(OptimizationTest, LoopUnrolling)
+{
+    struct test_options options = test_default_options();
+    options.compiler.unroll_limit = 100;
+    set_options(&options);
+    SetUp("optimization/loop_unrolling/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // Only the partially unrolled loop remains, the fully unrolled loops are dead code.
+    std::string output = root_string;
+    size_t loop_count = 0;
+    for (size_t pos = output.find("ForLoop"); pos != std::string::npos;
+         pos = output.find("ForLoop", pos + 1))
+    {
+        loop_count++;
+    }
+    ASSERT_EQ(1, loop_count);
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("@for0_i")));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("@for2_i")));
+}
+
+TEST_F(OptimizationTest, LoopUnrolling_Cycles)
+{
+    // The loop of a single iteration is executed, the long loop is unrolled by at most the maximal
+    // factor over all cycles of the optimization
+    std::string source = "extern void printInt(int val);\n"
+                         "export int main()\n"
+                         "{\n"
+                         "    int sum = 0;\n"
+                         "    for (int i = 0, 1) {\n"
+                         "        printInt(i);\n"
+                         "    }\n"
+                         "    for (int i = 0, 1000) {\n"
+                         "        sum = sum + i;\n"
+                         "    }\n"
+                         "    return sum;\n"
+                         "}\n";
+
+    for (int limit : {0, 1000})
+    {
+        testing::internal::CaptureStdout();
+        testing::internal::CaptureStderr();
+        struct test_options options = test_default_options();
+        options.compiler.unroll_limit = limit;
+        set_options(&options);
+        root = run_optimization_buf("cycles.cvc", source.data(), (uint32_t)source.size(),
+                                    CCNAC_ID_OPTIMIZATION);
+        reset_options();
+        testing::internal::GetCapturedStderr();
+        testing::internal::GetCapturedStdout();
+        ASSERT_NE(nullptr, root);
+
+        int calls = 0;
+        std::vector<int> loop_sizes;
+        for (node_st *decls = PROGRAM_DECLS(root); decls != nullptr;
+             decls = DECLARATIONS_NEXT(decls))
+        {
+            node_st *decl = DECLARATIONS_DECL(decls);
+            if (NODE_TYPE(decl) != NT_FUNDEF)
+            {
+                continue;
+            }
+
+            for (node_st *stmts = FUNBODY_STMTS(FUNDEF_FUNBODY(decl)); stmts != nullptr;
+                 stmts = STATEMENTS_NEXT(stmts))
+            {
+                node_st *stmt = STATEMENTS_STMT(stmts);
+                calls += NODE_TYPE(stmt) == NT_PROCCALL;
+                if (NODE_TYPE(stmt) != NT_FORLOOP || FORLOOP_BLOCK(stmt) == nullptr)
+                {
+                    continue;
+                }
+
+                int size = 0;
+                for (node_st *block = FORLOOP_BLOCK(stmt); block != nullptr;
+                     block = STATEMENTS_NEXT(block))
+                {
+                    calls += NODE_TYPE(STATEMENTS_STMT(block)) == NT_PROCCALL;
+                    size++;
+                }
+                loop_sizes.push_back(size);
+            }
+        }
+
+        EXPECT_EQ(1, calls) << "Unroll limit " << limit;
+        if (limit > 0)
+        {
+            ASSERT_EQ(1, loop_sizes.size());
+            EXPECT_GE(loop_sizes[0], 2);
+            EXPECT_LE(loop_sizes[0], 8);
+        }
+
+        cleanup_nodes(root);
+        root = nullptr;
+    }
+}
+
+TEST_F(OptimizationTest, LoopUnrolling_Remainder)
+{
+    // Both loops run 13 iterations, which is not a multiple of any unroll factor. The unrolled loop
+    // ends after the last full group and the remaining iterations follow it with the constant
+    // values of the iterator.
+    struct LoopCase
+    {
+        std::string header;
+        int start;
+        int step;
+    };
+    const LoopCase loops[] = {{"int i = 2, 41, 3", 2, 3}, {"int i = 40, 1, -3", 40, -3}};
+    for (const LoopCase &loop : loops)
+    {
+        std::string source = "extern void printInt(int val);\n"
+                             "export void main()\n"
+                             "{\n"
+                             "    for (" + loop.header + ") {\n"
+                             "        printInt(i);\n"
+                             "    }\n"
+                             "}\n";
+
+        testing::internal::CaptureStdout();
+        testing::internal::CaptureStderr();
+        struct test_options options = test_default_options();
+        options.compiler.unroll_limit = 16;
+        set_options(&options);
+        root = run_optimization_buf("remainder.cvc", source.data(), (uint32_t)source.size(),
+                                    CCNAC_ID_OPTIMIZATION);
+        reset_options();
+        testing::internal::GetCapturedStderr();
+        testing::internal::GetCapturedStdout();
+        ASSERT_NE(nullptr, root);
+
+        node_st *loop_node = nullptr;
+        std::vector<int> remainder;
+        for (node_st *decls = PROGRAM_DECLS(root); decls != nullptr;
+             decls = DECLARATIONS_NEXT(decls))
+        {
+            node_st *decl = DECLARATIONS_DECL(decls);
+            if (NODE_TYPE(decl) != NT_FUNDEF || FUNDEF_FUNBODY(decl) == nullptr)
+            {
+                continue;
+            }
+
+            for (node_st *stmts = FUNBODY_STMTS(FUNDEF_FUNBODY(decl)); stmts != nullptr;
+                 stmts = STATEMENTS_NEXT(stmts))
+            {
+                node_st *stmt = STATEMENTS_STMT(stmts);
+                if (NODE_TYPE(stmt) == NT_FORLOOP)
+                {
+                    loop_node = stmt;
+                }
+                else if (NODE_TYPE(stmt) == NT_PROCCALL && loop_node != nullptr)
+                {
+                    node_st *arg = EXPRS_EXPR(PROCCALL_EXPRS(stmt));
+                    ASSERT_EQ(NT_INT, NODE_TYPE(arg)) << loop.header;
+                    remainder.push_back(INT_VAL(arg));
+                }
+            }
+        }
+        ASSERT_NE(nullptr, loop_node) << loop.header;
+
+        int factor = 0;
+        for (node_st *block = FORLOOP_BLOCK(loop_node); block != nullptr;
+             block = STATEMENTS_NEXT(block))
+        {
+            factor++;
+        }
+        ASSERT_GE(factor, 2) << loop.header;
+        ASSERT_NE(0, 13 % factor) << loop.header;
+
+        int unrolled = 13 / factor * factor;
+        ASSERT_EQ(NT_INT, NODE_TYPE(FORLOOP_COND(loop_node))) << loop.header;
+        EXPECT_EQ(loop.start + unrolled * loop.step, INT_VAL(FORLOOP_COND(loop_node)))
+            << loop.header;
+        ASSERT_NE(nullptr, FORLOOP_ITER(loop_node)) << loop.header;
+        ASSERT_EQ(NT_INT, NODE_TYPE(FORLOOP_ITER(loop_node))) << loop.header;
+        EXPECT_EQ(factor * loop.step, INT_VAL(FORLOOP_ITER(loop_node))) << loop.header;
+
+        std::vector<int> expected;
+        for (int k = unrolled; k < 13; k++)
+        {
+            expected.push_back(loop.start + k * loop.step);
+        }
+        EXPECT_EQ(expected, remainder) << loop.header;
+
+        cleanup_nodes(root);
+        root = nullptr;
+    }
+}
+
+TEST_F(OptimizationTest, FunctionInlining)
+{
+    struct test_options options = test_default_options();
+    options.compiler.inline_limit = 50;
+    set_options(&options);
+    SetUp("optimization/function_inlining/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // Every call is inlined, only the function headers use the names
+    std::string output = root_string;
+    const char *names[] = {"'@fun_square'", "'@fun_scale'", "'@fun_sum'", "'@fun_setOffset'",
+                           "'@fun_add'"};
+    for (const char *name : names)
+    {
+        size_t count = 0;
+        for (size_t pos = output.find(name); pos != std::string::npos;
+             pos = output.find(name, pos + 1))
+        {
+            count++;
+        }
+        ASSERT_EQ(1, count) << name;
+    }
+    ASSERT_THAT(output, testing::HasSubstr("@1_inl"));
+}
+
+TEST_F(OptimizationTest, FunctionSpecialization)
+{
+    // A limit below the size of any body only propagates the arguments every call agrees on
+    struct test_options options = test_default_options();
+    options.compiler.specialize_limit = 1;
+    set_options(&options);
+    SetUp("optimization/function_specialization/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    {
+        std::string output = root_string;
+        ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@1_factor'")));
+        ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@2_times'")));
+        ASSERT_THAT(output, testing::HasSubstr("'@1_low'"));
+        ASSERT_THAT(output, testing::Not(testing::HasSubstr("@fun__spec")));
+    }
+
+    free(root_string);
+    free(symbols_string);
+    cleanup_nodes(root);
+    root_string = nullptr;
+    symbols_string = nullptr;
+    root = nullptr;
+
+    // The calls in the loop are specialized first
+    options = test_default_options();
+    options.compiler.specialize_limit = 1000;
+    set_options(&options);
+    SetUp("optimization/function_specialization/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::HasSubstr("'@fun__spec0_clamp'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@fun__spec1_clamp'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@fun__spec2_clamp'"));
+}
+
+TEST_F(OptimizationTest, CallEvaluation)
+{
+    // The budget covers the loop of pow2, but not the recursion of fib
+    struct test_options options = test_default_options();
+    options.compiler.eval_limit = 1000;
+    set_options(&options);
+    SetUp("optimization/call_evaluation/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    {
+        std::string output = root_string;
+        ASSERT_THAT(output, testing::HasSubstr("Int -- val:'1024'"));
+        ASSERT_THAT(output, testing::Not(testing::HasSubstr("Int -- val:'6765'")));
+    }
+
+    free(root_string);
+    free(symbols_string);
+    cleanup_nodes(root);
+    root_string = nullptr;
+    symbols_string = nullptr;
+    root = nullptr;
+
+    options = test_default_options();
+    options.compiler.eval_limit = 1000000;
+    set_options(&options);
+    SetUp("optimization/call_evaluation/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::HasSubstr("Int -- val:'6765'"));
+    ASSERT_THAT(output, testing::HasSubstr("Int -- val:'1024'"));
+    ASSERT_THAT(output, testing::HasSubstr("Float -- val:'4.500000'"));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@fun_isEven'")));
+
+    // The overflowing and the global reading call remain
+    const char *names[] = {"'@fun_overflow'", "'@fun_readCounter'"};
+    for (const char *name : names)
+    {
+        size_t count = 0;
+        for (size_t pos = output.find(name); pos != std::string::npos;
+             pos = output.find(name, pos + 1))
+        {
+            count++;
+        }
+        ASSERT_EQ(2, count) << name;
+    }
+}
+
+TEST_F(OptimizationTest, TailCalls)
+{
+    struct test_options options = test_default_options();
+    options.compiler.tail_calls = true;
+    set_options(&options);
+    SetUp("optimization/tail_calls/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // Only the calls in main remain, each function is turned into a loop
+    std::string output = root_string;
+    const char *names[] = {"'@fun_factorial'", "'@fun_gcd'", "'@fun_sumTo'", "'@fun_countdown'"};
+    for (const char *name : names)
+    {
+        size_t count = 0;
+        for (size_t pos = output.find(name); pos != std::string::npos;
+             pos = output.find(name, pos + 1))
+        {
+            count++;
+        }
+        ASSERT_EQ(2, count) << name;
+    }
+
+    size_t loop_count = 0;
+    for (size_t pos = output.find("DoWhileLoop"); pos != std::string::npos;
+         pos = output.find("DoWhileLoop", pos + 1))
+    {
+        loop_count++;
+    }
+    ASSERT_EQ(4, loop_count);
+    ASSERT_THAT(output, testing::HasSubstr("@tail_acc"));
+}
+
+TEST_F(OptimizationTest, SlotAllocation)
+{
+    SetUp("optimization/slot_allocation/main.cvc");
+    ASSERT_NE(nullptr, root);
+    std::string unpacked = root_string;
+
+    // Compile the same program again with slot packing
+    free(root_string);
+    free(symbols_string);
+    cleanup_nodes(root);
+    root_string = nullptr;
+    symbols_string = nullptr;
+    root = nullptr;
+
+    struct test_options options = test_default_options();
+    options.compiler.slot_packing = true;
+    set_options(&options);
+    SetUp("optimization/slot_allocation/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    std::string packed = root_string;
+
+    // The iterators of the two for loops share a slot
+    auto count_vardecs = [](const std::string &output)
+    {
+        size_t count = 0;
+        for (size_t pos = output.find("VarDec"); pos != std::string::npos;
+             pos = output.find("VarDec", pos + 1))
+        {
+            count++;
+        }
+        return count;
+    };
+    ASSERT_LT(count_vardecs(packed), count_vardecs(unpacked));
+}
+
+TEST_F(OptimizationTest, ScalarPromotion)
+{
+    struct test_options options = test_default_options();
+    options.compiler.scalar_promotion = true;
+    set_options(&options);
+    SetUp("optimization/scalar_promotion/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // The loops with calls of side effects or of functions which could read the written global
+    // keep the global
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::HasSubstr("'@prom0_total'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@prom1_limit'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@prom2_sum'"));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@prom3_")));
+}
+
+TEST_F(OptimizationTest, ValueRanges)
+{
+    struct test_options options = test_default_options();
+    options.compiler.value_ranges = true;
+    set_options(&options);
+    SetUp("optimization/value_ranges/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // The branches of the decided comparisons are removed with their sentinel values
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("val:'11111'")));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("val:'22222'")));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("val:'33333'")));
+}
+
+TEST_F(OptimizationTest, LinkTimeOptimization)
+{
+    std::string directory = std::string(PROJECT_DIRECTORY) + "/test/data/optimization/link_time/";
+    std::string main_path = directory + "main.cvc";
+    std::string lib_path = directory + "lib.cvc";
+    const char *inputs[] = {main_path.c_str(), lib_path.c_str()};
+    struct test_options options = test_default_options();
+    options.lto_inputs = inputs;
+    options.lto_input_count = 2;
+    set_options(&options);
+    SetUp("optimization/link_time/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // The clashing counters are renamed, only main stays exported and the unused export is removed
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::HasSubstr("'counter_1'"));
+    ASSERT_THAT(output, testing::HasSubstr("'counter_2'"));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@fun_unused'")));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("GlobalDef -- has_export:'1'")));
+}
+
+TEST_F(OptimizationTest, InterfaceSummary)
+{
+    std::string summary =
+        std::filesystem::temp_directory_path().string() + "/civicc_interface_summary.cvsum";
+    std::filesystem::remove(summary);
+    struct test_options options = test_default_options();
+    options.summary_output = summary.c_str();
+    set_options(&options);
+    SetUp("optimization/interface_summary/lib.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+    ASSERT_TRUE(std::filesystem::exists(summary));
+
+    free(root_string);
+    free(symbols_string);
+    cleanup_nodes(root);
+    root_string = nullptr;
+    symbols_string = nullptr;
+    root = nullptr;
+
+    const char *inputs[] = {summary.c_str()};
+    options = test_default_options();
+    options.summary_inputs = inputs;
+    options.summary_input_count = 1;
+    set_options(&options);
+    SetUp("optimization/interface_summary/main.cvc");
+    reset_options();
+    ASSERT_NE(nullptr, root);
+
+    // The unused results of the pure calls are removed with their declarations. The scalar globals
+    // stay extern variables, which another module could write
+    std::string output = root_string;
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@fun_square'")));
+    ASSERT_THAT(output, testing::Not(testing::HasSubstr("'@fun_scaled'")));
+    ASSERT_THAT(output, testing::HasSubstr("'@0_scale'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@fun_bump'"));
+    ASSERT_THAT(output, testing::HasSubstr("'@0_counter'"));
+}
+
+TEST_F(OptimizationTest, DeadCodeElimination_LongFunction)
+{
+    // The dead stores are found in a single backward walk over the long statement list
+    const int count = 2000;
+    std::string source = "export int main()\n{\n    int a = 0;\n    int b = 0;\n";
+    for (int i = 0; i < count; i++)
+    {
+        source += "    a = a + 1;\n    b = a;\n";
+    }
+    source += "    return a;\n}\n";
+
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    root = run_optimization_buf("long.cvc", source.data(), (uint32_t)source.size(),
+                                CCNAC_ID_DEADCODEELIMINATION);
+    testing::internal::GetCapturedStderr();
+    testing::internal::GetCapturedStdout();
+    ASSERT_NE(nullptr, root);
+
+    int a_assigns = 0;
+    int b_assigns = 0;
+    for (node_st *decls = PROGRAM_DECLS(root); decls != nullptr; decls = DECLARATIONS_NEXT(decls))
+    {
+        node_st *decl = DECLARATIONS_DECL(decls);
+        if (NODE_TYPE(decl) != NT_FUNDEF)
+        {
+            continue;
+        }
+
+        for (node_st *stmts = FUNBODY_STMTS(FUNDEF_FUNBODY(decl)); stmts != nullptr;
+             stmts = STATEMENTS_NEXT(stmts))
+        {
+            node_st *stmt = STATEMENTS_STMT(stmts);
+            if (NODE_TYPE(stmt) != NT_ASSIGN)
+            {
+                continue;
+            }
+            std::string name = VAR_NAME(ASSIGN_VAR(stmt));
+            a_assigns += name.back() == 'a';
+            b_assigns += name.back() == 'b';
+        }
+    }
+    EXPECT_EQ(count + 1, a_assigns);
+    EXPECT_EQ(0, b_assigns);
+}
+
 // /////////////////////////
 // COMPILATION FAILURE tests
 // /////////////////////////
@@ -0,0 +1,403 @@
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "test_interface.h"
+}
+
+/// Code size and executed instructions of a program compiled with or without optimizations.
+struct Measurement
+{
+    bool valid = false;
+    std::string error; // Why the program could not be measured
+    size_t code_size = 0; // Sum of the modules in bytes
+    size_t instructions = 0;
+};
+
+struct ProgramResult
+{
+    Measurement nopt;
+    Measurement opt;
+};
+
+// Allowed growth of the code size and executed instructions over the baseline
+constexpr double default_threshold = 0.02;
+
+static const std::filesystem::path baseline_file =
+    std::filesystem::path(PROJECT_DIRECTORY) / "test/data/performance_baseline.csv";
+
+// Directories of programs that compile without errors, a program needs a main function to be run
+static const char *program_directories[] = {"codegen",
+                                            "optimization",
+                                            "testsuite_public/basic/functional",
+                                            "testsuite_public/arrays/functional",
+                                            "testsuite_public/nested_funs/functional"};
+
+// Programs of multiple modules, which join their files with '+'
+static const char *multi_module_programs[] = {
+    "functional/assignment_01/queens.cvc+functional/assignment_01/array.cvc+"
+    "functional/assignment_01/coreio.cvc+functional/assignment_01/core.cvc",
+    "functional/assignment_01/test.cvc+functional/assignment_01/array.cvc+"
+    "functional/assignment_01/core.cvc",
+    "functional/codegen_paths/main.cvc+functional/codegen_paths/exports.cvc",
+    "testsuite_public/arrays/check_success/extern_array_arg.cvc+"
+    "testsuite_public/arrays/check_success/export_array_arg.cvc",
+    "testsuite_public/arrays/combined_extern_array/main.cvc+"
+    "testsuite_public/arrays/combined_extern_array/defs.cvc",
+    "testsuite_public/basic/combined_extern_var/main.cvc+"
+    "testsuite_public/basic/combined_extern_var/defs.cvc",
+    "optimization/interface_summary/main.cvc+optimization/interface_summary/lib.cvc",
+    "optimization/link_time/main.cvc+optimization/link_time/lib.cvc"};
+
+// Programs with a main function that can not be measured
+static const char *excluded_programs[] = {
+    "codegen/extern/main.cvc",                      // Uses externs no module defines
+    "optimization/dead_code_elimination/main.cvc",  // Uses externs no module defines
+    "optimization/parallel_diagnostics/main.cvc"};  // Divides by zero at run time
+
+static std::vector<std::string> split(const std::string &str, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(str);
+    for (std::string part; std::getline(stream, part, separator);)
+    {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+static std::map<std::string, ProgramResult> read_baseline()
+{
+    std::map<std::string, ProgramResult> baseline;
+    std::ifstream stream(baseline_file);
+    bool header = true;
+    for (std::string line; std::getline(stream, line);)
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        if (header)
+        {
+            header = false;
+            continue;
+        }
+
+        std::vector<std::string> fields = split(line, ',');
+        if (fields.size() != 5)
+        {
+            ADD_FAILURE() << "Invalid baseline line: '" << line << "'";
+            continue;
+        }
+        ProgramResult &result = baseline[fields[0]];
+        result.nopt = {true, std::stoul(fields[1]), std::stoul(fields[2])};
+        result.opt = {true, std::stoul(fields[3]), std::stoul(fields[4])};
+    }
+    return baseline;
+}
+
+static void write_baseline(const std::map<std::string, ProgramResult> &results)
+{
+    // Keep the comments of the current baseline
+    std::string comments;
+    {
+        std::ifstream stream(baseline_file);
+        for (std::string line; std::getline(stream, line) && (line.empty() || line[0] == '#');)
+        {
+            comments += line + "\n";
+        }
+    }
+
+    std::ofstream stream(baseline_file);
+    stream << comments;
+    stream << "program,nopt_code_size,nopt_instructions,opt_code_size,opt_instructions\n";
+    for (const auto &[program, result] : results)
+    {
+        if (result.nopt.valid && result.opt.valid)
+        {
+            stream << program << "," << result.nopt.code_size << "," << result.nopt.instructions
+                   << "," << result.opt.code_size << "," << result.opt.instructions << "\n";
+        }
+    }
+}
+
+/// Finds the single module programs with a main function and adds the multi module programs. The
+/// excluded programs and the modules of the multi module programs are skipped.
+static std::vector<std::string> find_programs()
+{
+    const std::filesystem::path data_directory =
+        std::filesystem::path(PROJECT_DIRECTORY) / "test/data";
+    std::vector<std::string> skipped(std::begin(excluded_programs), std::end(excluded_programs));
+    for (const char *program : multi_module_programs)
+    {
+        std::vector<std::string> modules = split(program, '+');
+        skipped.insert(skipped.end(), modules.begin(), modules.end());
+    }
+
+    std::vector<std::string> programs;
+    for (const char *directory : program_directories)
+    {
+        for (const auto &entry :
+             std::filesystem::recursive_directory_iterator(data_directory / directory))
+        {
+            if (entry.path().extension() != ".cvc")
+            {
+                continue;
+            }
+
+            std::ifstream stream(entry.path());
+            std::string source((std::istreambuf_iterator<char>(stream)),
+                               std::istreambuf_iterator<char>());
+            std::string program =
+                std::filesystem::relative(entry.path(), data_directory).generic_string();
+            if (source.find("export int main") != std::string::npos &&
+                std::find(skipped.begin(), skipped.end(), program) == skipped.end())
+            {
+                programs.push_back(program);
+            }
+        }
+    }
+    programs.insert(programs.end(), std::begin(multi_module_programs),
+                    std::end(multi_module_programs));
+    std::sort(programs.begin(), programs.end());
+    return programs;
+}
+
+static std::string run_command(const std::string &command, int &exit_status)
+{
+    std::string output;
+    FILE *fd = popen(command.c_str(), "r");
+    if (fd == nullptr)
+    {
+        exit_status = -1;
+        return output;
+    }
+
+    char buf[1024];
+    while (fgets(buf, sizeof(buf), fd) != nullptr)
+    {
+        output += buf;
+    }
+    int status = pclose(fd);
+    exit_status = status == -1 || WIFSIGNALED(status) ? -1 : WEXITSTATUS(status);
+    return output;
+}
+
+/// Compiles, assembles and runs the modules of a program like BehaviorTest::Execute.
+static Measurement measure(const std::string &program, bool optimize)
+{
+    Measurement measurement;
+#if defined(PROGRAM_CIVVM) && defined(PROGRAM_CIVAS) && defined(HAS_PROG_TIMEOUT)
+    using namespace std::filesystem;
+    const path data_directory = path(PROJECT_DIRECTORY) / "test/data";
+    const path output_directory = path(PROJECT_DIRECTORY) / "build/test_output/performance" /
+                                  (optimize ? "opt" : "nopt");
+
+    std::string objects;
+    for (const std::string &module : split(program, '+'))
+    {
+        path output_file = output_directory / module;
+        create_directories(output_file.parent_path());
+        output_file.replace_extension(".s");
+
+        testing::internal::CaptureStdout();
+        testing::internal::CaptureStderr();
+        node_st *root = run_code_generation_file((data_directory / module).c_str(),
+                                                 output_file.c_str(), optimize);
+        testing::internal::GetCapturedStdout();
+        std::string err_output = testing::internal::GetCapturedStderr();
+        if (root == nullptr || err_output.find("error:") != std::string::npos)
+        {
+            measurement.error = "'" + module + "' does not compile:\n" + err_output;
+            if (root != nullptr)
+            {
+                cleanup_nodes(root);
+            }
+            return measurement;
+        }
+        cleanup_nodes(root);
+
+        path object_file = output_file;
+        object_file.replace_extension(".out");
+        int status = 0;
+        std::string output = run_command(PROGRAM_CIVAS + std::string(" 2>&1 -o ") +
+                                             object_file.string() + " " + output_file.string(),
+                                         status);
+        if (status != 0)
+        {
+            measurement.error = "'" + module + "' does not assemble:\n" + output;
+            return measurement;
+        }
+        objects += " " + object_file.string();
+    }
+
+#ifdef __APPLE__
+    std::string timeout_cmd = "gtimeout 3s ";
+#else
+    std::string timeout_cmd = "timeout 3s ";
+#endif // __APPLE__
+    // The exit status is the result of main, only a timeout or a signal is a failure
+    int status = 0;
+    std::string output =
+        run_command(timeout_cmd + PROGRAM_CIVVM + " 2>&1 --size --instrs " + objects, status);
+    if (status == -1 || status == 124)
+    {
+        measurement.error = status == 124 ? "Timeout" : "Killed by a signal";
+        return measurement;
+    }
+
+    std::stringstream stream(output);
+    std::string line;
+    for (size_t i = 0; i < split(program, '+').size() && std::getline(stream, line); i++)
+    {
+        size_t start = line.find(": ");
+        size_t end = line.rfind(" bytes");
+        if (start == std::string::npos || end == std::string::npos)
+        {
+            measurement.error = "No code size in the output of civvm:\n" + output;
+            return measurement;
+        }
+        measurement.code_size +=
+            std::strtoul(line.substr(start + 1, end - start).c_str(), nullptr, 10);
+    }
+
+    while (std::getline(stream, line))
+    {
+        size_t start = line.find("Instructions executed: ");
+        if (start != std::string::npos)
+        {
+            measurement.instructions = std::strtoul(line.substr(start + 23).c_str(), nullptr, 10);
+            measurement.valid = true;
+            break;
+        }
+    }
+    if (!measurement.valid)
+    {
+        measurement.error = "No executed instructions in the output of civvm:\n" + output;
+    }
+#else
+    (void)program;
+    (void)optimize;
+#endif // defined(PROGRAM_CIVVM) && defined(PROGRAM_CIVAS) && defined(HAS_PROG_TIMEOUT)
+    return measurement;
+}
+
+static double change(size_t before, size_t after)
+{
+    return before == 0 ? 0.0
+                       : (static_cast<double>(after) - static_cast<double>(before)) * 100.0 /
+                             static_cast<double>(before);
+}
+
+static void expect_no_regression(const std::string &program, const char *kind, const char *value,
+                                 size_t baseline, size_t measured, double threshold)
+{
+    EXPECT_LE(static_cast<double>(measured), static_cast<double>(baseline) * (1.0 + threshold))
+        << "Regression of the " << value << " of '" << program << "' " << kind << ": " << baseline
+        << " -> " << measured << " (" << std::showpos << std::fixed << std::setprecision(1)
+        << change(baseline, measured) << std::noshowpos << "%)";
+}
+
+/**
+ * Compiles each program without and with the optimizations and compares the code size and the
+ * executed VM instructions to the checked-in baseline. A growth above the threshold fails, the
+ * threshold in percent is set with CIVICC_PERF_THRESHOLD. An empty baseline, a program missing
+ * from the baseline and a program that can not be compiled or run fail as well.
+ * CIVICC_UPDATE_BASELINE=1 writes the measured values to the baseline instead. The table shows the
+ * improvement of the optimizations.
+ */
+TEST(PerformanceTest, GeneratedCode)
+{
+#if !(defined(PROGRAM_CIVVM) && defined(PROGRAM_CIVAS) && defined(HAS_PROG_TIMEOUT))
+    GTEST_SKIP() << "Missing civas, civvm or timeout to execute. Test is skipped!";
+#endif
+
+    double threshold = default_threshold;
+    if (const char *env = std::getenv("CIVICC_PERF_THRESHOLD"))
+    {
+        threshold = std::strtod(env, nullptr) / 100.0;
+    }
+    const char *update_env = std::getenv("CIVICC_UPDATE_BASELINE");
+    const bool update = update_env != nullptr && std::string(update_env) == "1";
+
+    std::map<std::string, ProgramResult> baseline = read_baseline();
+    if (baseline.empty() && !update)
+    {
+        FAIL() << "The baseline '" << baseline_file.string()
+               << "' is empty, generate it with CIVICC_UPDATE_BASELINE=1";
+    }
+    std::vector<std::string> programs = find_programs();
+    for (const auto &[program, result] : baseline)
+    {
+        if (std::find(programs.begin(), programs.end(), program) == programs.end())
+        {
+            programs.push_back(program);
+        }
+    }
+
+    std::map<std::string, ProgramResult> results;
+    std::cout << std::left << std::setw(64) << "Program" << std::right << std::setw(10) << "Size"
+              << std::setw(10) << "Size Opt" << std::setw(9) << "Change" << std::setw(12)
+              << "Instrs" << std::setw(12) << "Instrs Opt" << std::setw(9) << "Change" << "\n";
+    for (const std::string &program : programs)
+    {
+        ProgramResult result{measure(program, false), measure(program, true)};
+        if (!result.nopt.valid || !result.opt.valid)
+        {
+            ADD_FAILURE() << "Program '" << program << "' could not be measured "
+                          << (result.nopt.valid ? "with" : "without") << " optimizations: "
+                          << (result.nopt.valid ? result.opt.error : result.nopt.error);
+            continue;
+        }
+        results[program] = result;
+
+        std::cout << std::left << std::setw(64) << program << std::right << std::setw(10)
+                  << result.nopt.code_size << std::setw(10) << result.opt.code_size << std::setw(8)
+                  << std::fixed << std::setprecision(1)
+                  << change(result.nopt.code_size, result.opt.code_size) << "%" << std::setw(12)
+                  << result.nopt.instructions << std::setw(12) << result.opt.instructions
+                  << std::setw(8) << change(result.nopt.instructions, result.opt.instructions)
+                  << "%\n";
+
+        if (update)
+        {
+            continue;
+        }
+        auto found = baseline.find(program);
+        if (found == baseline.end())
+        {
+            ADD_FAILURE() << "Program '" << program
+                          << "' is missing from the baseline, add it with CIVICC_UPDATE_BASELINE=1";
+            continue;
+        }
+        const ProgramResult &expected = found->second;
+        expect_no_regression(program, "without optimizations", "code size",
+                             expected.nopt.code_size, result.nopt.code_size, threshold);
+        expect_no_regression(program, "without optimizations", "executed instructions",
+                             expected.nopt.instructions, result.nopt.instructions, threshold);
+        expect_no_regression(program, "with optimizations", "code size", expected.opt.code_size,
+                             result.opt.code_size, threshold);
+        expect_no_regression(program, "with optimizations", "executed instructions",
+                             expected.opt.instructions, result.opt.instructions, threshold);
+    }
+
+    if (update)
+    {
+        write_baseline(results);
+        std::cout << "Updated the baseline '" << baseline_file.string() << "'\n";
+    }
+}
@@ -0,0 +1,418 @@
+#include "program_generator.h"
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Limits per function or declaration, bigger scales add more of them instead
+constexpr size_t max_depth = 128;
+constexpr size_t max_terms = 256;
+constexpr size_t max_elements = 1024;
+constexpr size_t max_locals = 64;
+constexpr size_t max_statements = 2048;
+
+class ProgramWriter
+{
+  public:
+    std::ostringstream decls;
+    std::vector<std::string> calls; // Expressions of type int printed by main
+
+    void line(size_t indent, const std::string &text)
+    {
+        decls << std::string(indent * 4, ' ') << text << "\n";
+    }
+
+    std::string finish()
+    {
+        std::ostringstream program;
+        program << "extern void printInt(int val);\n";
+        program << "extern int scanInt();\n\n";
+        program << decls.str();
+        program << "export int main()\n{\n";
+        program << "    int n = scanInt();\n";
+        for (const std::string &call : calls)
+        {
+            program << "    printInt(" << call << ");\n";
+        }
+        program << "    return 0;\n}\n";
+        return program.str();
+    }
+};
+
+size_t chunks(size_t total, size_t limit)
+{
+    return (total + limit - 1) / limit;
+}
+
+size_t chunk_size(size_t total, size_t limit, size_t chunk)
+{
+    return std::min(limit, total - chunk * limit);
+}
+
+void write_globals(ProgramWriter &writer, size_t scale)
+{
+    const size_t count = 16 * scale;
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (i % 3)
+        {
+        case 0:
+            writer.line(0, "int g" + std::to_string(i) + " = " + std::to_string(i) + ";");
+            break;
+        case 1:
+            writer.line(0, "float g" + std::to_string(i) + " = " + std::to_string(i) + ".5;");
+            break;
+        default:
+            writer.line(0, "bool g" + std::to_string(i) + " = " + (i % 2 == 0 ? "true" : "false") +
+                               ";");
+            break;
+        }
+    }
+
+    writer.line(0, "");
+    writer.line(0, "int use_globals(int n)");
+    writer.line(0, "{");
+    writer.line(1, "int sum = n;");
+    writer.line(1, "float fsum = 0.0;");
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string name = "g" + std::to_string(i);
+        switch (i % 3)
+        {
+        case 0:
+            writer.line(1, "sum = sum + " + name + ";");
+            writer.line(1, name + " = sum;");
+            break;
+        case 1:
+            writer.line(1, "fsum = fsum + " + name + ";");
+            break;
+        default:
+            writer.line(1, "if (" + name + ") {");
+            writer.line(2, "sum = sum + 1;");
+            writer.line(1, "}");
+            break;
+        }
+    }
+    writer.line(1, "return sum + (int)fsum;");
+    writer.line(0, "}");
+    writer.line(0, "");
+    writer.calls.push_back("use_globals(n)");
+}
+
+void write_deep_nesting(ProgramWriter &writer, size_t scale)
+{
+    const size_t total = 8 * scale;
+    for (size_t chunk = 0; chunk < chunks(total, max_depth); chunk++)
+    {
+        const size_t depth = chunk_size(total, max_depth, chunk);
+        std::string name = "nest" + std::to_string(chunk);
+        writer.line(0, "int " + name + "(int n)");
+        writer.line(0, "{");
+        writer.line(1, "int r = 0;");
+        for (size_t level = 0; level < depth; level++)
+        {
+            std::string index = std::to_string(level);
+            switch (level % 3)
+            {
+            case 0:
+                writer.line(level + 1, "if (r < n) {");
+                break;
+            case 1:
+                writer.line(level + 1, "while (r < n) {");
+                break;
+            default:
+                writer.line(level + 1, "for (int i" + index + " = 0, n) {");
+                break;
+            }
+            writer.line(level + 2, "r = r + " + index + ";");
+        }
+        writer.line(depth + 1, "r = r * 2;");
+        for (size_t level = depth; level > 0; level--)
+        {
+            if ((level - 1) % 3 == 0)
+            {
+                writer.line(level, "} else {");
+                writer.line(level + 1, "r = r - 1;");
+            }
+            writer.line(level, "}");
+        }
+        writer.line(1, "return r;");
+        writer.line(0, "}");
+        writer.line(0, "");
+        writer.calls.push_back(name + "(n)");
+    }
+}
+
+std::string expression(size_t terms, size_t seed)
+{
+    static const char *const term_list[] = {"a", "b * c", "(a - c)", "3", "b", "(c + a) * 2"};
+    static const char *const operators[] = {" + ", " - ", " + ", " * "};
+    std::string result = "r";
+    for (size_t i = 0; i < terms; i++)
+    {
+        // Multiply only with a single variable, so the values stay small enough to read
+        size_t op = (seed + i) % 4;
+        result += operators[op];
+        result += op == 3 ? "a" : term_list[(seed + i) % 6];
+    }
+    return result;
+}
+
+void write_long_expressions(ProgramWriter &writer, size_t scale)
+{
+    const size_t total = 32 * scale;
+    const size_t statements_per_function = 16;
+    const size_t statement_count = chunks(total, max_terms);
+    for (size_t function = 0; function < chunks(statement_count, statements_per_function);
+         function++)
+    {
+        std::string name = "expr" + std::to_string(function);
+        writer.line(0, "int " + name + "(int a, int b, int c)");
+        writer.line(0, "{");
+        writer.line(1, "int r = a;");
+        writer.line(1, "bool t = false;");
+        for (size_t i = 0; i < chunk_size(statement_count, statements_per_function, function); i++)
+        {
+            size_t statement = function * statements_per_function + i;
+            size_t terms = chunk_size(total, max_terms, statement);
+            writer.line(1, "r = " + expression(terms, statement) + ";");
+            writer.line(1, "t = t && a < b || c >= r && !(a == c) || b != r;");
+        }
+        writer.line(1, "if (t) {");
+        writer.line(2, "r = -r;");
+        writer.line(1, "}");
+        writer.line(1, "return r;");
+        writer.line(0, "}");
+        writer.line(0, "");
+        writer.calls.push_back(name + "(n, n + 1, n - 1)");
+    }
+}
+
+void write_array_inits(ProgramWriter &writer, size_t scale)
+{
+    const size_t total = 64 * scale;
+    const size_t count = chunks(total, max_elements);
+    for (size_t array = 0; array < count; array++)
+    {
+        const size_t elements = chunk_size(total, max_elements, array);
+        std::string name = "arr" + std::to_string(array);
+        std::ostringstream init;
+        if (array % 3 == 2 && elements % 4 == 0)
+        {
+            // Two dimensional array with four rows
+            init << "int[4, " << elements / 4 << "] " << name << " = [";
+            for (size_t row = 0; row < 4; row++)
+            {
+                init << (row > 0 ? ", [" : "[");
+                for (size_t i = 0; i < elements / 4; i++)
+                {
+                    init << (i > 0 ? ", " : "") << row * elements / 4 + i;
+                }
+                init << "]";
+            }
+        }
+        else if (array % 3 == 1)
+        {
+            init << "float[" << elements << "] " << name << " = [";
+            for (size_t i = 0; i < elements; i++)
+            {
+                init << (i > 0 ? ", " : "") << i << ".25";
+            }
+        }
+        else
+        {
+            init << "int[" << elements << "] " << name << " = [";
+            for (size_t i = 0; i < elements; i++)
+            {
+                init << (i > 0 ? ", " : "") << i;
+            }
+        }
+        init << "];";
+        writer.line(0, init.str());
+    }
+
+    writer.line(0, "");
+    writer.line(0, "int use_arrays(int n)");
+    writer.line(0, "{");
+    writer.line(1, "int sum = n;");
+    for (size_t array = 0; array < count; array++)
+    {
+        const size_t elements = chunk_size(total, max_elements, array);
+        std::string name = "arr" + std::to_string(array);
+        if (array % 3 == 2 && elements % 4 == 0)
+        {
+            writer.line(1, "sum = sum + " + name + "[3, 0];");
+        }
+        else if (array % 3 == 1)
+        {
+            writer.line(1, "sum = sum + (int)" + name + "[" + std::to_string(elements - 1) + "];");
+        }
+        else
+        {
+            writer.line(1, "sum = sum + " + name + "[0];");
+        }
+    }
+    writer.line(1, "return sum;");
+    writer.line(0, "}");
+    writer.line(0, "");
+    writer.calls.push_back("use_arrays(n)");
+}
+
+void write_local_functions(ProgramWriter &writer, size_t scale)
+{
+    const size_t total = 8 * scale;
+    for (size_t chunk = 0; chunk < chunks(total, max_locals); chunk++)
+    {
+        const size_t count = chunk_size(total, max_locals, chunk);
+        std::string name = "outer" + std::to_string(chunk);
+        writer.line(0, "int " + name + "(int n)");
+        writer.line(0, "{");
+        writer.line(1, "int acc = n;");
+        for (size_t local = 0; local < count; local++)
+        {
+            std::string index = std::to_string(local);
+            writer.line(1, "int local" + index + "(int x)");
+            writer.line(1, "{");
+            if (local % 4 == 3)
+            {
+                writer.line(2, "int inner(int y)");
+                writer.line(2, "{");
+                writer.line(3, "return y + x + acc;");
+                writer.line(2, "}");
+                writer.line(2, "return inner(x + " + index + ");");
+            }
+            else if (local % 2 == 0)
+            {
+                // Uses the variable of the parent, which escapes into the frame
+                writer.line(2, "acc = acc + 1;");
+                writer.line(2, "return x + " + index + ";");
+            }
+            else
+            {
+                writer.line(2, "return x * " + index + ";");
+            }
+            writer.line(1, "}");
+        }
+        for (size_t local = 0; local < count; local++)
+        {
+            writer.line(1, "acc = local" + std::to_string(local) + "(acc);");
+        }
+        writer.line(1, "return acc;");
+        writer.line(0, "}");
+        writer.line(0, "");
+        writer.calls.push_back(name + "(n)");
+    }
+}
+
+void write_statement_lists(ProgramWriter &writer, size_t scale)
+{
+    const size_t total = 32 * scale;
+    const size_t variables = 8;
+    for (size_t chunk = 0; chunk < chunks(total, max_statements); chunk++)
+    {
+        const size_t count = chunk_size(total, max_statements, chunk);
+        std::string name = "stmts" + std::to_string(chunk);
+        writer.line(0, "int " + name + "(int n)");
+        writer.line(0, "{");
+        for (size_t v = 0; v < variables; v++)
+        {
+            writer.line(1, "int v" + std::to_string(v) + " = n + " + std::to_string(v) + ";");
+        }
+        writer.line(1, "bool t = false;");
+        for (size_t i = 0; i < count; i++)
+        {
+            std::string a = "v" + std::to_string(i % variables);
+            std::string b = "v" + std::to_string((i + 3) % variables);
+            std::string c = "v" + std::to_string((i + 5) % variables);
+            switch (i % 6)
+            {
+            case 0:
+                writer.line(1, a + " = " + b + " + " + std::to_string(i) + ";");
+                break;
+            case 1:
+                writer.line(1, a + " = " + b + " * 2 - " + c + ";");
+                break;
+            case 2:
+                writer.line(1, "if (" + a + " > " + b + ") {");
+                writer.line(2, c + " = " + c + " + 1;");
+                writer.line(1, "} else {");
+                writer.line(2, c + " = " + c + " - 1;");
+                writer.line(1, "}");
+                break;
+            case 3:
+                writer.line(1, "t = " + a + " < " + b + " || t;");
+                break;
+            case 4:
+                writer.line(1, a + " = (int)((float)" + b + " * 1.5);");
+                break;
+            default:
+                writer.line(1, "printInt(" + a + ");");
+                break;
+            }
+        }
+        writer.line(1, "if (t) {");
+        writer.line(2, "v0 = v0 + 1;");
+        writer.line(1, "}");
+        writer.line(1, "return v0;");
+        writer.line(0, "}");
+        writer.line(0, "");
+        writer.calls.push_back(name + "(n)");
+    }
+}
+} // namespace
+
+const char *shape_name(ProgramShape shape)
+{
+    switch (shape)
+    {
+    case ProgramShape::Globals:
+        return "Globals";
+    case ProgramShape::DeepNesting:
+        return "DeepNesting";
+    case ProgramShape::LongExpressions:
+        return "LongExpressions";
+    case ProgramShape::ArrayInits:
+        return "ArrayInits";
+    case ProgramShape::LocalFunctions:
+        return "LocalFunctions";
+    case ProgramShape::StatementLists:
+        return "StatementLists";
+    case ProgramShape::Mixed:
+        return "Mixed";
+    }
+    return "Unknown";
+}
+
+std::string generate_program(ProgramShape shape, size_t scale)
+{
+    ProgramWriter writer;
+    bool mixed = shape == ProgramShape::Mixed;
+    if (mixed || shape == ProgramShape::Globals)
+    {
+        write_globals(writer, scale);
+    }
+    if (mixed || shape == ProgramShape::DeepNesting)
+    {
+        write_deep_nesting(writer, scale);
+    }
+    if (mixed || shape == ProgramShape::LongExpressions)
+    {
+        write_long_expressions(writer, scale);
+    }
+    if (mixed || shape == ProgramShape::ArrayInits)
+    {
+        write_array_inits(writer, scale);
+    }
+    if (mixed || shape == ProgramShape::LocalFunctions)
+    {
+        write_local_functions(writer, scale);
+    }
+    if (mixed || shape == ProgramShape::StatementLists)
+    {
+        write_statement_lists(writer, scale);
+    }
+    return writer.finish();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// Shape of a generated program, each stresses different parts of the compiler.
+enum class ProgramShape
+{
+    Globals,         // Many global variables of all basic types
+    DeepNesting,     // Deeply nested ifs, whiles and for loops
+    LongExpressions, // Long arithmetic and boolean expressions
+    ArrayInits,      // Big global array initializations
+    LocalFunctions,  // Many local functions using the variables of their parent
+    StatementLists,  // Long lists of assignments, branches and calls
+    Mixed,           // All of the above
+};
+
+/// Gets the name of the shape for the benchmark names.
+const char *shape_name(ProgramShape shape);
+
+/// Generates a well-typed CiviC program of the given shape. The size grows linearly with the
+/// scale, a scale of 1 gives a program of roughly 50 to 100 lines. The main function reads its
+/// input with scanInt, so the optimizations can not evaluate the program.
+std::string generate_program(ProgramShape shape, size_t scale);
@@ -6,9 +6,39 @@
 #include "ccngen/enum.h"
 #include "global/globals.h"
 #include "palm/ctinfo.h"
+#include "recovery.h"
 #include <ccn/phase_driver.h>
 #include <stddef.h>
 
+static _Thread_local bool has_options = false;
+static _Thread_local struct test_options options;
+
+struct test_options test_default_options(void)
+{
+    struct test_options defaults = {
+        .compiler = civicc_default_options(),
+        .verbosity = -1,
+        .lto_inputs = NULL,
+        .lto_input_count = 0,
+        .summary_inputs = NULL,
+        .summary_input_count = 0,
+        .summary_output = NULL,
+        .instrument_output = NULL,
+    };
+    return defaults;
+}
+
+void set_options(const struct test_options *new_options)
+{
+    options = *new_options;
+    has_options = true;
+}
+
+void reset_options(void)
+{
+    has_options = false;
+}
+
 // What to do when a breakpoint is reached.
 void BreakpointHandler(node_st *root)
 {
@@ -19,7 +49,15 @@ void BreakpointHandler(node_st *root)
 
 node_st *run_scan_parse_buf(const char *filepath, char *buffer, uint32_t buffer_length)
 {
+    struct test_options current = has_options ? options : test_default_options();
     GLBinitializeGlobals();
+    GLBapplyOptions(&current.compiler);
+    global.lto_inputs = current.lto_inputs;
+    global.lto_input_count = current.lto_input_count;
+    global.summary_inputs = current.summary_inputs;
+    global.summary_input_count = current.summary_input_count;
+    global.summary_output = current.summary_output;
+    global.instrument_output = current.instrument_output;
     global.input_file = filepath;
     global.input_buf = buffer;
     global.input_buf_len = buffer_length;
@@ -27,6 +65,10 @@ node_st *run_scan_parse_buf(const char *filepath, char *buffer, uint32_t buffer_
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     phase_driver.verbosity = PD_V_HIGH;
 #endif
+    if (current.verbosity >= 0)
+    {
+        phase_driver.verbosity = (enum pd_verbosity)current.verbosity;
+    }
     node_st *node =
         CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_SPDOSCANPARSE), CCN_ROOT_TYPE, NULL, false);
     node = TRAVstart(node, TRAV_check); // Check for inconstientcies in the AST
@@ -43,6 +85,11 @@ node_st *run_context_analysis_buf(const char *filepath, char *buffer, uint32_t b
     node_st *node = run_scan_parse_buf(filepath, buffer, buffer_length);
     node =
         CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_SEMANTICANALYSIS), CCN_ROOT_TYPE, node, true);
+    if (global.summary_input_count > 0 || global.summary_output != NULL)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_INTERFACESUMMARY), CCN_ROOT_TYPE, node,
+                                 true);
+    }
     node = TRAVstart(node, TRAV_check); // Check for inconstientcies in the AST
     if (CTIgetErrors() > 0)
     {
@@ -61,7 +108,32 @@ node_st *run_optimization_buf(const char *filepath, char *buffer, uint32_t buffe
                               enum ccn_action_id opt_id)
 {
     node_st *node = run_code_gen_preparation_buf(filepath, buffer, buffer_length);
+    if (opt_id == CCNAC_ID_OPTIMIZATION && global.tail_calls_enabled)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_TAILCALLELIMINATION), CCN_ROOT_TYPE,
+                                 node, true);
+    }
+    if (opt_id == CCNAC_ID_OPTIMIZATION && global.inline_limit > 0)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_FUNCTIONINLINING), CCN_ROOT_TYPE, node,
+                                 true);
+    }
+    if (opt_id == CCNAC_ID_OPTIMIZATION && global.specialize_limit > 0)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_FUNCTIONSPECIALIZATION),
+                                 CCN_ROOT_TYPE, node, true);
+    }
     node = CCNdispatchAction(CCNgetActionFromID(opt_id), CCN_ROOT_TYPE, node, true);
+    if (opt_id == CCNAC_ID_OPTIMIZATION && global.scalar_promotion_enabled)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_SCALARPROMOTION), CCN_ROOT_TYPE, node,
+                                 true);
+    }
+    if (opt_id == CCNAC_ID_OPTIMIZATION && global.slot_packing_enabled)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_SLOTALLOCATION), CCN_ROOT_TYPE, node,
+                                 true);
+    }
     node = TRAVstart(node, TRAV_check); // Check for inconstientcies in the AST
     CTIabortOnError();
     return node;
@@ -102,6 +174,11 @@ node_st *run_code_generation_buf(const char *input_filepath, char *buffer, uint3
     global.output_file = output_filepath;
     global.output_buf = out_buffer;
     global.output_buf_len = out_buffer_length;
+    if (global.instrument_output != NULL)
+    {
+        node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_INSTRUMENTATION), CCN_ROOT_TYPE, node,
+                                 true);
+    }
     node = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_CODEGEN), CCN_ROOT_TYPE, node, true);
     node = TRAVstart(node, TRAV_check); // Check for inconstientcies in the AST
     return node;
@@ -132,8 +209,18 @@ node_st *run_code_generation_node(node_st *node, char *out_buffer, uint32_t out_
     return node;
 }
 
+node_st *run_action_buf(node_st *node, enum ccn_action_id action_id, char *out_buffer,
+                        uint32_t out_buffer_length)
+{
+    global.output_file = NULL;
+    global.output_buf = out_buffer;
+    global.output_buf_len = out_buffer_length;
+    return CCNdispatchAction(CCNgetActionFromID(action_id), CCN_ROOT_TYPE, node, true);
+}
+
 void cleanup_nodes(node_st *root)
 {
+    recovery_release(root);
     root = CCNdispatchAction(CCNgetActionFromID(CCNAC_ID_FREESYMBOLS), CCN_ROOT_TYPE, root, true);
     TRAVstart(root, TRAV_free);
 }
@@ -2,6 +2,20 @@
 
 #include <ccngen/action_handling.h>
 #include <ccngen/ast.h>
+#include "civicc.h"
+
+/// Options of the runs, the compiler options start from those of the command line compiler.
+struct test_options
+{
+    struct civicc_options compiler;
+    int verbosity; // Verbosity of the phase driver, a negative level keeps the high verbosity
+    const char **lto_inputs; // Modules linked into one program instead of parsing the input file
+    int lto_input_count;     // 0 compiles the input file on its own
+    const char **summary_inputs; // Interface summaries read for the extern declarations
+    int summary_input_count;
+    const char *summary_output;    // Interface summary of the exports, not written if NULL
+    const char *instrument_output; // Source locations of the block counters, no counters if NULL
+};
 
 node_st *run_scan_parse_buf(const char *filepath, char *buffer, uint32_t buffer_length);
 node_st *run_scan_parse(const char *filepath);
@@ -20,4 +34,14 @@ node_st *run_code_generation_file(const char *input_filepath, const char *output
 node_st *run_code_generation(const char *input_filepath, char *out_buffer,
                              uint32_t out_buffer_length, bool optimize);
 node_st *run_code_generation_node(node_st *node, char *out_buffer, uint32_t out_buffer_length);
+// Runs a single action on the tree of a previous run without the AST check, e.g. to measure it on
+// its own. The output of a code generation is written to the buffer.
+node_st *run_action_buf(node_st *node, enum ccn_action_id action_id, char *out_buffer,
+                        uint32_t out_buffer_length);
 void cleanup_nodes(node_st *root);
+// Gets the options of the runs that no options were set for.
+struct test_options test_default_options(void);
+// Uses the options in the following runs of the calling thread until they are reset.
+void set_options(const struct test_options *options);
+// Restores the default options of the following runs of the calling thread.
+void reset_options(void);